@@ -0,0 +1,115 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "include/arena.h"
+#include "include/splio.h"
+
+static ARENA_BLOCK *new_arena_block(ARENA *, size_t);
+
+ARENA *create_arena(const char *name, size_t block_size)
+{
+    ARENA *arena = (ARENA *)malloc(sizeof(ARENA));
+    if(arena == NULL) return NULL;
+    arena->name = name;
+    arena->blocks = NULL;
+    arena->block_size = block_size > 0 ? block_size : ARENA_BLOCK_SIZE;
+    arena->bytes_used = 0;
+    arena->bytes_reserved = 0;
+    arena->allocations = 0;
+    arena->heap_allocations = 0;
+    arena->heap_bytes = 0;
+    return arena;
+}
+
+static ARENA_BLOCK *new_arena_block(ARENA *arena, size_t min_size)
+{
+    size_t size = min_size > arena->block_size ? min_size : arena->block_size;
+    /* The header is rounded up so that the data following it keeps the arena alignment */
+    size_t header = (sizeof(ARENA_BLOCK) + ARENA_ALIGNMENT - 1) & ~(size_t)(ARENA_ALIGNMENT - 1);
+    ARENA_BLOCK *block = (ARENA_BLOCK *)malloc(header + size);
+    if(block == NULL) return NULL;
+    INFO("Arena \"%s\": new block of %zd bytes\n", arena->name, size)
+    block->data = (char *)block + header;
+    block->size = size;
+    block->used = 0;
+    block->next = arena->blocks;
+    arena->blocks = block;
+    arena->bytes_reserved += header + size;
+    arena->heap_allocations++;
+    arena->heap_bytes += header + size;
+    return block;
+}
+
+void *arena_alloc(ARENA *arena, size_t size)
+{
+    size_t aligned = (size + ARENA_ALIGNMENT - 1) & ~(size_t)(ARENA_ALIGNMENT - 1);
+    ARENA_BLOCK *block = arena->blocks;
+    if(block == NULL || block->size - block->used < aligned)
+    {
+        block = new_arena_block(arena, aligned);
+        if(block == NULL) return NULL;
+    }
+    void *ptr = block->data + block->used;
+    block->used += aligned;
+    arena->bytes_used += aligned;
+    arena->allocations++;
+    return ptr;
+}
+
+char *arena_strdup(ARENA *arena, const char *s)
+{
+    size_t len = strlen(s) + 1;
+    /* Strings do not need the full alignment, so pack them into the current block */
+    ARENA_BLOCK *block = arena->blocks;
+    if(block == NULL || block->size - block->used < len)
+    {
+        block = new_arena_block(arena, len);
+        if(block == NULL) return NULL;
+    }
+    char *copy = block->data + block->used;
+    memcpy(copy, s, len);
+    block->used += len;
+    arena->bytes_used += len;
+    arena->allocations++;
+    return copy;
+}
+
+void report_arena(FILE *output, ARENA *arena)
+{
+    if(arena == NULL) return;
+    fprintf(output, "Arena %-12s %10zd bytes used, %10zd bytes reserved, %8zd allocations\n",
+        arena->name, arena->bytes_used, arena->bytes_reserved, arena->allocations);
+}
+
+/* Release everything allocated so far but keep the newest block, so that an arena which is
+** reused for one compilation after another settles on a single block */
+void reset_arena(ARENA *arena)
+{
+    if(arena == NULL || arena->blocks == NULL) return;
+    ARENA_BLOCK *block = arena->blocks->next;
+    while(block != NULL)
+    {
+        ARENA_BLOCK *next = block->next;
+        free(block);
+        block = next;
+    }
+    size_t header = (sizeof(ARENA_BLOCK) + ARENA_ALIGNMENT - 1) & ~(size_t)(ARENA_ALIGNMENT - 1);
+    arena->blocks->next = NULL;
+    arena->blocks->used = 0;
+    arena->bytes_used = 0;
+    arena->bytes_reserved = header + arena->blocks->size;
+    arena->allocations = 0;
+}
+
+void destroy_arena(ARENA *arena)
+{
+    if(arena == NULL) return;
+    ARENA_BLOCK *block = arena->blocks;
+    while(block != NULL)
+    {
+        ARENA_BLOCK *next = block->next;
+        free(block);
+        block = next;
+    }
+    free(arena);
+}
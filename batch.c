@@ -0,0 +1,348 @@
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "include/batch.h"
+#include "include/compile.h"
+#include "include/compile_stats.h"
+#include "include/splio.h"
+
+/* Each worker owns a deque of jobs. It takes work from the front of its own deque and, once
+** that is empty, steals from the back of the others. Jobs are dealt out largest first, so the
+** long compilations start early and the short ones fill in the gaps at the end. No job is
+** added once the workers start, so a worker which finds every deque empty is finished. */
+typedef struct {
+    pthread_mutex_t lock;
+    BATCH_JOB **jobs;
+    int head;
+    int tail;
+} JOB_DEQUE;
+
+typedef struct {
+    JOB_DEQUE *deques;
+    int worker_count;
+    const COMPILE_OPTIONS *options; /* Given to every compile context */
+} BATCH;
+
+typedef struct {
+    BATCH *batch;
+    int id;
+    int compiled;
+    size_t bytes;
+    COMPILE_STATS *stats;       /* NULL unless the batch is collecting stats */
+    pthread_t thread;
+    int started;                /* The thread was created, and must be joined */
+} BATCH_WORKER;
+
+static BATCH_JOB *take_job(JOB_DEQUE *);
+static BATCH_JOB *steal_job(JOB_DEQUE *);
+static void run_job(COMPILE_CONTEXT *, BATCH_JOB *, BATCH_WORKER *);
+static void *run_worker(void *);
+static char *output_path_for(const char *, const char *, const char *);
+static int compare_job_size(const void *, const void *);
+static int compare_output_path(const void *, const void *);
+static int drop_shared_outputs(BATCH_JOB **, int);
+
+int default_job_count(void)
+{
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    return cpus > 0 ? (int)cpus : 1;
+}
+
+static BATCH_JOB *take_job(JOB_DEQUE *deque)
+{
+    BATCH_JOB *job = NULL;
+    pthread_mutex_lock(&deque->lock);
+    if(deque->head < deque->tail) job = deque->jobs[deque->head++];
+    pthread_mutex_unlock(&deque->lock);
+    return job;
+}
+
+static BATCH_JOB *steal_job(JOB_DEQUE *deque)
+{
+    BATCH_JOB *job = NULL;
+    pthread_mutex_lock(&deque->lock);
+    if(deque->head < deque->tail) job = deque->jobs[--deque->tail];
+    pthread_mutex_unlock(&deque->lock);
+    return job;
+}
+
+static void run_job(COMPILE_CONTEXT *ctx, BATCH_JOB *job, BATCH_WORKER *worker)
+{
+    size_t length;
+    char *source;
+    FILE *input;
+    if(job->output_path == NULL)
+    {
+        job->status = -1;
+        return;
+    }
+    if(worker->stats != NULL) worker->stats->label = job->source_path;
+    begin_phase(ctx, PHASE_READ);
+    input = fopen(job->source_path, "rb");
+    if(input == NULL)
+    {
+        fprintf(stderr, "%s: %s\n", job->source_path, strerror(errno));
+        end_phase(ctx, PHASE_READ);
+        job->status = -1;
+        return;
+    }
+    source = read_source(input, &length);
+    fclose(input);
+    end_phase(ctx, PHASE_READ);
+    if(source == NULL)
+    {
+        fprintf(stderr, "%s: could not be read\n", job->source_path);
+        job->status = -1;
+        return;
+    }
+
+    INFO("Worker %d compiling %s (%zd bytes)\n", worker->id, job->source_path, length)
+    job->status = compile_source(ctx, source, length);
+    free(source);
+    worker->bytes += length;
+    if(job->status != 0)
+    {
+        fprintf(stderr, "%s: compilation failed\n", job->source_path);
+        return;
+    }
+
+    /* The output file is only created once the program has compiled */
+    begin_phase(ctx, PHASE_WRITE);
+    FILE *output = fopen(job->output_path, "wb");
+    if(output == NULL || write_compiled_output(output, ctx) != 0)
+    {
+        fprintf(stderr, "%s: %s\n", job->output_path, strerror(errno));
+        if(output != NULL) fclose(output);
+        end_phase(ctx, PHASE_WRITE);
+        job->status = -1;
+        return;
+    }
+    fclose(output);
+    end_phase(ctx, PHASE_WRITE);
+    worker->compiled++;
+}
+
+static void *run_worker(void *arg)
+{
+    BATCH_WORKER *worker = (BATCH_WORKER *)arg;
+    BATCH *batch = worker->batch;
+    COMPILE_CONTEXT *ctx = create_compile_context();
+    if(ctx == NULL) return NULL;
+    ctx->stats = worker->stats;
+    ctx->options = *batch->options;
+    for(;;)
+    {
+        BATCH_JOB *job = take_job(&batch->deques[worker->id]);
+        int victim;
+        for(victim = 1; job == NULL && victim < batch->worker_count; victim++)
+        {
+            job = steal_job(&batch->deques[(worker->id + victim) % batch->worker_count]);
+        }
+        if(job == NULL) break;
+        run_job(ctx, job, worker);
+    }
+    destroy_compile_context(ctx);
+    return NULL;
+}
+
+/* "dir/name.spl" becomes "output_dir/name.c", or "dir/name.c" when there is no output directory.
+** The extension is ".c", or ".s" for assembly. */
+static char *output_path_for(const char *source_path, const char *output_dir, const char *output_extension)
+{
+    const char *name = strrchr(source_path, '/');
+    const char *base = name != NULL ? name + 1 : source_path;
+    const char *extension = strrchr(base, '.');
+    size_t stem_length = extension != NULL ? (size_t)(extension - base) : strlen(base);
+    const char *dir = output_dir;
+    size_t dir_length;
+    if(dir == NULL)
+    {
+        dir = source_path;
+        dir_length = (size_t)(base - source_path);
+    }
+    else dir_length = strlen(dir);
+    int needs_separator = dir_length > 0 && dir[dir_length - 1] != '/';
+
+    char *path = (char *)malloc(dir_length + needs_separator + stem_length + strlen(output_extension) + 1);
+    if(path == NULL) return NULL;
+    memcpy(path, dir, dir_length);
+    if(needs_separator) path[dir_length] = '/';
+    memcpy(path + dir_length + needs_separator, base, stem_length);
+    strcpy(path + dir_length + needs_separator + stem_length, output_extension);
+    return path;
+}
+
+/* Orders jobs by output path, with the jobs which have none first */
+static int compare_output_path(const void *a, const void *b)
+{
+    const char *left = (*(const BATCH_JOB * const *)a)->output_path;
+    const char *right = (*(const BATCH_JOB * const *)b)->output_path;
+    if(left == NULL || right == NULL) return (left != NULL) - (right != NULL);
+    return strcmp(left, right);
+}
+
+/* Sources with the same name in different directories would be written to the same output file,
+** each over the last. None of them is compiled; each loses its output path, so it fails without
+** being run. The jobs are left sorted by output path. Returns the number of jobs dropped. */
+static int drop_shared_outputs(BATCH_JOB **order, int job_count)
+{
+    int dropped = 0;
+    int first;
+    int last;
+    qsort(order, job_count, sizeof(BATCH_JOB *), compare_output_path);
+    for(first = 0; first < job_count; first = last)
+    {
+        for(last = first + 1; last < job_count && order[first]->output_path != NULL
+            && compare_output_path(&order[first], &order[last]) == 0; last++)
+        {
+            fprintf(stderr, "Error : %s and %s would both be written to %s\n",
+                order[first]->source_path, order[last]->source_path, order[first]->output_path);
+        }
+        if(last - first > 1)
+        {
+            int i;
+            for(i = first; i < last; i++)
+            {
+                free(order[i]->output_path);
+                order[i]->output_path = NULL;
+            }
+            dropped += last - first;
+        }
+    }
+    return dropped;
+}
+
+static int compare_job_size(const void *a, const void *b)
+{
+    const BATCH_JOB *left = *(const BATCH_JOB * const *)a;
+    const BATCH_JOB *right = *(const BATCH_JOB * const *)b;
+    if(left->size == right->size) return 0;
+    return left->size < right->size ? 1 : -1;
+}
+
+/* Compile every file on a pool of worker threads, each with its own compile context, then
+** print the throughput of the whole batch. Each worker collects its own stats, which are added
+** into stats, if given, once they have all finished. Returns the number of files which failed. */
+int compile_batch(char **files, int file_count, const char *output_dir, int worker_count, const COMPILE_OPTIONS *options, COMPILE_STATS *stats)
+{
+    BATCH batch;
+    BATCH_JOB *jobs;
+    BATCH_JOB **order;
+    BATCH_JOB **slots;
+    BATCH_WORKER *workers;
+    int i;
+    int started = 0;
+    int per_deque;
+    int compiled = 0;
+    int failed;
+    size_t bytes = 0;
+
+    if(file_count <= 0) return 0;
+    if(worker_count <= 0) worker_count = default_job_count();
+    if(worker_count > file_count) worker_count = file_count;
+    if(output_dir != NULL && mkdir(output_dir, 0777) != 0 && errno != EEXIST)
+    {
+        fprintf(stderr, "%s: %s\n", output_dir, strerror(errno));
+        return file_count;
+    }
+
+    jobs = (BATCH_JOB *)calloc(file_count, sizeof(BATCH_JOB));
+    order = (BATCH_JOB **)malloc(sizeof(BATCH_JOB *) * file_count);
+    /* Every deque has room for its share of the jobs, rounded up, in one block */
+    per_deque = file_count / worker_count + 1;
+    slots = (BATCH_JOB **)malloc(sizeof(BATCH_JOB *) * per_deque * worker_count);
+    batch.deques = (JOB_DEQUE *)calloc(worker_count, sizeof(JOB_DEQUE));
+    workers = (BATCH_WORKER *)calloc(worker_count, sizeof(BATCH_WORKER));
+    if(jobs == NULL || order == NULL || slots == NULL || batch.deques == NULL || workers == NULL)
+    {
+        fprintf(stderr, "Error : Out of memory for a batch of %d files\n", file_count);
+        free(jobs);
+        free(order);
+        free(slots);
+        free(batch.deques);
+        free(workers);
+        return file_count;
+    }
+    batch.worker_count = worker_count;
+    batch.options = options;
+
+    for(i = 0; i < file_count; i++)
+    {
+        struct stat info;
+        jobs[i].source_path = files[i];
+        jobs[i].output_path = output_path_for(files[i], output_dir, options->assembly ? ".s" : ".c");
+        jobs[i].size = stat(files[i], &info) == 0 ? (size_t)info.st_size : 0;
+        order[i] = &jobs[i];
+    }
+    drop_shared_outputs(order, file_count);
+    qsort(order, file_count, sizeof(BATCH_JOB *), compare_job_size);
+
+    /* Deal the jobs round robin, so each deque is also largest first */
+    for(i = 0; i < worker_count; i++)
+    {
+        pthread_mutex_init(&batch.deques[i].lock, NULL);
+        batch.deques[i].jobs = slots + (size_t)i * per_deque;
+    }
+    for(i = 0; i < file_count; i++)
+    {
+        JOB_DEQUE *deque = &batch.deques[i % worker_count];
+        deque->jobs[deque->tail++] = order[i];
+    }
+
+    double start = monotonic_seconds();
+    for(i = 0; i < worker_count; i++)
+    {
+        workers[i].batch = &batch;
+        workers[i].id = i;
+        if(stats != NULL)
+        {
+            workers[i].stats = (COMPILE_STATS *)malloc(sizeof(COMPILE_STATS));
+            if(workers[i].stats != NULL)
+            {
+                init_compile_stats(workers[i].stats, stats->tracing, stats->origin);
+                workers[i].stats->thread = i + 1;
+            }
+        }
+        int error = pthread_create(&workers[i].thread, NULL, run_worker, &workers[i]);
+        if(error != 0) fprintf(stderr, "Error : Could not start worker %d: %s\n", i, strerror(error));
+        else workers[i].started = 1;
+        started += workers[i].started;
+    }
+    /* The workers which did start steal the jobs of those which did not. If none started,
+    ** the first works through them all on this thread. */
+    if(started == 0) run_worker(&workers[0]);
+    for(i = 0; i < worker_count; i++)
+    {
+        if(workers[i].started) pthread_join(workers[i].thread, NULL);
+        compiled += workers[i].compiled;
+        bytes += workers[i].bytes;
+        if(workers[i].stats != NULL)
+        {
+            merge_compile_stats(stats, workers[i].stats);
+            free_compile_stats(workers[i].stats);
+            free(workers[i].stats);
+        }
+    }
+    double elapsed = monotonic_seconds() - start;
+    if(elapsed <= 0) elapsed = 1e-9;
+
+    /* This also counts jobs which were never picked up because no worker could create a context,
+    ** and those dropped for sharing an output file */
+    failed = file_count - compiled;
+    fprintf(stderr, "Compiled %d of %d files in %.3f s on %d threads: %.1f files/s, %.2f MB/s\n",
+        compiled, file_count, elapsed, worker_count, compiled / elapsed, bytes / elapsed / 1e6);
+
+    for(i = 0; i < worker_count; i++) pthread_mutex_destroy(&batch.deques[i].lock);
+    for(i = 0; i < file_count; i++) free(jobs[i].output_path);
+    free(slots);
+    free(jobs);
+    free(order);
+    free(batch.deques);
+    free(workers);
+    return failed;
+}
@@ -0,0 +1,85 @@
+#!/bin/sh
+# Time the programs --asm writes for loop-heavy SPL, assembled and linked by the C compiler
+# driver, against the C the compiler writes for them built at -O0 and at -O2: how much of the
+# speed of the generated programs is the C compiler's optimiser. Each is run RUNS times and the
+# fastest kept, and the outputs are checked against each other.
+#
+# usage: bench/asm_runtime.sh [path/to/spl]
+
+SPL=${1:-./spl}
+. "$(dirname "$0")/common.sh"
+
+write_program() {
+    case $1 in
+        runtime_by) cat <<'EOF'
+runtimeby : DECLARATIONS
+  n, s, i, j, step OF TYPE INTEGER;
+CODE
+  READ(n); READ(step); 0 -> s;
+  FOR i IS 1 BY step TO n DO
+    FOR j IS i BY step TO n DO s + i * j -> s ENDFOR
+  ENDFOR;
+  WRITE(s)
+ENDP runtimeby.
+EOF
+        ;;
+        bound_expr) cat <<'EOF'
+boundexpr : DECLARATIONS
+  n, s, i, j, k OF TYPE INTEGER;
+CODE
+  READ(n); READ(k); 0 -> s;
+  FOR i IS 1 BY 1 TO n * k / 100 DO
+    FOR j IS 1 BY 1 TO (n + k) * 20 DO s + (j - i) * k -> s ENDFOR
+  ENDFOR;
+  WRITE(s)
+ENDP boundexpr.
+EOF
+        ;;
+        real_while) cat <<'EOF'
+realwhile : DECLARATIONS
+  n, i OF TYPE INTEGER;
+  x, y OF TYPE REAL;
+CODE
+  READ(n); READ(i); 0.0 -> x; 1.0 -> y; 0 -> i;
+  WHILE i < n * 2000 DO
+    IF x < y THEN x + 0.25 -> x ELSE y * 2.0 -> y ENDIF;
+    i + 1 -> i
+  ENDWHILE;
+  WRITE(x, y)
+ENDP realwhile.
+EOF
+        ;;
+        invariant) cat <<'EOF'
+invariant : DECLARATIONS
+  n, s, i, a, b OF TYPE INTEGER;
+CODE
+  READ(n); READ(a); 0 -> s; 0 -> i; 3 -> b;
+  WHILE i < n * 4000 DO
+    s + (a * b + n) * (a - b) + i -> s;
+    i + 1 -> i
+  ENDWHILE;
+  WRITE(s)
+ENDP invariant.
+EOF
+        ;;
+    esac
+}
+
+# Run $WORK.exe, its output left in $WORK.out.$1
+run_program() {
+    printf '20000\n1\n' | "$WORK.exe" > "$WORK.out.$1"
+}
+
+printf "%-12s %10s %10s %10s\n" program asm "C -O0" "C -O2"
+for name in runtime_by bound_expr real_while invariant
+do
+    write_program "$name" > "$WORK.spl"
+    "$SPL" --asm < "$WORK.spl" > "$WORK.s" && "$CC" -o "$WORK.exe" "$WORK.s" || { echo "$name: --asm failed" >&2; exit 1; }
+    asm=$(best_time run_program asm) || { echo "$name: failed" >&2; exit 1; }
+    "$SPL" < "$WORK.spl" > "$WORK.c" && "$CC" -O0 -w -o "$WORK.exe" "$WORK.c" -lm || { echo "$name: C failed" >&2; exit 1; }
+    unoptimised=$(best_time run_program O0) || { echo "$name: failed at -O0" >&2; exit 1; }
+    "$CC" -O2 -w -o "$WORK.exe" "$WORK.c" -lm || exit 1
+    optimised=$(best_time run_program O2) || { echo "$name: failed at -O2" >&2; exit 1; }
+    cmp -s "$WORK.out.asm" "$WORK.out.O0" && cmp -s "$WORK.out.asm" "$WORK.out.O2" || { echo "$name: output differs from the C" >&2; exit 1; }
+    printf "%-12s %10.4f %10.4f %10.4f\n" "$name" "$asm" "$unoptimised" "$optimised"
+done
@@ -0,0 +1,54 @@
+# The harness the runtime benchmarks share, sourced once they have set SPL (and REFERENCE, where
+# there is one). It sets CC and RUNS from the environment, and WORK, the prefix of the scratch
+# files, which are removed on exit.
+
+CC=${CC:-cc}
+RUNS=${RUNS:-3}
+WORK=${TMPDIR:-/tmp}/spl_$(basename "$0" .sh).$$
+trap 'rm -f "$WORK".*' EXIT
+
+# Build $WORK.exe from the C the compiler $1 generates for $WORK.spl, at -O2
+build_program() {
+    "$1" < "$WORK.spl" > "$WORK.c" || return 1
+    "$CC" -O2 -w -o "$WORK.exe" "$WORK.c" -lm
+}
+
+# Run a command RUNS times and print the fastest run, in seconds
+best_time() {
+    best=
+    run=0
+    while [ "$run" -lt "$RUNS" ]
+    do
+        START=$(date +%s%N)
+        "$@" || return 1
+        END=$(date +%s%N)
+        best=$(awk -v ns="$((END - START))" -v best="$best" 'BEGIN { s = ns / 1e9; print (best == "" || s < best) ? s : best }')
+        run=$((run + 1))
+    done
+    echo "$best"
+}
+
+# Time each program named, as write_program writes it, with time_program "$SPL" new. Given a
+# REFERENCE compiler, time it with time_program "$REFERENCE" reference as well, check that
+# $WORK.out.new and $WORK.out.reference match, and report the speedup.
+time_programs() {
+    if [ -n "$REFERENCE" ]
+    then
+        printf "%-12s %10s %10s %8s\n" program seconds reference speedup
+    else
+        printf "%-12s %10s\n" program seconds
+    fi
+    for name
+    do
+        write_program "$name" > "$WORK.spl"
+        seconds=$(time_program "$SPL" new) || { echo "$name: failed" >&2; exit 1; }
+        if [ -z "$REFERENCE" ]
+        then
+            printf "%-12s %10.4f\n" "$name" "$seconds"
+            continue
+        fi
+        reference=$(time_program "$REFERENCE" reference) || { echo "$name: failed with the reference" >&2; exit 1; }
+        cmp -s "$WORK.out.new" "$WORK.out.reference" || { echo "$name: output differs from the reference" >&2; exit 1; }
+        awk -v n="$name" -v s="$seconds" -v r="$reference" 'BEGIN { printf "%-12s %10.4f %10.4f %7.2fx\n", n, s, r, (s > 0 ? r / s : 0) }'
+    done
+}
@@ -0,0 +1,93 @@
+#!/bin/sh
+# Compile a set of synthetic programs (see bench/splgen.sh) and report the lex, parse, optimise,
+# lower and generate times and the peak RSS of each, as measured by --stats. Every program is compiled
+# RUNS times and the smallest of each figure kept. The results are compared against the stored
+# baseline, and the script fails if any has grown by more than TOLERANCE (a fraction) and, for
+# times, by more than a millisecond. -u stores the results as the new baseline instead.
+#
+# The baseline belongs to the machine it was taken on; store a new one before comparing elsewhere.
+#
+# usage: bench/compiler_throughput.sh [-u] [path/to/spl]
+
+BENCH=$(dirname "$0")
+BASELINE=${BASELINE:-$BENCH/baseline.txt}
+RUNS=${RUNS:-5}
+TOLERANCE=${TOLERANCE:-0.25}
+UPDATE=0
+if [ "$1" = "-u" ]; then UPDATE=1; shift; fi
+SPL=${1:-./spl}
+WORK=${TMPDIR:-/tmp}/spl_compiler_throughput.$$
+trap 'rm -f "$WORK".*' EXIT
+
+# name, then the splgen options: declarations, depth, operands, writes, blocks
+SCALES="small        50    3   20     50     20
+declarations 50000 2   5      10     10
+nesting      50    60  5      10     200
+expressions  50    2   20000  10     20
+writes       200   2   5      50000  1
+mixed        5000  6   200    5000   500"
+
+# Pull one number out of the --stats=json report
+field() {
+    sed -n "s/.*\"$1\": {\"seconds\": \([0-9.e+-]*\).*/\1/p; s/.*\"$1\": \([0-9]*\),.*/\1/p" "$WORK.json"
+}
+
+echo "$SCALES" | while read -r name decls depth operands writes blocks
+do
+    sh "$BENCH/splgen.sh" -d "$decls" -n "$depth" -e "$operands" -w "$writes" -b "$blocks" > "$WORK.spl"
+    run=0
+    while [ "$run" -lt "$RUNS" ]
+    do
+        "$SPL" --stats=json < "$WORK.spl" > "$WORK.c" 2> "$WORK.json" || { cat "$WORK.json" >&2; exit 1; }
+        echo "$name $(field lex) $(field parse) $(field optimise) $(field lower) $(field generate) $(field peak_rss_kb)"
+        run=$((run + 1))
+    done
+done > "$WORK.runs" || exit 1
+
+awk '
+    !($1 in seen) { seen[$1] = 1; order[++count] = $1; for(c = 2; c <= 7; c++) best[$1, c] = $c; next }
+    { for(c = 2; c <= 7; c++) if($c < best[$1, c]) best[$1, c] = $c }
+    END {
+        for(i = 1; i <= count; i++)
+        {
+            n = order[i]
+            printf "%-12s %10.6f %10.6f %10.6f %10.6f %10.6f %10d\n", n, best[n, 2], best[n, 3], best[n, 4], best[n, 5], best[n, 6], best[n, 7]
+        }
+    }' "$WORK.runs" > "$WORK.results"
+
+if [ "$UPDATE" -eq 1 ]
+then
+    {
+        echo "# name lex parse optimise lower generate peak_rss_kb, from bench/compiler_throughput.sh -u"
+        cat "$WORK.results"
+    } > "$BASELINE"
+    cat "$WORK.results"
+    echo "Stored the baseline in $BASELINE"
+    exit 0
+fi
+
+[ -f "$BASELINE" ] || { echo "No baseline at $BASELINE; store one with -u" >&2; exit 1; }
+awk -v tolerance="$TOLERANCE" '
+    BEGIN {
+        split("lex parse optimise lower generate peak_rss_kb", columns, " ")
+        printf "%-12s", "program"
+        for(c = 1; c <= 6; c++) printf " %18s", columns[c]
+        printf "\n"
+    }
+    FNR == NR { if($1 !~ /^#/) for(c = 2; c <= 7; c++) base[$1, c] = $c; next }
+    {
+        printf "%-12s", $1
+        for(c = 2; c <= 7; c++)
+        {
+            old = base[$1, c]
+            ratio = old > 0 ? $c / old : 1
+            worse = ($1, c) in base && ratio > 1 + tolerance && (c == 7 || $c - old > 0.001)
+            if(worse) regressions++
+            printf c == 7 ? " %10d x%5.2f%s" : " %10.6f x%5.2f%s", $c, ratio, worse ? "!" : " "
+        }
+        printf "\n"
+    }
+    END {
+        if(regressions) { printf "%d measurements regressed by more than %d%%\n", regressions, tolerance * 100; exit 1 }
+        print "No regressions against the baseline"
+    }' "$BASELINE" "$WORK.results"
@@ -0,0 +1,26 @@
+#!/bin/sh
+# Time the compiler on one assignment whose expression has N operands, doubling N each run.
+# Code generation is linear when the time per operand stays roughly flat as N grows.
+#
+# usage: bench/expression_scaling.sh [path/to/spl] [smallest N] [largest N]
+
+SPL=${1:-./spl}
+N=${2:-10000}
+MAX=${3:-320000}
+WORK=${TMPDIR:-/tmp}/spl_expression_scaling.$$
+trap 'rm -f "$WORK.spl" "$WORK.c"' EXIT
+
+printf "%10s %12s %14s\n" operands seconds "ns/operand"
+while [ "$N" -le "$MAX" ]
+do
+    awk -v n="$N" 'BEGIN {
+        printf "scaling : DECLARATIONS x, y OF TYPE INTEGER; CODE READ(x); x"
+        for(i = 1; i < n; i++) printf(i % 3 ? " + x" : " * x")
+        printf " -> y; WRITE(y) ENDP scaling.\n"
+    }' > "$WORK.spl"
+    START=$(date +%s%N)
+    "$SPL" < "$WORK.spl" > "$WORK.c" || exit 1
+    END=$(date +%s%N)
+    awk -v n="$N" -v ns="$((END - START))" 'BEGIN { printf "%10d %12.3f %14.1f\n", n, ns / 1e9, ns / n }'
+    N=$((N * 2))
+done
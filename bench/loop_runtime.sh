@@ -0,0 +1,64 @@
+#!/bin/sh
+# Time the programs the compiler generates for loop-heavy SPL, built by the C compiler at -O2.
+# Each is run RUNS times and the fastest kept. Given a second compiler, its programs are timed
+# as well, their output checked against the first's, and the speedup reported.
+#
+# usage: bench/loop_runtime.sh [path/to/spl] [path/to/reference/spl]
+
+SPL=${1:-./spl}
+REFERENCE=$2
+. "$(dirname "$0")/common.sh"
+
+# Each program reads its bounds, so neither compiler can work the loops out in advance
+write_program() {
+    case $1 in
+        runtime_by) cat <<'EOF'
+runtimeby : DECLARATIONS
+  n, s, i, j, step OF TYPE INTEGER;
+CODE
+  READ(n); READ(step); 0 -> s;
+  FOR i IS 1 BY step TO n DO
+    FOR j IS i BY step TO n DO s + i * j -> s ENDFOR
+  ENDFOR;
+  WRITE(s)
+ENDP runtimeby.
+EOF
+        ;;
+        bound_expr) cat <<'EOF'
+boundexpr : DECLARATIONS
+  n, s, i, j, k OF TYPE INTEGER;
+CODE
+  READ(n); READ(k); 0 -> s;
+  FOR i IS 1 BY 1 TO n * k / 100 DO
+    FOR j IS 1 BY 1 TO (n + k) * 20 DO s + (j - i) * k -> s ENDFOR
+  ENDFOR;
+  WRITE(s)
+ENDP boundexpr.
+EOF
+        ;;
+        invariant) cat <<'EOF'
+invariant : DECLARATIONS
+  n, s, i, a, b OF TYPE INTEGER;
+CODE
+  READ(n); READ(a); 0 -> s; 0 -> i; 3 -> b;
+  WHILE i < n * 4000 DO
+    s + (a * b + n) * (a - b) + i -> s;
+    i + 1 -> i
+  ENDWHILE;
+  WRITE(s)
+ENDP invariant.
+EOF
+        ;;
+    esac
+}
+
+run_program() {
+    printf '20000\n1\n' | "$WORK.exe" > "$WORK.out.$1"
+}
+
+# Best run time in seconds of the program one compiler makes of $WORK.spl
+time_program() {
+    build_program "$1" && best_time run_program "$2"
+}
+
+time_programs runtime_by bound_expr invariant
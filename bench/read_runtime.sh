@@ -0,0 +1,112 @@
+#!/bin/sh
+# Time the programs the compiler generates for input-heavy SPL, built by the C compiler at -O2,
+# each reading COUNT values, once with its input redirected from a file and once through a pipe.
+# Each is run RUNS times and the fastest kept. Given a second compiler, its programs are timed as
+# well, their output checked against the first's, and the speedups reported.
+#
+# usage: bench/read_runtime.sh [path/to/spl] [path/to/reference/spl]
+
+SPL=${1:-./spl}
+REFERENCE=$2
+COUNT=${COUNT:-2000000}
+. "$(dirname "$0")/common.sh"
+
+# Each program reads how many values follow, then sums or counts them
+write_program() {
+    case $1 in
+        integers) cat <<'EOF'
+integers : DECLARATIONS
+  n, i, x, s OF TYPE INTEGER;
+CODE
+  READ(n); 0 -> s;
+  FOR i IS 1 BY 1 TO n DO
+    READ(x); s + x -> s
+  ENDFOR;
+  WRITE(s)
+ENDP integers.
+EOF
+        ;;
+        reals) cat <<'EOF'
+reals : DECLARATIONS
+  n, i OF TYPE INTEGER;
+  x, s OF TYPE REAL;
+CODE
+  READ(n); 0.0 -> s;
+  FOR i IS 1 BY 1 TO n DO
+    READ(x); s + x -> s
+  ENDFOR;
+  WRITE(s)
+ENDP reals.
+EOF
+        ;;
+        characters) cat <<'EOF'
+characters : DECLARATIONS
+  n, i, k OF TYPE INTEGER;
+  c OF TYPE CHARACTER;
+CODE
+  READ(n); 0 -> k;
+  FOR i IS 1 BY 1 TO n DO
+    READ(c);
+    IF c = 'y' THEN k + 1 -> k ENDIF
+  ENDFOR;
+  WRITE(k)
+ENDP characters.
+EOF
+        ;;
+    esac
+}
+
+# The input for one program: COUNT, then COUNT values of its type
+write_input() {
+    awk -v kind="$1" -v n="$COUNT" 'BEGIN {
+        srand(1);
+        print n;
+        for(i = 0; i < n; i++)
+        {
+            if(kind == "integers") print int(rand() * 2000000) - 1000000;
+            else if(kind == "reals") printf "%.6f\n", rand() * 2000 - 1000;
+            else printf "%c%s", substr("xyz", int(rand() * 3) + 1, 1), i % 40 == 39 ? "\n" : " ";
+        }
+    }'
+}
+
+# Run $WORK.exe reading $WORK.in the way $1 says
+run_program() {
+    if [ "$1" = file ]
+    then
+        "$WORK.exe" < "$WORK.in" > "$WORK.out"
+    else
+        cat "$WORK.in" | "$WORK.exe" > "$WORK.out"
+    fi
+}
+
+# Best times from a file and through a pipe of the program one compiler makes of $WORK.spl
+time_program() {
+    build_program "$1" || return 1
+    file=$(best_time run_program file) || return 1
+    cp "$WORK.out" "$WORK.out.$2"
+    pipe=$(best_time run_program pipe) || return 1
+    cmp -s "$WORK.out" "$WORK.out.$2" || return 1
+    echo "$file $pipe"
+}
+
+if [ -n "$REFERENCE" ]
+then
+    printf "%-12s %10s %10s %10s %10s %8s %8s\n" program file pipe ref-file ref-pipe file-x pipe-x
+else
+    printf "%-12s %10s %10s\n" program file pipe
+fi
+for name in integers reals characters
+do
+    write_program "$name" > "$WORK.spl"
+    write_input "$name" > "$WORK.in"
+    seconds=$(time_program "$SPL" new) || { echo "$name: failed" >&2; exit 1; }
+    if [ -z "$REFERENCE" ]
+    then
+        printf "%-12s %10.4f %10.4f\n" "$name" $seconds
+        continue
+    fi
+    reference=$(time_program "$REFERENCE" reference) || { echo "$name: failed with the reference" >&2; exit 1; }
+    cmp -s "$WORK.out.new" "$WORK.out.reference" || { echo "$name: output differs from the reference" >&2; exit 1; }
+    echo "$seconds $reference" | awk -v n="$name" '{ printf "%-12s %10.4f %10.4f %10.4f %10.4f %7.2fx %7.2fx\n", n, $1, $2, $3, $4, ($1 > 0 ? $3 / $1 : 0), ($2 > 0 ? $4 / $2 : 0) }'
+done
@@ -0,0 +1,79 @@
+#!/bin/sh
+# Time running SPL programs with --run and --jit against compiling them to C, building that with
+# the C compiler at -O2 and running it, each from the source to the last line of output. Each way
+# is timed RUNS times and the fastest kept, and their output is checked against each other.
+# A short program shows what skipping the C compiler saves; the loops what the VM costs, and how
+# much of that the machine code --jit writes wins back.
+#
+# usage: bench/run_vs_cc.sh [path/to/spl]
+
+SPL=${1:-./spl}
+. "$(dirname "$0")/common.sh"
+
+# Each program reads its bounds, so neither way can work the loops out in advance
+write_program() {
+    case $1 in
+        short) cat <<'EOF'
+short : DECLARATIONS
+  n, s, i OF TYPE INTEGER;
+  r OF TYPE REAL;
+CODE
+  READ(n); READ(s); 0.5 -> r;
+  FOR i IS 1 BY 1 TO 10 DO
+    WRITE(i, (i * n + s), (r * i)); NEWLINE
+  ENDFOR
+ENDP short.
+EOF
+        ;;
+        nested) cat <<'EOF'
+nested : DECLARATIONS
+  n, s, i, j, step OF TYPE INTEGER;
+CODE
+  READ(n); READ(step); 0 -> s;
+  FOR i IS 1 BY step TO n / 4 DO
+    FOR j IS i BY step TO n / 4 DO s + i * j -> s ENDFOR
+  ENDFOR;
+  WRITE(s)
+ENDP nested.
+EOF
+        ;;
+        while_real) cat <<'EOF'
+whilereal : DECLARATIONS
+  n, i OF TYPE INTEGER;
+  x, y OF TYPE REAL;
+CODE
+  READ(n); READ(i); 0.0 -> x; 1.0 -> y; 0 -> i;
+  WHILE i < n * 1000 DO
+    IF x < y THEN x + 0.25 -> x ELSE y * 2.0 -> y ENDIF;
+    i + 1 -> i
+  ENDWHILE;
+  WRITE(x, y)
+ENDP whilereal.
+EOF
+        ;;
+    esac
+}
+
+# Compile $WORK.spl to C, build it and run it
+run_cc() {
+    "$SPL" < "$WORK.spl" > "$WORK.c" || return 1
+    "$CC" -O2 -w -o "$WORK.exe" "$WORK.c" -lm || return 1
+    printf '20000\n1\n' | "$WORK.exe" > "$WORK.out.cc"
+}
+
+# Run $WORK.spl with $1, --run or --jit
+run_spl() {
+    printf '20000\n1\n' | "$SPL" "$1" "$WORK.spl" > "$WORK.out$1"
+}
+
+printf "%-12s %10s %10s %10s %8s %8s\n" program run jit cc+run run-x jit-x
+for name in short nested while_real
+do
+    write_program "$name" > "$WORK.spl"
+    run=$(best_time run_spl --run) || { echo "$name: --run failed" >&2; exit 1; }
+    jit=$(best_time run_spl --jit) || { echo "$name: --jit failed" >&2; exit 1; }
+    cc=$(best_time run_cc) || { echo "$name: failed through $CC" >&2; exit 1; }
+    cmp -s "$WORK.out--run" "$WORK.out.cc" || { echo "$name: --run output differs from the C" >&2; exit 1; }
+    cmp -s "$WORK.out--jit" "$WORK.out.cc" || { echo "$name: --jit output differs from the C" >&2; exit 1; }
+    awk -v n="$name" -v r="$run" -v j="$jit" -v c="$cc" 'BEGIN { printf "%-12s %10.4f %10.4f %10.4f %7.2fx %7.2fx\n", n, r, j, c, (r > 0 ? c / r : 0), (j > 0 ? c / j : 0) }'
+done
@@ -0,0 +1,68 @@
+#!/bin/sh
+# Write a synthetic SPL program to stdout, sized by its options:
+#
+#   -d N   declared INTEGER variables, each assigned once at the start     (default 100)
+#   -n N   depth of the nested IF / WHILE / FOR statements in each block   (default 4)
+#   -e N   operands in the expression at the centre of each block          (default 50)
+#   -w N   WRITE statements at the end of the program                      (default 100)
+#   -b N   blocks, each a complete nest with its own expression            (default 10)
+#
+# usage: bench/splgen.sh [-d N] [-n N] [-e N] [-w N] [-b N] > program.spl
+
+DECLARATIONS=100
+DEPTH=4
+OPERANDS=50
+WRITES=100
+BLOCKS=10
+while getopts d:n:e:w:b: option
+do
+    case $option in
+        d) DECLARATIONS=$OPTARG ;;
+        n) DEPTH=$OPTARG ;;
+        e) OPERANDS=$OPTARG ;;
+        w) WRITES=$OPTARG ;;
+        b) BLOCKS=$OPTARG ;;
+        *) sed -n 's/^# usage: /usage: /p' "$0" >&2; exit 2 ;;
+    esac
+done
+
+awk -v decls="$DECLARATIONS" -v depth="$DEPTH" -v operands="$OPERANDS" \
+    -v writes="$WRITES" -v blocks="$BLOCKS" '
+function variable(i) { return "x" (i % decls) }
+
+# Cycle through + - * so the optimiser and code generator see mixed precedence
+function expression(seed,    text, i) {
+    text = variable(seed)
+    for(i = 1; i < operands; i++)
+        text = text (i % 3 == 0 ? " * " : i % 3 == 1 ? " + " : " - ") variable(seed + i)
+    return text
+}
+
+# Statement lists are separated, not terminated, by semicolons
+function nest(level, seed,    inner) {
+    if(level == depth) return "  " expression(seed) " -> " variable(seed)
+    inner = nest(level + 1, seed + 1)
+    if(level % 3 == 0)
+        return "  IF " variable(seed) " < " variable(seed + 1) " THEN\n" inner "\n  ELSE WRITE(" variable(seed) ") ENDIF"
+    if(level % 3 == 1)
+        return "  0 -> w" level ";\n  WHILE w" level " < 2 DO\n  w" level " + 1 -> w" level ";\n" inner "\n  ENDWHILE"
+    return "  FOR f" level " IS 1 BY 1 TO 2 DO\n" inner "\n  ENDFOR"
+}
+
+BEGIN {
+    if(decls < 1) decls = 1
+    print "synthetic : DECLARATIONS"
+    for(i = 0; i < decls; i++) print "  x" i " OF TYPE INTEGER;"
+    for(level = 0; level < depth; level++)
+    {
+        if(level % 3 == 1) print "  w" level " OF TYPE INTEGER;"
+        if(level % 3 == 2) print "  f" level " OF TYPE INTEGER;"
+    }
+    print "  r OF TYPE REAL;"
+    print "CODE"
+    for(i = 0; i < decls; i++) print "  " i " -> x" i ";"
+    printf "  1.5 -> r"
+    for(b = 0; b < blocks; b++) printf ";\n%s", nest(0, b * 7)
+    for(i = 0; i < writes; i++) printf ";\n  WRITE(%s, r);\n  NEWLINE", variable(i)
+    print "\nENDP synthetic."
+}'
@@ -0,0 +1,64 @@
+#!/bin/sh
+# Time the programs the compiler generates for output-heavy SPL, built by the C compiler at -O2,
+# with their output sent to /dev/null so that only the writing itself is measured. Each is run
+# RUNS times and the fastest kept. Given a second compiler, its programs are timed as well, their
+# output checked against the first's, and the speedup reported.
+#
+# usage: bench/write_runtime.sh [path/to/spl] [path/to/reference/spl]
+
+SPL=${1:-./spl}
+REFERENCE=$2
+. "$(dirname "$0")/common.sh"
+
+# Each program reads how much to write, so neither compiler can work the output out in advance
+write_program() {
+    case $1 in
+        integers) cat <<'EOF'
+integers : DECLARATIONS
+  n, i, s OF TYPE INTEGER;
+CODE
+  READ(n); READ(s);
+  FOR i IS 1 BY 1 TO n * 100 DO
+    WRITE(i, 'x', (i * s - n)); NEWLINE
+  ENDFOR
+ENDP integers.
+EOF
+        ;;
+        reals) cat <<'EOF'
+reals : DECLARATIONS
+  n, i, s OF TYPE INTEGER;
+  x OF TYPE REAL;
+CODE
+  READ(n); READ(s); 0.0 -> x;
+  FOR i IS 1 BY 1 TO n * 100 DO
+    x + 0.125 -> x;
+    WRITE(x, 'x', (x * 3.0)); NEWLINE
+  ENDFOR
+ENDP reals.
+EOF
+        ;;
+        characters) cat <<'EOF'
+characters : DECLARATIONS
+  n, i, s OF TYPE INTEGER;
+CODE
+  READ(n); READ(s);
+  FOR i IS 1 BY s TO n * 100 DO
+    WRITE('s', 'p', 'l', 'x', i); NEWLINE
+  ENDFOR
+ENDP characters.
+EOF
+        ;;
+    esac
+}
+
+run_program() {
+    printf '20000\n1\n' | "$WORK.exe" > "$1"
+}
+
+# Best run time in seconds of the program one compiler makes of $WORK.spl, once its output has
+# been kept for the comparison
+time_program() {
+    build_program "$1" && run_program "$WORK.out.$2" && best_time run_program /dev/null
+}
+
+time_programs integers reals characters
@@ -0,0 +1,378 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "include/arena.h"
+#include "include/bytecode.h"
+#include "include/compile.h"
+#include "include/ir.h"
+#include "include/splio.h"
+#include "include/symbol_table.h"
+
+/* ------------- bytecode translation --------------------------- */
+
+/* The lowered program is translated node by node. Each IF, WHILE, DO and FOR becomes branches
+** to labels; a label collects the branches to it until its place is known, chained through
+** their dest. WHILE and a FOR which is not counted are tested once on entry and then at the
+** bottom of each iteration, so the test at the bottom directly follows the step or the body's
+** last instruction, and the two can be fused. */
+
+#define SCRATCH_SLOTS 3
+
+typedef struct {
+    COMPILE_CONTEXT *ctx;
+    BC_PROGRAM *program;
+    ARENA *arena;
+    int *variable_slots;        /* By symbol, or -1 */
+    int temp_base;              /* Temporary n is slot temp_base + n */
+    int counter_base;           /* As is counter n */
+    int scratch;                /* The first scratch slot */
+    int label_at;               /* Where a label was last placed; branches there cannot be fused */
+    int failed;                 /* Out of memory */
+} BC_STATE;
+
+typedef struct {
+    int position;               /* Of the instruction the label is on, or -1 until placed */
+    int pending;                /* The last branch to the label while it is not placed, or -1 */
+} BC_LABEL;
+
+static const BC_LABEL NEW_LABEL = {-1, -1};
+
+/* Branching when a comparison fails is branching when its opposite holds, for integers */
+static const enum CompareSymType OPPOSITE_COMPARES[] = {SYM_NEQ_TO, SYM_EQ_TO, SYM_GREATER_THAN_EQ, SYM_LESS_THAN_EQ,
+    SYM_GREATER_THAN, SYM_LESS_THAN};
+static const enum BcOp INTEGER_OPS[] = {BC_MOVE, BC_ADD_I, BC_SUB_I, BC_MUL_I, BC_DIV_I, BC_SHL_I};
+static const enum BcOp REAL_OPS[] = {BC_MOVE, BC_ADD_R, BC_SUB_R, BC_MUL_R, BC_DIV_R, BC_HALT};
+
+static void *grow_bytecode_array(ARENA *, void *, int, int *, size_t);
+static int new_slot(BC_STATE *);
+static int emit_bytecode(BC_STATE *, enum BcOp, int, int, int);
+static void emit_branch(BC_STATE *, enum BcOp, int, int, BC_LABEL *);
+static void branch_to(BC_STATE *, int, BC_LABEL *);
+static void place_label(BC_STATE *, BC_LABEL *);
+static void translate_nodes(BC_STATE *, IR_NODE *);
+static void translate_loop(BC_STATE *, IR_NODE *);
+static void translate_instruction(BC_STATE *, IR_INSTRUCTION *);
+static void translate_condition(BC_STATE *, IR_CONDITION *, int, BC_LABEL *);
+static int operand_slot(BC_STATE *, IR_OPERAND);
+static int value_slot(BC_STATE *, IR_OPERAND, int, int);
+static void store_value(BC_STATE *, IR_OPERAND, int, int);
+
+/* Returns NULL when out of memory. The program is kept in the IR's arena. */
+BC_PROGRAM *compile_bytecode(COMPILE_CONTEXT *ctx, IR_PROGRAM *ir)
+{
+    BC_STATE state;
+    int i;
+    memset(&state, 0, sizeof(BC_STATE));
+    state.ctx = ctx;
+    state.arena = ir->arena;
+    state.label_at = -1;
+    state.program = (BC_PROGRAM *)arena_alloc(ir->arena, sizeof(BC_PROGRAM));
+    state.variable_slots = (int *)malloc(sizeof(int) * (ctx->symTabRec->in_use + 1));
+    if(state.program == NULL || state.variable_slots == NULL)
+    {
+        free(state.variable_slots);
+        return NULL;
+    }
+    memset(state.program, 0, sizeof(BC_PROGRAM));
+    for(i = 0; i <= ctx->symTabRec->in_use; i++) state.variable_slots[i] = -1;
+    for(i = 0; i < ir->variable_count; i++) state.variable_slots[ir->variables[i]] = new_slot(&state);
+    state.temp_base = state.program->slot_count - 1;
+    for(i = 0; i < ir->temp_count; i++) new_slot(&state);
+    state.counter_base = state.program->slot_count - 1;
+    for(i = 0; i < ir->counter_count; i++) new_slot(&state);
+    state.scratch = state.program->slot_count;
+    for(i = 0; i < SCRATCH_SLOTS; i++) new_slot(&state);
+
+    translate_nodes(&state, ir->body);
+    emit_bytecode(&state, BC_HALT, 0, 0, 0);
+    free(state.variable_slots);
+    if(state.failed) return NULL;
+    INFO("Bytecode: %d instructions, %d slots\n", state.program->count, state.program->slot_count)
+    return state.program;
+}
+
+static void *grow_bytecode_array(ARENA *arena, void *array, int count, int *capacity, size_t size)
+{
+    int new_capacity = *capacity ? *capacity*2 : 64;
+    void *grown = arena_alloc(arena, size * new_capacity);
+    if(grown == NULL) return NULL;
+    if(array != NULL) memcpy(grown, array, size * count);
+    *capacity = new_capacity;
+    return grown;
+}
+
+static int new_slot(BC_STATE *state)
+{
+    BC_PROGRAM *program = state->program;
+    if(program->slot_count == program->slot_capacity)
+    {
+        BC_SLOT *grown = grow_bytecode_array(state->arena, program->slots, program->slot_count, &program->slot_capacity, sizeof(BC_SLOT));
+        if(grown == NULL)
+        {
+            state->failed = TRUE;
+            return 0;
+        }
+        program->slots = grown;
+    }
+    memset(&program->slots[program->slot_count], 0, sizeof(BC_SLOT));
+    return program->slot_count++;
+}
+
+/* Returns the instruction's number, or -1 when out of memory */
+static int emit_bytecode(BC_STATE *state, enum BcOp op, int dest, int a, int b)
+{
+    BC_PROGRAM *program = state->program;
+    BC_INSTRUCTION *instruction;
+    if(state->failed) return -1;
+    if(program->count == program->capacity)
+    {
+        BC_INSTRUCTION *grown = grow_bytecode_array(state->arena, program->code, program->count, &program->capacity, sizeof(BC_INSTRUCTION));
+        if(grown == NULL)
+        {
+            state->failed = TRUE;
+            return -1;
+        }
+        program->code = grown;
+    }
+    instruction = &program->code[program->count];
+    memset(instruction, 0, sizeof(BC_INSTRUCTION));
+    instruction->op = op;
+    instruction->dest = dest;
+    instruction->a = a;
+    instruction->b = b;
+    return program->count++;
+}
+
+/* An integer comparison of what the instruction before it has just added to is made part of
+** that instruction, unless a branch may arrive between the two */
+static void emit_branch(BC_STATE *state, enum BcOp op, int a, int b, BC_LABEL *label)
+{
+    BC_PROGRAM *program = state->program;
+    int last = program->count - 1;
+    if(op >= BC_JEQ_I && op <= BC_JGE_I && last >= 0 && state->label_at != program->count && !state->failed)
+    {
+        BC_INSTRUCTION *add = &program->code[last];
+        if(add->op == BC_ADD_I && add->dest == a && add->a == a)
+        {
+            add->op = (enum BcOp)(BC_ADD_JEQ_I + (op - BC_JEQ_I));
+            add->c = add->b;
+            add->b = b;
+            branch_to(state, last, label);
+            return;
+        }
+    }
+    branch_to(state, emit_bytecode(state, op, 0, a, b), label);
+}
+
+static void branch_to(BC_STATE *state, int branch, BC_LABEL *label)
+{
+    if(branch < 0) return;
+    if(label->position >= 0) state->program->code[branch].dest = label->position;
+    else
+    {
+        state->program->code[branch].dest = label->pending;
+        label->pending = branch;
+    }
+}
+
+static void place_label(BC_STATE *state, BC_LABEL *label)
+{
+    int next;
+    label->position = state->program->count;
+    state->label_at = label->position;
+    while(label->pending >= 0)
+    {
+        next = state->program->code[label->pending].dest;
+        state->program->code[label->pending].dest = label->position;
+        label->pending = next;
+    }
+}
+
+static void translate_nodes(BC_STATE *state, IR_NODE *node)
+{
+    int i;
+    for(; node != NULL && !state->failed; node = node->next)
+    {
+        BC_LABEL orelse = NEW_LABEL;
+        BC_LABEL end = NEW_LABEL;
+        switch(node->kind)
+        {
+            case IR_BLOCK:
+                for(i = 0; i < node->count; i++) translate_instruction(state, &node->code[i]);
+                break;
+            case IR_IF:
+                translate_condition(state, node->condition, FALSE, &orelse);
+                translate_nodes(state, node->body);
+                if(node->orelse != NULL) branch_to(state, emit_bytecode(state, BC_JUMP, 0, 0, 0), &end);
+                place_label(state, &orelse);
+                translate_nodes(state, node->orelse);
+                if(node->orelse != NULL) place_label(state, &end);
+                break;
+            case IR_WHILE:
+            case IR_DO:
+            case IR_FOR:
+                translate_loop(state, node);
+                break;
+        }
+    }
+}
+
+static void translate_loop(BC_STATE *state, IR_NODE *node)
+{
+    BC_LABEL top = NEW_LABEL;
+    BC_LABEL test = NEW_LABEL;
+    BC_LABEL end = NEW_LABEL;
+    translate_nodes(state, node->init);
+    if(node->counter != 0)
+    {
+        /* The counter is tested, and counted down, at the bottom */
+        int counter = state->counter_base + node->counter;
+        int from = value_slot(state, node->variable, FALSE, state->scratch);
+        int to = value_slot(state, node->bound, FALSE, state->scratch + 1);
+        int by = value_slot(state, node->stride, FALSE, state->scratch + 2);
+        int trips = emit_bytecode(state, BC_TRIPS, counter, from, to);
+        if(trips >= 0) state->program->code[trips].c = by;
+        branch_to(state, emit_bytecode(state, BC_JUMP, 0, 0, 0), &test);
+        place_label(state, &top);
+        translate_nodes(state, node->body);
+        translate_nodes(state, node->step);
+        place_label(state, &test);
+        branch_to(state, emit_bytecode(state, BC_COUNT, 0, counter, 0), &top);
+        return;
+    }
+    if(node->kind != IR_DO) translate_condition(state, node->condition, FALSE, &end);
+    place_label(state, &top);
+    translate_nodes(state, node->body);
+    translate_nodes(state, node->step);
+    translate_condition(state, node->condition, TRUE, &top);
+    place_label(state, &end);
+}
+
+static void translate_instruction(BC_STATE *state, IR_INSTRUCTION *instruction)
+{
+    int real = instruction->type == REAL_T;
+    int a;
+    int b;
+    int dest;
+    int direct;
+    switch(instruction->op)
+    {
+        case IR_NOP:
+            break;
+        case IR_WRITE:
+            a = value_slot(state, instruction->a, real, state->scratch);
+            emit_bytecode(state, instruction->type == CHAR_T ? BC_WRITE_C : real ? BC_WRITE_R : BC_WRITE_I, 0, a, 0);
+            break;
+        case IR_NEWLINE:
+            emit_bytecode(state, BC_NEWLINE, 0, 0, 0);
+            break;
+        case IR_READ:
+            emit_bytecode(state, instruction->type == CHAR_T ? BC_READ_C : real ? BC_READ_R : BC_READ_I,
+                operand_slot(state, instruction->dest), 0, 0);
+            break;
+        case IR_COPY:
+            real = instruction->a.type == REAL_T;
+            store_value(state, instruction->dest, value_slot(state, instruction->a, real, state->scratch), real);
+            break;
+        default:
+            a = value_slot(state, instruction->a, real, state->scratch);
+            b = value_slot(state, instruction->b, real, state->scratch + 1);
+            /* A CHARACTER is converted once the arithmetic is done, as is a result of the other type */
+            direct = (instruction->dest.type == REAL_T) == real && instruction->dest.type != CHAR_T;
+            dest = direct ? operand_slot(state, instruction->dest) : state->scratch + 2;
+            emit_bytecode(state, real ? REAL_OPS[instruction->op] : INTEGER_OPS[instruction->op], dest, a, b);
+            if(!direct) store_value(state, instruction->dest, dest, real);
+            break;
+    }
+}
+
+/* Branch to target when the condition comes out as when, otherwise carry on */
+static void translate_condition(BC_STATE *state, IR_CONDITION *condition, int when, BC_LABEL *target)
+{
+    BC_LABEL skip = NEW_LABEL;
+    int real;
+    int a;
+    int b;
+    switch(condition->kind)
+    {
+        case IR_COMPARE:
+            translate_nodes(state, condition->setup);
+            real = condition->type == REAL_T;
+            a = value_slot(state, condition->left, real, state->scratch);
+            b = value_slot(state, condition->right, real, state->scratch + 1);
+            if(real) emit_branch(state, (enum BcOp)((when ? BC_JEQ_R : BC_JNOT_EQ_R) + condition->compare), a, b, target);
+            else emit_branch(state, (enum BcOp)(BC_JEQ_I + (when ? condition->compare : OPPOSITE_COMPARES[condition->compare])), a, b, target);
+            break;
+        case IR_NOT:
+            translate_condition(state, condition->first, !when, target);
+            break;
+        case IR_AND:
+        case IR_OR:
+            /* The first part decides the whole when it comes out as FALSE for AND, TRUE for OR */
+            if(when == (condition->kind == IR_OR)) translate_condition(state, condition->first, when, target);
+            else translate_condition(state, condition->first, !when, &skip);
+            translate_condition(state, condition->second, when, target);
+            if(skip.pending >= 0) place_label(state, &skip);
+            break;
+    }
+}
+
+static int operand_slot(BC_STATE *state, IR_OPERAND operand)
+{
+    if(operand.kind == IR_TEMP) return state->temp_base + operand.index;
+    if(state->variable_slots[operand.index] < 0) state->variable_slots[operand.index] = new_slot(state);
+    return state->variable_slots[operand.index];
+}
+
+/* The slot holding an operand as a REAL, when real, or otherwise an int. A constant is given a
+** slot of its own; a variable or temporary of the other kind is converted into scratch. */
+static int value_slot(BC_STATE *state, IR_OPERAND operand, int real, int scratch)
+{
+    double value;
+    int slot;
+    switch(operand.kind)
+    {
+        case IR_VARIABLE:
+        case IR_TEMP:
+            slot = operand_slot(state, operand);
+            if((operand.type == REAL_T) == real) return slot;
+            emit_bytecode(state, real ? BC_TO_REAL : BC_TO_INT, scratch, slot, 0);
+            return scratch;
+        case IR_INT_CONST:
+        case IR_CHAR_CONST:
+        case IR_REAL_CONST:
+            if(operand.kind == IR_REAL_CONST)
+            {
+                value = strtod(state->ctx->symTabRec->array[operand.index]->identifier, NULL);
+                if(operand.value) value = -value;
+            }
+            else value = operand.value;
+            slot = new_slot(state);
+            if(state->failed) return scratch;
+            if(real) state->program->slots[slot].r = value;
+            else state->program->slots[slot].i = (int)value;
+            return slot;
+        case IR_NONE:
+            break;
+    }
+    return scratch;
+}
+
+/* Assign a value held as a REAL, when real, or as an int, converting it as C would */
+static void store_value(BC_STATE *state, IR_OPERAND dest, int value, int real)
+{
+    int slot = operand_slot(state, dest);
+    if(dest.type == REAL_T)
+    {
+        if(!real) emit_bytecode(state, BC_TO_REAL, slot, value, 0);
+        else if(slot != value) emit_bytecode(state, BC_MOVE, slot, value, 0);
+        return;
+    }
+    if(real)
+    {
+        emit_bytecode(state, BC_TO_INT, slot, value, 0);
+        value = slot;
+    }
+    if(dest.type == CHAR_T) emit_bytecode(state, BC_TO_CHAR, slot, value, 0);
+    else if(slot != value) emit_bytecode(state, BC_MOVE, slot, value, 0);
+}
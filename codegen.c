@@ -1,547 +1,726 @@
 #ifndef DEBUG
 
+#include <ctype.h>
+#include <limits.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include "include/codegen.h"
+#include "include/compile.h"
+#include "include/ir.h"
+#include "include/string_builder.h"
 #include "include/symbol_table.h"
-#include "include/types.h"
 #include "include/utils.h"
 
-static void sanitise_identifier(char **);
+static void generate_declarations(COMPILE_CONTEXT *, IR_PROGRAM *, STRING_BUILDER *);
+static void mark_temps(IR_NODE *, char *);
+static void mark_condition_temps(IR_CONDITION *, char *);
+static void mark_io(IR_NODE *, char *, char *);
+static void generate_nodes(COMPILE_CONTEXT *, IR_NODE *, int, STRING_BUILDER *);
+static void generate_block(COMPILE_CONTEXT *, IR_NODE *, int, STRING_BUILDER *);
+static void generate_expression_list(COMPILE_CONTEXT *, IR_NODE *, STRING_BUILDER *);
+static int has_expressions(IR_NODE *);
+static void generate_instruction(COMPILE_CONTEXT *, IR_INSTRUCTION *, STRING_BUILDER *);
+static void generate_condition(COMPILE_CONTEXT *, IR_CONDITION *, STRING_BUILDER *);
+static void generate_operand(COMPILE_CONTEXT *, IR_OPERAND, STRING_BUILDER *);
+static const char *c_type_name(enum SymbolTypes);
 
+static const char *C_COMPARATORS[] = {"==", "!=", "<", ">", "<=", ">="};
+static const char *C_OPERATORS[] = {"", " + ", " - ", " * ", " / "};
 
-char *RESERVED_WORDS[] = {"auto", "double", "int", "struct", "break", "else", "long", "switch", "case", "enum", "register", "typedef", "char", "extern", "return", "union", "const", "float", "short", "unsigned", "continue", "for", "signed", "void", "default", "goto", "sizeof", "volatile", "do", "if", "static", "while"};
+/* How many times a counted FOR runs, from how it would test its variable: by > 0 counts up to
+** to, anything else down to it. Zero counts down for ever, as near as makes no difference. */
+static const char TRIP_COUNT_FUNCTION[] =
+    "static unsigned long long spl_trips(long long from, long long to, long long by)\n"
+    "{\n"
+    "    if(by > 0) return from <= to ? (unsigned long long)(to - from) / by + 1 : 0;\n"
+    "    if(by < 0) return from >= to ? (unsigned long long)(from - to) / -by + 1 : 0;\n"
+    "    return from >= to ? ~0ull : 0;\n"
+    "}\n\n";
 
-static void sanitise_identifier(char **id_ptr)
+/* WRITE and NEWLINE append to spl_out, which goes to stdout only when it fills, before a READ
+** and once the program ends. Each type has its own formatter, so nothing parses a format as the
+** program runs. A REAL between 0.0001 and 1000000, which %lg prints without an exponent, is
+** rounded to six significant digits by hand unless it lies too near halfway between two roundings
+** to tell them apart after scaling; snprintf prints the rest. Only the formatters a program
+** uses are printed. */
+static const char OUTPUT_BUFFER[] =
+    "static char spl_out[65536];\n"
+    "static int spl_out_length;\n\n"
+    "static void spl_flush(void)\n"
+    "{\n"
+    "    if(spl_out_length > 0) fwrite(spl_out, 1, spl_out_length, stdout);\n"
+    "    spl_out_length = 0;\n"
+    "}\n\n";
+
+static const char WRITE_CHAR_FUNCTION[] =
+    "static void spl_write_char(char c)\n"
+    "{\n"
+    "    if(spl_out_length == (int)sizeof(spl_out)) spl_flush();\n"
+    "    spl_out[spl_out_length++] = c;\n"
+    "}\n\n";
+
+static const char WRITE_INT_FUNCTION[] =
+    "static void spl_write_int(int value)\n"
+    "{\n"
+    "    char text[12];\n"
+    "    unsigned int digits = value < 0 ? 0u - (unsigned int)value : (unsigned int)value;\n"
+    "    int count = 0;\n"
+    "    if(spl_out_length > (int)sizeof(spl_out) - 12) spl_flush();\n"
+    "    do text[count++] = (char)('0' + digits % 10); while((digits /= 10) != 0);\n"
+    "    if(value < 0) text[count++] = '-';\n"
+    "    while(count > 0) spl_out[spl_out_length++] = text[--count];\n"
+    "}\n\n";
+
+static const char WRITE_REAL_FUNCTION[] =
+    "static void spl_write_real(double value)\n"
+    "{\n"
+    "    static const double scales[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9};\n"
+    "    double magnitude = value < 0 ? -value : value;\n"
+    "    double scaled;\n"
+    "    double fraction;\n"
+    "    unsigned int digits;\n"
+    "    char text[20];\n"
+    "    int places = 9;\n"
+    "    int count = 0;\n"
+    "    if(spl_out_length > (int)sizeof(spl_out) - 32) spl_flush();\n"
+    "    if(magnitude >= 1e-4 && magnitude < 1e6)\n"
+    "    {\n"
+    "        while(magnitude * scales[places] >= 1e6) places--;\n"
+    "        scaled = magnitude * scales[places];\n"
+    "        digits = (unsigned int)scaled;\n"
+    "        fraction = scaled - digits;\n"
+    "        digits += fraction > 0.5;\n"
+    "        if(digits < 1000000 && (fraction < 0.4999999 || fraction > 0.5000001))\n"
+    "        {\n"
+    "            while(places > 0 && digits % 10 == 0) digits /= 10, places--;\n"
+    "            for(; count < places; count++, digits /= 10) text[count] = (char)('0' + digits % 10);\n"
+    "            if(places > 0) text[count++] = '.';\n"
+    "            do text[count++] = (char)('0' + digits % 10); while((digits /= 10) != 0);\n"
+    "            if(value < 0) text[count++] = '-';\n"
+    "            while(count > 0) spl_out[spl_out_length++] = text[--count];\n"
+    "            return;\n"
+    "        }\n"
+    "    }\n"
+    "    spl_out_length += snprintf(spl_out + spl_out_length, 32, \"%lg\", value);\n"
+    "}\n\n";
+
+/* READ takes its input from spl_in_block, filled a block at a time by read(), or from the whole
+** of stdin mapped into memory when it is a file, and parses it by hand in place of scanf. The
+** parsers take just the characters scanf would, even from malformed input: a sign or '.' with no
+** digits after it is used up, as is an 'e' with no exponent, and spl_token keeps the REAL being
+** read in the block when it is refilled. What %d overflows to is taken from strtol, as glibc does,
+** and a REAL that is not a short decimal goes to strtod. Pending output is flushed whenever the
+** program has to wait for more input, as stdio would. */
+static const char INPUT_BUFFER[] =
+    "static char spl_in_block[65536];\n"
+    "static const char *spl_in = spl_in_block;\n"
+    "static const char *spl_in_end = spl_in_block;\n"
+    "static const char *spl_token;\n"
+    "static int spl_in_started;\n"
+    "static int spl_in_done;\n"
+    "\n"
+    "static int spl_fill(void)\n"
+    "{\n"
+    "    size_t kept = 0;\n"
+    "    long got;\n"
+    "    if(spl_in_done) return 0;\n"
+    "    spl_flush();\n"
+    "    fflush(stdout);\n"
+    "#if defined(__unix__) || defined(__APPLE__)\n"
+    "    if(!spl_in_started)\n"
+    "    {\n"
+    "        struct stat status;\n"
+    "        off_t at = lseek(0, 0, SEEK_CUR);\n"
+    "        void *mapped;\n"
+    "        spl_in_started = 1;\n"
+    "        if(fstat(0, &status) == 0 && S_ISREG(status.st_mode) && at >= 0 && status.st_size > at)\n"
+    "        {\n"
+    "            mapped = mmap(NULL, (size_t)status.st_size, PROT_READ, MAP_PRIVATE, 0, 0);\n"
+    "            if(mapped != MAP_FAILED)\n"
+    "            {\n"
+    "                spl_in = (const char *)mapped + at;\n"
+    "                spl_in_end = (const char *)mapped + status.st_size;\n"
+    "                spl_in_done = 1;\n"
+    "                return 1;\n"
+    "            }\n"
+    "        }\n"
+    "    }\n"
+    "#endif\n"
+    "    if(spl_token != NULL)\n"
+    "    {\n"
+    "        kept = spl_in_end - spl_token;\n"
+    "        if(kept == sizeof(spl_in_block)) return 0;\n"
+    "        memmove(spl_in_block, spl_token, kept);\n"
+    "        spl_token = spl_in_block;\n"
+    "    }\n"
+    "#if defined(__unix__) || defined(__APPLE__)\n"
+    "    got = read(0, spl_in_block + kept, sizeof(spl_in_block) - kept);\n"
+    "#else\n"
+    "    got = fgets(spl_in_block + kept, (int)(sizeof(spl_in_block) - kept), stdin) != NULL ? (long)strlen(spl_in_block + kept) : 0;\n"
+    "#endif\n"
+    "    spl_in = spl_in_block + kept;\n"
+    "    spl_in_end = spl_in + (got > 0 ? got : 0);\n"
+    "    if(got <= 0) spl_in_done = 1;\n"
+    "    return got > 0;\n"
+    "}\n"
+    "\n"
+    "static int spl_peek(void)\n"
+    "{\n"
+    "    return spl_in < spl_in_end || spl_fill() ? (unsigned char)*spl_in : EOF;\n"
+    "}\n"
+    "\n"
+    "static int spl_skip_space(void)\n"
+    "{\n"
+    "    int c;\n"
+    "    while((c = spl_peek()) == ' ' || (c >= '\\t' && c <= '\\r')) spl_in++;\n"
+    "    return c;\n"
+    "}\n\n";
+
+static const char READ_CHAR_FUNCTION[] =
+    "static void spl_read_char(char *variable)\n"
+    "{\n"
+    "    if(spl_skip_space() != EOF) *variable = *spl_in++;\n"
+    "}\n\n";
+
+static const char READ_INT_FUNCTION[] =
+    "static void spl_read_int(int *variable)\n"
+    "{\n"
+    "    unsigned long magnitude = 0;\n"
+    "    unsigned long limit = (unsigned long)LONG_MAX + 1;\n"
+    "    int negative = 0;\n"
+    "    int digits = 0;\n"
+    "    int c = spl_skip_space();\n"
+    "    if(c == '-' || c == '+')\n"
+    "    {\n"
+    "        negative = c == '-';\n"
+    "        spl_in++;\n"
+    "        c = spl_peek();\n"
+    "    }\n"
+    "    while(c >= '0' && c <= '9')\n"
+    "    {\n"
+    "        magnitude = magnitude > (limit - (c - '0')) / 10 ? limit : magnitude * 10 + (c - '0');\n"
+    "        digits++;\n"
+    "        spl_in++;\n"
+    "        c = spl_peek();\n"
+    "    }\n"
+    "    if(digits == 0) return;\n"
+    "    if(negative) *variable = (int)(magnitude >= limit ? LONG_MIN : -(long)magnitude);\n"
+    "    else *variable = (int)(magnitude >= limit ? LONG_MAX : (long)magnitude);\n"
+    "}\n\n";
+
+static const char READ_REAL_FUNCTION[] =
+    "static int spl_take(const char *word)\n"
+    "{\n"
+    "    int c;\n"
+    "    for(; *word != '\\0'; word++)\n"
+    "    {\n"
+    "        if((c = spl_peek()) == EOF) return 0;\n"
+    "        spl_in++;\n"
+    "        if((c | 0x20) != *word) return 0;\n"
+    "    }\n"
+    "    return 1;\n"
+    "}\n"
+    "\n"
+    "static int spl_take_digits(int hexadecimal)\n"
+    "{\n"
+    "    int c;\n"
+    "    int digits = 0;\n"
+    "    while(((c = spl_peek()) >= '0' && c <= '9') || (hexadecimal && (c | 0x20) >= 'a' && (c | 0x20) <= 'f'))\n"
+    "    {\n"
+    "        spl_in++;\n"
+    "        digits++;\n"
+    "    }\n"
+    "    return digits;\n"
+    "}\n"
+    "\n"
+    "static void spl_read_real(double *variable)\n"
+    "{\n"
+    "    static const double powers[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,\n"
+    "        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};\n"
+    "    unsigned long long mantissa = 0;\n"
+    "    int scale = 0;\n"
+    "    int exponent = 0;\n"
+    "    int exponent_sign = 1;\n"
+    "    int exact = 1;\n"
+    "    int digits = 0;\n"
+    "    int fraction = 0;\n"
+    "    int c = spl_skip_space();\n"
+    "    char text[128];\n"
+    "    char *copy = text;\n"
+    "    size_t length;\n"
+    "    if(c == EOF) return;\n"
+    "    spl_token = spl_in;\n"
+    "    if(c == '-' || c == '+')\n"
+    "    {\n"
+    "        spl_in++;\n"
+    "        c = spl_peek();\n"
+    "    }\n"
+    "    if((c | 0x20) == 'i' || (c | 0x20) == 'n')\n"
+    "    {\n"
+    "        if((c | 0x20) == 'i' ? !spl_take(\"inf\") : !spl_take(\"nan\")) goto failed;\n"
+    "        if((c | 0x20) == 'i' && (spl_peek() | 0x20) == 'i' && !spl_take(\"inity\")) goto failed;\n"
+    "        goto converted;\n"
+    "    }\n"
+    "    if(c == '0')\n"
+    "    {\n"
+    "        spl_in++;\n"
+    "        if((spl_peek() | 0x20) == 'x')\n"
+    "        {\n"
+    "            spl_in++;\n"
+    "            digits = spl_take_digits(1);\n"
+    "            if(spl_peek() == '.')\n"
+    "            {\n"
+    "                spl_in++;\n"
+    "                if(digits + spl_take_digits(1) == 0) goto converted;\n"
+    "            }\n"
+    "            else if(digits == 0) goto failed;\n"
+    "            if((spl_peek() | 0x20) == 'p')\n"
+    "            {\n"
+    "                spl_in++;\n"
+    "                if((c = spl_peek()) == '-' || c == '+') spl_in++;\n"
+    "                spl_take_digits(0);\n"
+    "            }\n"
+    "            goto converted;\n"
+    "        }\n"
+    "        digits = 1;\n"
+    "    }\n"
+    "    for(;;)\n"
+    "    {\n"
+    "        c = spl_peek();\n"
+    "        if(c >= '0' && c <= '9')\n"
+    "        {\n"
+    "            if(mantissa < 100000000000000000ull)\n"
+    "            {\n"
+    "                mantissa = mantissa * 10 + (c - '0');\n"
+    "                scale -= fraction;\n"
+    "            }\n"
+    "            else\n"
+    "            {\n"
+    "                scale += !fraction;\n"
+    "                if(c != '0') exact = 0;\n"
+    "            }\n"
+    "            digits++;\n"
+    "        }\n"
+    "        else if(c == '.' && !fraction) fraction = 1;\n"
+    "        else break;\n"
+    "        spl_in++;\n"
+    "    }\n"
+    "    if(digits == 0) goto failed;\n"
+    "    if((c | 0x20) == 'e')\n"
+    "    {\n"
+    "        spl_in++;\n"
+    "        if((c = spl_peek()) == '-' || c == '+')\n"
+    "        {\n"
+    "            exponent_sign = c == '-' ? -1 : 1;\n"
+    "            spl_in++;\n"
+    "        }\n"
+    "        while((c = spl_peek()) >= '0' && c <= '9')\n"
+    "        {\n"
+    "            if(exponent < 100000) exponent = exponent * 10 + (c - '0');\n"
+    "            spl_in++;\n"
+    "        }\n"
+    "        scale += exponent_sign * exponent;\n"
+    "    }\n"
+    "    if(exact && mantissa <= 1ull << 53 && scale >= -22 && scale <= 22)\n"
+    "    {\n"
+    "        double value = scale < 0 ? (double)mantissa / powers[-scale] : (double)mantissa * powers[scale];\n"
+    "        *variable = *spl_token == '-' ? -value : value;\n"
+    "        spl_token = NULL;\n"
+    "        return;\n"
+    "    }\n"
+    "converted:\n"
+    "    length = spl_in - spl_token;\n"
+    "    if(length >= sizeof(text) && (copy = (char *)malloc(length + 1)) == NULL) copy = text, length = sizeof(text) - 1;\n"
+    "    memcpy(copy, spl_token, length);\n"
+    "    copy[length] = '\\0';\n"
+    "    *variable = strtod(copy, NULL);\n"
+    "    if(copy != text) free(copy);\n"
+    "failed:\n"
+    "    spl_token = NULL;\n"
+    "}\n\n";
+
+
+#define PRINTLINE(level) append_string(output, "\n"); append_repeated(output, ' ', (level)*4);
+
+/* Print a lowered program as C. Straight-line code becomes one statement per instruction, a
+** WRITE a call to the output function for its type; IF, WHILE, DO and FOR are printed as their
+** C counterparts. */
+int GenerateC(COMPILE_CONTEXT *ctx, IR_PROGRAM *program, STRING_BUILDER *output)
 {
-    INFO("Sanitising identifier: %s\n", *id_ptr)
-    static unsigned int gen_var_count;
-    const char gen_var_prefix = 'v';
-    int i;
-    char *id = *id_ptr;
-    int len = (int)(sizeof(RESERVED_WORDS) / sizeof(RESERVED_WORDS[0]));
-    for(i=0; i < len; i++) {
-        char *rsrvd = RESERVED_WORDS[i];
-        size_t rsrvd_len = strlen(rsrvd);
-        size_t id_len    = strlen(id);
-        if(!strncmp(id, rsrvd, id_len > rsrvd_len ? id_len : rsrvd_len)) {
-            char *var_name = NULL;
-            do {
-            free(var_name);
-            size_t name_length = 
-                1 + snprintf(NULL, 0, "%u", gen_var_count) + 1;
-            var_name = (char *)malloc(name_length);
-            snprintf(var_name, name_length, "%c%u", gen_var_prefix, gen_var_count);
-            } while (lookup_symbol(var_name, symTabRec) >= 0);
-            INFO("Sanitised variable name: %s\n", var_name)
-            *id_ptr = var_name;
-            return;
-        }
+    char written[REAL_T + 1] = {0};
+    char read_in[REAL_T + 1] = {0};
+    int reads;
+    int buffered;
+    mark_io(program->body, written, read_in);
+    reads = read_in[CHAR_T] || read_in[INT_T] || read_in[REAL_T];
+    buffered = reads || written[CHAR_T] || written[INT_T] || written[REAL_T];
+    append_string(output, "#include <stdio.h>\n");
+    if(read_in[INT_T]) append_string(output, "#include <limits.h>\n");
+    if(read_in[REAL_T]) append_string(output, "#include <stdlib.h>\n");
+    if(reads)
+    {
+        append_string(output, "#include <string.h>\n#if defined(__unix__) || defined(__APPLE__)\n");
+        append_string(output, "#include <sys/mman.h>\n#include <sys/stat.h>\n#include <unistd.h>\n#endif\n");
     }
+    append_string(output, "\n");
+    if(program->counter_count > 0) append_string(output, TRIP_COUNT_FUNCTION);
+    if(buffered) append_string(output, OUTPUT_BUFFER);
+    if(written[CHAR_T]) append_string(output, WRITE_CHAR_FUNCTION);
+    if(written[INT_T]) append_string(output, WRITE_INT_FUNCTION);
+    if(written[REAL_T]) append_string(output, WRITE_REAL_FUNCTION);
+    if(reads) append_string(output, INPUT_BUFFER);
+    if(read_in[CHAR_T]) append_string(output, READ_CHAR_FUNCTION);
+    if(read_in[INT_T]) append_string(output, READ_INT_FUNCTION);
+    if(read_in[REAL_T]) append_string(output, READ_REAL_FUNCTION);
+    /* The program is named apart from the C library, which SPL identifiers cannot be, as they
+    ** hold no underscore; a program called read would otherwise clash with read(2) */
+    append_format(output, "void spl_program_%s(void);\n\nint main(void) { spl_program_%s();%s return 0; }\n\nvoid spl_program_%s(void)\n{",
+        program->name, program->name, buffered ? " spl_flush();" : "", program->name);
+    generate_declarations(ctx, program, output);
+    generate_nodes(ctx, program->body, 1, output);
+    append_string(output, "\n}\n");
+    return output->failed ? -1 : 0;
 }
 
-int GenerateC(TERNARY_TREE t, int level, FILE* output)
+static const char *c_type_name(enum SymbolTypes type)
 {
-    static int   declared_sym_only = FALSE;
-    static int   currType;
-    static int   lastType;
-    static int   insideExpr;
-    static char *buffer;
-    static char *fmt_buffer = NULL;
-    static int   fmt_buffer_length;
-           char *indent = NULL;
-           int indent_count = 0;
-    if(level > 0) {
-        indent = malloc(level*4+1);
-        indent[level*4] = '\0';
-    }
-#define PRINTCODE(s) fprintf(output, "%s", s);
-#define BUFFERCODE(s) INFO("Adjusting buffer size from %zd to %zd\n", strlen(s), strlen(s)+strlen(buffer))  \
-                      buffer = (char *)realloc(buffer, strlen(s) + strlen(buffer) + 1); \
-                      INFO("Buffer adjusted.\n") strncat(buffer, s, strlen(s));
-#define BUFFERRESET buffer = calloc(1, sizeof(char));
-#define PRINTBUFFER PRINTCODE(buffer); BUFFERRESET
-#define BUFFER_FMT_STRING(fmt_string, ...) fmt_buffer_length = snprintf(NULL, 0, fmt_string, __VA_ARGS__) + 1; INFO("Fmt string length: %d\n", fmt_buffer_length) \
-                                           fmt_buffer = (char *)malloc(fmt_buffer_length); snprintf(fmt_buffer, fmt_buffer_length, fmt_string, __VA_ARGS__); \
-                                           INFO("Buffering string: %s\n", fmt_buffer) \
-                                           BUFFERCODE(fmt_buffer) \
-                                           INFO("String buffered\n") free(fmt_buffer); fmt_buffer_length = 0;
-#define PRINTLINE fprintf(output, "\n%s", indent);
-#define CALLTREENODE(node, level, output) if(GenerateC(node, level, output) < 0) return -1;
-    for(indent_count = 0; (level > 0) && (indent_count < (level*4)); indent_count++) {
-        indent[indent_count] = ' ';
+    switch(type)
+    {
+        case CHAR_T:
+            return "char";
+        case REAL_T:
+            return "double";
+        default:
+            return "int";
     }
-    static DYNAMIC_SYMTAB *tempSymTabRec;
-    if(tempSymTabRec == NULL)
-        tempSymTabRec = create_dynamic_symtab();
+}
 
-    if(t == NULL) return 1;
-    switch(t->nodeIdentifier)
+/* Variables of the same type declared one after another share a declaration, as they did in
+** the source; the temporaries which are still assigned follow, one declaration for each type */
+static void generate_declarations(COMPILE_CONTEXT *ctx, IR_PROGRAM *program, STRING_BUILDER *output)
+{
+    enum SymbolTypes types[] = {CHAR_T, INT_T, REAL_T};
+    char *assigned = (char *)calloc(program->temp_count + 1, 1);
+    int i;
+    int j;
+    if(assigned != NULL) mark_temps(program->body, assigned);
+    for(i = 0; i < program->variable_count; i++)
     {
-        case PROGRAM:
+        SYMTABNODEPTR symbol = ctx->symTabRec->array[program->variables[i]];
+        if(i > 0 && ctx->symTabRec->array[program->variables[i - 1]]->type == symbol->type)
         {
-            int retVal = 0;
-            BUFFERRESET
-            GenerateC(t->first, level, output);
-            SYMTABNODEPTR prog_id_node = tempSymTabRec->array[0];
-            char *prog_name = prog_id_node->identifier;
-            BUFFERRESET
-            BUFFER_FMT_STRING("#include <stdio.h>\n\nvoid %s(void);\n\nint main(void) { %s(); return 0; }\n\nvoid %s", prog_name, prog_name, prog_name);
-            PRINTBUFFER
-            prog_id_node->declared = TRUE;
-            prog_id_node->type = PROGRAM;
-            reset_dynamic_symtab(tempSymTabRec);
-            PRINTCODE("(void)\n{")
-            level++;
-            BUFFERRESET
-            if(GenerateC(t->second, level, output) < 0) {
-                retVal = -1;
-                goto clean_up;
-            }
-            level--;
-            PRINTCODE("\n}\n")
-            INFO("Cleaning up..\n");
-            clean_up:
-                destroy_symtab(tempSymTabRec);
-                if(indent != NULL)
-                    free(indent);
-                if(buffer != NULL)
-                    free(buffer);
-            return retVal;
+            append_format(output, ", %s", symbol->identifier);
+            continue;
         }
-        case BLOCK:
-            BUFFERRESET
-            BUFFERRESET
-            CALLTREENODE(t->first, level, output);
-            CALLTREENODE(t->second, level, output);
-            return 0;
-        case DECLARATION_BLOCK:
-            CALLTREENODE(t->first, level, output);
-            reset_dynamic_symtab(tempSymTabRec);
-            CALLTREENODE(t->second, level, output);
-            declared_sym_only = TRUE;
-            return 0;
-        case DECLARATION:
-		{
-            PRINTLINE
-            CALLTREENODE(t->second, level, output);
-            PRINTCODE(" ");
-            CALLTREENODE(t->first, level, output);
-            PRINTBUFFER
-            BUFFERRESET
-            PRINTCODE(";")
-			int sym_count = 0;
-            for(sym_count = 0; sym_count < tempSymTabRec->in_use; sym_count++)
-            {
-                SYMTABNODEPTR current_sym = tempSymTabRec->array[sym_count];
-                current_sym->type = currType;
-                if(current_sym->declared) {
-                    ERROR(*lineno, *colno, "Variable with identifier \"%s\" has already been declared.", current_sym->identifier)
-                    return -1;
-                }
-                current_sym->declared = TRUE;
-            }
-            return 0;
-		}
-        case ID_LIST:
-            CALLTREENODE(t->first, level, output);
-            if(t->second != NULL)
-            {
-                BUFFERCODE(", ")
-                CALLTREENODE(t->second, level, output);
-            }
-            return 0;
-        case TYPE_P:
-            currType = t->item;
-            switch(t->item)
+        if(i > 0) append_string(output, ";");
+        PRINTLINE(1)
+        append_format(output, "%s %s", c_type_name(symbol->type), symbol->identifier);
+    }
+    if(program->variable_count > 0) append_string(output, ";");
+    for(j = 0; j < (int)(sizeof(types) / sizeof(types[0])); j++)
+    {
+        int declared = 0;
+        for(i = 1; i <= program->temp_count; i++)
+        {
+            if(program->temp_types[i] != types[j] || (assigned != NULL && !assigned[i])) continue;
+            if(declared++ == 0)
             {
-                case CHAR_T:
-                    PRINTCODE("char")
-                    return 0;
-                case INT_T:
-                    PRINTCODE("int")
-                    return 0;
-                case REAL_T:
-                    PRINTCODE("double")
-                    return 0;
+                PRINTLINE(1)
+                append_format(output, "%s t_", c_type_name(types[j]));
             }
-            return 1;
-        case STATEMENT_LIST:
-            CALLTREENODE(t->first, level, output);
-            CALLTREENODE(t->second, level, output);
-            return 0;
-        case STATEMENT:
-            PRINTLINE
-            CALLTREENODE(t->first, level, output);
-            return 0;
-        case ASSIGNMENT:
+            else append_string(output, ", t_");
+            append_int(output, i);
+        }
+        if(declared > 0) append_string(output, ";");
+    }
+    for(i = 1; i <= program->counter_count; i++)
+    {
+        if(i == 1)
         {
-            SYMTABNODEPTR currSym;
-            BUFFERRESET
-            reset_dynamic_symtab(tempSymTabRec);
-            CALLTREENODE(t->second, level, output);
-            currSym = tempSymTabRec->array[0];
-            BUFFERCODE(" = ")
-            CALLTREENODE(t->first, level, output);
-            if(currSym && (currSym->type < lastType) ) {
-                ERROR(0,0,"Invalid assignment: \"%s\" does not have the correct type.\n", currSym->identifier)
-                return -1;
-            }
-            PRINTBUFFER
-            PRINTCODE(";")
-            currSym->initialised = 1;
-            return 0;
+            PRINTLINE(1)
+            append_string(output, "unsigned long long n_");
         }
-        case IF_S:
-            PRINTCODE("if(")
-            CALLTREENODE(t->first, level, output);
-            PRINTCODE(")"); 
-            PRINTLINE 
-            PRINTCODE("{");
-            CALLTREENODE(t->second, ++level, output); level--;
-            PRINTLINE
-            PRINTCODE("}")
-            if(t->third != NULL)
-            {
-                PRINTLINE
-                PRINTCODE("else"); 
-                PRINTLINE
-                PRINTCODE("{");
-                CALLTREENODE(t->third, ++level, output); level--;
-                PRINTLINE
-                PRINTCODE("}")
-            }
-            return 0;
-        case DO_S:
-            PRINTCODE("do")
-            CALLTREENODE(t->first, level, output);
-            PRINTCODE(" while( ")
-            CALLTREENODE(t->second, level, output);
-            PRINTCODE(" );")
-            return 0;
-        case WHILE_S:
-            PRINTCODE("while ( ")
-            CALLTREENODE(t->first, level, output);
-            PRINTCODE(" )")
-            CALLTREENODE(t->second, level, output);
-            return 0;
-        case FOR_S:
-            PRINTCODE("for( ");
-            CALLTREENODE(t->first, level, output);
-            PRINTCODE("; ")
-            CALLTREENODE(t->second, level, output);
-            PRINTCODE(" )");
-            CALLTREENODE(t->third, level, output); 
-            return 0;
-        case FOR_ASSIGN:
-            reset_dynamic_symtab(tempSymTabRec);
-            BUFFERRESET
-            CALLTREENODE(t->first, level, output);
-            PRINTCODE(" /* identifier */ ");
-            BUFFERCODE(" = ");
-            CALLTREENODE(t->second, level, output);
-            PRINTBUFFER
-            PRINTCODE(" /* value */ ");
-            tempSymTabRec->array[0]->initialised = 1;
-            return 0;
-        case FOR_PROPERTIES:
+        else append_string(output, ", n_");
+        append_int(output, i);
+    }
+    if(program->counter_count > 0) append_string(output, ";");
+    free(assigned);
+}
+
+static void mark_temps(IR_NODE *node, char *assigned)
+{
+    int i;
+    for(; node != NULL; node = node->next)
+    {
+        for(i = 0; i < node->count; i++)
         {
-            SYMTABNODEPTR for_iter = tempSymTabRec->array[0];
-            char *loop_ident = for_iter->identifier;
-            if(for_iter->type == REAL_T) {
-                WARNING(*lineno, 0, "Iterator \"%s\" defined as type REAL may cause the FOR loop to run perpetually.\n", loop_ident)
-            }
-            BUFFERRESET
-            /* Decide what the condition sign should be */
-            TERNARY_TREE curr_by_tree = t->first;
-            if(curr_by_tree->nodeIdentifier == EXPRESSION) {
-                /* If there is no +/- operators within the expression */
-                INFO("FOR loop: Iterator is EXPRESSION\n")
-                curr_by_tree = curr_by_tree->first;
-                if(curr_by_tree->nodeIdentifier == TERM) {
-                    /* If there is no * /(divide) operators within the term   */
-                    INFO("FOR loop: Iterator is TERM\n")
-                    curr_by_tree = curr_by_tree->first;
-                    if(curr_by_tree->nodeIdentifier == VAL_CONSTANT) {
-                        /* If the "by" clause is a constant value
-                        /* This makes it easier to decide what sign we should use in the condition */
-                        INFO("FOR loop: Iterator is VAL_CONSTANT\n")
-                        char *sign = malloc(2);
-                        curr_by_tree = curr_by_tree->first;
-                        if(curr_by_tree->nodeIdentifier == CHAR_CONST) {
-                            /* A char is an unsigned integer constant therefore it must always be positive */
-                            sign = "<=";
-                        }
-                        else {
-                            int curr_by_tree_node = curr_by_tree->first->nodeIdentifier;
-                            if(curr_by_tree_node == INT_CONST || curr_by_tree_node == FLOAT_CONST) {
-                                sign = "<=";
-                            }
-                            else if(curr_by_tree_node == NEG_INT_CONST || 
-                                    curr_by_tree_node == NEG_FLOAT_CONST) {
-                                        sign = ">=";
-                                    }
-                            else {
-                                WARNING(*lineno, *colno, "Error parsing value of BY clause of FOR loop, reverting to default \"!=\" operator.")
-                                sign = "!=";
-                            }
-                        }
-                        BUFFERCODE(loop_ident) BUFFER_FMT_STRING(" %s ", sign)
-                        TREE_INFO("Buffered for-loop identifier..\n")
-                        CALLTREENODE(t->second, level, output);
-                    }
+            if(node->code[i].dest.kind == IR_TEMP) assigned[node->code[i].dest.index] = TRUE;
+        }
+        mark_condition_temps(node->condition, assigned);
+        mark_temps(node->body, assigned);
+        mark_temps(node->orelse, assigned);
+        mark_temps(node->init, assigned);
+        mark_temps(node->step, assigned);
+    }
+}
+
+static void mark_condition_temps(IR_CONDITION *condition, char *assigned)
+{
+    if(condition == NULL) return;
+    mark_temps(condition->setup, assigned);
+    mark_condition_temps(condition->first, assigned);
+    mark_condition_temps(condition->second, assigned);
+}
+
+/* The types WRITE and READ are given, with NEWLINE as a CHAR. Conditions never print or read,
+** so only the statements need looking at. */
+static void mark_io(IR_NODE *node, char *written, char *read)
+{
+    int i;
+    for(; node != NULL; node = node->next)
+    {
+        for(i = 0; i < node->count; i++)
+        {
+            IR_INSTRUCTION *instruction = &node->code[i];
+            enum SymbolTypes type = instruction->type == CHAR_T || instruction->type == REAL_T ? instruction->type : INT_T;
+            if(instruction->op == IR_WRITE) written[type] = TRUE;
+            else if(instruction->op == IR_NEWLINE) written[CHAR_T] = TRUE;
+            else if(instruction->op == IR_READ) read[type] = TRUE;
+        }
+        mark_io(node->body, written, read);
+        mark_io(node->orelse, written, read);
+    }
+}
+
+static void generate_nodes(COMPILE_CONTEXT *ctx, IR_NODE *node, int level, STRING_BUILDER *output)
+{
+    for(; node != NULL; node = node->next)
+    {
+        switch(node->kind)
+        {
+            case IR_BLOCK:
+                generate_block(ctx, node, level, output);
+                break;
+            case IR_IF:
+                PRINTLINE(level)
+                append_string(output, "if(");
+                generate_condition(ctx, node->condition, output);
+                append_string(output, ")");
+                PRINTLINE(level)
+                append_string(output, "{");
+                generate_nodes(ctx, node->body, level + 1, output);
+                PRINTLINE(level)
+                append_string(output, "}");
+                if(node->orelse != NULL)
+                {
+                    PRINTLINE(level)
+                    append_string(output, "else");
+                    PRINTLINE(level)
+                    append_string(output, "{");
+                    generate_nodes(ctx, node->orelse, level + 1, output);
+                    PRINTLINE(level)
+                    append_string(output, "}");
                 }
-                else {
-                    BUFFERCODE("(")
-                    CALLTREENODE(t->first, level, output)
-                    BUFFER_FMT_STRING(" > 0 ? %s-(", loop_ident)
-                    CALLTREENODE(t->second, level, output)
-                    BUFFERCODE(") : (")
-                    CALLTREENODE(t->second, level, output)
-                    BUFFER_FMT_STRING(")-%s ) <= 0", loop_ident)
+                break;
+            case IR_WHILE:
+                PRINTLINE(level)
+                append_string(output, "while(");
+                generate_condition(ctx, node->condition, output);
+                append_string(output, ")");
+                PRINTLINE(level)
+                append_string(output, "{");
+                generate_nodes(ctx, node->body, level + 1, output);
+                PRINTLINE(level)
+                append_string(output, "}");
+                break;
+            case IR_DO:
+                PRINTLINE(level)
+                append_string(output, "do");
+                PRINTLINE(level)
+                append_string(output, "{");
+                generate_nodes(ctx, node->body, level + 1, output);
+                PRINTLINE(level)
+                append_string(output, "} while(");
+                generate_condition(ctx, node->condition, output);
+                append_string(output, ");");
+                break;
+            case IR_FOR:
+                PRINTLINE(level)
+                append_string(output, "for(");
+                generate_expression_list(ctx, node->init, output);
+                if(node->counter != 0)
+                {
+                    append_format(output, ", n_%d = spl_trips(", node->counter);
+                    generate_operand(ctx, node->variable, output);
+                    append_string(output, ", ");
+                    generate_operand(ctx, node->bound, output);
+                    append_string(output, ", ");
+                    generate_operand(ctx, node->stride, output);
+                    append_format(output, "); n_%d != 0; n_%d--, ", node->counter, node->counter);
                 }
-            }
-            else {
-                BUFFERCODE("(")
-                CALLTREENODE(t->first, level, output)
-                BUFFER_FMT_STRING(" > 0 ? %s-(", loop_ident)
-                CALLTREENODE(t->second, level, output)
-                BUFFERCODE(") : (")
-                CALLTREENODE(t->second, level, output)
-                BUFFER_FMT_STRING(")-%s ) <= 0", loop_ident)
-            }
-            TREE_INFO("Generated loop condition..\n")
-            BUFFER_FMT_STRING("; %s = %s+(", loop_ident, loop_ident)
-            /*INFO("Start generating iterator..\n")*/
-            CALLTREENODE(t->first, level, output);
-            TREE_INFO("Generated iterator..\n")
-            BUFFERCODE(")")
-            TREE_INFO("Completed for-loop declaration\n")
-            PRINTBUFFER
-            BUFFERRESET
-            return 0;
-        }
-        case LOOP_BODY:
-            PRINTLINE
-            PRINTCODE("{")
-            CALLTREENODE(t->first, ++level, output); level--;
-            PRINTLINE
-            PRINTCODE("}")
-            return 0;
-        case WRITE_S:
-		{
-            reset_dynamic_symtab(tempSymTabRec);
-            BUFFERRESET
-            CALLTREENODE(t->first, level, output);
-            INFO("Number of outputs: %d", tempSymTabRec->in_use)
-            int sym_count;
-            for(sym_count = 0; sym_count < tempSymTabRec->in_use; sym_count++) {
-                SYMTABNODEPTR curr_sym = tempSymTabRec->array[sym_count];
-                if(curr_sym->identifier && !curr_sym->initialised) {
-                    ERROR(*lineno, *colno, "Attempt to WRITE uninitialised variable \"%s\"\n", curr_sym->identifier)
-                    return -1;
+                else
+                {
+                    append_string(output, "; ");
+                    generate_condition(ctx, node->condition, output);
+                    append_string(output, "; ");
                 }
-            }
-            PRINTCODE("printf(\"")
-            for(sym_count = 0; sym_count < tempSymTabRec->in_use; sym_count++)
-            {
-                PRINTCODE(get_formatter(tempSymTabRec->array[sym_count]->type))
-            }
-            PRINTCODE("\", ")
-            PRINTBUFFER
-            PRINTCODE(")")
-            PRINTCODE(";")
-            BUFFERRESET
-            return 0;
-		}
-        case WRITE_NEWLINE:
-            PRINTCODE("putchar('\\n');")
-            return 0;
-        case READ_S:
-        {
-            reset_dynamic_symtab(tempSymTabRec);
-            enum SymbolTypes read_type = symTabRec->array[t->first->item]->type;
-#ifdef DEBUG
-            BUFFER_FMT_STRING("/* Type is %d */", read_type) PRINTLINE
-#endif
-            PRINTCODE("scanf(\"")
-            BUFFERRESET
-            BUFFER_FMT_STRING("%s%s\", &", read_type == CHAR_T ? " " : "", get_formatter(read_type))
-            CALLTREENODE(t->first, level, output); 
-            PRINTBUFFER
-            PRINTCODE(")")
-            PRINTCODE(";")
-            tempSymTabRec->array[0]->initialised = TRUE;
-            return 0;
+                generate_expression_list(ctx, node->step, output);
+                append_string(output, ")");
+                PRINTLINE(level)
+                append_string(output, "{");
+                generate_nodes(ctx, node->body, level + 1, output);
+                PRINTLINE(level)
+                append_string(output, "}");
+                break;
         }
-        case OUTPUT_LIST:
+    }
+}
+
+static void generate_block(COMPILE_CONTEXT *ctx, IR_NODE *block, int level, STRING_BUILDER *output)
+{
+    int i;
+    for(i = 0; i < block->count; i++)
+    {
+        IR_INSTRUCTION *instruction = &block->code[i];
+        if(instruction->op == IR_NOP) continue;
+        PRINTLINE(level)
+        switch(instruction->op)
         {
+            case IR_WRITE:
+                append_format(output, "spl_write_%s(", instruction->type == CHAR_T ? "char" : instruction->type == REAL_T ? "real" : "int");
+                generate_operand(ctx, instruction->a, output);
+                append_string(output, ");");
+                break;
+            case IR_NEWLINE:
+                append_string(output, "spl_write_char('\\n');");
+                break;
+            case IR_READ:
+                append_format(output, "spl_read_%s(&", instruction->type == CHAR_T ? "char" : instruction->type == REAL_T ? "real" : "int");
+                generate_operand(ctx, instruction->dest, output);
+                append_string(output, ");");
+                break;
+            default:
+                generate_instruction(ctx, instruction, output);
+                append_string(output, ";");
+                break;
+        }
+    }
+}
 
-            currType = 0;
-            CALLTREENODE(t->first, level, output);
-            SYMTABNODEPTR placeholder = (SYMTABNODEPTR)malloc(sizeof(SYMTABNODE));
-            placeholder->type = currType;
-            placeholder->identifier = NULL;
-            /* Because symbols are automatically added to the symbol stack, unless within an expression */
-            if(t->first->nodeIdentifier != VAL_IDENTIFIER)
-                add_symbol(tempSymTabRec, placeholder);
-            if(t->second != NULL)
-            {
-                BUFFERCODE(", ")
-                CALLTREENODE(t->second, level, output);
-            }
-            return 0;
+/* The arithmetic of a FOR's init and step, or of a comparison's setup, as a comma expression */
+static void generate_expression_list(COMPILE_CONTEXT *ctx, IR_NODE *node, STRING_BUILDER *output)
+{
+    int i;
+    int first = TRUE;
+    for(; node != NULL; node = node->next)
+    {
+        for(i = 0; i < node->count; i++)
+        {
+            if(!first) append_string(output, ", ");
+            generate_instruction(ctx, &node->code[i], output);
+            first = FALSE;
         }
-        case CONDITIONAL:
-            CALLTREENODE(t->first, level, output);
-            return 0;
-        case NEGATION:
-            PRINTCODE("!( ")
-            CALLTREENODE(t->first, level, output);
-            PRINTCODE(" )")
-            return 0;
-        case LOG_AND:
-            PRINTCODE("( ")
-            CALLTREENODE(t->first, level, output);
-            PRINTCODE(" && ")
-            CALLTREENODE(t->second, level, output);
-            PRINTCODE(" )")
-            return 0;
-        case LOG_OR:
-            PRINTCODE("( ")
-            CALLTREENODE(t->first, level, output);
-            PRINTCODE(" || ")
-            CALLTREENODE(t->second, level, output);
-            PRINTCODE(" )")
-            return 0;
-        case COMPARISON:
-            BUFFERRESET
-            CALLTREENODE(t->first, level, output); BUFFERCODE(" ");
-            CALLTREENODE(t->second, level, output); BUFFERCODE(" ");
-            CALLTREENODE(t->third, level, output);
-            PRINTBUFFER
-            BUFFERRESET
-            return 0;
-        case COMPARATOR:
-            switch(t->item)
-            {
-                case SYM_EQ_TO:
-                    BUFFERCODE("==");
-                    break;
-                case SYM_NEQ_TO:
-                    BUFFERCODE("!=");
-                    break;
-                case SYM_LESS_THAN:
-                    BUFFERCODE("<");
-                    break;
-                case SYM_GREATER_THAN:
-                    BUFFERCODE(">");
-                    break;
-                case SYM_LESS_THAN_EQ:
-                    BUFFERCODE("<=");
-                    break;
-                case SYM_GREATER_THAN_EQ:
-                    BUFFERCODE(">=");
-                    break;
-            }
-            return 0;
-        case EXPRESSION:
-            {
-                int notAlreadyInside = insideExpr == FALSE;
-                TREE_INFO("Entered expression%s..current buffer is \n%s\n", notAlreadyInside ? " at top of expr tree" : "", buffer)
-                if(notAlreadyInside) insideExpr = TRUE;
-                CALLTREENODE(t->first, level, output);
-                if(notAlreadyInside) insideExpr = FALSE;
-            }
-            return 0;
-        case EXPR_ADD:
-            CALLTREENODE(t->first, level, output);
-            BUFFERCODE(" + ")
-            CALLTREENODE(t->second, level, output);
-            return 0;
-        case EXPR_MINUS:
-            CALLTREENODE(t->first, level, output);
-            BUFFERCODE(" - ")
-            CALLTREENODE(t->second, level, output);
-            return 0;
-        case TERM:
-            TREE_INFO("Inside term..\n")
-            CALLTREENODE(t->first, level, output);
-            return 0;
-        case TERM_MUL:
-            CALLTREENODE(t->first, level, output);
-            BUFFERCODE(" * ")
-            CALLTREENODE(t->second, level, output);
-            return 0;
-        case TERM_DIV:
-            CALLTREENODE(t->first, level, output);
-            BUFFERCODE(" / ")
-            CALLTREENODE(t->second, level, output);
-            return 0;
-        case VAL_IDENTIFIER:
-            CALLTREENODE(t->first, level, output);
-            return 0;
-        case VAL_CONSTANT:
-            TREE_INFO("Found a constant..\n")
-            CALLTREENODE(t->first, level, output);
-            return 0;
-        case VAL_EXPR:
-            CALLTREENODE(t->first, level, output);
-            return 0;
-        case NUMBER_CONST:
-            TREE_INFO("Constant is a number..\n")
-            CALLTREENODE(t->first, level, output);
-            return 0;
-        case CHAR_CONST:
-            BUFFER_FMT_STRING("'%c'", (char)t->item);
-            if(currType < CHAR_T) currType = CHAR_T;
-            lastType = CHAR_T;
-            return 0;
-        case INT_CONST:
-            BUFFER_FMT_STRING("%d", t->item);
-            if(currType < INT_T) currType = INT_T;
-            lastType = INT_T;
-            return 0;
-        case NEG_INT_CONST:
-            TREE_INFO("Hit negative integer literal: %d\n", t->item)
-            BUFFER_FMT_STRING("%d", -t->item);
-            /*TREE_INFO("Literal has been buffered..\n")*/
-            if(currType < INT_T) currType = INT_T;
-            lastType = INT_T;
-            return 0;
-        case FLOAT_CONST:
-            BUFFERCODE(symTabRec->array[t->item]->identifier);
-            if(currType < REAL_T) currType = REAL_T;
-            lastType = REAL_T;
-            return 0;
-        case NEG_FLOAT_CONST:
-            BUFFERCODE(make_float_negative(symTabRec->array[t->item]->identifier))
-            if(currType < REAL_T) currType = REAL_T;
-            lastType = REAL_T;
-            return 0;
-        case ID_VAL:
+    }
+}
+
+static int has_expressions(IR_NODE *node)
+{
+    for(; node != NULL; node = node->next)
+    {
+        if(node->count > 0) return TRUE;
+    }
+    return FALSE;
+}
+
+static void generate_instruction(COMPILE_CONTEXT *ctx, IR_INSTRUCTION *instruction, STRING_BUILDER *output)
+{
+    generate_operand(ctx, instruction->dest, output);
+    append_string(output, " = ");
+    if(instruction->op == IR_SHL)
+    {
+        /* A shift of a negative int is undefined in C, where the multiplication it stands for
+        ** would not be */
+        append_string(output, "(int)((unsigned int)");
+        generate_operand(ctx, instruction->a, output);
+        append_string(output, " << ");
+        generate_operand(ctx, instruction->b, output);
+        append_string(output, ")");
+        return;
+    }
+    generate_operand(ctx, instruction->a, output);
+    if(instruction->op != IR_COPY)
+    {
+        append_string(output, C_OPERATORS[instruction->op]);
+        generate_operand(ctx, instruction->b, output);
+    }
+}
+
+static void generate_condition(COMPILE_CONTEXT *ctx, IR_CONDITION *condition, STRING_BUILDER *output)
+{
+    switch(condition->kind)
+    {
+        case IR_COMPARE:
         {
-            SYMTABNODEPTR sym_ptr = symTabRec->array[t->item];
-            if(!declared_sym_only && !sym_ptr->sanitised) {
-                sanitise_identifier(&(sym_ptr->identifier));
-            }
-            if(declared_sym_only && !sym_ptr->declared) {
-                ERROR(*lineno, *colno, "Unknown identifier \"%s\"\n", sym_ptr->identifier)
-                add_symbol(tempSymTabRec, sym_ptr);
-                return -1;
-            }
-            BUFFERCODE(sym_ptr->identifier);
-            if(insideExpr)
+            /* The passes may have emptied the setup */
+            int bracketed = has_expressions(condition->setup);
+            if(bracketed)
             {
-                if(currType < sym_ptr->type) currType = sym_ptr->type;
+                append_string(output, "(");
+                generate_expression_list(ctx, condition->setup, output);
+                append_string(output, ", ");
             }
-            else add_symbol(tempSymTabRec, sym_ptr);
-            return 0;
+            generate_operand(ctx, condition->left, output);
+            append_format(output, " %s ", C_COMPARATORS[condition->compare]);
+            generate_operand(ctx, condition->right, output);
+            if(bracketed) append_string(output, ")");
+            break;
         }
+        case IR_NOT:
+            append_string(output, "!( ");
+            generate_condition(ctx, condition->first, output);
+            append_string(output, " )");
+            break;
+        case IR_AND:
+        case IR_OR:
+            append_string(output, "( ");
+            generate_condition(ctx, condition->first, output);
+            append_string(output, condition->kind == IR_AND ? " && " : " || ");
+            generate_condition(ctx, condition->second, output);
+            append_string(output, " )");
+            break;
     }
-    if(indent != NULL) 
-        free(indent);
 }
 
-#endif
\ No newline at end of file
+static void generate_operand(COMPILE_CONTEXT *ctx, IR_OPERAND operand, STRING_BUILDER *output)
+{
+    switch(operand.kind)
+    {
+        case IR_VARIABLE:
+            append_string(output, ctx->symTabRec->array[operand.index]->identifier);
+            break;
+        case IR_TEMP:
+            append_string(output, "t_");
+            append_int(output, operand.index);
+            break;
+        case IR_INT_CONST:
+            /* -2147483648 would be the negation of a constant too big for an int */
+            if(operand.value == INT_MIN) append_format(output, "(%d - 1)", INT_MIN + 1);
+            else append_int(output, operand.value);
+            break;
+        case IR_CHAR_CONST:
+            /* Characters which would need escaping are given by value */
+            if(isprint((unsigned char)operand.value) && operand.value != '\'' && operand.value != '\\')
+                append_format(output, "'%c'", (char)operand.value);
+            else append_format(output, "%d", (char)operand.value);
+            break;
+        case IR_REAL_CONST:
+            if(operand.value) append_string(output, "-");
+            append_string(output, ctx->symTabRec->array[operand.index]->identifier);
+            break;
+        case IR_NONE:
+            break;
+    }
+}
+
+#endif
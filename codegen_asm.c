@@ -0,0 +1,824 @@
+#ifndef DEBUG
+
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#include "include/codegen.h"
+#include "include/compile.h"
+#include "include/ir.h"
+#include "include/splio.h"
+#include "include/string_builder.h"
+#include "include/symbol_table.h"
+
+/* ------------- x86-64 assembly --------------------------- */
+
+/* The lowered program as x86-64 assembly for the System V ABI, in the syntax of the GNU
+** assembler, so it can be built without a C compiler's front end: cc program.s, or as and ld
+** with the C library. Every variable, temporary and counter is live from the first to the last
+** instruction naming it, and over the whole of any loop which carries it round. Registers are
+** given out over those intervals by linear scan, and what does not fit lives in the frame.
+** CHARACTER and INTEGER values are held in general registers, REAL values in SSE2 registers.
+**
+** WRITE and READ call a small runtime written out after the program. It calls printf and scanf
+** with the formats the generated C uses, and saves every register the program was given, so a
+** value stays in its register across them. %eax, %ecx and %edx, and %xmm0 and %xmm1, are
+** scratch, and carry values to and from the runtime. */
+
+#define CALLEE_SAVED_COUNT 5
+#define INT_REGISTER_COUNT 11
+#define REAL_REGISTER_COUNT 14      /* %xmm2 to %xmm15 */
+#define FIRST_SPILL_OFFSET 48       /* Below the saved %rbp, %rbx and %r12 to %r15 */
+#define LOCATION_LENGTH 32
+
+/* The callee-saved registers first; the runtime saves the others it might lose */
+static const char *const LONG_REGISTERS[] = {"%rbx", "%r12", "%r13", "%r14", "%r15", "%rsi", "%rdi", "%r8", "%r9",
+    "%r10", "%r11"};
+static const char *const WORD_REGISTERS[] = {"%ebx", "%r12d", "%r13d", "%r14d", "%r15d", "%esi", "%edi", "%r8d", "%r9d",
+    "%r10d", "%r11d"};
+
+/* In the order of enum CompareSymType */
+static const char *const INT_JUMPS[] = {"je", "jne", "jl", "jg", "jle", "jge"};
+static const enum CompareSymType MIRRORED_COMPARES[] = {SYM_EQ_TO, SYM_NEQ_TO, SYM_GREATER_THAN, SYM_LESS_THAN,
+    SYM_GREATER_THAN_EQ, SYM_LESS_THAN_EQ};
+static const enum CompareSymType NEGATED_COMPARES[] = {SYM_NEQ_TO, SYM_EQ_TO, SYM_GREATER_THAN_EQ, SYM_LESS_THAN_EQ,
+    SYM_GREATER_THAN, SYM_LESS_THAN};
+static const char *const INT_OPERATIONS[] = {"movl", "addl", "subl", "imull", "idivl", "shll"};
+static const char *const REAL_OPERATIONS[] = {"movsd", "addsd", "subsd", "mulsd", "divsd", ""};
+
+enum AsmValueClass {ASM_INT, ASM_REAL, ASM_COUNTER};
+
+typedef struct {
+    enum AsmValueClass class;
+    int start;                  /* The first position naming it, or -1 when none does */
+    int end;
+    int reg;                    /* Its register, or -1 when it lives in the frame */
+    int offset;                 /* Its place in the frame, below %rbp */
+    int zeroed;                 /* Set to 0 on entry */
+} ASM_VALUE;
+
+/* Variable s is value s, temporary n value temp_base + n and counter n value counter_base + n */
+typedef struct {
+    COMPILE_CONTEXT *ctx;
+    STRING_BUILDER *output;
+    ASM_VALUE *values;
+    int value_count;
+    int temp_base;
+    int counter_base;
+    int position;
+    int *named;                 /* The values named, in order, so loops can extend them */
+    int named_count;
+    int named_capacity;
+    int frame_slots;
+    int int_used;               /* How many of the registers were given out */
+    int real_used;
+    int labels;
+    double *constants;          /* REAL constants, labelled .LR and their index */
+    int constant_count;
+    int constant_capacity;
+    int failed;                 /* Out of memory */
+} ASM_STATE;
+
+typedef struct {
+    int start;
+    int value;
+} ASM_INTERVAL;
+
+static void scan_asm_nodes(ASM_STATE *, IR_NODE *);
+static void scan_asm_condition(ASM_STATE *, IR_CONDITION *);
+static void name_value(ASM_STATE *, IR_OPERAND, int);
+static void allocate_asm_registers(ASM_STATE *);
+static int compare_intervals(const void *, const void *);
+static void emit_asm_nodes(ASM_STATE *, IR_NODE *);
+static void emit_asm_loop(ASM_STATE *, IR_NODE *);
+static void emit_asm_instruction(ASM_STATE *, IR_INSTRUCTION *);
+static void emit_asm_condition(ASM_STATE *, IR_CONDITION *, int, int);
+static void emit_int_branch(ASM_STATE *, IR_CONDITION *, int, int);
+static void emit_real_branch(ASM_STATE *, IR_CONDITION *, int, int);
+static void emit_runtime(ASM_STATE *);
+static int value_of(ASM_STATE *, IR_OPERAND);
+static const char *locate(ASM_STATE *, int, int, char *);
+static int in_register(ASM_STATE *, IR_OPERAND);
+static double constant_value(ASM_STATE *, IR_OPERAND);
+static const char *real_data(ASM_STATE *, double, char *);
+static const char *int_source(ASM_STATE *, IR_OPERAND, const char *, char *);
+static const char *real_source(ASM_STATE *, IR_OPERAND, const char *, char *);
+static void load_int(ASM_STATE *, IR_OPERAND, const char *);
+static void load_real(ASM_STATE *, IR_OPERAND, const char *);
+static void store_int(ASM_STATE *, IR_OPERAND);
+static void store_real(ASM_STATE *, IR_OPERAND);
+
+int GenerateAsm(COMPILE_CONTEXT *ctx, IR_PROGRAM *program, STRING_BUILDER *output)
+{
+    ASM_STATE state;
+    int frame;
+    int i;
+    memset(&state, 0, sizeof(ASM_STATE));
+    state.ctx = ctx;
+    state.output = output;
+    state.temp_base = ctx->symTabRec->in_use;
+    state.counter_base = state.temp_base + program->temp_count;
+    state.value_count = state.counter_base + program->counter_count + 1;
+    state.values = (ASM_VALUE *)calloc(state.value_count, sizeof(ASM_VALUE));
+    if(state.values == NULL) return -1;
+    for(i = 0; i < state.value_count; i++)
+    {
+        state.values[i].start = -1;
+        state.values[i].reg = -1;
+        if(i > state.counter_base) state.values[i].class = ASM_COUNTER;
+        else if(i > state.temp_base) state.values[i].class = program->temp_types[i - state.temp_base] == REAL_T ? ASM_REAL : ASM_INT;
+        else state.values[i].class = i < ctx->symTabRec->in_use && ctx->symTabRec->array[i]->type == REAL_T ? ASM_REAL : ASM_INT;
+    }
+    scan_asm_nodes(&state, program->body);
+    if(!state.failed) allocate_asm_registers(&state);
+    INFO("Assembly: %d general and %d SSE registers, %d values in the frame\n", state.int_used, state.real_used, state.frame_slots)
+
+    /* The frame keeps %rsp 16 byte aligned at each call */
+    frame = 8*state.frame_slots;
+    if(frame % 16 == 0) frame += 8;
+    append_format(output, "# %s, compiled from SPL\n\t.text\n\t.globl\tmain\n\t.type\tmain, @function\nmain:\n", program->name);
+    append_string(output, "\tpushq\t%rbp\n\tmovq\t%rsp, %rbp\n");
+    for(i = 0; i < CALLEE_SAVED_COUNT; i++) append_format(output, "\tpushq\t%s\n", LONG_REGISTERS[i]);
+    append_format(output, "\tsubq\t$%d, %%rsp\n", frame);
+    for(i = 0; i < state.value_count; i++)
+    {
+        char buffer[LOCATION_LENGTH];
+        const char *location;
+        if(!state.values[i].zeroed) continue;
+        location = locate(&state, i, FALSE, buffer);
+        if(state.values[i].reg < 0) append_format(output, "\tmovq\t$0, %s\n", location);
+        else if(state.values[i].class == ASM_REAL) append_format(output, "\txorpd\t%s, %s\n", location, location);
+        else append_format(output, "\txorl\t%s, %s\n", location, location);
+    }
+    emit_asm_nodes(&state, program->body);
+    append_format(output, "\txorl\t%%eax, %%eax\n\tleaq\t-%d(%%rbp), %%rsp\n", 8*CALLEE_SAVED_COUNT);
+    for(i = CALLEE_SAVED_COUNT - 1; i >= 0; i--) append_format(output, "\tpopq\t%s\n", LONG_REGISTERS[i]);
+    append_string(output, "\tpopq\t%rbp\n\tret\n\t.size\tmain, .-main\n");
+    emit_runtime(&state);
+
+    free(state.values);
+    free(state.named);
+    free(state.constants);
+    return state.failed || output->failed ? -1 : 0;
+}
+
+/* ------------- live intervals --------------------------- */
+
+/* Positions are handed out in the order the code is written out, a loop's condition once */
+static void scan_asm_nodes(ASM_STATE *state, IR_NODE *node)
+{
+    int start;
+    int mark;
+    int i;
+    for(; node != NULL; node = node->next)
+    {
+        switch(node->kind)
+        {
+            case IR_BLOCK:
+                for(i = 0; i < node->count; i++)
+                {
+                    if(node->code[i].op == IR_NOP) continue;
+                    state->position++;
+                    name_value(state, node->code[i].a, TRUE);
+                    name_value(state, node->code[i].b, TRUE);
+                    name_value(state, node->code[i].dest, node->code[i].op == IR_READ);
+                }
+                break;
+            case IR_IF:
+                scan_asm_condition(state, node->condition);
+                scan_asm_nodes(state, node->body);
+                scan_asm_nodes(state, node->orelse);
+                break;
+            case IR_WHILE:
+            case IR_DO:
+            case IR_FOR:
+                scan_asm_nodes(state, node->init);
+                state->position++;
+                if(node->counter != 0)
+                {
+                    name_value(state, node->variable, TRUE);
+                    name_value(state, node->bound, TRUE);
+                    name_value(state, node->stride, TRUE);
+                }
+                start = ++state->position;
+                mark = state->named_count;
+                if(node->counter == 0) scan_asm_condition(state, node->condition);
+                scan_asm_nodes(state, node->body);
+                scan_asm_nodes(state, node->step);
+                state->position++;
+                if(node->counter != 0)
+                {
+                    state->values[state->counter_base + node->counter].start = start - 1;
+                    state->values[state->counter_base + node->counter].end = state->position;
+                }
+                /* A variable named in the loop may be carried round it, as may anything from
+                ** before the loop; a temporary first assigned in it is not */
+                for(i = mark; i < state->named_count; i++)
+                {
+                    ASM_VALUE *value = &state->values[state->named[i]];
+                    if(state->named[i] > state->temp_base && value->start >= start) continue;
+                    if(value->start > start) value->start = start;
+                    if(value->end < state->position) value->end = state->position;
+                }
+                break;
+        }
+    }
+}
+
+static void scan_asm_condition(ASM_STATE *state, IR_CONDITION *condition)
+{
+    switch(condition->kind)
+    {
+        case IR_COMPARE:
+            scan_asm_nodes(state, condition->setup);
+            state->position++;
+            name_value(state, condition->left, TRUE);
+            name_value(state, condition->right, TRUE);
+            break;
+        case IR_NOT:
+            scan_asm_condition(state, condition->first);
+            break;
+        case IR_AND:
+        case IR_OR:
+            scan_asm_condition(state, condition->first);
+            scan_asm_condition(state, condition->second);
+            break;
+    }
+}
+
+/* A variable read before anything is assigned to it is live, as 0, from the start */
+static void name_value(ASM_STATE *state, IR_OPERAND operand, int read)
+{
+    int index = value_of(state, operand);
+    ASM_VALUE *value;
+    if(index < 0) return;
+    value = &state->values[index];
+    if(value->start < 0)
+    {
+        value->zeroed = read;
+        value->start = read ? 0 : state->position;
+    }
+    value->end = state->position;
+    if(state->named_count == state->named_capacity)
+    {
+        int capacity = state->named_capacity ? state->named_capacity*2 : 256;
+        int *grown = (int *)realloc(state->named, sizeof(int) * capacity);
+        if(grown == NULL)
+        {
+            state->failed = TRUE;
+            return;
+        }
+        state->named = grown;
+        state->named_capacity = capacity;
+    }
+    state->named[state->named_count++] = index;
+}
+
+/* Each interval in turn takes a free register of its class. When there is none, whichever of
+** it and those holding a register lives longest goes to the frame. */
+static void allocate_asm_registers(ASM_STATE *state)
+{
+    ASM_INTERVAL *intervals = (ASM_INTERVAL *)malloc(sizeof(ASM_INTERVAL) * state->value_count);
+    int holders[INT_REGISTER_COUNT + REAL_REGISTER_COUNT];
+    int count = 0;
+    int i;
+    int r;
+    if(intervals == NULL)
+    {
+        state->failed = TRUE;
+        return;
+    }
+    for(i = 0; i < state->value_count; i++)
+    {
+        if(state->values[i].start < 0) continue;
+        intervals[count].start = state->values[i].start;
+        intervals[count++].value = i;
+    }
+    qsort(intervals, count, sizeof(ASM_INTERVAL), compare_intervals);
+    for(r = 0; r < INT_REGISTER_COUNT + REAL_REGISTER_COUNT; r++) holders[r] = -1;
+
+    for(i = 0; i < count; i++)
+    {
+        ASM_VALUE *value = &state->values[intervals[i].value];
+        int first = value->class == ASM_REAL ? INT_REGISTER_COUNT : 0;
+        int last = value->class == ASM_REAL ? INT_REGISTER_COUNT + REAL_REGISTER_COUNT : INT_REGISTER_COUNT;
+        int free_register = -1;
+        int longest = -1;
+        for(r = first; r < last; r++)
+        {
+            if(holders[r] >= 0 && state->values[holders[r]].end < value->start) holders[r] = -1;
+            if(holders[r] < 0)
+            {
+                if(free_register < 0) free_register = r;
+            }
+            else if(longest < 0 || state->values[holders[r]].end > state->values[holders[longest]].end) longest = r;
+        }
+        if(free_register < 0 && state->values[holders[longest]].end > value->end)
+        {
+            ASM_VALUE *spilled = &state->values[holders[longest]];
+            spilled->reg = -1;
+            spilled->offset = FIRST_SPILL_OFFSET + 8*state->frame_slots++;
+            free_register = longest;
+        }
+        if(free_register < 0)
+        {
+            value->offset = FIRST_SPILL_OFFSET + 8*state->frame_slots++;
+            continue;
+        }
+        holders[free_register] = intervals[i].value;
+        value->reg = free_register - first;
+        if(value->class == ASM_REAL && value->reg >= state->real_used) state->real_used = value->reg + 1;
+        if(value->class != ASM_REAL && value->reg >= state->int_used) state->int_used = value->reg + 1;
+    }
+    free(intervals);
+}
+
+static int compare_intervals(const void *a, const void *b)
+{
+    const ASM_INTERVAL *left = (const ASM_INTERVAL *)a;
+    const ASM_INTERVAL *right = (const ASM_INTERVAL *)b;
+    if(left->start != right->start) return left->start < right->start ? -1 : 1;
+    return left->value < right->value ? -1 : left->value > right->value;
+}
+
+/* ------------- code --------------------------- */
+
+static void emit_asm_nodes(ASM_STATE *state, IR_NODE *node)
+{
+    int orelse;
+    int end;
+    int i;
+    for(; node != NULL; node = node->next)
+    {
+        switch(node->kind)
+        {
+            case IR_BLOCK:
+                for(i = 0; i < node->count; i++) emit_asm_instruction(state, &node->code[i]);
+                break;
+            case IR_IF:
+                orelse = ++state->labels;
+                emit_asm_condition(state, node->condition, FALSE, orelse);
+                emit_asm_nodes(state, node->body);
+                if(node->orelse != NULL)
+                {
+                    end = ++state->labels;
+                    append_format(state->output, "\tjmp\t.L%d\n.L%d:\n", end, orelse);
+                    emit_asm_nodes(state, node->orelse);
+                    append_format(state->output, ".L%d:\n", end);
+                }
+                else append_format(state->output, ".L%d:\n", orelse);
+                break;
+            case IR_WHILE:
+            case IR_DO:
+            case IR_FOR:
+                emit_asm_loop(state, node);
+                break;
+        }
+    }
+}
+
+/* As for the bytecode, a loop is tested at the bottom, and a WHILE or FOR on entry as well. A
+** counted FOR counts down a trip count: subtracting one borrows only once it has run out. */
+static void emit_asm_loop(ASM_STATE *state, IR_NODE *node)
+{
+    int top = ++state->labels;
+    int end = ++state->labels;
+    char buffer[LOCATION_LENGTH];
+    emit_asm_nodes(state, node->init);
+    if(node->counter != 0)
+    {
+        const char *counter = locate(state, state->counter_base + node->counter, TRUE, buffer);
+        load_int(state, node->variable, "%eax");
+        load_int(state, node->bound, "%ecx");
+        load_int(state, node->stride, "%edx");
+        append_format(state->output, "\tcall\tspl_trips\n\tmovq\t%%rax, %s\n\tjmp\t.L%d\n.L%d:\n", counter, end, top);
+        emit_asm_nodes(state, node->body);
+        emit_asm_nodes(state, node->step);
+        append_format(state->output, ".L%d:\n\tsubq\t$1, %s\n\tjnc\t.L%d\n", end, counter, top);
+        return;
+    }
+    if(node->kind != IR_DO) emit_asm_condition(state, node->condition, FALSE, end);
+    append_format(state->output, ".L%d:\n", top);
+    emit_asm_nodes(state, node->body);
+    emit_asm_nodes(state, node->step);
+    emit_asm_condition(state, node->condition, TRUE, top);
+    append_format(state->output, ".L%d:\n", end);
+}
+
+static void emit_asm_instruction(ASM_STATE *state, IR_INSTRUCTION *instruction)
+{
+    STRING_BUILDER *output = state->output;
+    char a_buffer[LOCATION_LENGTH];
+    char b_buffer[LOCATION_LENGTH];
+    char dest_buffer[LOCATION_LENGTH];
+    IR_OPERAND a = instruction->a;
+    IR_OPERAND b = instruction->b;
+    IR_OPERAND dest = instruction->dest;
+    const char *target;
+    const char *source;
+    switch(instruction->op)
+    {
+        case IR_NOP:
+            return;
+        case IR_WRITE:
+            if(instruction->type == REAL_T) load_real(state, a, "%xmm0");
+            else load_int(state, a, "%eax");
+            append_format(output, "\tcall\t%s\n", instruction->type == CHAR_T ? "spl_write_char" :
+                instruction->type == REAL_T ? "spl_write_real" : "spl_write_int");
+            return;
+        case IR_NEWLINE:
+            append_string(output, "\tcall\tspl_newline\n");
+            return;
+        case IR_READ:
+            /* scanf leaves the variable as it was if there is nothing to read */
+            if(instruction->type == REAL_T)
+            {
+                load_real(state, dest, "%xmm0");
+                append_string(output, "\tcall\tspl_read_real\n");
+                store_real(state, dest);
+                return;
+            }
+            load_int(state, dest, "%eax");
+            append_format(output, "\tcall\t%s\n", instruction->type == CHAR_T ? "spl_read_char" : "spl_read_int");
+            store_int(state, dest);
+            return;
+        case IR_COPY:
+            if(dest.type == REAL_T)
+            {
+                if(in_register(state, dest)) load_real(state, a, locate(state, value_of(state, dest), FALSE, dest_buffer));
+                else
+                {
+                    load_real(state, a, "%xmm0");
+                    store_real(state, dest);
+                }
+                return;
+            }
+            if(dest.type == INT_T && a.type != REAL_T && (in_register(state, dest) || in_register(state, a) || ir_is_constant(a)))
+            {
+                target = locate(state, value_of(state, dest), FALSE, dest_buffer);
+                source = int_source(state, a, "%eax", a_buffer);
+                if(strcmp(source, target) != 0) append_format(output, "\tmovl\t%s, %s\n", source, target);
+                return;
+            }
+            load_int(state, a, "%eax");
+            store_int(state, dest);
+            return;
+        default:
+            break;
+    }
+
+    if(instruction->type == REAL_T)
+    {
+        /* Worked in the destination's register when that is not also the second operand's */
+        if(dest.type == REAL_T && in_register(state, dest) && value_of(state, b) == value_of(state, dest)
+            && (instruction->op == IR_ADD || instruction->op == IR_MUL) && value_of(state, a) != value_of(state, dest))
+        {
+            b = instruction->a;
+            a = instruction->b;
+        }
+        if(dest.type == REAL_T && in_register(state, dest) && (value_of(state, b) != value_of(state, dest) || value_of(state, a) == value_of(state, dest)))
+        {
+            target = locate(state, value_of(state, dest), FALSE, dest_buffer);
+            load_real(state, a, target);
+            append_format(output, "\t%s\t%s, %s\n", REAL_OPERATIONS[instruction->op], real_source(state, b, "%xmm1", b_buffer), target);
+            return;
+        }
+        load_real(state, a, "%xmm0");
+        append_format(output, "\t%s\t%s, %%xmm0\n", REAL_OPERATIONS[instruction->op], real_source(state, b, "%xmm1", b_buffer));
+        store_real(state, dest);
+        return;
+    }
+
+    if(instruction->op == IR_DIV)
+    {
+        load_int(state, a, "%eax");
+        source = int_source(state, b, "%ecx", b_buffer);
+        if(ir_is_constant(b))
+        {
+            append_format(output, "\tmovl\t%s, %%ecx\n", source);
+            source = "%ecx";
+        }
+        append_format(output, "\tcltd\n\tidivl\t%s\n", source);
+        store_int(state, dest);
+        return;
+    }
+    if(dest.type == INT_T && in_register(state, dest) && value_of(state, b) == value_of(state, dest)
+        && (instruction->op == IR_ADD || instruction->op == IR_MUL) && value_of(state, a) != value_of(state, dest))
+    {
+        b = instruction->a;
+        a = instruction->b;
+    }
+    if(dest.type == INT_T && in_register(state, dest) && (value_of(state, b) != value_of(state, dest) || value_of(state, a) == value_of(state, dest)))
+        target = locate(state, value_of(state, dest), FALSE, dest_buffer);
+    else target = "%eax";
+    load_int(state, a, target);
+    source = int_source(state, b, "%ecx", b_buffer);
+    if(instruction->op == IR_SHL && !ir_is_constant(b))
+    {
+        if(strcmp(source, "%ecx") != 0) append_format(output, "\tmovl\t%s, %%ecx\n", source);
+        source = "%cl";
+    }
+    append_format(output, "\t%s\t%s, %s\n", INT_OPERATIONS[instruction->op], source, target);
+    if(strcmp(target, "%eax") == 0) store_int(state, dest);
+}
+
+/* Jump to label when the condition comes out as when, otherwise fall through */
+static void emit_asm_condition(ASM_STATE *state, IR_CONDITION *condition, int when, int label)
+{
+    int skip;
+    switch(condition->kind)
+    {
+        case IR_COMPARE:
+            emit_asm_nodes(state, condition->setup);
+            if(condition->type == REAL_T) emit_real_branch(state, condition, when, label);
+            else emit_int_branch(state, condition, when, label);
+            break;
+        case IR_NOT:
+            emit_asm_condition(state, condition->first, !when, label);
+            break;
+        case IR_AND:
+        case IR_OR:
+            /* The first part decides the whole when it comes out as FALSE for AND, TRUE for OR */
+            if(when == (condition->kind == IR_OR))
+            {
+                emit_asm_condition(state, condition->first, when, label);
+                emit_asm_condition(state, condition->second, when, label);
+                break;
+            }
+            skip = ++state->labels;
+            emit_asm_condition(state, condition->first, !when, skip);
+            emit_asm_condition(state, condition->second, when, label);
+            append_format(state->output, ".L%d:\n", skip);
+            break;
+    }
+}
+
+/* cmp cannot compare a constant with anything, or memory with memory */
+static void emit_int_branch(ASM_STATE *state, IR_CONDITION *condition, int when, int label)
+{
+    char left_buffer[LOCATION_LENGTH];
+    char right_buffer[LOCATION_LENGTH];
+    enum CompareSymType compare = condition->compare;
+    IR_OPERAND left = condition->left;
+    IR_OPERAND right = condition->right;
+    const char *first;
+    const char *second;
+    if(ir_is_constant(left) && !ir_is_constant(right))
+    {
+        left = condition->right;
+        right = condition->left;
+        compare = MIRRORED_COMPARES[compare];
+    }
+    if(ir_is_constant(left) || left.type == REAL_T || (!in_register(state, left) && !in_register(state, right) && !ir_is_constant(right)))
+    {
+        load_int(state, left, "%eax");
+        first = "%eax";
+    }
+    else first = locate(state, value_of(state, left), FALSE, left_buffer);
+    second = int_source(state, right, "%ecx", right_buffer);
+    if(!when) compare = NEGATED_COMPARES[compare];
+    append_format(state->output, "\tcmpl\t%s, %s\n\t%s\t.L%d\n", second, first, INT_JUMPS[compare], label);
+}
+
+/* ucomisd b, a sets the flags as an unsigned comparison of a with b would, and sets all of
+** them when either is a NaN, which every comparison but != is then false for. Comparing the
+** other way round lets < and <= test the carry flag as > and >= do. */
+static void emit_real_branch(ASM_STATE *state, IR_CONDITION *condition, int when, int label)
+{
+    STRING_BUILDER *output = state->output;
+    char left_buffer[LOCATION_LENGTH];
+    char right_buffer[LOCATION_LENGTH];
+    enum CompareSymType compare = condition->compare;
+    IR_OPERAND left = condition->left;
+    IR_OPERAND right = condition->right;
+    const char *first;
+    const char *second;
+    int skip;
+    if(compare == SYM_LESS_THAN || compare == SYM_LESS_THAN_EQ)
+    {
+        left = condition->right;
+        right = condition->left;
+        compare = MIRRORED_COMPARES[compare];
+    }
+    if(left.type == REAL_T && in_register(state, left)) first = locate(state, value_of(state, left), FALSE, left_buffer);
+    else
+    {
+        load_real(state, left, "%xmm0");
+        first = "%xmm0";
+    }
+    second = real_source(state, right, "%xmm1", right_buffer);
+    append_format(output, "\tucomisd\t%s, %s\n", second, first);
+    switch(compare)
+    {
+        case SYM_GREATER_THAN:
+            append_format(output, "\t%s\t.L%d\n", when ? "ja" : "jbe", label);
+            break;
+        case SYM_GREATER_THAN_EQ:
+            append_format(output, "\t%s\t.L%d\n", when ? "jae" : "jb", label);
+            break;
+        default:
+            /* Equal is zero set and parity clear */
+            if(when == (compare == SYM_EQ_TO))
+            {
+                skip = ++state->labels;
+                append_format(output, "\tjp\t.L%d\n\tje\t.L%d\n.L%d:\n", skip, label, skip);
+            }
+            else append_format(output, "\tjp\t.L%d\n\tjne\t.L%d\n", label, label);
+            break;
+    }
+}
+
+/* ------------- operands --------------------------- */
+
+static int value_of(ASM_STATE *state, IR_OPERAND operand)
+{
+    if(operand.kind == IR_VARIABLE) return operand.index;
+    if(operand.kind == IR_TEMP) return state->temp_base + operand.index;
+    return -1;
+}
+
+/* A value's register, as a long when wide, or its place in the frame */
+static const char *locate(ASM_STATE *state, int index, int wide, char *buffer)
+{
+    ASM_VALUE *value = &state->values[index];
+    if(value->reg < 0)
+    {
+        snprintf(buffer, LOCATION_LENGTH, "-%d(%%rbp)", value->offset);
+        return buffer;
+    }
+    if(value->class == ASM_REAL)
+    {
+        snprintf(buffer, LOCATION_LENGTH, "%%xmm%d", value->reg + 2);
+        return buffer;
+    }
+    return wide ? LONG_REGISTERS[value->reg] : WORD_REGISTERS[value->reg];
+}
+
+static int in_register(ASM_STATE *state, IR_OPERAND operand)
+{
+    int index = value_of(state, operand);
+    return index >= 0 && state->values[index].reg >= 0;
+}
+
+static double constant_value(ASM_STATE *state, IR_OPERAND operand)
+{
+    double value;
+    if(operand.kind == IR_INT_CONST) return operand.value;
+    if(operand.kind == IR_CHAR_CONST) return (char)operand.value;
+    value = strtod(state->ctx->symTabRec->array[operand.index]->identifier, NULL);
+    return operand.value ? -value : value;
+}
+
+/* REAL constants are kept with the program's data, one for each use */
+static const char *real_data(ASM_STATE *state, double value, char *buffer)
+{
+    if(state->constant_count == state->constant_capacity)
+    {
+        int capacity = state->constant_capacity ? state->constant_capacity*2 : 64;
+        double *grown = (double *)realloc(state->constants, sizeof(double) * capacity);
+        if(grown == NULL)
+        {
+            state->failed = TRUE;
+            return "$0";
+        }
+        state->constants = grown;
+        state->constant_capacity = capacity;
+    }
+    state->constants[state->constant_count] = value;
+    snprintf(buffer, LOCATION_LENGTH, ".LR%d(%%rip)", state->constant_count++);
+    return buffer;
+}
+
+/* An operand as the source of an integer instruction: a register, the frame or a constant. A
+** REAL is first converted, truncating as C does, into scratch. */
+static const char *int_source(ASM_STATE *state, IR_OPERAND operand, const char *scratch, char *buffer)
+{
+    double value;
+    switch(operand.kind)
+    {
+        case IR_VARIABLE:
+        case IR_TEMP:
+            if(operand.type != REAL_T) return locate(state, value_of(state, operand), FALSE, buffer);
+            append_format(state->output, "\tcvttsd2si\t%s, %s\n", locate(state, value_of(state, operand), FALSE, buffer), scratch);
+            return scratch;
+        case IR_REAL_CONST:
+            /* What cvttsd2si makes of a value out of range */
+            value = constant_value(state, operand);
+            snprintf(buffer, LOCATION_LENGTH, "$%d", value > -2147483649.0 && value < 2147483648.0 ? (int)value : INT_MIN);
+            return buffer;
+        default:
+            snprintf(buffer, LOCATION_LENGTH, "$%d", (int)constant_value(state, operand));
+            return buffer;
+    }
+}
+
+/* An operand as the source of an SSE2 instruction: a register, the frame or the data. An
+** integer is first converted into scratch. */
+static const char *real_source(ASM_STATE *state, IR_OPERAND operand, const char *scratch, char *buffer)
+{
+    if(ir_is_constant(operand)) return real_data(state, constant_value(state, operand), buffer);
+    if(operand.type == REAL_T) return locate(state, value_of(state, operand), FALSE, buffer);
+    append_format(state->output, "\tcvtsi2sdl\t%s, %s\n", locate(state, value_of(state, operand), FALSE, buffer), scratch);
+    return scratch;
+}
+
+static void load_int(ASM_STATE *state, IR_OPERAND operand, const char *target)
+{
+    char buffer[LOCATION_LENGTH];
+    const char *source = int_source(state, operand, target, buffer);
+    if(strcmp(source, target) != 0) append_format(state->output, "\tmovl\t%s, %s\n", source, target);
+}
+
+static void load_real(ASM_STATE *state, IR_OPERAND operand, const char *target)
+{
+    char buffer[LOCATION_LENGTH];
+    const char *source = real_source(state, operand, target, buffer);
+    if(strcmp(source, target) == 0) return;
+    append_format(state->output, "\t%s\t%s, %s\n", in_register(state, operand) && operand.type == REAL_T ? "movapd" : "movsd",
+        source, target);
+}
+
+/* Assign the int in %eax, converting it as C would */
+static void store_int(ASM_STATE *state, IR_OPERAND dest)
+{
+    char buffer[LOCATION_LENGTH];
+    if(dest.type == REAL_T)
+    {
+        append_string(state->output, "\tcvtsi2sdl\t%eax, %xmm0\n");
+        store_real(state, dest);
+        return;
+    }
+    if(dest.type == CHAR_T) append_string(state->output, "\tmovsbl\t%al, %eax\n");
+    append_format(state->output, "\tmovl\t%%eax, %s\n", locate(state, value_of(state, dest), FALSE, buffer));
+}
+
+/* Assign the REAL in %xmm0, converting it as C would */
+static void store_real(ASM_STATE *state, IR_OPERAND dest)
+{
+    char buffer[LOCATION_LENGTH];
+    if(dest.type != REAL_T)
+    {
+        append_string(state->output, "\tcvttsd2si\t%xmm0, %eax\n");
+        store_int(state, dest);
+        return;
+    }
+    append_format(state->output, "\t%s\t%%xmm0, %s\n", in_register(state, dest) ? "movapd" : "movsd",
+        locate(state, value_of(state, dest), FALSE, buffer));
+}
+
+/* ------------- runtime --------------------------- */
+
+/* Each call into the C library saves the registers the program was given which the library
+** may change. Values are passed in %eax or %xmm0 and a READ gives back the variable as it was
+** when there is nothing to read. spl_trips is the counted FOR's trip count, as in the C. */
+static void emit_runtime(ASM_STATE *state)
+{
+    STRING_BUILDER *output = state->output;
+    int saved = 0;
+    int i;
+    append_string(output, "\n\t.macro\tspl_enter\n\tpushq\t%rbp\n\tmovq\t%rsp, %rbp\n\tsubq\t$176, %rsp\n");
+    for(i = CALLEE_SAVED_COUNT; i < state->int_used; i++)
+        append_format(output, "\tmovq\t%s, -%d(%%rbp)\n", LONG_REGISTERS[i], 16 + 8*saved++);
+    for(i = 0; i < state->real_used; i++) append_format(output, "\tmovsd\t%%xmm%d, -%d(%%rbp)\n", i + 2, 16 + 8*saved++);
+    append_string(output, "\t.endm\n\n\t.macro\tspl_leave\n");
+    saved = 0;
+    for(i = CALLEE_SAVED_COUNT; i < state->int_used; i++)
+        append_format(output, "\tmovq\t-%d(%%rbp), %s\n", 16 + 8*saved++, LONG_REGISTERS[i]);
+    for(i = 0; i < state->real_used; i++) append_format(output, "\tmovsd\t-%d(%%rbp), %%xmm%d\n", 16 + 8*saved++, i + 2);
+    append_string(output, "\tleave\n\tret\n\t.endm\n\n");
+
+    append_string(output,
+        "spl_write_int:\n\tspl_enter\n\tmovl\t%eax, %esi\n\tleaq\t.Lspl_int(%rip), %rdi\n\txorl\t%eax, %eax\n"
+        "\tcall\tprintf@PLT\n\tspl_leave\n\n"
+        "spl_write_real:\n\tspl_enter\n\tleaq\t.Lspl_real(%rip), %rdi\n\tmovl\t$1, %eax\n\tcall\tprintf@PLT\n\tspl_leave\n\n"
+        "spl_write_char:\n\tspl_enter\n\tmovl\t%eax, %edi\n\tcall\tputchar@PLT\n\tspl_leave\n\n"
+        "spl_newline:\n\tspl_enter\n\tmovl\t$10, %edi\n\tcall\tputchar@PLT\n\tspl_leave\n\n"
+        "spl_read_int:\n\tspl_enter\n\tmovl\t%eax, -8(%rbp)\n\tleaq\t-8(%rbp), %rsi\n\tleaq\t.Lspl_int(%rip), %rdi\n"
+        "\txorl\t%eax, %eax\n\tcall\tscanf@PLT\n\tmovl\t-8(%rbp), %eax\n\tspl_leave\n\n"
+        "spl_read_real:\n\tspl_enter\n\tmovsd\t%xmm0, -8(%rbp)\n\tleaq\t-8(%rbp), %rsi\n\tleaq\t.Lspl_real(%rip), %rdi\n"
+        "\txorl\t%eax, %eax\n\tcall\tscanf@PLT\n\tmovsd\t-8(%rbp), %xmm0\n\tspl_leave\n\n"
+        "spl_read_char:\n\tspl_enter\n\tmovb\t%al, -8(%rbp)\n\tleaq\t-8(%rbp), %rsi\n\tleaq\t.Lspl_char(%rip), %rdi\n"
+        "\txorl\t%eax, %eax\n\tcall\tscanf@PLT\n\tmovsbl\t-8(%rbp), %eax\n\tspl_leave\n\n");
+
+    /* From %eax to %ecx by %edx: by > 0 counts up, anything else down, and 0 for ever */
+    append_string(output,
+        "spl_trips:\n\tmovslq\t%eax, %rax\n\tmovslq\t%ecx, %rcx\n\tmovslq\t%edx, %rdx\n"
+        "\ttestq\t%rdx, %rdx\n\tjg\t1f\n\tjl\t2f\n"
+        "\tcmpq\t%rcx, %rax\n\tmovq\t$-1, %rax\n\tjge\t4f\n\txorl\t%eax, %eax\n\tret\n"
+        "1:\tcmpq\t%rcx, %rax\n\tjg\t3f\n\tsubq\t%rax, %rcx\n\tmovq\t%rcx, %rax\n\tmovq\t%rdx, %rcx\n\tjmp\t5f\n"
+        "2:\tcmpq\t%rcx, %rax\n\tjl\t3f\n\tsubq\t%rcx, %rax\n\tnegq\t%rdx\n\tmovq\t%rdx, %rcx\n"
+        "5:\txorl\t%edx, %edx\n\tdivq\t%rcx\n\tincq\t%rax\n\tret\n"
+        "3:\txorl\t%eax, %eax\n4:\tret\n\n");
+
+    append_string(output, "\t.section\t.rodata\n.Lspl_int:\n\t.string\t\"%d\"\n.Lspl_real:\n\t.string\t\"%lg\"\n"
+        ".Lspl_char:\n\t.string\t\" %c\"\n");
+    if(state->constant_count > 0) append_string(output, "\t.align\t8\n");
+    for(i = 0; i < state->constant_count; i++)
+    {
+        unsigned long long bits;
+        memcpy(&bits, &state->constants[i], sizeof(bits));
+        append_format(output, ".LR%d:\n\t.quad\t0x%016llx\n", i, bits);
+    }
+    append_string(output, "\t.section\t.note.GNU-stack,\"\",@progbits\n");
+}
+
+#endif
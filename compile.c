@@ -0,0 +1,249 @@
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "include/arena.h"
+#include "include/compile.h"
+#include "include/compile_stats.h"
+#include "include/splio.h"
+#include "include/string_builder.h"
+#include "include/symbol_table.h"
+
+#ifdef ME
+#include "include/bytecode.h"
+#include "include/codegen.h"
+#include "include/ir.h"
+#include "include/lower_tree.h"
+#include "include/optimise_ir.h"
+#include "include/optimise_tree.h"
+#include "include/tree_procedures.h"
+#include "spl.tab.h"
+#include "lex.yy.h"
+#endif
+
+#ifdef DO_TREE_OPS
+static int generate_program(COMPILE_CONTEXT *);
+#endif
+
+void default_compile_options(COMPILE_OPTIONS *options)
+{
+    options->fast_math = 0;
+    options->unroll_budget = DEFAULT_UNROLL_BUDGET;
+    options->run = 0;
+    options->assembly = 0;
+    options->jit = 0;
+}
+
+COMPILE_CONTEXT *create_compile_context(void)
+{
+    COMPILE_CONTEXT *ctx = (COMPILE_CONTEXT *)calloc(1, sizeof(COMPILE_CONTEXT));
+    if(ctx == NULL) return NULL;
+    init_string_builder(&ctx->output);
+    default_compile_options(&ctx->options);
+#ifdef DO_TREE_OPS
+    ctx->treeArena = create_arena("tree", ARENA_BLOCK_SIZE);
+    ctx->symbolArena = create_arena("symbols", ARENA_BLOCK_SIZE);
+    ctx->identifierArena = create_arena("identifiers", ARENA_BLOCK_SIZE/4);
+    ctx->irArena = create_arena("ir", ARENA_BLOCK_SIZE);
+    if(ctx->treeArena == NULL || ctx->symbolArena == NULL || ctx->identifierArena == NULL || ctx->irArena == NULL)
+    {
+        destroy_compile_context(ctx);
+        return NULL;
+    }
+#endif
+    return ctx;
+}
+
+/* Forget the previous compilation, but not the options. The arenas each keep one block and the
+** string builders keep their storage, so a context which is reused for program after program soon stops going back to malloc */
+void reset_compile_context(COMPILE_CONTEXT *ctx)
+{
+    ARENA *treeArena = ctx->treeArena;
+    ARENA *symbolArena = ctx->symbolArena;
+    ARENA *identifierArena = ctx->identifierArena;
+    ARENA *irArena = ctx->irArena;
+    STRING_BUILDER output = ctx->output;
+    struct compileStats *stats = ctx->stats;
+    COMPILE_OPTIONS options = ctx->options;
+#ifdef DO_TREE_OPS
+    if(ctx->symTabRec != NULL) destroy_symtab(ctx->symTabRec);
+    reset_arena(treeArena);
+    reset_arena(symbolArena);
+    reset_arena(identifierArena);
+    reset_arena(irArena);
+#endif
+    memset(ctx, 0, sizeof(COMPILE_CONTEXT));
+    ctx->treeArena = treeArena;
+    ctx->symbolArena = symbolArena;
+    ctx->identifierArena = identifierArena;
+    ctx->irArena = irArena;
+    ctx->output = output;
+    ctx->stats = stats;
+    ctx->options = options;
+    reset_string_builder(&ctx->output);
+}
+
+void report_compile_arenas(FILE *output, COMPILE_CONTEXT *ctx)
+{
+#ifdef DO_TREE_OPS
+    report_arena(output, ctx->treeArena);
+    report_arena(output, ctx->symbolArena);
+    report_arena(output, ctx->identifierArena);
+    report_arena(output, ctx->irArena);
+#endif
+}
+
+void destroy_compile_context(COMPILE_CONTEXT *ctx)
+{
+    if(ctx == NULL) return;
+    reset_compile_context(ctx);
+#ifdef DO_TREE_OPS
+    destroy_arena(ctx->treeArena);
+    destroy_arena(ctx->symbolArena);
+    destroy_arena(ctx->identifierArena);
+    destroy_arena(ctx->irArena);
+#endif
+    free_string_builder(&ctx->output);
+    free(ctx);
+}
+
+/* Read the whole of a program into memory, returning NULL if it could not be read */
+char *read_source(FILE *input, size_t *length)
+{
+    size_t capacity = 4096;
+    size_t used = 0;
+    size_t count;
+    char *source = (char *)malloc(capacity);
+    if(source == NULL) return NULL;
+    while((count = fread(source + used, 1, capacity - used, input)) > 0)
+    {
+        used += count;
+        if(used == capacity)
+        {
+            char *grown = (char *)realloc(source, capacity*2);
+            if(grown == NULL)
+            {
+                free(source);
+                return NULL;
+            }
+            source = grown;
+            capacity *= 2;
+        }
+    }
+    if(ferror(input))
+    {
+        free(source);
+        return NULL;
+    }
+    *length = used;
+    return source;
+}
+
+/* Compile one program held in memory into ctx->output. Returns 0 on success, the yyparse
+** result if the program could not be parsed, or -1 if it was too large to scan or was rejected
+** afterwards, in which case the output is left empty */
+int compile_source(COMPILE_CONTEXT *ctx, const char *source, size_t length)
+{
+    void *scanner;
+    int retVal;
+
+    reset_compile_context(ctx);
+    /* The scanner takes an int length, and needs two bytes more for its end markers */
+    if(length > INT_MAX - 2)
+    {
+        fprintf(stderr, "Error : The program is too large, at %zu bytes; the most is %d\n", length, INT_MAX - 2);
+        return -1;
+    }
+#ifdef DO_TREE_OPS
+    ctx->symTabRec = create_arena_symtab(ctx->symbolArena, ctx->identifierArena);
+    if(ctx->symTabRec == NULL) return -1;
+#endif
+    if(yylex_init_extra(ctx, &scanner) != 0) return -1;
+    begin_phase(ctx, PHASE_PARSE);
+    yy_scan_bytes(source, (int)length, scanner);
+    yyset_column(1, scanner);
+
+    retVal = yyparse(scanner, ctx);
+    ctx->lineno = yyget_lineno(scanner);
+    ctx->colno  = yyget_column(scanner);
+    yylex_destroy(scanner);
+    end_phase(ctx, PHASE_PARSE);
+    if(retVal == 0) count_program(ctx);
+
+#ifdef DO_TREE_OPS
+    if(retVal == 0 && ctx->parseTree != NULL)
+        retVal = generate_program(ctx);
+#endif
+    return retVal;
+}
+
+/* Write the output of the last successful compilation */
+int write_compiled_output(FILE *output, COMPILE_CONTEXT *ctx)
+{
+    return write_string_builder(output, &ctx->output);
+}
+
+#ifdef DO_TREE_OPS
+static int generate_program(COMPILE_CONTEXT *ctx)
+{
+    TERNARY_TREE ParseTree = ctx->parseTree;
+#ifdef DEBUG
+    PrintTree(ctx, ParseTree, 0);
+#endif
+    begin_phase(ctx, PHASE_OPTIMISE);
+    Optimise(ctx, &ParseTree);
+    end_phase(ctx, PHASE_OPTIMISE);
+    ctx->parseTree = ParseTree;
+#ifdef DEBUG
+    PrintTree(ctx, ParseTree, 0);
+#endif
+    begin_phase(ctx, PHASE_LOWER);
+    ctx->irProgram = lower_tree(ctx, ParseTree);
+    end_phase(ctx, PHASE_LOWER);
+    if(ctx->irProgram == NULL)
+    {
+        fprintf(stderr, "Compilation failed.\n");
+        return -1;
+    }
+    begin_phase(ctx, PHASE_OPTIMISE);
+    optimise_ir(ctx, ctx->irProgram);
+    end_phase(ctx, PHASE_OPTIMISE);
+#ifdef DEBUG
+    print_ir(stdout, ctx, ctx->irProgram);
+    return 0;
+#else
+    if(ctx->options.run)
+    {
+        INFO("Generating bytecode..\n")
+        begin_phase(ctx, PHASE_GENERATE);
+        ctx->bytecode = compile_bytecode(ctx, ctx->irProgram);
+        end_phase(ctx, PHASE_GENERATE);
+        if(ctx->bytecode == NULL)
+        {
+            fprintf(stderr, "Compilation failed.\n");
+            return -1;
+        }
+        return 0;
+    }
+    /* The output is only handed over if all of it was generated; a rejected program leaves nothing */
+    INFO("Generating code..\n")
+    begin_phase(ctx, PHASE_GENERATE);
+    int generated = ctx->options.assembly ? GenerateAsm(ctx, ctx->irProgram, &ctx->output)
+        : GenerateC(ctx, ctx->irProgram, &ctx->output);
+    end_phase(ctx, PHASE_GENERATE);
+    if(generated < 0 || ctx->output.failed)
+    {
+        fprintf(stderr, "Compilation failed.\n");
+        reset_string_builder(&ctx->output);
+        return -1;
+    }
+    return 0;
+#endif /*    DEBUG    */
+}
+#endif /* DO_TREE_OPS */
+
+void yyerror(YYLTYPE *location, void *scanner, COMPILE_CONTEXT *ctx, const char *s)
+{
+    fprintf(stderr, "Error : Exiting %s\n", s);
+}
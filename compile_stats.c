@@ -0,0 +1,315 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/resource.h>
+
+#include "include/arena.h"
+#include "include/compile.h"
+#include "include/compile_stats.h"
+#include "include/string_builder.h"
+#include "include/tree_procedures.h"
+#include "include/types.h"
+
+const char *PHASE_NAMES[] = {FOREACH_PHASE(CREATE_PHASE_NAME)};
+
+static void measure_memory(COMPILE_CONTEXT *, MEMORY_COUNTS *);
+static void add_arena(MEMORY_COUNTS *, ARENA *);
+static void add_memory(MEMORY_COUNTS *, MEMORY_COUNTS *, MEMORY_COUNTS *, int);
+static void add_event(COMPILE_STATS *, int, const char *, int, double, double);
+static void add_hoist(COMPILE_STATS *, const char *, const char *, int, int);
+static void count_nodes(COMPILE_STATS *, TERNARY_TREE);
+static void write_json_string(FILE *, const char *);
+static long peak_rss_kb(void);
+
+double monotonic_seconds(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)now.tv_sec + (double)now.tv_nsec / 1e9;
+}
+
+/* Trace timestamps are relative to origin, so the stats of several threads can share one */
+void init_compile_stats(COMPILE_STATS *stats, int tracing, double origin)
+{
+    memset(stats, 0, sizeof(COMPILE_STATS));
+    stats->tracing = tracing;
+    stats->origin = origin;
+}
+
+static void add_arena(MEMORY_COUNTS *counts, ARENA *arena)
+{
+    if(arena == NULL) return;
+    counts->heap_allocations += arena->heap_allocations;
+    counts->heap_bytes += arena->heap_bytes;
+    counts->arena_allocations += arena->allocations;
+    counts->arena_bytes += arena->bytes_used;
+}
+
+static void measure_memory(COMPILE_CONTEXT *ctx, MEMORY_COUNTS *counts)
+{
+    memset(counts, 0, sizeof(MEMORY_COUNTS));
+    add_arena(counts, ctx->treeArena);
+    add_arena(counts, ctx->symbolArena);
+    add_arena(counts, ctx->identifierArena);
+    add_arena(counts, ctx->irArena);
+    counts->heap_allocations += ctx->output.heap_allocations;
+    counts->heap_bytes += ctx->output.heap_bytes;
+}
+
+/* total += (after - before) * sign. The arena counts restart with each compilation, so a count
+** which went down is taken to have started again from zero. */
+static void add_memory(MEMORY_COUNTS *total, MEMORY_COUNTS *after, MEMORY_COUNTS *before, int sign)
+{
+#define ADD_DELTA(field) total->field += (size_t)sign * \
+        (after->field >= before->field ? after->field - before->field : after->field);
+    ADD_DELTA(heap_allocations)
+    ADD_DELTA(heap_bytes)
+    ADD_DELTA(arena_allocations)
+    ADD_DELTA(arena_bytes)
+#undef ADD_DELTA
+}
+
+void begin_phase(COMPILE_CONTEXT *ctx, enum CompilePhase phase)
+{
+    COMPILE_STATS *stats = ctx->stats;
+    if(stats == NULL) return;
+    if(phase == PHASE_PARSE)
+    {
+        stats->lex_seconds_at_parse = stats->seconds[PHASE_LEX];
+        stats->lex_memory_at_parse = stats->memory[PHASE_LEX];
+    }
+    measure_memory(ctx, &stats->phase_memory[phase]);
+    stats->phase_start[phase] = monotonic_seconds();
+}
+
+void end_phase(COMPILE_CONTEXT *ctx, enum CompilePhase phase)
+{
+    COMPILE_STATS *stats = ctx->stats;
+    MEMORY_COUNTS now_memory;
+    if(stats == NULL) return;
+    double now = monotonic_seconds();
+    double elapsed = now - stats->phase_start[phase];
+    measure_memory(ctx, &now_memory);
+    add_memory(&stats->memory[phase], &now_memory, &stats->phase_memory[phase], 1);
+    stats->seconds[phase] += elapsed;
+    if(phase == PHASE_PARSE)
+    {
+        /* Leave the scanner's share to PHASE_LEX */
+        stats->seconds[phase] -= stats->seconds[PHASE_LEX] - stats->lex_seconds_at_parse;
+        add_memory(&stats->memory[phase], &stats->memory[PHASE_LEX], &stats->lex_memory_at_parse, -1);
+    }
+    /* Every token would be far too many events; lexing shows up inside the parse event */
+    if(stats->tracing && phase != PHASE_LEX)
+        add_event(stats, phase, stats->label, stats->thread, stats->phase_start[phase] - stats->origin, elapsed);
+}
+
+static void add_event(COMPILE_STATS *stats, int phase, const char *label, int thread, double start, double duration)
+{
+    if(stats->event_count == stats->event_capacity)
+    {
+        size_t new_capacity = stats->event_capacity ? stats->event_capacity*2 : 64;
+        TRACE_EVENT *grown = (TRACE_EVENT *)realloc(stats->events, sizeof(TRACE_EVENT) * new_capacity);
+        if(grown == NULL) return;
+        stats->events = grown;
+        stats->event_capacity = new_capacity;
+    }
+    TRACE_EVENT *event = &stats->events[stats->event_count++];
+    event->phase = phase;
+    event->label = label;
+    event->thread = thread;
+    event->start = start;
+    event->duration = duration;
+}
+
+/* Record the size of a program once it has been parsed */
+void count_program(COMPILE_CONTEXT *ctx)
+{
+    COMPILE_STATS *stats = ctx->stats;
+    if(stats == NULL) return;
+    stats->programs++;
+    if(ctx->symTabRec != NULL) stats->symbols += ctx->symTabRec->in_use;
+    count_nodes(stats, ctx->parseTree);
+}
+
+/* Record what was hoisted out of one loop. Only loops which had something hoisted are kept. */
+void count_hoisted(COMPILE_CONTEXT *ctx, const char *loop, int number, int instructions)
+{
+    COMPILE_STATS *stats = ctx->stats;
+    if(stats == NULL) return;
+    add_hoist(stats, stats->label, loop, number, instructions);
+}
+
+static void add_hoist(COMPILE_STATS *stats, const char *label, const char *loop, int number, int instructions)
+{
+    if(stats->hoist_count == stats->hoist_capacity)
+    {
+        size_t new_capacity = stats->hoist_capacity ? stats->hoist_capacity*2 : 16;
+        HOIST_REPORT *grown = (HOIST_REPORT *)realloc(stats->hoists, sizeof(HOIST_REPORT) * new_capacity);
+        if(grown == NULL) return;
+        stats->hoists = grown;
+        stats->hoist_capacity = new_capacity;
+    }
+    HOIST_REPORT *hoist = &stats->hoists[stats->hoist_count++];
+    hoist->label = label;
+    hoist->loop = loop;
+    hoist->number = number;
+    hoist->instructions = instructions;
+    stats->hoisted += instructions;
+}
+
+static void count_nodes(COMPILE_STATS *stats, TERNARY_TREE t)
+{
+    for(; t != NULL; t = is_chain_link(t) ? t->second : NULL)
+    {
+        stats->nodes[t->nodeIdentifier]++;
+        count_nodes(stats, t->first);
+        if(!is_chain_link(t)) count_nodes(stats, t->second);
+        count_nodes(stats, t->third);
+    }
+}
+
+void merge_compile_stats(COMPILE_STATS *into, COMPILE_STATS *from)
+{
+    int i;
+    for(i = 0; i < PHASE_COUNT; i++)
+    {
+        MEMORY_COUNTS none = {0, 0, 0, 0};
+        into->seconds[i] += from->seconds[i];
+        add_memory(&into->memory[i], &from->memory[i], &none, 1);
+    }
+    into->programs += from->programs;
+    into->tokens += from->tokens;
+    into->symbols += from->symbols;
+    for(i = 0; i < NODE_TYPE_COUNT; i++) into->nodes[i] += from->nodes[i];
+    size_t e;
+    for(e = 0; e < from->hoist_count; e++)
+    {
+        HOIST_REPORT *hoist = &from->hoists[e];
+        add_hoist(into, hoist->label, hoist->loop, hoist->number, hoist->instructions);
+    }
+    for(e = 0; e < from->event_count; e++)
+    {
+        TRACE_EVENT *event = &from->events[e];
+        add_event(into, event->phase, event->label, event->thread, event->start, event->duration);
+    }
+}
+
+/* The high-water mark of the whole process, in kilobytes, as Linux and the BSDs report it */
+static long peak_rss_kb(void)
+{
+    struct rusage usage;
+    if(getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+    return usage.ru_maxrss;
+}
+
+void report_compile_stats(FILE *output, COMPILE_STATS *stats, int json)
+{
+    int i;
+    double total_seconds = 0;
+    size_t total_nodes = 0;
+    size_t h;
+    for(i = 0; i < PHASE_COUNT; i++) total_seconds += stats->seconds[i];
+    for(i = 0; i < NODE_TYPE_COUNT; i++) total_nodes += stats->nodes[i];
+
+    if(json)
+    {
+        fprintf(output, "{\"programs\": %zd, \"seconds\": %.9f, \"phases\": {", stats->programs, total_seconds);
+        for(i = 0; i < PHASE_COUNT; i++)
+        {
+            MEMORY_COUNTS *m = &stats->memory[i];
+            fprintf(output, "%s\"%s\": {\"seconds\": %.9f, \"heap_allocations\": %zd, \"heap_bytes\": %zd, "
+                "\"arena_allocations\": %zd, \"arena_bytes\": %zd}", i ? ", " : "", PHASE_NAMES[i],
+                stats->seconds[i], m->heap_allocations, m->heap_bytes, m->arena_allocations, m->arena_bytes);
+        }
+        fprintf(output, "}, \"peak_rss_kb\": %ld, \"tokens\": %zd, \"symbols\": %zd, \"nodes\": {\"total\": %zd",
+            peak_rss_kb(), stats->tokens, stats->symbols, total_nodes);
+        for(i = 0; i < NODE_TYPE_COUNT; i++)
+        {
+            if(stats->nodes[i]) fprintf(output, ", \"%s\": %zd", NODE_TYPE_NAMES[i], stats->nodes[i]);
+        }
+        fprintf(output, "}, \"hoisted\": {\"total\": %zd, \"loops\": [", stats->hoisted);
+        for(h = 0; h < stats->hoist_count; h++)
+        {
+            HOIST_REPORT *hoist = &stats->hoists[h];
+            fprintf(output, "%s{", h ? ", " : "");
+            if(hoist->label != NULL)
+            {
+                fprintf(output, "\"program\": ");
+                write_json_string(output, hoist->label);
+                fprintf(output, ", ");
+            }
+            fprintf(output, "\"loop\": \"%s\", \"number\": %d, \"instructions\": %d}", hoist->loop, hoist->number,
+                hoist->instructions);
+        }
+        fprintf(output, "]}}\n");
+        return;
+    }
+
+    fprintf(output, "%zd program%s, %.6f s in all phases\n", stats->programs, stats->programs == 1 ? "" : "s", total_seconds);
+    fprintf(output, "%-10s %12s %12s %14s %12s %14s\n", "Phase", "Seconds", "Heap allocs", "Heap bytes", "Arena allocs", "Arena bytes");
+    for(i = 0; i < PHASE_COUNT; i++)
+    {
+        MEMORY_COUNTS *m = &stats->memory[i];
+        fprintf(output, "%-10s %12.6f %12zd %14zd %12zd %14zd\n", PHASE_NAMES[i], stats->seconds[i],
+            m->heap_allocations, m->heap_bytes, m->arena_allocations, m->arena_bytes);
+    }
+    fprintf(output, "Peak RSS: %ld kB\n", peak_rss_kb());
+    fprintf(output, "Tokens: %zd\nSymbols: %zd\nTree nodes: %zd\n", stats->tokens, stats->symbols, total_nodes);
+    for(i = 0; i < NODE_TYPE_COUNT; i++)
+    {
+        if(stats->nodes[i]) fprintf(output, "    %-18s %10zd\n", NODE_TYPE_NAMES[i], stats->nodes[i]);
+    }
+    fprintf(output, "Hoisted instructions: %zd\n", stats->hoisted);
+    for(h = 0; h < stats->hoist_count; h++)
+    {
+        HOIST_REPORT *hoist = &stats->hoists[h];
+        fprintf(output, "    %s%s%s loop %d: %d\n", hoist->label != NULL ? hoist->label : "", hoist->label != NULL ? ": " : "",
+            hoist->loop, hoist->number, hoist->instructions);
+    }
+}
+
+static void write_json_string(FILE *output, const char *s)
+{
+    fputc('"', output);
+    for(; s != NULL && *s; s++)
+    {
+        if(*s == '"' || *s == '\\') fprintf(output, "\\%c", *s);
+        else if((unsigned char)*s < 0x20) fprintf(output, "\\u%04x", (unsigned char)*s);
+        else fputc(*s, output);
+    }
+    fputc('"', output);
+}
+
+/* Write the phases as Chrome trace events ("X" complete events, in microseconds), which
+** chrome://tracing, Perfetto and speedscope can all load */
+int write_trace(const char *path, COMPILE_STATS *stats)
+{
+    FILE *output = fopen(path, "w");
+    size_t e;
+    if(output == NULL) return -1;
+    fprintf(output, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [");
+    for(e = 0; e < stats->event_count; e++)
+    {
+        TRACE_EVENT *event = &stats->events[e];
+        fprintf(output, "%s\n{\"name\": \"%s\", \"cat\": \"spl\", \"ph\": \"X\", \"ts\": %.3f, \"dur\": %.3f, "
+            "\"pid\": 1, \"tid\": %d, \"args\": {\"program\": ", e ? "," : "", PHASE_NAMES[event->phase],
+            event->start * 1e6, event->duration * 1e6, event->thread);
+        write_json_string(output, event->label);
+        fprintf(output, "}}");
+    }
+    fprintf(output, "\n]}\n");
+    return fclose(output) == 0 ? 0 : -1;
+}
+
+void free_compile_stats(COMPILE_STATS *stats)
+{
+    free(stats->events);
+    stats->events = NULL;
+    stats->event_count = 0;
+    stats->event_capacity = 0;
+    free(stats->hoists);
+    stats->hoists = NULL;
+    stats->hoist_count = 0;
+    stats->hoist_capacity = 0;
+}
@@ -0,0 +1,36 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+#include <stdio.h>
+
+#define ARENA_BLOCK_SIZE (64*1024)
+#define ARENA_ALIGNMENT  16
+
+/* A bump-pointer allocator. Everything allocated from an arena is released together by destroy_arena */
+typedef struct arenaBlock {
+    struct arenaBlock *next;
+    size_t size;
+    size_t used;
+    char *data;
+} ARENA_BLOCK;
+
+typedef struct {
+    const char *name;
+    ARENA_BLOCK *blocks;
+    size_t block_size;
+    size_t bytes_used;      /* Bytes handed out, including alignment padding */
+    size_t bytes_reserved;  /* Bytes obtained from malloc */
+    size_t allocations;
+    size_t heap_allocations;    /* Blocks obtained from malloc over the life of the arena */
+    size_t heap_bytes;
+} ARENA;
+
+ARENA *create_arena(const char *, size_t);
+void *arena_alloc(ARENA *, size_t);
+char *arena_strdup(ARENA *, const char *);
+void report_arena(FILE *, ARENA *);
+void reset_arena(ARENA *);
+void destroy_arena(ARENA *);
+
+#endif
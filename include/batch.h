@@ -0,0 +1,20 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <stddef.h>
+
+#include "compile.h"
+#include "compile_stats.h"
+
+/* One program in a batch, and what became of it */
+typedef struct {
+    const char *source_path;
+    char *output_path;
+    size_t size;
+    int status;         /* 0 once compiled, otherwise the compile_source result */
+} BATCH_JOB;
+
+int default_job_count(void);
+int compile_batch(char **, int, const char *, int, const COMPILE_OPTIONS *, COMPILE_STATS *);
+
+#endif
@@ -0,0 +1,70 @@
+#ifndef BYTECODE_H
+#define BYTECODE_H
+
+#include "compile.h"
+#include "ir.h"
+
+/* ------------- register bytecode --------------------------- */
+
+/* --run executes the lowered program on a virtual machine instead of writing it out as C. Its
+** registers are slots: one for each variable, temporary and counter, a few scratch slots for
+** conversions, and one for each constant, filled in before the program starts. CHARACTER and
+** INTEGER values are both held as ints, a CHARACTER already converted as C would convert it,
+** and REAL values as doubles, so each operation is typed by its opcode, not by its slots.
+**
+** Conditions become compare-and-branch instructions, and a loop is tested at the bottom, so
+** each iteration branches once. A loop whose last instruction adds to a variable which its test
+** then compares is tested by one instruction which does both. */
+
+#define FOREACH_BC_OP(CREATE) \
+CREATE(BC_HALT) CREATE(BC_MOVE) CREATE(BC_TO_CHAR) CREATE(BC_TO_INT) CREATE(BC_TO_REAL) \
+CREATE(BC_ADD_I) CREATE(BC_SUB_I) CREATE(BC_MUL_I) CREATE(BC_DIV_I) CREATE(BC_SHL_I) \
+CREATE(BC_ADD_R) CREATE(BC_SUB_R) CREATE(BC_MUL_R) CREATE(BC_DIV_R) \
+CREATE(BC_WRITE_C) CREATE(BC_WRITE_I) CREATE(BC_WRITE_R) CREATE(BC_NEWLINE) \
+CREATE(BC_READ_C) CREATE(BC_READ_I) CREATE(BC_READ_R) \
+CREATE(BC_JUMP) \
+CREATE(BC_JEQ_I) CREATE(BC_JNE_I) CREATE(BC_JLT_I) CREATE(BC_JGT_I) CREATE(BC_JLE_I) CREATE(BC_JGE_I) \
+CREATE(BC_JEQ_R) CREATE(BC_JNE_R) CREATE(BC_JLT_R) CREATE(BC_JGT_R) CREATE(BC_JLE_R) CREATE(BC_JGE_R) \
+CREATE(BC_JNOT_EQ_R) CREATE(BC_JNOT_NE_R) CREATE(BC_JNOT_LT_R) CREATE(BC_JNOT_GT_R) CREATE(BC_JNOT_LE_R) CREATE(BC_JNOT_GE_R) \
+CREATE(BC_ADD_JEQ_I) CREATE(BC_ADD_JNE_I) CREATE(BC_ADD_JLT_I) CREATE(BC_ADD_JGT_I) CREATE(BC_ADD_JLE_I) CREATE(BC_ADD_JGE_I) \
+CREATE(BC_TRIPS) CREATE(BC_COUNT)
+
+#define CREATE_BC_OP_ENUM(OP) OP,
+
+/* The comparisons come in the order of enum CompareSymType. The JNOT forms branch when a REAL
+** comparison fails, which is not the opposite comparison once a NaN is involved. */
+enum BcOp {FOREACH_BC_OP(CREATE_BC_OP_ENUM) BC_OP_COUNT};
+
+typedef union {
+    int i;                      /* CHARACTER and INTEGER */
+    double r;                   /* REAL */
+    unsigned long long n;       /* The iterations a counted FOR has left */
+} BC_SLOT;
+
+/* dest = a op b, in slots. A branch jumps to the instruction numbered dest; ADD_J adds c to a
+** before comparing it with b. TRIPS sets counter dest to the iterations from a to b by c, and
+** COUNT jumps to dest while counter a, counted down, was not yet zero. */
+typedef struct {
+    const void *handler;        /* Where the threaded interpreter runs the instruction */
+    enum BcOp op;
+    int dest;
+    int a;
+    int b;
+    int c;
+} BC_INSTRUCTION;
+
+typedef struct bytecodeProgram {
+    BC_INSTRUCTION *code;
+    int count;
+    int capacity;
+    BC_SLOT *slots;             /* Every slot as the program starts: constants set, the rest zero */
+    int slot_count;
+    int slot_capacity;
+    int threaded;               /* The handlers have been filled in */
+} BC_PROGRAM;
+
+BC_PROGRAM *compile_bytecode(COMPILE_CONTEXT *, IR_PROGRAM *);
+int run_bytecode(BC_PROGRAM *);
+int run_jit(BC_PROGRAM *);
+
+#endif
@@ -1,11 +1,13 @@
 #ifndef CODEGEN_H
 #define CODEGEN_H
 
-#include <stdio.h>
-#include "types.h"
+#include "compile.h"
+#include "ir.h"
+#include "string_builder.h"
 
 #ifndef DEBUG
-int GenerateC(TERNARY_TREE, int, FILE *);
+int GenerateC(COMPILE_CONTEXT *, IR_PROGRAM *, STRING_BUILDER *);
+int GenerateAsm(COMPILE_CONTEXT *, IR_PROGRAM *, STRING_BUILDER *);
 #endif
 
 #endif
\ No newline at end of file
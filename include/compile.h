@@ -0,0 +1,65 @@
+#ifndef COMPILE_H
+#define COMPILE_H
+
+#include <stddef.h>
+#include <stdio.h>
+
+#include "arena.h"
+#include "string_builder.h"
+#include "symbol_table.h"
+#include "types.h"
+
+struct bytecodeProgram;
+struct compileStats;
+struct irProgram;
+
+/* The instructions a loop may be unrolled into, unless --unroll says otherwise */
+#define DEFAULT_UNROLL_BUDGET 64
+
+/* What the command line asked for, the same for every program it compiles */
+typedef struct {
+    int fast_math;              /* REAL arithmetic may be reassociated, as --fast-math asks */
+    int unroll_budget;          /* The instructions a FOR loop may be unrolled into; 0 turns unrolling off */
+    int run;                    /* The program is compiled to bytecode and run, as --run asks, not written as C */
+    int assembly;               /* The output is x86-64 assembly, as --asm asks, not C */
+    int jit;                    /* What --run runs is compiled to machine code first, as --jit asks */
+} COMPILE_OPTIONS;
+
+/* Everything one compilation reads and writes. Nothing is shared between contexts, so
+** compilations may run one after another on the same context, or concurrently on different
+** threads with a context each. */
+typedef struct compileContext {
+    /* Storage for the tree, the symbols and their identifiers, released together */
+    ARENA *treeArena;
+    ARENA *symbolArena;
+    ARENA *identifierArena;
+    DYNAMIC_SYMTAB *symTabRec;
+
+    TERNARY_TREE parseTree;
+    int lineno;                 /* Where the scanner stopped, reported by errors found after parsing */
+    int colno;
+
+    /* Lowering and code generation */
+    ARENA *irArena;
+    struct irProgram *irProgram;
+    unsigned int gen_var_count; /* Numbers the replacements for identifiers which are reserved in C */
+    struct bytecodeProgram *bytecode;   /* What --run runs, in place of the output */
+
+    STRING_BUILDER output;      /* The generated C, kept until the caller writes it out */
+
+    struct compileStats *stats; /* Phase timings are collected here when not NULL */
+
+    COMPILE_OPTIONS options;
+} COMPILE_CONTEXT;
+
+void default_compile_options(COMPILE_OPTIONS *);
+COMPILE_CONTEXT *create_compile_context(void);
+void reset_compile_context(COMPILE_CONTEXT *);
+void report_compile_arenas(FILE *, COMPILE_CONTEXT *);
+void destroy_compile_context(COMPILE_CONTEXT *);
+
+char *read_source(FILE *, size_t *);
+int compile_source(COMPILE_CONTEXT *, const char *, size_t);
+int write_compiled_output(FILE *, COMPILE_CONTEXT *);
+
+#endif
@@ -0,0 +1,89 @@
+#ifndef COMPILE_STATS_H
+#define COMPILE_STATS_H
+
+#include <stddef.h>
+#include <stdio.h>
+
+#include "compile.h"
+#include "types.h"
+
+/* The phases of a compilation which are timed. Lexing happens on demand while parsing, so
+** its share is kept apart from, and taken out of, the parse figures. */
+#define FOREACH_PHASE(CREATE) \
+CREATE(PHASE_READ, "read") CREATE(PHASE_LEX, "lex") CREATE(PHASE_PARSE, "parse") \
+CREATE(PHASE_OPTIMISE, "optimise") CREATE(PHASE_LOWER, "lower") \
+CREATE(PHASE_GENERATE, "generate") CREATE(PHASE_WRITE, "write") CREATE(PHASE_RUN, "run")
+
+#define CREATE_PHASE_ENUM(PHASE, NAME) PHASE,
+#define CREATE_PHASE_NAME(PHASE, NAME) NAME,
+
+enum CompilePhase {FOREACH_PHASE(CREATE_PHASE_ENUM) PHASE_COUNT};
+
+extern const char *PHASE_NAMES[];
+
+/* Memory is measured at the compiler's own allocators: the arenas and string builders of the
+** context. heap_ counts are the blocks those obtained from malloc, arena_ counts the
+** allocations made from the arenas. */
+typedef struct {
+    size_t heap_allocations;
+    size_t heap_bytes;
+    size_t arena_allocations;
+    size_t arena_bytes;
+} MEMORY_COUNTS;
+
+typedef struct {
+    int phase;
+    const char *label;
+    int thread;
+    double start;           /* Seconds since the stats origin */
+    double duration;
+} TRACE_EVENT;
+
+/* A loop which loop-invariant code motion hoisted instructions out of */
+typedef struct {
+    const char *label;      /* The program, when compiling a batch */
+    const char *loop;       /* WHILE, DO or FOR */
+    int number;             /* The loop's place in the program, counting from 1 */
+    int instructions;
+} HOIST_REPORT;
+
+typedef struct compileStats {
+    double seconds[PHASE_COUNT];
+    MEMORY_COUNTS memory[PHASE_COUNT];
+    size_t programs;
+    size_t tokens;
+    size_t symbols;
+    size_t nodes[NODE_TYPE_COUNT];
+    size_t hoisted;
+    HOIST_REPORT *hoists;
+    size_t hoist_count;
+    size_t hoist_capacity;
+
+    /* Phases in progress */
+    double phase_start[PHASE_COUNT];
+    MEMORY_COUNTS phase_memory[PHASE_COUNT];
+    double lex_seconds_at_parse;
+    MEMORY_COUNTS lex_memory_at_parse;
+
+    /* Trace events, only recorded when tracing */
+    int tracing;
+    int thread;
+    const char *label;
+    double origin;
+    TRACE_EVENT *events;
+    size_t event_count;
+    size_t event_capacity;
+} COMPILE_STATS;
+
+double monotonic_seconds(void);
+void init_compile_stats(COMPILE_STATS *, int, double);
+void begin_phase(COMPILE_CONTEXT *, enum CompilePhase);
+void end_phase(COMPILE_CONTEXT *, enum CompilePhase);
+void count_program(COMPILE_CONTEXT *);
+void count_hoisted(COMPILE_CONTEXT *, const char *, int, int);
+void merge_compile_stats(COMPILE_STATS *, COMPILE_STATS *);
+void report_compile_stats(FILE *, COMPILE_STATS *, int);
+int write_trace(const char *, COMPILE_STATS *);
+void free_compile_stats(COMPILE_STATS *);
+
+#endif
@@ -0,0 +1,140 @@
+#ifndef IR_H
+#define IR_H
+
+#include <stdio.h>
+
+#include "arena.h"
+#include "compile.h"
+#include "symbol_types.h"
+#include "types.h"
+
+/* ------------- three-address intermediate representation --------------------------- */
+
+/* A program is a sequence of statement nodes. Straight-line code is held in IR_BLOCK nodes as
+** typed three-address instructions; IF, WHILE, DO and FOR keep their structure, with their
+** branches and bodies as nested sequences and their conditions as IR_CONDITION trees. The
+** passes can then see every loop and branch without pattern matching the grammar, and the
+** C emitter can still print structured code. */
+
+#define FOREACH_IR_OP(CREATE) \
+CREATE(IR_COPY, "copy") CREATE(IR_ADD, "add") CREATE(IR_SUB, "sub") CREATE(IR_MUL, "mul") \
+CREATE(IR_DIV, "div") CREATE(IR_SHL, "shl") CREATE(IR_WRITE, "write") CREATE(IR_NEWLINE, "newline") CREATE(IR_READ, "read") \
+CREATE(IR_NOP, "nop")
+
+#define CREATE_IR_OP_ENUM(OP, NAME) OP,
+#define CREATE_IR_OP_NAME(OP, NAME) NAME,
+
+enum IrOp {FOREACH_IR_OP(CREATE_IR_OP_ENUM) IR_OP_COUNT};
+
+extern const char *IR_OP_NAMES[];
+
+enum IrOperandKind {IR_NONE, IR_VARIABLE, IR_TEMP, IR_INT_CONST, IR_CHAR_CONST, IR_REAL_CONST};
+
+/* A variable or REAL literal is a symbol index, a temporary is numbered from 1 */
+typedef struct {
+    enum IrOperandKind kind;
+    enum SymbolTypes type;
+    int index;
+    int value;                  /* INT and CHAR constants; TRUE for a negated REAL literal */
+} IR_OPERAND;
+
+/* dest = a op b. Arithmetic is carried out in type, which is INT_T or REAL_T just as C would
+** promote the operands. SHL only comes from the passes, which make it of an integer
+** multiplication by 2^b for a constant b, and wraps as that would. WRITE prints a as type, so
+** CHAR_T values print as characters. Passes delete an instruction by making it a NOP and then
+** compacting its block. */
+typedef struct {
+    enum IrOp op;
+    enum SymbolTypes type;
+    IR_OPERAND dest;
+    IR_OPERAND a;
+    IR_OPERAND b;
+} IR_INSTRUCTION;
+
+enum IrNodeKind {IR_BLOCK, IR_IF, IR_WHILE, IR_DO, IR_FOR};
+
+enum IrConditionKind {IR_COMPARE, IR_NOT, IR_AND, IR_OR};
+
+struct irNode;
+
+/* AND and OR short circuit, so a comparison's setup code only runs when it is reached */
+typedef struct irCondition {
+    enum IrConditionKind kind;
+    struct irNode *setup;       /* IR_COMPARE: the block computing left and right, or NULL */
+    enum CompareSymType compare;
+    enum SymbolTypes type;      /* The type the comparison is made in */
+    IR_OPERAND left;
+    IR_OPERAND right;
+    struct irCondition *first;  /* IR_NOT, IR_AND and IR_OR */
+    struct irCondition *second;
+} IR_CONDITION;
+
+/* IR_FOR runs init once, then while condition holds runs body and step. Both init and step
+** are blocks of arithmetic only. A counted FOR has been found to run a number of times fixed
+** once init has run, by a step and bound the loop cannot change; it is run by a counter
+** instead, which C compilers recognise more readily than the condition. */
+typedef struct irNode {
+    enum IrNodeKind kind;
+    struct irNode *next;
+
+    /* IR_BLOCK */
+    IR_INSTRUCTION *code;
+    int count;
+    int capacity;
+
+    IR_CONDITION *condition;
+    struct irNode *body;        /* The THEN branch of an IF */
+    struct irNode *orelse;      /* The ELSE branch of an IF */
+
+    /* IR_FOR */
+    IR_OPERAND variable;
+    struct irNode *init;
+    struct irNode *step;
+    int counter;                /* A counted FOR's counter, numbered from 1; otherwise 0 */
+    IR_OPERAND bound;           /* A counted FOR's TO and BY values */
+    IR_OPERAND stride;
+
+    /* IR_WHILE, IR_DO and IR_FOR: the variables assigned and read anywhere in the loop, as
+    ** symbols, filled in by summarise_ir_loops. Passes which only delete code or move it out
+    ** of loops leave them a safe over-estimate. */
+    int *assigned;
+    int assigned_count;
+    int assigned_capacity;
+    int *used;
+    int used_count;
+    int used_capacity;
+} IR_NODE;
+
+typedef struct irProgram {
+    const char *name;
+    IR_NODE *body;
+    int *variables;             /* Declared symbols, in the order of their declarations */
+    int variable_count;
+    int variable_capacity;
+    enum SymbolTypes *temp_types;   /* Indexed by temporary number; entry 0 is unused */
+    int temp_count;
+    int temp_capacity;
+    int counter_count;          /* The counters of counted FOR loops */
+    ARENA *arena;               /* Every part of the program is allocated here */
+} IR_PROGRAM;
+
+IR_PROGRAM *create_ir_program(ARENA *, const char *);
+IR_NODE *new_ir_node(IR_PROGRAM *, enum IrNodeKind);
+IR_CONDITION *new_ir_condition(IR_PROGRAM *, enum IrConditionKind);
+IR_INSTRUCTION *append_ir_instruction(IR_PROGRAM *, IR_NODE *, enum IrOp, enum SymbolTypes);
+void compact_ir_block(IR_NODE *);
+int count_ir_instructions(IR_NODE *);
+int summarise_ir_loops(IR_PROGRAM *, int);
+int add_ir_variable(IR_PROGRAM *, int);
+IR_OPERAND new_ir_temp(IR_PROGRAM *, enum SymbolTypes);
+IR_OPERAND ir_variable(COMPILE_CONTEXT *, int);
+IR_OPERAND ir_int_constant(int);
+IR_OPERAND ir_char_constant(int);
+IR_OPERAND ir_real_constant(int, int);
+enum SymbolTypes ir_arithmetic_type(enum SymbolTypes, enum SymbolTypes);
+int ir_is_constant(IR_OPERAND);
+#ifdef DEBUG
+void print_ir(FILE *, COMPILE_CONTEXT *, IR_PROGRAM *);
+#endif
+
+#endif
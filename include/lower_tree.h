@@ -0,0 +1,10 @@
+#ifndef LOWER_TREE_H
+#define LOWER_TREE_H
+
+#include "compile.h"
+#include "ir.h"
+#include "types.h"
+
+IR_PROGRAM *lower_tree(COMPILE_CONTEXT *, TERNARY_TREE);
+
+#endif
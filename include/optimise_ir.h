@@ -0,0 +1,28 @@
+#ifndef OPTIMISE_IR_H
+#define OPTIMISE_IR_H
+
+#include "compile.h"
+#include "ir.h"
+
+void optimise_ir(COMPILE_CONTEXT *, IR_PROGRAM *);
+
+/* The passes optimise_ir runs, in order */
+void propagate_constants(COMPILE_CONTEXT *, IR_PROGRAM *);
+void fold_conditions(COMPILE_CONTEXT *, IR_PROGRAM *);
+int unroll_loops(COMPILE_CONTEXT *, IR_PROGRAM *);
+void eliminate_common_subexpressions(COMPILE_CONTEXT *, IR_PROGRAM *);
+void hoist_loop_invariants(COMPILE_CONTEXT *, IR_PROGRAM *);
+void eliminate_dead_stores(COMPILE_CONTEXT *, IR_PROGRAM *);
+void remove_unused_variables(COMPILE_CONTEXT *, IR_PROGRAM *);
+
+/* Run by propagate_constants on each instruction, once the constants it knows are in place */
+int simplify_ir_instruction(COMPILE_CONTEXT *, IR_INSTRUCTION *);
+
+/* TRUE or FALSE when two constants are compared, otherwise -1 */
+int compare_ir_constants(COMPILE_CONTEXT *, enum CompareSymType, IR_OPERAND, IR_OPERAND);
+
+/* Arithmetic as the generated program does it, for the tree folder as well */
+int fold_integers(enum IrOp, int, int, int *);
+int fold_reals(enum IrOp, double, double, double *);
+
+#endif
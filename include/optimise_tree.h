@@ -1,8 +1,9 @@
 #ifndef OPTIMISE_TREE_H
 #define OPTIMISE_TREE_H
 
+#include "compile.h"
 #include "types.h"
 
-void Optimise(TERNARY_TREE *);
+void Optimise(COMPILE_CONTEXT *, TERNARY_TREE *);
 
 #endif
\ No newline at end of file
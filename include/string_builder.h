@@ -0,0 +1,31 @@
+#ifndef STRING_BUILDER_H
+#define STRING_BUILDER_H
+
+#include <stddef.h>
+#include <stdio.h>
+
+#define INITIAL_BUILDER_CAPACITY 4096
+
+/* A growable run of bytes, kept NUL terminated. The capacity doubles when it runs out, so
+** appending n bytes in total costs O(n). If growing ever fails the builder is marked failed
+** and later appends are ignored, so callers can check once at the end. */
+typedef struct {
+    char *data;
+    size_t length;
+    size_t capacity;
+    int failed;
+    size_t heap_allocations;    /* Calls to realloc over the life of the builder */
+    size_t heap_bytes;
+} STRING_BUILDER;
+
+void init_string_builder(STRING_BUILDER *);
+int append_bytes(STRING_BUILDER *, const char *, size_t);
+int append_string(STRING_BUILDER *, const char *);
+int append_format(STRING_BUILDER *, const char *, ...);
+int append_int(STRING_BUILDER *, int);
+int append_repeated(STRING_BUILDER *, char, size_t);
+void reset_string_builder(STRING_BUILDER *);
+int write_string_builder(FILE *, STRING_BUILDER *);
+void free_string_builder(STRING_BUILDER *);
+
+#endif
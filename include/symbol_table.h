@@ -1,9 +1,14 @@
 #ifndef SYMBOL_TABLE_H
 #define SYMBOL_TABLE_H
 
+#include "arena.h"
 #include "symbol_types.h"
 
 #define INITIAL_CAPACITY 2
+#define INITIAL_HASH_CAPACITY 64
+
+#define HASH_SLOT_EMPTY   -1
+#define HASH_SLOT_DELETED -2
 
 typedef struct {
     char *identifier;
@@ -13,22 +18,31 @@ typedef struct {
     int sanitised;
     int line;
     int col;
+    unsigned int hash;
+    double value;               /* A REAL literal's value, read once when it is installed */
 } SYMTABNODE;
 
 typedef  SYMTABNODE        *SYMTABNODEPTR;
 
-
 typedef struct {
-    SYMTABNODEPTR *array;
+    SYMTABNODEPTR *array;       /* Index -> symbol, so ID_VAL nodes can keep storing an index */
     int in_use;
     int capacity;
+    SYMTABNODE *entries;        /* Contiguous storage for the symbols owned by this table */
+    int *hash_slots;            /* Open addressing index over the interned identifiers */
+    int hash_capacity;
+    int hash_in_use;
+    ARENA *symbol_arena;        /* Owns entries and array when the table owns its symbols */
+    ARENA *identifier_arena;    /* Owns the interned identifier strings */
 } DYNAMIC_SYMTAB;
 
-DYNAMIC_SYMTAB *symTabRec;
-
 DYNAMIC_SYMTAB *create_dynamic_symtab();
+DYNAMIC_SYMTAB *create_arena_symtab(ARENA *, ARENA *);
 int add_symbol(DYNAMIC_SYMTAB *array, SYMTABNODEPTR element);
+int install_symbol(DYNAMIC_SYMTAB *, char *, enum SymbolTypes);
+int install_real_literal(DYNAMIC_SYMTAB *, double);
 int lookup_symbol(char *, DYNAMIC_SYMTAB *);
+int rename_symbol(DYNAMIC_SYMTAB *, int, char *);
 int reset_dynamic_symtab(DYNAMIC_SYMTAB *array);
 void destroy_symtab(DYNAMIC_SYMTAB *);
 #endif
\ No newline at end of file
@@ -3,17 +3,19 @@
 
 #include <stdio.h>
 
+#include "compile.h"
+#include "string_builder.h"
 #include "symbol_table.h"
 #include "types.h"
 
-TERNARY_TREE create_inode(int ival, int case_identifier, TERNARY_TREE p1,
+TERNARY_TREE create_inode(COMPILE_CONTEXT *ctx, int ival, int case_identifier, TERNARY_TREE p1,
     TERNARY_TREE  p2, TERNARY_TREE  p3);
+TERNARY_TREE link_inode(TERNARY_TREE tail, int case_identifier, int ival, TERNARY_TREE next);
+int is_chain_link(TERNARY_TREE);
     
-void Optimise(TERNARY_TREE*);
+void Optimise(COMPILE_CONTEXT *, TERNARY_TREE *);
 
 #ifdef DEBUG
-void PrintTree(TERNARY_TREE, int);
-#else
-int GenerateC(TERNARY_TREE,int,FILE*);
+void PrintTree(COMPILE_CONTEXT *, TERNARY_TREE, int);
 #endif  /* DEBUG */
 #endif /* TREE_PROCEDURES_H */
\ No newline at end of file
@@ -16,6 +16,9 @@ CREATE(NUMBER_CONST) CREATE(CHAR_CONST) CREATE(INT_CONST) CREATE(NEG_INT_CONST)
 
 #define CREATE_ENUM(NODE_TYPE) NODE_TYPE,
 #define CREATE_STRING(NODE_TYPE) #NODE_TYPE,
+#define CREATE_COUNT(NODE_TYPE) +1
+
+#define NODE_TYPE_COUNT (0 FOREACH_NODE_TYPE(CREATE_COUNT))
 
 enum ParseTreeNodeType {FOREACH_NODE_TYPE(CREATE_ENUM)};  
 
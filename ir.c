@@ -0,0 +1,438 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "include/arena.h"
+#include "include/compile.h"
+#include "include/ir.h"
+#include "include/symbol_table.h"
+
+#define INITIAL_IR_CAPACITY 8
+
+const char *IR_OP_NAMES[] = {FOREACH_IR_OP(CREATE_IR_OP_NAME)};
+
+IR_PROGRAM *create_ir_program(ARENA *arena, const char *name)
+{
+    IR_PROGRAM *program = (IR_PROGRAM *)arena_alloc(arena, sizeof(IR_PROGRAM));
+    if(program == NULL) return NULL;
+    memset(program, 0, sizeof(IR_PROGRAM));
+    program->name = name;
+    program->arena = arena;
+    return program;
+}
+
+IR_NODE *new_ir_node(IR_PROGRAM *program, enum IrNodeKind kind)
+{
+    IR_NODE *node = (IR_NODE *)arena_alloc(program->arena, sizeof(IR_NODE));
+    if(node == NULL) return NULL;
+    memset(node, 0, sizeof(IR_NODE));
+    node->kind = kind;
+    return node;
+}
+
+IR_CONDITION *new_ir_condition(IR_PROGRAM *program, enum IrConditionKind kind)
+{
+    IR_CONDITION *condition = (IR_CONDITION *)arena_alloc(program->arena, sizeof(IR_CONDITION));
+    if(condition == NULL) return NULL;
+    memset(condition, 0, sizeof(IR_CONDITION));
+    condition->kind = kind;
+    return condition;
+}
+
+/* Arrays in the arena cannot be resized in place, so a full one is copied into one twice the
+** size. The abandoned copies add up to less than the final array, keeping appends O(1). */
+static void *grow_ir_array(ARENA *arena, void *array, int count, int *capacity, size_t size)
+{
+    int new_capacity = *capacity ? *capacity*2 : INITIAL_IR_CAPACITY;
+    void *grown = arena_alloc(arena, size * new_capacity);
+    if(grown == NULL) return NULL;
+    if(array != NULL) memcpy(grown, array, size * count);
+    *capacity = new_capacity;
+    return grown;
+}
+
+IR_INSTRUCTION *append_ir_instruction(IR_PROGRAM *program, IR_NODE *block, enum IrOp op, enum SymbolTypes type)
+{
+    if(block->count == block->capacity)
+    {
+        IR_INSTRUCTION *grown = grow_ir_array(program->arena, block->code, block->count, &block->capacity, sizeof(IR_INSTRUCTION));
+        if(grown == NULL) return NULL;
+        block->code = grown;
+    }
+    IR_INSTRUCTION *instruction = &block->code[block->count++];
+    memset(instruction, 0, sizeof(IR_INSTRUCTION));
+    instruction->op = op;
+    instruction->type = type;
+    return instruction;
+}
+
+void compact_ir_block(IR_NODE *block)
+{
+    int kept = 0;
+    int i;
+    for(i = 0; i < block->count; i++)
+    {
+        if(block->code[i].op != IR_NOP) block->code[kept++] = block->code[i];
+    }
+    block->count = kept;
+}
+
+static int count_condition_instructions(IR_CONDITION *);
+
+/* The instructions in a list of nodes and everything inside them */
+int count_ir_instructions(IR_NODE *node)
+{
+    int count = 0;
+    for(; node != NULL; node = node->next)
+    {
+        count += node->count;
+        count += count_condition_instructions(node->condition);
+        count += count_ir_instructions(node->body);
+        count += count_ir_instructions(node->orelse);
+        count += count_ir_instructions(node->init);
+        count += count_ir_instructions(node->step);
+    }
+    return count;
+}
+
+static int count_condition_instructions(IR_CONDITION *condition)
+{
+    if(condition == NULL) return 0;
+    return count_ir_instructions(condition->setup) + count_condition_instructions(condition->first)
+        + count_condition_instructions(condition->second);
+}
+
+/* ------------- loop summaries --------------------------- */
+
+typedef struct {
+    IR_PROGRAM *program;
+    int *assigned_stamp;        /* The last loop each symbol was kept in, by loop number */
+    int *used_stamp;
+    int loops;
+    int failed;
+} LOOP_SUMMARY_STATE;
+
+static void add_loop_symbol(LOOP_SUMMARY_STATE *, int **, int *, int *, int);
+static void summarise_operand(LOOP_SUMMARY_STATE *, IR_NODE *, IR_OPERAND, int);
+static void summarise_nodes(LOOP_SUMMARY_STATE *, IR_NODE *, IR_NODE *);
+static void summarise_condition(LOOP_SUMMARY_STATE *, IR_CONDITION *, IR_NODE *);
+static int remove_repeats(int *, int, int *, int);
+
+static void add_loop_symbol(LOOP_SUMMARY_STATE *state, int **symbols, int *count, int *capacity, int symbol)
+{
+    if(*count == *capacity)
+    {
+        int *grown = grow_ir_array(state->program->arena, *symbols, *count, capacity, sizeof(int));
+        if(grown == NULL)
+        {
+            state->failed = TRUE;
+            return;
+        }
+        *symbols = grown;
+    }
+    (*symbols)[(*count)++] = symbol;
+}
+
+static void summarise_operand(LOOP_SUMMARY_STATE *state, IR_NODE *loop, IR_OPERAND operand, int assigned)
+{
+    if(loop == NULL || operand.kind != IR_VARIABLE) return;
+    if(assigned) add_loop_symbol(state, &loop->assigned, &loop->assigned_count, &loop->assigned_capacity, operand.index);
+    else add_loop_symbol(state, &loop->used, &loop->used_count, &loop->used_capacity, operand.index);
+}
+
+/* Lists may pick up repeats while a loop is being summarised, as the loops inside it are
+** merged in; they are removed once it is complete */
+static int remove_repeats(int *symbols, int count, int *stamp, int loop_number)
+{
+    int kept = 0;
+    int i;
+    for(i = 0; i < count; i++)
+    {
+        if(stamp[symbols[i]] == loop_number) continue;
+        stamp[symbols[i]] = loop_number;
+        symbols[kept++] = symbols[i];
+    }
+    return kept;
+}
+
+static void summarise_nodes(LOOP_SUMMARY_STATE *state, IR_NODE *node, IR_NODE *loop)
+{
+    int i;
+    for(; node != NULL; node = node->next)
+    {
+        switch(node->kind)
+        {
+            case IR_BLOCK:
+                for(i = 0; i < node->count; i++)
+                {
+                    summarise_operand(state, loop, node->code[i].dest, TRUE);
+                    summarise_operand(state, loop, node->code[i].a, FALSE);
+                    summarise_operand(state, loop, node->code[i].b, FALSE);
+                }
+                break;
+            case IR_IF:
+                summarise_condition(state, node->condition, loop);
+                summarise_nodes(state, node->body, loop);
+                summarise_nodes(state, node->orelse, loop);
+                break;
+            case IR_WHILE:
+            case IR_DO:
+            case IR_FOR:
+            {
+                int loop_number = ++state->loops;
+                /* FOR's init runs before the loop, in whatever encloses it */
+                summarise_nodes(state, node->init, loop);
+                node->assigned_count = 0;
+                node->used_count = 0;
+                summarise_condition(state, node->condition, node);
+                summarise_nodes(state, node->body, node);
+                summarise_nodes(state, node->step, node);
+                node->assigned_count = remove_repeats(node->assigned, node->assigned_count, state->assigned_stamp, loop_number);
+                node->used_count = remove_repeats(node->used, node->used_count, state->used_stamp, loop_number);
+                if(loop != NULL)
+                {
+                    for(i = 0; i < node->assigned_count; i++)
+                        add_loop_symbol(state, &loop->assigned, &loop->assigned_count, &loop->assigned_capacity, node->assigned[i]);
+                    for(i = 0; i < node->used_count; i++)
+                        add_loop_symbol(state, &loop->used, &loop->used_count, &loop->used_capacity, node->used[i]);
+                }
+                break;
+            }
+        }
+    }
+}
+
+static void summarise_condition(LOOP_SUMMARY_STATE *state, IR_CONDITION *condition, IR_NODE *loop)
+{
+    if(condition == NULL) return;
+    summarise_nodes(state, condition->setup, loop);
+    summarise_operand(state, loop, condition->left, FALSE);
+    summarise_operand(state, loop, condition->right, FALSE);
+    summarise_condition(state, condition->first, loop);
+    summarise_condition(state, condition->second, loop);
+}
+
+/* Work out what each loop assigns and reads, in one walk over the program, so passes do not
+** have to walk each loop again for every loop around it. Returns -1 when out of memory. */
+int summarise_ir_loops(IR_PROGRAM *program, int symbol_count)
+{
+    LOOP_SUMMARY_STATE state;
+    memset(&state, 0, sizeof(LOOP_SUMMARY_STATE));
+    state.program = program;
+    state.assigned_stamp = (int *)calloc(symbol_count + 1, sizeof(int));
+    state.used_stamp = (int *)calloc(symbol_count + 1, sizeof(int));
+    if(state.assigned_stamp != NULL && state.used_stamp != NULL) summarise_nodes(&state, program->body, NULL);
+    else state.failed = TRUE;
+    free(state.assigned_stamp);
+    free(state.used_stamp);
+    return state.failed ? -1 : 0;
+}
+
+int add_ir_variable(IR_PROGRAM *program, int symbol)
+{
+    if(program->variable_count == program->variable_capacity)
+    {
+        int *grown = grow_ir_array(program->arena, program->variables, program->variable_count,
+            &program->variable_capacity, sizeof(int));
+        if(grown == NULL) return -1;
+        program->variables = grown;
+    }
+    program->variables[program->variable_count++] = symbol;
+    return 0;
+}
+
+/* Temporaries are numbered from 1 and typed, so the emitter can declare them */
+IR_OPERAND new_ir_temp(IR_PROGRAM *program, enum SymbolTypes type)
+{
+    IR_OPERAND temp = {IR_NONE, type, 0, 0};
+    if(program->temp_count + 1 >= program->temp_capacity)
+    {
+        enum SymbolTypes *grown = grow_ir_array(program->arena, program->temp_types, program->temp_count + 1,
+            &program->temp_capacity, sizeof(enum SymbolTypes));
+        if(grown == NULL) return temp;
+        program->temp_types = grown;
+    }
+    temp.kind = IR_TEMP;
+    temp.index = ++program->temp_count;
+    program->temp_types[temp.index] = type;
+    return temp;
+}
+
+IR_OPERAND ir_variable(COMPILE_CONTEXT *ctx, int symbol)
+{
+    IR_OPERAND operand = {IR_VARIABLE, ctx->symTabRec->array[symbol]->type, symbol, 0};
+    return operand;
+}
+
+IR_OPERAND ir_int_constant(int value)
+{
+    IR_OPERAND operand = {IR_INT_CONST, INT_T, 0, value};
+    return operand;
+}
+
+IR_OPERAND ir_char_constant(int value)
+{
+    IR_OPERAND operand = {IR_CHAR_CONST, CHAR_T, 0, value};
+    return operand;
+}
+
+IR_OPERAND ir_real_constant(int symbol, int negative)
+{
+    IR_OPERAND operand = {IR_REAL_CONST, REAL_T, symbol, negative};
+    return operand;
+}
+
+/* The type C carries out arithmetic in: characters are promoted to int */
+enum SymbolTypes ir_arithmetic_type(enum SymbolTypes left, enum SymbolTypes right)
+{
+    return (left == REAL_T || right == REAL_T) ? REAL_T : INT_T;
+}
+
+int ir_is_constant(IR_OPERAND operand)
+{
+    return operand.kind == IR_INT_CONST || operand.kind == IR_CHAR_CONST || operand.kind == IR_REAL_CONST;
+}
+
+#ifdef DEBUG
+static void print_ir_operand(FILE *, COMPILE_CONTEXT *, IR_OPERAND);
+static void print_ir_condition(FILE *, COMPILE_CONTEXT *, IR_CONDITION *, int);
+static void print_ir_nodes(FILE *, COMPILE_CONTEXT *, IR_NODE *, int);
+
+static const char *IR_COMPARE_NAMES[] = {"==", "!=", "<", ">", "<=", ">="};
+
+static void print_ir_operand(FILE *output, COMPILE_CONTEXT *ctx, IR_OPERAND operand)
+{
+    switch(operand.kind)
+    {
+        case IR_NONE:
+            fprintf(output, "_");
+            break;
+        case IR_VARIABLE:
+            fprintf(output, "%s", ctx->symTabRec->array[operand.index]->identifier);
+            break;
+        case IR_TEMP:
+            fprintf(output, "t_%d", operand.index);
+            break;
+        case IR_INT_CONST:
+            fprintf(output, "%d", operand.value);
+            break;
+        case IR_CHAR_CONST:
+            fprintf(output, "'%c'", (char)operand.value);
+            break;
+        case IR_REAL_CONST:
+            fprintf(output, "%s%s", operand.value ? "-" : "", ctx->symTabRec->array[operand.index]->identifier);
+            break;
+    }
+}
+
+static void print_ir_condition(FILE *output, COMPILE_CONTEXT *ctx, IR_CONDITION *condition, int level)
+{
+    switch(condition->kind)
+    {
+        case IR_COMPARE:
+            if(condition->setup != NULL) print_ir_nodes(output, ctx, condition->setup, level);
+            fprintf(output, "%*s", level*4, "");
+            print_ir_operand(output, ctx, condition->left);
+            fprintf(output, " %s ", IR_COMPARE_NAMES[condition->compare]);
+            print_ir_operand(output, ctx, condition->right);
+            fprintf(output, "\n");
+            break;
+        case IR_NOT:
+            fprintf(output, "%*snot\n", level*4, "");
+            print_ir_condition(output, ctx, condition->first, level + 1);
+            break;
+        case IR_AND:
+        case IR_OR:
+            fprintf(output, "%*s%s\n", level*4, "", condition->kind == IR_AND ? "and" : "or");
+            print_ir_condition(output, ctx, condition->first, level + 1);
+            print_ir_condition(output, ctx, condition->second, level + 1);
+            break;
+    }
+}
+
+static void print_ir_nodes(FILE *output, COMPILE_CONTEXT *ctx, IR_NODE *node, int level)
+{
+    int i;
+    for(; node != NULL; node = node->next)
+    {
+        switch(node->kind)
+        {
+            case IR_BLOCK:
+                for(i = 0; i < node->count; i++)
+                {
+                    IR_INSTRUCTION *instruction = &node->code[i];
+                    fprintf(output, "%*s", level*4, "");
+                    if(instruction->dest.kind != IR_NONE)
+                    {
+                        print_ir_operand(output, ctx, instruction->dest);
+                        fprintf(output, " = ");
+                    }
+                    fprintf(output, "%s.%d", IR_OP_NAMES[instruction->op], instruction->type);
+                    if(instruction->a.kind != IR_NONE)
+                    {
+                        fprintf(output, " ");
+                        print_ir_operand(output, ctx, instruction->a);
+                    }
+                    if(instruction->b.kind != IR_NONE)
+                    {
+                        fprintf(output, ", ");
+                        print_ir_operand(output, ctx, instruction->b);
+                    }
+                    fprintf(output, "\n");
+                }
+                break;
+            case IR_IF:
+                fprintf(output, "%*sif\n", level*4, "");
+                print_ir_condition(output, ctx, node->condition, level + 1);
+                fprintf(output, "%*sthen\n", level*4, "");
+                print_ir_nodes(output, ctx, node->body, level + 1);
+                if(node->orelse != NULL)
+                {
+                    fprintf(output, "%*selse\n", level*4, "");
+                    print_ir_nodes(output, ctx, node->orelse, level + 1);
+                }
+                break;
+            case IR_WHILE:
+            case IR_DO:
+                fprintf(output, "%*s%s\n", level*4, "", node->kind == IR_WHILE ? "while" : "do while");
+                print_ir_condition(output, ctx, node->condition, level + 1);
+                fprintf(output, "%*sbody\n", level*4, "");
+                print_ir_nodes(output, ctx, node->body, level + 1);
+                break;
+            case IR_FOR:
+                fprintf(output, "%*sfor ", level*4, "");
+                print_ir_operand(output, ctx, node->variable);
+                fprintf(output, "\n%*sinit\n", level*4, "");
+                print_ir_nodes(output, ctx, node->init, level + 1);
+                if(node->counter != 0)
+                {
+                    fprintf(output, "%*scounted n_%d to ", level*4, "", node->counter);
+                    print_ir_operand(output, ctx, node->bound);
+                    fprintf(output, " by ");
+                    print_ir_operand(output, ctx, node->stride);
+                    fprintf(output, "\n");
+                }
+                fprintf(output, "%*swhile\n", level*4, "");
+                print_ir_condition(output, ctx, node->condition, level + 1);
+                fprintf(output, "%*sbody\n", level*4, "");
+                print_ir_nodes(output, ctx, node->body, level + 1);
+                fprintf(output, "%*sstep\n", level*4, "");
+                print_ir_nodes(output, ctx, node->step, level + 1);
+                break;
+        }
+    }
+}
+
+void print_ir(FILE *output, COMPILE_CONTEXT *ctx, IR_PROGRAM *program)
+{
+    int i;
+    fprintf(output, "program %s\n", program->name);
+    for(i = 0; i < program->variable_count; i++)
+    {
+        SYMTABNODEPTR symbol = ctx->symTabRec->array[program->variables[i]];
+        fprintf(output, "    var %s.%d\n", symbol->identifier, symbol->type);
+    }
+    for(i = 1; i <= program->temp_count; i++) fprintf(output, "    temp t_%d.%d\n", i, program->temp_types[i]);
+    print_ir_nodes(output, ctx, program->body, 1);
+}
+#endif
@@ -0,0 +1,276 @@
+#include <stdlib.h>
+
+#include "include/compile.h"
+#include "include/ir.h"
+#include "include/optimise_ir.h"
+#include "include/splio.h"
+#include "include/symbol_table.h"
+
+/* ------------- condition folding --------------------------- */
+
+/* Constant propagation leaves every comparison whose outcome it knows with a constant on each
+** side, and deletes the loops it knows are never entered. What is known is folded into the NOT,
+** AND and OR around it here, NOT NOT is dropped, and an IF or DO whose outcome is then known is
+** replaced by the code which runs: the branch taken, or the body of a DO once.
+**
+** Comparing has no effect of its own, so a comparison is only kept for its setup, and only for
+** what that computes for later comparisons: lowering only uses a temporary of a setup which is
+** sure to have run, so the setups kept are those evaluated before the outcome was decided. A
+** loop whose condition always holds is left as it is. */
+
+static int fold_condition(COMPILE_CONTEXT *, IR_CONDITION **);
+static int condition_outcome(COMPILE_CONTEXT *, IR_CONDITION *);
+static IR_NODE *evaluated_setup(COMPILE_CONTEXT *, IR_CONDITION *);
+static IR_NODE *join_nodes(IR_NODE *, IR_NODE *);
+static IR_NODE **replace_node(IR_NODE **, IR_NODE *);
+static void join_blocks(IR_PROGRAM *, IR_NODE *);
+static void fold_nodes(COMPILE_CONTEXT *, IR_PROGRAM *, IR_NODE **);
+
+void fold_conditions(COMPILE_CONTEXT *ctx, IR_PROGRAM *program)
+{
+    fold_nodes(ctx, program, &program->body);
+}
+
+/* Returns TRUE or FALSE when the outcome is known, otherwise -1 after simplifying the condition */
+static int fold_condition(COMPILE_CONTEXT *ctx, IR_CONDITION **link)
+{
+    IR_CONDITION *condition = *link;
+    IR_CONDITION *leading;
+    int first;
+    int second;
+    int decisive;
+    switch(condition->kind)
+    {
+        case IR_COMPARE:
+            return compare_ir_constants(ctx, condition->compare, condition->left, condition->right);
+        case IR_NOT:
+            first = fold_condition(ctx, &condition->first);
+            if(first >= 0) return !first;
+            if(condition->first->kind == IR_NOT)
+            {
+                INFO("Optimisation: Removed NOT NOT\n")
+                *link = condition->first->first;
+            }
+            return -1;
+        case IR_AND:
+        case IR_OR:
+            /* The outcome of either part which decides the whole */
+            decisive = condition->kind == IR_OR;
+            first = fold_condition(ctx, &condition->first);
+            second = fold_condition(ctx, &condition->second);
+            if(first == decisive || second == decisive) return decisive;
+            if(first >= 0 && second >= 0) return second;
+            if(first >= 0)
+            {
+                /* The second part decides, after the first's setup */
+                leading = condition->second;
+                while(leading->kind != IR_COMPARE) leading = leading->first;
+                leading->setup = join_nodes(evaluated_setup(ctx, condition->first), leading->setup);
+                *link = condition->second;
+            }
+            else if(second >= 0) *link = condition->first;
+            return -1;
+    }
+    return -1;
+}
+
+/* As fold_condition works it out, without changing anything */
+static int condition_outcome(COMPILE_CONTEXT *ctx, IR_CONDITION *condition)
+{
+    int first;
+    int second;
+    int decisive;
+    switch(condition->kind)
+    {
+        case IR_COMPARE:
+            return compare_ir_constants(ctx, condition->compare, condition->left, condition->right);
+        case IR_NOT:
+            first = condition_outcome(ctx, condition->first);
+            return first < 0 ? -1 : !first;
+        case IR_AND:
+        case IR_OR:
+            decisive = condition->kind == IR_OR;
+            first = condition_outcome(ctx, condition->first);
+            second = condition_outcome(ctx, condition->second);
+            if(first == decisive || second == decisive) return decisive;
+            return first >= 0 && second >= 0 ? second : -1;
+    }
+    return -1;
+}
+
+/* The setups which are sure to run, joined in order. The condition is being discarded, so its
+** setups are linked together as they are. */
+static IR_NODE *evaluated_setup(COMPILE_CONTEXT *ctx, IR_CONDITION *condition)
+{
+    int first;
+    switch(condition->kind)
+    {
+        case IR_COMPARE:
+            return condition->setup;
+        case IR_NOT:
+            return evaluated_setup(ctx, condition->first);
+        case IR_AND:
+        case IR_OR:
+            /* The second part runs only when the first does not decide */
+            first = condition_outcome(ctx, condition->first);
+            if(first < 0 || first == (condition->kind == IR_OR)) return evaluated_setup(ctx, condition->first);
+            return join_nodes(evaluated_setup(ctx, condition->first), evaluated_setup(ctx, condition->second));
+    }
+    return NULL;
+}
+
+static IR_NODE *join_nodes(IR_NODE *first, IR_NODE *second)
+{
+    IR_NODE *last = first;
+    if(first == NULL) return second;
+    while(last->next != NULL) last = last->next;
+    last->next = second;
+    return first;
+}
+
+/* Put the nodes of replacement in place of the node at link, returning the link after them */
+static IR_NODE **replace_node(IR_NODE **link, IR_NODE *replacement)
+{
+    IR_NODE *next = (*link)->next;
+    *link = replacement;
+    while(*link != NULL) link = &(*link)->next;
+    *link = next;
+    return link;
+}
+
+/* Replacing leaves blocks side by side, which are joined so that their WRITEs can share a printf */
+static void join_blocks(IR_PROGRAM *program, IR_NODE *node)
+{
+    int count;
+    int i;
+    for(; node != NULL; node = node->next)
+    {
+        while(node->kind == IR_BLOCK && node->next != NULL && node->next->kind == IR_BLOCK)
+        {
+            IR_NODE *next = node->next;
+            if(node->count == 0)
+            {
+                node->code = next->code;
+                node->count = next->count;
+                node->capacity = next->capacity;
+            }
+            else
+            {
+                count = node->count;
+                for(i = 0; i < next->count; i++)
+                {
+                    IR_INSTRUCTION *instruction = append_ir_instruction(program, node, next->code[i].op, next->code[i].type);
+                    if(instruction == NULL)
+                    {
+                        node->count = count;
+                        return;
+                    }
+                    *instruction = next->code[i];
+                }
+            }
+            node->next = next->next;
+        }
+    }
+}
+
+static void fold_nodes(COMPILE_CONTEXT *ctx, IR_PROGRAM *program, IR_NODE **link)
+{
+    IR_NODE **first = link;
+    while(*link != NULL)
+    {
+        IR_NODE *node = *link;
+        int outcome;
+        switch(node->kind)
+        {
+            case IR_BLOCK:
+                break;
+            case IR_IF:
+                fold_nodes(ctx, program, &node->body);
+                fold_nodes(ctx, program, &node->orelse);
+                outcome = fold_condition(ctx, &node->condition);
+                if(outcome < 0) break;
+                INFO("Optimisation: Removed the %s branch of an IF whose condition %s\n", outcome ? "ELSE" : "THEN",
+                    outcome ? "always holds" : "never holds")
+                link = replace_node(link, join_nodes(evaluated_setup(ctx, node->condition), outcome ? node->body : node->orelse));
+                continue;
+            case IR_DO:
+                fold_nodes(ctx, program, &node->body);
+                if(fold_condition(ctx, &node->condition) != FALSE) break;
+                INFO("Optimisation: Replaced a DO loop whose condition never holds by its body\n")
+                link = replace_node(link, join_nodes(node->body, evaluated_setup(ctx, node->condition)));
+                continue;
+            case IR_WHILE:
+            case IR_FOR:
+                fold_nodes(ctx, program, &node->body);
+                fold_condition(ctx, &node->condition);
+                break;
+        }
+        link = &node->next;
+    }
+    join_blocks(program, *first);
+}
+
+/* ------------- unused declarations --------------------------- */
+
+/* Once the other passes have deleted what they can, a variable which is neither read nor
+** assigned anywhere is not declared either */
+
+static void mark_variables(IR_NODE *, char *);
+static void mark_condition_variables(IR_CONDITION *, char *);
+static void mark_variable(IR_OPERAND, char *);
+
+void remove_unused_variables(COMPILE_CONTEXT *ctx, IR_PROGRAM *program)
+{
+    char *used = (char *)calloc(ctx->symTabRec->in_use + 1, 1);
+    int kept = 0;
+    int i;
+    if(used == NULL) return;
+    mark_variables(program->body, used);
+    for(i = 0; i < program->variable_count; i++)
+    {
+        if(used[program->variables[i]]) program->variables[kept++] = program->variables[i];
+        else
+        {
+            INFO("Optimisation: Removed unused variable %s\n", ctx->symTabRec->array[program->variables[i]]->identifier)
+        }
+    }
+    program->variable_count = kept;
+    free(used);
+}
+
+static void mark_variables(IR_NODE *node, char *used)
+{
+    int i;
+    for(; node != NULL; node = node->next)
+    {
+        for(i = 0; i < node->count; i++)
+        {
+            mark_variable(node->code[i].dest, used);
+            mark_variable(node->code[i].a, used);
+            mark_variable(node->code[i].b, used);
+        }
+        mark_condition_variables(node->condition, used);
+        mark_variables(node->body, used);
+        mark_variables(node->orelse, used);
+        mark_variables(node->init, used);
+        mark_variables(node->step, used);
+        mark_variable(node->variable, used);
+        mark_variable(node->bound, used);
+        mark_variable(node->stride, used);
+    }
+}
+
+static void mark_condition_variables(IR_CONDITION *condition, char *used)
+{
+    if(condition == NULL) return;
+    mark_variables(condition->setup, used);
+    mark_variable(condition->left, used);
+    mark_variable(condition->right, used);
+    mark_condition_variables(condition->first, used);
+    mark_condition_variables(condition->second, used);
+}
+
+static void mark_variable(IR_OPERAND operand, char *used)
+{
+    if(operand.kind == IR_VARIABLE) used[operand.index] = TRUE;
+}
@@ -0,0 +1,724 @@
+#include <float.h>
+#include <limits.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "include/compile.h"
+#include "include/ir.h"
+#include "include/optimise_ir.h"
+#include "include/splio.h"
+#include "include/symbol_table.h"
+
+/* ------------- constant propagation --------------------------- */
+
+/* What is known about each variable and temporary at the current point of the program: the
+** constant it holds, or an IR_NONE operand when it may hold anything. Every variable starts
+** unknown, as C leaves it uninitialised.
+**
+** The IR is structured, so the analysis follows it rather than iterating over a flow graph.
+** The two arms of an IF are analysed from the same state and merged afterwards, keeping only
+** the arm that runs when the condition is a known constant. Before a loop, every variable it
+** assigns is forgotten, which is the state at the head of the loop on any iteration; one pass
+** over the body is then enough, whatever the nesting. Temporaries are assigned once and only
+** used after their assignment, so they are never merged or forgotten.
+**
+** A WHILE or FOR whose condition fails on entry is never entered, which only this pass can see,
+** since the state on entry is not kept. It is deleted here, leaving a FOR's init. */
+typedef struct {
+    COMPILE_CONTEXT *ctx;
+    IR_OPERAND *variables;      /* Indexed by symbol */
+    IR_OPERAND *temps;          /* Indexed by temporary number */
+    int symbol_count;
+} CONSTANT_STATE;
+
+static IR_OPERAND *copy_variables(CONSTANT_STATE *);
+static void forget_variables(CONSTANT_STATE *);
+static void merge_variables(CONSTANT_STATE *, IR_OPERAND *);
+static void forget_assigned(CONSTANT_STATE *, IR_NODE *);
+static void substitute(CONSTANT_STATE *, IR_OPERAND *);
+static void set_value(CONSTANT_STATE *, IR_OPERAND, IR_OPERAND);
+static int is_integer_constant(IR_OPERAND);
+static int same_constant(IR_OPERAND, IR_OPERAND);
+static IR_OPERAND convert_constant(CONSTANT_STATE *, IR_OPERAND, enum SymbolTypes);
+static int real_value(COMPILE_CONTEXT *, IR_OPERAND, double *);
+static IR_OPERAND real_constant(CONSTANT_STATE *, double);
+static void propagate_block(CONSTANT_STATE *, IR_NODE *);
+static void propagate_instruction(CONSTANT_STATE *, IR_INSTRUCTION *);
+static int propagate_condition(CONSTANT_STATE *, IR_CONDITION *);
+static int outcome_on_entry(CONSTANT_STATE *, IR_CONDITION *);
+static int combine_outcomes(enum IrConditionKind, int, int);
+static void remove_loop(IR_NODE *);
+static void propagate_nodes(CONSTANT_STATE *, IR_NODE *);
+
+static const IR_OPERAND UNKNOWN_VALUE = {IR_NONE, UNKNOWN_T, 0, 0};
+
+void propagate_constants(COMPILE_CONTEXT *ctx, IR_PROGRAM *program)
+{
+    CONSTANT_STATE state;
+    state.ctx = ctx;
+    state.symbol_count = ctx->symTabRec->in_use;
+    state.variables = (IR_OPERAND *)malloc(sizeof(IR_OPERAND) * (state.symbol_count + 1));
+    state.temps = (IR_OPERAND *)malloc(sizeof(IR_OPERAND) * (program->temp_count + 1));
+    if(state.variables != NULL && state.temps != NULL && summarise_ir_loops(program, state.symbol_count) == 0)
+    {
+        int i;
+        forget_variables(&state);
+        for(i = 0; i <= program->temp_count; i++) state.temps[i] = UNKNOWN_VALUE;
+        propagate_nodes(&state, program->body);
+    }
+    free(state.variables);
+    free(state.temps);
+}
+
+/* Returns NULL when out of memory, after forgetting everything so the analysis stays sound */
+static IR_OPERAND *copy_variables(CONSTANT_STATE *state)
+{
+    IR_OPERAND *copy = (IR_OPERAND *)malloc(sizeof(IR_OPERAND) * (state->symbol_count + 1));
+    if(copy == NULL)
+    {
+        forget_variables(state);
+        return NULL;
+    }
+    memcpy(copy, state->variables, sizeof(IR_OPERAND) * state->symbol_count);
+    return copy;
+}
+
+static void forget_variables(CONSTANT_STATE *state)
+{
+    int i;
+    for(i = 0; i < state->symbol_count; i++) state->variables[i] = UNKNOWN_VALUE;
+}
+
+/* Keep only the constants both states agree on */
+static void merge_variables(CONSTANT_STATE *state, IR_OPERAND *other)
+{
+    int i;
+    for(i = 0; i < state->symbol_count; i++)
+    {
+        if(!same_constant(state->variables[i], other[i])) state->variables[i] = UNKNOWN_VALUE;
+    }
+}
+
+static void forget_assigned(CONSTANT_STATE *state, IR_NODE *loop)
+{
+    int i;
+    for(i = 0; i < loop->assigned_count; i++) state->variables[loop->assigned[i]] = UNKNOWN_VALUE;
+}
+
+static void substitute(CONSTANT_STATE *state, IR_OPERAND *operand)
+{
+    IR_OPERAND value = UNKNOWN_VALUE;
+    if(operand->kind == IR_VARIABLE) value = state->variables[operand->index];
+    else if(operand->kind == IR_TEMP) value = state->temps[operand->index];
+    if(value.kind != IR_NONE) *operand = value;
+}
+
+/* Record what dest holds, given as a constant of the type it will be stored in */
+static void set_value(CONSTANT_STATE *state, IR_OPERAND dest, IR_OPERAND value)
+{
+    if(dest.kind == IR_VARIABLE) state->variables[dest.index] = value;
+    else if(dest.kind == IR_TEMP) state->temps[dest.index] = value;
+}
+
+static int is_integer_constant(IR_OPERAND operand)
+{
+    return operand.kind == IR_INT_CONST || operand.kind == IR_CHAR_CONST;
+}
+
+static int same_constant(IR_OPERAND left, IR_OPERAND right)
+{
+    return left.kind != IR_NONE && left.kind == right.kind && left.type == right.type
+        && left.index == right.index && left.value == right.value;
+}
+
+/* The constant a variable of the given type holds once value is stored in it */
+static IR_OPERAND convert_constant(CONSTANT_STATE *state, IR_OPERAND value, enum SymbolTypes type)
+{
+    switch(type)
+    {
+        case CHAR_T:
+            if(is_integer_constant(value)) return ir_char_constant((char)value.value);
+            break;
+        case INT_T:
+            if(is_integer_constant(value)) return ir_int_constant(value.value);
+            break;
+        case REAL_T:
+            if(value.kind == IR_REAL_CONST) return value;
+            if(is_integer_constant(value)) return real_constant(state, value.value);
+            break;
+        default:
+            break;
+    }
+    return UNKNOWN_VALUE;
+}
+
+/* The value of a constant as C would convert it to double */
+static int real_value(COMPILE_CONTEXT *ctx, IR_OPERAND operand, double *value)
+{
+    if(is_integer_constant(operand)) *value = operand.value;
+    else if(operand.kind == IR_REAL_CONST)
+    {
+        *value = ctx->symTabRec->array[operand.index]->value;
+        if(operand.value) *value = -*value;
+    }
+    else return FALSE;
+    return TRUE;
+}
+
+/* The literal for a value, or UNKNOWN_VALUE when it has none */
+static IR_OPERAND real_constant(CONSTANT_STATE *state, double value)
+{
+    int symbol = install_real_literal(state->ctx->symTabRec, fabs(value));
+    if(symbol < 0) return UNKNOWN_VALUE;
+    return ir_real_constant(symbol, signbit(value) != 0);
+}
+
+/* Integer arithmetic as the generated program would do it, wrapping on overflow. Division
+** by zero, and the one division which overflows, are left for run time. */
+int fold_integers(enum IrOp op, int left, int right, int *result)
+{
+    switch(op)
+    {
+        case IR_ADD:
+            *result = (int)((unsigned int)left + (unsigned int)right);
+            return TRUE;
+        case IR_SUB:
+            *result = (int)((unsigned int)left - (unsigned int)right);
+            return TRUE;
+        case IR_MUL:
+            *result = (int)((unsigned int)left * (unsigned int)right);
+            return TRUE;
+        case IR_DIV:
+            if(right == 0 || (right == -1 && left == INT_MIN)) return FALSE;
+            *result = left / right;
+            return TRUE;
+        case IR_SHL:
+            if(right < 0 || right >= 32) return FALSE;
+            *result = (int)((unsigned int)left << right);
+            return TRUE;
+        default:
+            return FALSE;
+    }
+}
+
+/* REAL arithmetic as the generated program would do it, rounding each operation to double.
+** That is only certain when this compiler's own arithmetic does too, so nothing is folded
+** where it may carry more precision. A result which is not finite has no literal, and is left
+** for run time. */
+int fold_reals(enum IrOp op, double left, double right, double *result)
+{
+#if FLT_EVAL_METHOD == 0
+    switch(op)
+    {
+        case IR_ADD:
+            *result = left + right;
+            break;
+        case IR_SUB:
+            *result = left - right;
+            break;
+        case IR_MUL:
+            *result = left * right;
+            break;
+        case IR_DIV:
+            *result = left / right;
+            break;
+        default:
+            return FALSE;
+    }
+    return isfinite(*result);
+#else
+    return FALSE;
+#endif
+}
+
+static void propagate_block(CONSTANT_STATE *state, IR_NODE *block)
+{
+    int i;
+    for(i = 0; i < block->count; i++) propagate_instruction(state, &block->code[i]);
+}
+
+static void propagate_instruction(CONSTANT_STATE *state, IR_INSTRUCTION *instruction)
+{
+    IR_OPERAND value = UNKNOWN_VALUE;
+    int folded;
+    double left;
+    double right;
+    double result;
+    switch(instruction->op)
+    {
+        case IR_WRITE:
+            substitute(state, &instruction->a);
+            break;
+        case IR_READ:
+            set_value(state, instruction->dest, UNKNOWN_VALUE);
+            break;
+        case IR_NEWLINE:
+        case IR_NOP:
+            break;
+        case IR_COPY:
+            substitute(state, &instruction->a);
+            if(ir_is_constant(instruction->a)) value = instruction->a;
+            set_value(state, instruction->dest, convert_constant(state, value, instruction->dest.type));
+            break;
+        default:
+            substitute(state, &instruction->a);
+            substitute(state, &instruction->b);
+            simplify_ir_instruction(state->ctx, instruction);
+            if(instruction->op == IR_COPY)
+            {
+                if(ir_is_constant(instruction->a)) value = instruction->a;
+            }
+            else if(instruction->type == INT_T && is_integer_constant(instruction->a) && is_integer_constant(instruction->b)
+                && fold_integers(instruction->op, instruction->a.value, instruction->b.value, &folded))
+            {
+                INFO("Optimisation: Folded %s of %d and %d to %d\n", IR_OP_NAMES[instruction->op],
+                    instruction->a.value, instruction->b.value, folded)
+                value = ir_int_constant(folded);
+                instruction->op = IR_COPY;
+                instruction->a = value;
+                instruction->b = UNKNOWN_VALUE;
+            }
+            else if(instruction->type == REAL_T && real_value(state->ctx, instruction->a, &left)
+                && real_value(state->ctx, instruction->b, &right) && fold_reals(instruction->op, left, right, &result)
+                && (value = real_constant(state, result)).kind != IR_NONE)
+            {
+                INFO("Optimisation: Folded %s of %.17g and %.17g to %.17g\n", IR_OP_NAMES[instruction->op],
+                    left, right, result)
+                instruction->op = IR_COPY;
+                instruction->type = instruction->dest.type;
+                instruction->a = value;
+                instruction->b = UNKNOWN_VALUE;
+            }
+            set_value(state, instruction->dest, convert_constant(state, value, instruction->dest.type));
+            break;
+    }
+}
+
+/* TRUE or FALSE when two constants are compared, otherwise -1 */
+int compare_ir_constants(COMPILE_CONTEXT *ctx, enum CompareSymType compare, IR_OPERAND left, IR_OPERAND right)
+{
+    double left_value;
+    double right_value;
+    /* Every int is exactly a double, so integers compare the same either way */
+    if(!real_value(ctx, left, &left_value) || !real_value(ctx, right, &right_value)) return -1;
+    switch(compare)
+    {
+        case SYM_EQ_TO:
+            return left_value == right_value;
+        case SYM_NEQ_TO:
+            return left_value != right_value;
+        case SYM_LESS_THAN:
+            return left_value < right_value;
+        case SYM_GREATER_THAN:
+            return left_value > right_value;
+        case SYM_LESS_THAN_EQ:
+            return left_value <= right_value;
+        case SYM_GREATER_THAN_EQ:
+            return left_value >= right_value;
+    }
+    return -1;
+}
+
+/* Returns TRUE or FALSE when the outcome of the condition is known, otherwise -1 */
+static int propagate_condition(CONSTANT_STATE *state, IR_CONDITION *condition)
+{
+    int first;
+    int second = -1;
+    if(condition->kind == IR_COMPARE)
+    {
+        propagate_nodes(state, condition->setup);
+        substitute(state, &condition->left);
+        substitute(state, &condition->right);
+        return compare_ir_constants(state->ctx, condition->compare, condition->left, condition->right);
+    }
+    first = propagate_condition(state, condition->first);
+    if(condition->kind != IR_NOT) second = propagate_condition(state, condition->second);
+    return combine_outcomes(condition->kind, first, second);
+}
+
+/* The outcome of a loop's condition on entry, worked out on copies of its setup and operands,
+** as the condition is then analysed from the state at the head of the loop */
+static int outcome_on_entry(CONSTANT_STATE *state, IR_CONDITION *condition)
+{
+    IR_NODE *setup;
+    IR_INSTRUCTION instruction;
+    IR_OPERAND left;
+    IR_OPERAND right;
+    int first;
+    int second = -1;
+    int i;
+    if(condition->kind == IR_COMPARE)
+    {
+        for(setup = condition->setup; setup != NULL; setup = setup->next)
+        {
+            if(setup->kind != IR_BLOCK) return -1;
+            for(i = 0; i < setup->count; i++)
+            {
+                instruction = setup->code[i];
+                propagate_instruction(state, &instruction);
+            }
+        }
+        left = condition->left;
+        right = condition->right;
+        substitute(state, &left);
+        substitute(state, &right);
+        return compare_ir_constants(state->ctx, condition->compare, left, right);
+    }
+    first = outcome_on_entry(state, condition->first);
+    if(condition->kind != IR_NOT) second = outcome_on_entry(state, condition->second);
+    return combine_outcomes(condition->kind, first, second);
+}
+
+/* The outcome of NOT, AND or OR from those of its parts, each TRUE, FALSE or -1 when unknown.
+** Comparing has no effect, so one known part can decide AND or OR alone. */
+static int combine_outcomes(enum IrConditionKind kind, int first, int second)
+{
+    switch(kind)
+    {
+        case IR_NOT:
+            return first < 0 ? -1 : !first;
+        case IR_AND:
+            if(first == FALSE || second == FALSE) return FALSE;
+            return first == TRUE && second == TRUE ? TRUE : -1;
+        case IR_OR:
+            if(first == TRUE || second == TRUE) return TRUE;
+            return first == FALSE && second == FALSE ? FALSE : -1;
+        default:
+            return -1;
+    }
+}
+
+/* The setup of the condition only computes what it compares, so a FOR's init is all that is
+** left of a loop which is never entered */
+static void remove_loop(IR_NODE *loop)
+{
+    IR_NODE *init = loop->init;
+    INFO("Optimisation: Removed a %s loop which is never entered\n", loop->kind == IR_WHILE ? "WHILE" : "FOR")
+    loop->kind = IR_BLOCK;
+    loop->code = init != NULL ? init->code : NULL;
+    loop->count = init != NULL ? init->count : 0;
+    loop->capacity = init != NULL ? init->capacity : 0;
+    loop->condition = NULL;
+    loop->body = NULL;
+    loop->init = NULL;
+    loop->step = NULL;
+}
+
+static void propagate_nodes(CONSTANT_STATE *state, IR_NODE *node)
+{
+    IR_OPERAND *before;
+    IR_OPERAND *head;
+    int outcome;
+    for(; node != NULL; node = node->next)
+    {
+        switch(node->kind)
+        {
+            case IR_BLOCK:
+                propagate_block(state, node);
+                break;
+            case IR_IF:
+                outcome = propagate_condition(state, node->condition);
+                before = copy_variables(state);
+                propagate_nodes(state, node->body);
+                if(before == NULL)
+                {
+                    forget_variables(state);
+                    break;
+                }
+                /* Swap the state after THEN for the one before it, and run ELSE from that */
+                {
+                    IR_OPERAND *after_then = state->variables;
+                    state->variables = before;
+                    propagate_nodes(state, node->orelse);
+                    /* A loop in ELSE leaves the state in a new array, so before may be gone */
+                    if(outcome == TRUE)
+                    {
+                        free(state->variables);
+                        state->variables = after_then;
+                    }
+                    else
+                    {
+                        if(outcome < 0) merge_variables(state, after_then);
+                        free(after_then);
+                    }
+                }
+                break;
+            case IR_WHILE:
+                if(outcome_on_entry(state, node->condition) == FALSE)
+                {
+                    remove_loop(node);
+                    break;
+                }
+                forget_assigned(state, node);
+                propagate_condition(state, node->condition);
+                head = copy_variables(state);
+                propagate_nodes(state, node->body);
+                if(head == NULL)
+                {
+                    forget_variables(state);
+                    break;
+                }
+                /* The loop is left from its head */
+                free(state->variables);
+                state->variables = head;
+                break;
+            case IR_DO:
+                forget_assigned(state, node);
+                propagate_nodes(state, node->body);
+                propagate_condition(state, node->condition);
+                break;
+            case IR_FOR:
+                propagate_nodes(state, node->init);
+                /* The init is one block, as lowering makes it */
+                if((node->init == NULL || (node->init->kind == IR_BLOCK && node->init->next == NULL))
+                    && outcome_on_entry(state, node->condition) == FALSE)
+                {
+                    remove_loop(node);
+                    break;
+                }
+                forget_assigned(state, node);
+                propagate_condition(state, node->condition);
+                head = copy_variables(state);
+                propagate_nodes(state, node->body);
+                propagate_nodes(state, node->step);
+                if(head == NULL)
+                {
+                    forget_variables(state);
+                    break;
+                }
+                free(state->variables);
+                state->variables = head;
+                break;
+        }
+    }
+}
+
+/* ------------- dead store elimination --------------------------- */
+
+/* A backward liveness analysis over the variables, again following the structure of the IR.
+** A loop may use anything it reads on a later iteration, so everything its summary says it
+** reads is taken to be live throughout. An assignment to a variable which is not live is deleted.
+** Temporaries are assigned once, so their uses are simply counted, and an assignment to one
+** which is no longer used is deleted too. Uses always follow the assignment, so when the
+** program is walked backwards a temporary has lost all the uses it will lose before its
+** assignment is reached. Assignments are all that is deleted; READ still consumes input
+** even when what it reads is never used. */
+typedef unsigned long LIVE_WORD;
+
+#define LIVE_WORD_BITS (8*sizeof(LIVE_WORD))
+
+typedef struct {
+    int words;                  /* The size of a set of variables */
+    int *temp_uses;
+    int failed;                 /* Out of memory, so nothing more is deleted */
+} LIVENESS;
+
+static LIVE_WORD *new_live_set(LIVENESS *, LIVE_WORD *);
+static void use_operand(LIVE_WORD *, IR_OPERAND);
+static void count_temp_uses(LIVENESS *, IR_NODE *);
+static void count_condition_temp_uses(LIVENESS *, IR_CONDITION *);
+static void release_operand(LIVENESS *, IR_OPERAND);
+static void eliminate_in_block(LIVENESS *, LIVE_WORD *, IR_NODE *);
+static void eliminate_in_condition(LIVENESS *, LIVE_WORD *, IR_CONDITION *);
+static void eliminate_in_nodes(LIVENESS *, LIVE_WORD *, IR_NODE *);
+static void eliminate_in_loop(LIVENESS *, LIVE_WORD *, IR_NODE *);
+
+#define IS_LIVE(set, index) ((set)[(index) / LIVE_WORD_BITS] >> ((index) % LIVE_WORD_BITS) & 1)
+#define SET_LIVE(set, index) ((set)[(index) / LIVE_WORD_BITS] |= (LIVE_WORD)1 << ((index) % LIVE_WORD_BITS))
+#define SET_DEAD(set, index) ((set)[(index) / LIVE_WORD_BITS] &= ~((LIVE_WORD)1 << ((index) % LIVE_WORD_BITS)))
+
+void eliminate_dead_stores(COMPILE_CONTEXT *ctx, IR_PROGRAM *program)
+{
+    LIVENESS liveness;
+    LIVE_WORD *live;
+    liveness.words = (int)((ctx->symTabRec->in_use + LIVE_WORD_BITS) / LIVE_WORD_BITS);
+    liveness.failed = FALSE;
+    liveness.temp_uses = (int *)calloc(program->temp_count + 1, sizeof(int));
+    live = new_live_set(&liveness, NULL);
+    /* The summaries are redone, as propagating constants will have removed uses */
+    if(liveness.temp_uses != NULL && live != NULL && summarise_ir_loops(program, ctx->symTabRec->in_use) == 0)
+    {
+        /* Nothing is live once the program returns */
+        count_temp_uses(&liveness, program->body);
+        eliminate_in_nodes(&liveness, live, program->body);
+    }
+    free(live);
+    free(liveness.temp_uses);
+}
+
+/* A copy of from, or an empty set */
+static LIVE_WORD *new_live_set(LIVENESS *liveness, LIVE_WORD *from)
+{
+    LIVE_WORD *set = (LIVE_WORD *)calloc(liveness->words, sizeof(LIVE_WORD));
+    if(set == NULL) liveness->failed = TRUE;
+    else if(from != NULL) memcpy(set, from, sizeof(LIVE_WORD) * liveness->words);
+    return set;
+}
+
+static void use_operand(LIVE_WORD *live, IR_OPERAND operand)
+{
+    if(operand.kind == IR_VARIABLE) SET_LIVE(live, operand.index);
+}
+
+static void count_temp_uses(LIVENESS *liveness, IR_NODE *node)
+{
+    int i;
+    for(; node != NULL; node = node->next)
+    {
+        for(i = 0; i < node->count; i++)
+        {
+            if(node->code[i].a.kind == IR_TEMP) liveness->temp_uses[node->code[i].a.index]++;
+            if(node->code[i].b.kind == IR_TEMP) liveness->temp_uses[node->code[i].b.index]++;
+        }
+        count_condition_temp_uses(liveness, node->condition);
+        count_temp_uses(liveness, node->body);
+        count_temp_uses(liveness, node->orelse);
+        count_temp_uses(liveness, node->init);
+        count_temp_uses(liveness, node->step);
+    }
+}
+
+static void count_condition_temp_uses(LIVENESS *liveness, IR_CONDITION *condition)
+{
+    if(condition == NULL) return;
+    count_temp_uses(liveness, condition->setup);
+    if(condition->left.kind == IR_TEMP) liveness->temp_uses[condition->left.index]++;
+    if(condition->right.kind == IR_TEMP) liveness->temp_uses[condition->right.index]++;
+    count_condition_temp_uses(liveness, condition->first);
+    count_condition_temp_uses(liveness, condition->second);
+}
+
+static void release_operand(LIVENESS *liveness, IR_OPERAND operand)
+{
+    if(operand.kind == IR_TEMP) liveness->temp_uses[operand.index]--;
+}
+
+static void eliminate_in_block(LIVENESS *liveness, LIVE_WORD *live, IR_NODE *block)
+{
+    int removed = FALSE;
+    int i;
+    for(i = block->count - 1; i >= 0; i--)
+    {
+        IR_INSTRUCTION *instruction = &block->code[i];
+        IR_OPERAND dest = instruction->dest;
+        switch(instruction->op)
+        {
+            case IR_WRITE:
+                use_operand(live, instruction->a);
+                break;
+            case IR_READ:
+                /* A READ at end of input, or that fails to match, leaves the variable as it
+                ** was, so it may not define it. It is left live: what was stored before is
+                ** still wanted. */
+            case IR_NEWLINE:
+            case IR_NOP:
+                break;
+            default:
+                if(!liveness->failed && ((dest.kind == IR_VARIABLE && !IS_LIVE(live, dest.index))
+                    || (dest.kind == IR_TEMP && liveness->temp_uses[dest.index] == 0)))
+                {
+                    release_operand(liveness, instruction->a);
+                    release_operand(liveness, instruction->b);
+                    instruction->op = IR_NOP;
+                    removed = TRUE;
+                    break;
+                }
+                if(dest.kind == IR_VARIABLE) SET_DEAD(live, dest.index);
+                use_operand(live, instruction->a);
+                use_operand(live, instruction->b);
+                break;
+        }
+    }
+    if(removed) compact_ir_block(block);
+}
+
+static void eliminate_in_condition(LIVENESS *liveness, LIVE_WORD *live, IR_CONDITION *condition)
+{
+    switch(condition->kind)
+    {
+        case IR_COMPARE:
+            use_operand(live, condition->left);
+            use_operand(live, condition->right);
+            eliminate_in_nodes(liveness, live, condition->setup);
+            break;
+        case IR_NOT:
+            eliminate_in_condition(liveness, live, condition->first);
+            break;
+        case IR_AND:
+        case IR_OR:
+            eliminate_in_condition(liveness, live, condition->second);
+            eliminate_in_condition(liveness, live, condition->first);
+            break;
+    }
+}
+
+/* Sequences are singly linked, so the nodes are gathered up to be visited last to first */
+static void eliminate_in_nodes(LIVENESS *liveness, LIVE_WORD *live, IR_NODE *first)
+{
+    IR_NODE *local_nodes[16];
+    IR_NODE **nodes = local_nodes;
+    IR_NODE *node;
+    int count = 0;
+    for(node = first; node != NULL; node = node->next) count++;
+    if(count > 16)
+    {
+        nodes = (IR_NODE **)malloc(sizeof(IR_NODE *) * count);
+        if(nodes == NULL)
+        {
+            liveness->failed = TRUE;
+            return;
+        }
+    }
+    count = 0;
+    for(node = first; node != NULL; node = node->next) nodes[count++] = node;
+
+    while(count > 0)
+    {
+        node = nodes[--count];
+        switch(node->kind)
+        {
+            case IR_BLOCK:
+                eliminate_in_block(liveness, live, node);
+                break;
+            case IR_IF:
+            {
+                LIVE_WORD *after_then = new_live_set(liveness, live);
+                int i;
+                if(after_then == NULL) break;
+                eliminate_in_nodes(liveness, after_then, node->body);
+                eliminate_in_nodes(liveness, live, node->orelse);
+                for(i = 0; i < liveness->words; i++) live[i] |= after_then[i];
+                free(after_then);
+                eliminate_in_condition(liveness, live, node->condition);
+                break;
+            }
+            case IR_WHILE:
+            case IR_DO:
+            case IR_FOR:
+                eliminate_in_loop(liveness, live, node);
+                break;
+        }
+    }
+    if(nodes != local_nodes) free(nodes);
+}
+
+/* live becomes the set live at the head of the loop: everything live after it, or read
+** anywhere in it. That is also what is live after the body, the step and the condition. */
+static void eliminate_in_loop(LIVENESS *liveness, LIVE_WORD *live, IR_NODE *loop)
+{
+    LIVE_WORD *part;
+    int i;
+    for(i = 0; i < loop->used_count; i++) SET_LIVE(live, loop->used[i]);
+
+    part = new_live_set(liveness, live);
+    if(part == NULL) return;
+    eliminate_in_nodes(liveness, part, loop->step);
+    memcpy(part, live, sizeof(LIVE_WORD) * liveness->words);
+    eliminate_in_nodes(liveness, part, loop->body);
+    memcpy(part, live, sizeof(LIVE_WORD) * liveness->words);
+    eliminate_in_condition(liveness, part, loop->condition);
+    free(part);
+    /* Only a FOR has anything before its head */
+    eliminate_in_nodes(liveness, live, loop->init);
+}
@@ -0,0 +1,434 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "include/compile.h"
+#include "include/compile_stats.h"
+#include "include/ir.h"
+#include "include/optimise_ir.h"
+#include "include/splio.h"
+#include "include/symbol_table.h"
+
+/* ------------- loop-invariant code motion --------------------------- */
+
+/* Arithmetic whose operands cannot change while a loop runs is moved in front of the loop, into
+** a preheader: the block before it, or a new one. Loops are visited innermost first, so what is
+** hoisted out of an inner loop lands in the body of the one around it and can be hoisted again.
+** Each loop then only needs to look at its own level of code; what the loops inside it assign
+** and read is taken from their summaries.
+**
+** An operand is invariant when it is a constant, a variable the loop never assigns, or a
+** temporary assigned outside the loop or already hoisted. Hoisted code runs even when the loop
+** runs no times, or when the IF it was in would not have been taken, so integer division is
+** only hoisted when its divisor is a constant which cannot trap.
+**
+** Assigning a temporary has no effect beyond the loop, so these are moved whole. Assigning a
+** variable is only moved whole when the loop is certain to run it before anything reads the
+** variable and nothing else in the loop assigns it: that is, at the top level of a DO body.
+** Elsewhere the arithmetic is moved into a new temporary and the variable copied from that.
+**
+** Once a FOR whose direction is only known at run time has had its BY and TO hoisted, and its
+** body does not assign the loop variable, how many times it runs is known when it starts. It
+** is then counted (see IR_FOR), so the direction is no longer tested on every iteration. */
+typedef struct {
+    COMPILE_CONTEXT *ctx;
+    IR_PROGRAM *program;
+    int *assigned_stamp;        /* The loop number of the loop being hoisted from, for each symbol it assigns */
+    int *store_stamp;           /* Marks store_count as belonging to the loop being hoisted from */
+    int *store_count;           /* Assignments to each symbol in the loop */
+    int *used_stamp;            /* Marks the symbols read so far in the loop */
+    int *temp_stamp;            /* Marks the temporaries assigned in the loop and not hoisted */
+    int temp_capacity;
+    int loops;                  /* Loops numbered so far; the numbers stamp the arrays above */
+    int failed;                 /* Out of memory, so nothing more is hoisted */
+} HOIST_STATE;
+
+/* The loop being hoisted from, and where its hoisted code goes */
+typedef struct {
+    IR_NODE *loop;
+    int number;
+    IR_NODE **link;             /* The link to the loop in the list holding it */
+    IR_NODE *previous;          /* The node before it in that list, if any */
+    IR_NODE *preheader;
+    int hoisted;
+} HOIST_LOOP;
+
+static void hoist_from_nodes(HOIST_STATE *, IR_NODE **);
+static void hoist_from_loop(HOIST_STATE *, IR_NODE *, int, IR_NODE **, IR_NODE *);
+static int grow_temp_stamps(HOIST_STATE *);
+static void count_stores(HOIST_STATE *, HOIST_LOOP *, IR_NODE *);
+static void count_condition_stores(HOIST_STATE *, HOIST_LOOP *, IR_CONDITION *);
+static void count_store(HOIST_STATE *, HOIST_LOOP *, int);
+static int is_invariant(HOIST_STATE *, HOIST_LOOP *, IR_OPERAND);
+static int can_hoist(HOIST_STATE *, HOIST_LOOP *, IR_INSTRUCTION *);
+static IR_INSTRUCTION *add_to_preheader(HOIST_STATE *, HOIST_LOOP *, IR_INSTRUCTION *);
+static void hoist_nodes(HOIST_STATE *, HOIST_LOOP *, IR_NODE *, int);
+static void hoist_block(HOIST_STATE *, HOIST_LOOP *, IR_NODE *, int);
+static void hoist_condition(HOIST_STATE *, HOIST_LOOP *, IR_CONDITION *);
+static void mark_used(HOIST_STATE *, HOIST_LOOP *, IR_OPERAND);
+static void count_for_loop(HOIST_STATE *, HOIST_LOOP *);
+static int is_plain_compare(IR_CONDITION *, enum CompareSymType, IR_OPERAND);
+static int same_operand(IR_OPERAND, IR_OPERAND);
+
+static const IR_OPERAND NO_OPERAND = {IR_NONE, UNKNOWN_T, 0, 0};
+static const char *HOIST_LOOP_NAMES[] = {"", "", "WHILE", "DO", "FOR"};
+
+void hoist_loop_invariants(COMPILE_CONTEXT *ctx, IR_PROGRAM *program)
+{
+    HOIST_STATE state;
+    int symbols = ctx->symTabRec->in_use + 1;
+    memset(&state, 0, sizeof(HOIST_STATE));
+    state.ctx = ctx;
+    state.program = program;
+    state.assigned_stamp = (int *)calloc(symbols, sizeof(int));
+    state.store_stamp = (int *)calloc(symbols, sizeof(int));
+    state.store_count = (int *)calloc(symbols, sizeof(int));
+    state.used_stamp = (int *)calloc(symbols, sizeof(int));
+    /* The summaries are redone, as the earlier passes will have deleted code */
+    if(state.assigned_stamp != NULL && state.store_stamp != NULL && state.store_count != NULL
+        && state.used_stamp != NULL && summarise_ir_loops(program, ctx->symTabRec->in_use) == 0)
+    {
+        hoist_from_nodes(&state, &program->body);
+    }
+    free(state.assigned_stamp);
+    free(state.store_stamp);
+    free(state.store_count);
+    free(state.used_stamp);
+    free(state.temp_stamp);
+}
+
+/* Visit the loops innermost first. They are numbered in the order they appear, for the report
+** --stats gives of what was hoisted out of each. */
+static void hoist_from_nodes(HOIST_STATE *state, IR_NODE **link)
+{
+    IR_NODE *previous = NULL;
+    for(; *link != NULL && !state->failed; link = &(*link)->next)
+    {
+        IR_NODE *node = *link;
+        switch(node->kind)
+        {
+            case IR_BLOCK:
+                break;
+            case IR_IF:
+                hoist_from_nodes(state, &node->body);
+                hoist_from_nodes(state, &node->orelse);
+                break;
+            case IR_WHILE:
+            case IR_DO:
+            case IR_FOR:
+            {
+                int number = ++state->loops;
+                hoist_from_nodes(state, &node->body);
+                hoist_from_loop(state, node, number, link, previous);
+                /* A new preheader now holds the link to the loop */
+                if(*link != node) link = &(*link)->next;
+                break;
+            }
+        }
+        previous = node;
+    }
+}
+
+static void hoist_from_loop(HOIST_STATE *state, IR_NODE *node, int number, IR_NODE **link, IR_NODE *previous)
+{
+    HOIST_LOOP loop;
+    int i;
+    loop.loop = node;
+    loop.number = number;
+    loop.link = link;
+    loop.previous = previous;
+    loop.preheader = NULL;
+    loop.hoisted = 0;
+    if(grow_temp_stamps(state) < 0) return;
+    for(i = 0; i < node->assigned_count; i++) state->assigned_stamp[node->assigned[i]] = loop.number;
+    count_condition_stores(state, &loop, node->condition);
+    count_stores(state, &loop, node->body);
+    count_stores(state, &loop, node->step);
+    /* In program order, so hoisted code keeps its order and uses are seen before later stores */
+    if(node->kind == IR_DO)
+    {
+        hoist_nodes(state, &loop, node->body, TRUE);
+        hoist_condition(state, &loop, node->condition);
+    }
+    else
+    {
+        hoist_condition(state, &loop, node->condition);
+        hoist_nodes(state, &loop, node->body, FALSE);
+        hoist_nodes(state, &loop, node->step, FALSE);
+        if(node->kind == IR_FOR && !state->failed) count_for_loop(state, &loop);
+    }
+    if(loop.hoisted > 0)
+    {
+        count_hoisted(state->ctx, HOIST_LOOP_NAMES[node->kind], loop.number, loop.hoisted);
+        INFO("Optimisation: Hoisted %d instruction%s out of %s loop %d\n", loop.hoisted, loop.hoisted == 1 ? "" : "s",
+            HOIST_LOOP_NAMES[node->kind], loop.number)
+    }
+}
+
+/* Hoisting creates temporaries, so the stamps are grown to cover them before each loop */
+static int grow_temp_stamps(HOIST_STATE *state)
+{
+    int needed = state->program->temp_count + 1;
+    int *grown;
+    if(needed <= state->temp_capacity) return 0;
+    grown = (int *)realloc(state->temp_stamp, sizeof(int) * needed);
+    if(grown == NULL)
+    {
+        state->failed = TRUE;
+        return -1;
+    }
+    memset(grown + state->temp_capacity, 0, sizeof(int) * (needed - state->temp_capacity));
+    state->temp_stamp = grown;
+    state->temp_capacity = needed;
+    return 0;
+}
+
+/* Count the assignments to each variable in the loop, and mark the temporaries it assigns */
+static void count_stores(HOIST_STATE *state, HOIST_LOOP *loop, IR_NODE *node)
+{
+    int i;
+    for(; node != NULL; node = node->next)
+    {
+        switch(node->kind)
+        {
+            case IR_BLOCK:
+                for(i = 0; i < node->count; i++)
+                {
+                    IR_OPERAND dest = node->code[i].dest;
+                    if(dest.kind == IR_VARIABLE) count_store(state, loop, dest.index);
+                    else if(dest.kind == IR_TEMP) state->temp_stamp[dest.index] = loop->number;
+                }
+                break;
+            case IR_IF:
+                count_condition_stores(state, loop, node->condition);
+                count_stores(state, loop, node->body);
+                count_stores(state, loop, node->orelse);
+                break;
+            default:
+                /* An inner loop's own code has been dealt with; its temporaries are its own */
+                count_stores(state, loop, node->init);
+                for(i = 0; i < node->assigned_count; i++) count_store(state, loop, node->assigned[i]);
+                break;
+        }
+    }
+}
+
+static void count_condition_stores(HOIST_STATE *state, HOIST_LOOP *loop, IR_CONDITION *condition)
+{
+    if(condition == NULL) return;
+    count_stores(state, loop, condition->setup);
+    count_condition_stores(state, loop, condition->first);
+    count_condition_stores(state, loop, condition->second);
+}
+
+static void count_store(HOIST_STATE *state, HOIST_LOOP *loop, int symbol)
+{
+    if(state->store_stamp[symbol] != loop->number)
+    {
+        state->store_stamp[symbol] = loop->number;
+        state->store_count[symbol] = 0;
+    }
+    state->store_count[symbol]++;
+}
+
+static int is_invariant(HOIST_STATE *state, HOIST_LOOP *loop, IR_OPERAND operand)
+{
+    switch(operand.kind)
+    {
+        case IR_VARIABLE:
+            return state->assigned_stamp[operand.index] != loop->number;
+        case IR_TEMP:
+            return state->temp_stamp[operand.index] != loop->number;
+        default:
+            return TRUE;
+    }
+}
+
+static int can_hoist(HOIST_STATE *state, HOIST_LOOP *loop, IR_INSTRUCTION *instruction)
+{
+    switch(instruction->op)
+    {
+        case IR_DIV:
+            if(instruction->type == INT_T && ((instruction->b.kind != IR_INT_CONST && instruction->b.kind != IR_CHAR_CONST)
+                || instruction->b.value == 0 || instruction->b.value == -1)) return FALSE;
+            /* Fall through */
+        case IR_ADD:
+        case IR_SUB:
+        case IR_MUL:
+        case IR_SHL:
+            if(!is_invariant(state, loop, instruction->b)) return FALSE;
+            /* Fall through */
+        case IR_COPY:
+            return is_invariant(state, loop, instruction->a)
+                && (instruction->dest.kind == IR_TEMP || instruction->dest.kind == IR_VARIABLE);
+        default:
+            return FALSE;
+    }
+}
+
+/* Returns the copy of the instruction in the preheader, or NULL when out of memory */
+static IR_INSTRUCTION *add_to_preheader(HOIST_STATE *state, HOIST_LOOP *loop, IR_INSTRUCTION *instruction)
+{
+    IR_INSTRUCTION *copy;
+    if(loop->preheader == NULL)
+    {
+        if(loop->previous != NULL && loop->previous->kind == IR_BLOCK) loop->preheader = loop->previous;
+        else
+        {
+            loop->preheader = new_ir_node(state->program, IR_BLOCK);
+            if(loop->preheader == NULL)
+            {
+                state->failed = TRUE;
+                return NULL;
+            }
+            loop->preheader->next = loop->loop;
+            *loop->link = loop->preheader;
+        }
+    }
+    copy = append_ir_instruction(state->program, loop->preheader, instruction->op, instruction->type);
+    if(copy == NULL)
+    {
+        state->failed = TRUE;
+        return NULL;
+    }
+    *copy = *instruction;
+    loop->hoisted++;
+    return copy;
+}
+
+/* certain is TRUE when the code runs on every iteration, and before anything else assigns */
+static void hoist_nodes(HOIST_STATE *state, HOIST_LOOP *loop, IR_NODE *node, int certain)
+{
+    int i;
+    for(; node != NULL && !state->failed; node = node->next)
+    {
+        switch(node->kind)
+        {
+            case IR_BLOCK:
+                hoist_block(state, loop, node, certain);
+                break;
+            case IR_IF:
+                hoist_condition(state, loop, node->condition);
+                hoist_nodes(state, loop, node->body, FALSE);
+                hoist_nodes(state, loop, node->orelse, FALSE);
+                break;
+            default:
+                hoist_nodes(state, loop, node->init, FALSE);
+                for(i = 0; i < node->used_count; i++) state->used_stamp[node->used[i]] = loop->number;
+                break;
+        }
+    }
+}
+
+static void hoist_block(HOIST_STATE *state, HOIST_LOOP *loop, IR_NODE *block, int certain)
+{
+    int hoisted = FALSE;
+    int i;
+    for(i = 0; i < block->count && !state->failed; i++)
+    {
+        IR_INSTRUCTION *instruction = &block->code[i];
+        mark_used(state, loop, instruction->a);
+        mark_used(state, loop, instruction->b);
+        if(!can_hoist(state, loop, instruction)) continue;
+        if(instruction->dest.kind == IR_TEMP)
+        {
+            if(add_to_preheader(state, loop, instruction) == NULL) break;
+            state->temp_stamp[instruction->dest.index] = 0;
+            instruction->op = IR_NOP;
+            hoisted = TRUE;
+        }
+        else if(certain && state->store_count[instruction->dest.index] == 1
+            && state->used_stamp[instruction->dest.index] != loop->number)
+        {
+            if(add_to_preheader(state, loop, instruction) == NULL) break;
+            instruction->op = IR_NOP;
+            hoisted = TRUE;
+        }
+        else if(instruction->op != IR_COPY)
+        {
+            IR_OPERAND temp = new_ir_temp(state->program, instruction->type);
+            IR_INSTRUCTION *copy;
+            if(temp.kind == IR_NONE || (copy = add_to_preheader(state, loop, instruction)) == NULL)
+            {
+                state->failed = TRUE;
+                break;
+            }
+            copy->dest = temp;
+            instruction->op = IR_COPY;
+            instruction->type = instruction->dest.type;
+            instruction->a = temp;
+            instruction->b = NO_OPERAND;
+        }
+    }
+    if(hoisted) compact_ir_block(block);
+}
+
+static void hoist_condition(HOIST_STATE *state, HOIST_LOOP *loop, IR_CONDITION *condition)
+{
+    if(condition == NULL) return;
+    hoist_nodes(state, loop, condition->setup, FALSE);
+    mark_used(state, loop, condition->left);
+    mark_used(state, loop, condition->right);
+    hoist_condition(state, loop, condition->first);
+    hoist_condition(state, loop, condition->second);
+}
+
+static void mark_used(HOIST_STATE *state, HOIST_LOOP *loop, IR_OPERAND operand)
+{
+    if(operand.kind == IR_VARIABLE) state->used_stamp[operand.index] = loop->number;
+}
+
+/* The condition lower_for gives a FOR with a run-time direction is
+** (sign > 0 && var <= bound) || (!(sign > 0) && var >= bound), and its step var = var + stride,
+** where sign and stride are both the BY value. With no setup left in the condition, and only
+** that one instruction in the step, both have been hoisted and so are fixed. */
+static void count_for_loop(HOIST_STATE *state, HOIST_LOOP *loop)
+{
+    IR_NODE *node = loop->loop;
+    IR_OPERAND variable = node->variable;
+    IR_CONDITION *condition = node->condition;
+    IR_INSTRUCTION *step;
+    IR_OPERAND sign;
+    IR_OPERAND bound;
+    if(variable.type != INT_T || condition->kind != IR_OR || condition->first->kind != IR_AND
+        || condition->second->kind != IR_AND || condition->second->first->kind != IR_NOT) return;
+    sign = condition->first->first->left;
+    bound = condition->first->second->right;
+    if(!is_plain_compare(condition->first->first, SYM_GREATER_THAN, sign)
+        || !is_plain_compare(condition->first->second, SYM_LESS_THAN_EQ, variable)
+        || !is_plain_compare(condition->second->first->first, SYM_GREATER_THAN, sign)
+        || !is_plain_compare(condition->second->second, SYM_GREATER_THAN_EQ, variable)
+        || !same_operand(condition->second->second->right, bound)
+        || condition->first->first->right.kind != IR_INT_CONST || condition->first->first->right.value != 0
+        || condition->second->first->first->right.kind != IR_INT_CONST || condition->second->first->first->right.value != 0)
+        return;
+    if(node->step == NULL || node->step->next != NULL || node->step->count != 1) return;
+    step = &node->step->code[0];
+    if(step->op != IR_ADD || step->type != INT_T || !same_operand(step->dest, variable) || !same_operand(step->a, variable))
+        return;
+    /* The step is the only assignment to the variable */
+    if(state->store_stamp[variable.index] != loop->number || state->store_count[variable.index] != 1) return;
+    if(bound.type == REAL_T || sign.type == REAL_T || !is_invariant(state, loop, sign)
+        || !is_invariant(state, loop, bound) || !is_invariant(state, loop, step->b)) return;
+    /* Both are the BY value, so the step can share the sign's, leaving its own to be deleted */
+    step->b = sign;
+    node->counter = ++state->program->counter_count;
+    node->bound = bound;
+    node->stride = sign;
+    INFO("Optimisation: Counted FOR loop %d\n", loop->number)
+}
+
+static int is_plain_compare(IR_CONDITION *condition, enum CompareSymType compare, IR_OPERAND left)
+{
+    IR_NODE *setup;
+    if(condition->kind != IR_COMPARE || condition->compare != compare || !same_operand(condition->left, left)) return FALSE;
+    for(setup = condition->setup; setup != NULL; setup = setup->next)
+    {
+        if(setup->count > 0) return FALSE;
+    }
+    return TRUE;
+}
+
+static int same_operand(IR_OPERAND left, IR_OPERAND right)
+{
+    return left.kind == right.kind && left.index == right.index && left.value == right.value;
+}
@@ -0,0 +1,224 @@
+#include <limits.h>
+
+#include "include/compile.h"
+#include "include/ir.h"
+#include "include/optimise_ir.h"
+#include "include/splio.h"
+#include "include/symbol_table.h"
+
+/* ------------- algebraic simplification --------------------------- */
+
+/* Rewrite rules for arithmetic with one constant operand, or with the same operand on both
+** sides, tried in order until none applies. Constant propagation runs them on each instruction
+** once it has put the constants it knows in place, so they see more than the literals written.
+**
+** Each rule names the arithmetic it holds in. The integer rules hold for every value, as the
+** generated program wraps. A REAL rule must give the same double for every input, infinities,
+** NaN and negative zero included, so x * 0 is only simplified in integer arithmetic, and
+** x + 0 in REAL only when x is an integer, since -0.0 + 0 is +0.0. Integer division by a power
+** of two is left alone: it rounds towards zero, so it is not a shift, and the C compiler
+** already divides by a constant well. */
+
+enum SimplifyMatch {MATCH_ZERO, MATCH_ONE, MATCH_MINUS_ONE, MATCH_TWO, MATCH_POWER_OF_TWO, MATCH_NEGATED, MATCH_SAME};
+
+enum SimplifyResult {RESULT_OTHER, RESULT_ZERO, RESULT_NEGATE, RESULT_SHIFT, RESULT_DOUBLE, RESULT_ADD_NEGATION};
+
+/* The arithmetic a rule holds in */
+#define RULE_INT                1
+#define RULE_REAL               2
+#define RULE_REAL_OF_INTEGER    4   /* REAL arithmetic on an operand which is not REAL */
+
+/* Where the constant must be */
+#define RULE_RIGHT              1
+#define RULE_LEFT               2
+#define RULE_EITHER             (RULE_RIGHT | RULE_LEFT)
+
+typedef struct {
+    enum IrOp op;
+    int side;                   /* Unused by MATCH_SAME */
+    enum SimplifyMatch match;
+    int types;
+    enum SimplifyResult result;
+    const char *description;
+} SIMPLIFY_RULE;
+
+static const SIMPLIFY_RULE SIMPLIFY_RULES[] = {
+    {IR_ADD, RULE_EITHER, MATCH_ZERO, RULE_INT | RULE_REAL_OF_INTEGER, RESULT_OTHER, "x + 0 to x"},
+    {IR_SUB, RULE_RIGHT, MATCH_ZERO, RULE_INT | RULE_REAL, RESULT_OTHER, "x - 0 to x"},
+    {IR_SUB, RULE_RIGHT, MATCH_NEGATED, RULE_INT | RULE_REAL, RESULT_ADD_NEGATION, "x - -c to x + c"},
+    {IR_SUB, 0, MATCH_SAME, RULE_INT | RULE_REAL_OF_INTEGER, RESULT_ZERO, "x - x to 0"},
+    {IR_MUL, RULE_EITHER, MATCH_ONE, RULE_INT | RULE_REAL, RESULT_OTHER, "x * 1 to x"},
+    {IR_MUL, RULE_EITHER, MATCH_ZERO, RULE_INT, RESULT_ZERO, "x * 0 to 0"},
+    {IR_MUL, RULE_EITHER, MATCH_MINUS_ONE, RULE_INT, RESULT_NEGATE, "x * -1 to 0 - x"},
+    {IR_MUL, RULE_EITHER, MATCH_POWER_OF_TWO, RULE_INT, RESULT_SHIFT, "x * 2^k to x << k"},
+    {IR_MUL, RULE_EITHER, MATCH_TWO, RULE_REAL, RESULT_DOUBLE, "x * 2 to x + x"},
+    {IR_DIV, RULE_RIGHT, MATCH_ONE, RULE_INT | RULE_REAL, RESULT_OTHER, "x / 1 to x"},
+    {IR_DIV, RULE_RIGHT, MATCH_MINUS_ONE, RULE_INT, RESULT_NEGATE, "x / -1 to 0 - x"}
+};
+
+#define SIMPLIFY_RULE_COUNT ((int)(sizeof(SIMPLIFY_RULES) / sizeof(SIMPLIFY_RULES[0])))
+
+static const IR_OPERAND ABSENT_OPERAND = {IR_NONE, UNKNOWN_T, 0, 0};
+
+/* An operand, with its value worked out once for all the rules when it is a constant */
+typedef struct {
+    IR_OPERAND operand;
+    int constant;
+    double value;
+} SIMPLIFY_OPERAND;
+
+static int apply_rule(const SIMPLIFY_RULE *, IR_INSTRUCTION *, SIMPLIFY_OPERAND *, SIMPLIFY_OPERAND *);
+static int rule_matches(const SIMPLIFY_RULE *, SIMPLIFY_OPERAND *, IR_OPERAND, enum SymbolTypes);
+static void read_operand(COMPILE_CONTEXT *, IR_OPERAND, SIMPLIFY_OPERAND *);
+static int shift_of(IR_OPERAND);
+
+/* Returns TRUE if the instruction was rewritten */
+int simplify_ir_instruction(COMPILE_CONTEXT *ctx, IR_INSTRUCTION *instruction)
+{
+    SIMPLIFY_OPERAND a;
+    SIMPLIFY_OPERAND b;
+    int simplified = FALSE;
+    int i;
+    /* Every rule needs a constant operand, or the same operand twice */
+    if(!ir_is_constant(instruction->a) && !ir_is_constant(instruction->b)
+        && (instruction->a.kind != instruction->b.kind || instruction->a.index != instruction->b.index)) return FALSE;
+    read_operand(ctx, instruction->a, &a);
+    read_operand(ctx, instruction->b, &b);
+    for(i = 0; i < SIMPLIFY_RULE_COUNT; i++)
+    {
+        if(SIMPLIFY_RULES[i].op != instruction->op || !apply_rule(&SIMPLIFY_RULES[i], instruction, &a, &b)) continue;
+        INFO("Optimisation: Simplified %s\n", SIMPLIFY_RULES[i].description)
+        simplified = TRUE;
+        /* The rewritten instruction may match an earlier rule */
+        read_operand(ctx, instruction->a, &a);
+        read_operand(ctx, instruction->b, &b);
+        i = -1;
+    }
+    return simplified;
+}
+
+static int apply_rule(const SIMPLIFY_RULE *rule, IR_INSTRUCTION *instruction, SIMPLIFY_OPERAND *a, SIMPLIFY_OPERAND *b)
+{
+    IR_OPERAND constant = ABSENT_OPERAND;
+    IR_OPERAND other;
+    if(rule->match == MATCH_SAME)
+    {
+        if((a->operand.kind != IR_VARIABLE && a->operand.kind != IR_TEMP) || a->operand.kind != b->operand.kind
+            || a->operand.index != b->operand.index || !rule_matches(rule, a, a->operand, instruction->type)) return FALSE;
+        other = a->operand;
+    }
+    else if((rule->side & RULE_RIGHT) && rule_matches(rule, b, a->operand, instruction->type))
+    {
+        constant = b->operand;
+        other = a->operand;
+    }
+    else if((rule->side & RULE_LEFT) && rule_matches(rule, a, b->operand, instruction->type))
+    {
+        constant = a->operand;
+        other = b->operand;
+    }
+    else return FALSE;
+
+    switch(rule->result)
+    {
+        case RESULT_OTHER:
+            instruction->op = IR_COPY;
+            instruction->type = instruction->dest.type;
+            instruction->a = other;
+            instruction->b = ABSENT_OPERAND;
+            break;
+        case RESULT_ZERO:
+            instruction->op = IR_COPY;
+            instruction->type = instruction->dest.type;
+            instruction->a = ir_int_constant(0);
+            instruction->b = ABSENT_OPERAND;
+            break;
+        case RESULT_NEGATE:
+            instruction->op = IR_SUB;
+            instruction->a = ir_int_constant(0);
+            instruction->b = other;
+            break;
+        case RESULT_SHIFT:
+            instruction->op = IR_SHL;
+            instruction->a = other;
+            instruction->b = ir_int_constant(shift_of(constant));
+            break;
+        case RESULT_DOUBLE:
+            instruction->op = IR_ADD;
+            instruction->a = other;
+            instruction->b = other;
+            break;
+        case RESULT_ADD_NEGATION:
+            instruction->op = IR_ADD;
+            instruction->a = other;
+            if(constant.kind == IR_REAL_CONST) instruction->b = ir_real_constant(constant.index, !constant.value);
+            else instruction->b = ir_int_constant(-constant.value);
+            break;
+    }
+    return TRUE;
+}
+
+/* Whether the rule holds with operand as its constant, in arithmetic of the given type */
+static int rule_matches(const SIMPLIFY_RULE *rule, SIMPLIFY_OPERAND *operand, IR_OPERAND other, enum SymbolTypes type)
+{
+    IR_OPERAND constant = operand->operand;
+    if(type == INT_T)
+    {
+        if(!(rule->types & RULE_INT)) return FALSE;
+    }
+    else if(type != REAL_T || !((rule->types & RULE_REAL) || ((rule->types & RULE_REAL_OF_INTEGER) && other.type != REAL_T)))
+        return FALSE;
+    if(rule->match == MATCH_SAME) return TRUE;
+    if(!operand->constant) return FALSE;
+    switch(rule->match)
+    {
+        case MATCH_ZERO:
+            /* x - -0.0 is not x when x is -0.0 */
+            return operand->value == 0 && !(constant.kind == IR_REAL_CONST && constant.value);
+        case MATCH_ONE:
+            return operand->value == 1;
+        case MATCH_MINUS_ONE:
+            return operand->value == -1;
+        case MATCH_TWO:
+            return operand->value == 2;
+        case MATCH_POWER_OF_TWO:
+            return shift_of(constant) > 0;
+        case MATCH_NEGATED:
+            /* The negation of INT_MIN is not an int */
+            if(constant.kind == IR_REAL_CONST) return constant.value;
+            return constant.value < 0 && constant.value != INT_MIN;
+        default:
+            return FALSE;
+    }
+}
+
+static void read_operand(COMPILE_CONTEXT *ctx, IR_OPERAND operand, SIMPLIFY_OPERAND *read)
+{
+    read->operand = operand;
+    read->constant = TRUE;
+    switch(operand.kind)
+    {
+        case IR_INT_CONST:
+        case IR_CHAR_CONST:
+            read->value = operand.value;
+            break;
+        case IR_REAL_CONST:
+            read->value = ctx->symTabRec->array[operand.index]->value;
+            if(operand.value) read->value = -read->value;
+            break;
+        default:
+            read->constant = FALSE;
+            read->value = 0;
+            break;
+    }
+}
+
+/* k where an integer constant is 2^k for k of at least 1, otherwise 0 */
+static int shift_of(IR_OPERAND operand)
+{
+    int k = 0;
+    if((operand.kind != IR_INT_CONST && operand.kind != IR_CHAR_CONST) || operand.value < 2
+        || (operand.value & (operand.value - 1)) != 0) return 0;
+    while((1 << k) != operand.value) k++;
+    return k;
+}
@@ -0,0 +1,382 @@
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "include/compile.h"
+#include "include/ir.h"
+#include "include/optimise_ir.h"
+#include "include/splio.h"
+
+/* ------------- loop unrolling --------------------------- */
+
+/* Once constants have been propagated, a FOR over an INT variable whose IS, BY and TO have all
+** become constants runs a number of times known now. Its body is copied once for each
+** iteration, each copy after an assignment of the value the variable has then, so that
+** propagating constants again can fold it into the copy. The variable is left holding the
+** value the loop would have left it.
+**
+** The copies together may hold no more instructions than the unroll budget. A loop too long to
+** unroll fully is unrolled by the largest factor of 8, 4 or 2 which fits instead: the loop
+** then runs its body that many times on each iteration, stepping the variable between the
+** copies, and the iterations left over are unrolled fully after it. Loops are visited
+** innermost first, so an outer loop is measured with whatever its inner loops became.
+**
+** Each copy of the body assigns new temporaries, so each is still assigned only once. The
+** comparison's setup only computes the bound, which is now a constant, so it is dropped along
+** with the comparison. */
+
+#define MAX_UNROLL_FACTOR 8
+
+typedef struct {
+    COMPILE_CONTEXT *ctx;
+    IR_PROGRAM *program;
+    int *temp_stamp;            /* Marks the temporaries assigned in the copy being made */
+    int *temp_copy;             /* Their replacements in that copy */
+    int temp_capacity;
+    int copies;                 /* Copies made so far; the numbers stamp temp_stamp */
+    int unrolled;
+    int failed;                 /* Out of memory, so nothing more is unrolled */
+} UNROLL_STATE;
+
+/* What a FOR loop is found to do */
+typedef struct {
+    IR_NODE *loop;
+    long long start;
+    long long step;
+    long long trips;
+    long long size;             /* Instructions in one iteration, counting the variable's assignment */
+} UNROLL_LOOP;
+
+static void unroll_nodes(UNROLL_STATE *, IR_NODE **);
+static IR_NODE **unroll_loop(UNROLL_STATE *, IR_NODE **);
+static int is_unrollable(IR_NODE *, UNROLL_LOOP *);
+static int integer_constant(IR_OPERAND, long long *);
+static int assigns_variable(IR_NODE *, int);
+static IR_NODE *unroll_iterations(UNROLL_STATE *, UNROLL_LOOP *, long long);
+static IR_NODE *assign_variable(UNROLL_STATE *, IR_OPERAND, long long);
+static IR_NODE *copy_body(UNROLL_STATE *, IR_NODE *);
+static IR_NODE *copy_nodes(UNROLL_STATE *, IR_NODE *);
+static IR_CONDITION *copy_condition(UNROLL_STATE *, IR_CONDITION *);
+static IR_OPERAND copy_operand(UNROLL_STATE *, IR_OPERAND);
+static IR_OPERAND copy_assigned_operand(UNROLL_STATE *, IR_OPERAND);
+static IR_NODE *last_node(IR_NODE *);
+
+/* Returns the number of loops unrolled, after which constants are worth propagating again */
+int unroll_loops(COMPILE_CONTEXT *ctx, IR_PROGRAM *program)
+{
+    UNROLL_STATE state;
+    if(ctx->options.unroll_budget <= 0) return 0;
+    memset(&state, 0, sizeof(UNROLL_STATE));
+    state.ctx = ctx;
+    state.program = program;
+    unroll_nodes(&state, &program->body);
+    free(state.temp_stamp);
+    free(state.temp_copy);
+    if(state.unrolled)
+    {
+        INFO("Optimisation: Unrolled %d FOR loops\n", state.unrolled)
+    }
+    return state.unrolled;
+}
+
+static void unroll_nodes(UNROLL_STATE *state, IR_NODE **link)
+{
+    while(*link != NULL && !state->failed)
+    {
+        IR_NODE *node = *link;
+        switch(node->kind)
+        {
+            case IR_BLOCK:
+                break;
+            case IR_IF:
+                unroll_nodes(state, &node->body);
+                unroll_nodes(state, &node->orelse);
+                break;
+            case IR_WHILE:
+            case IR_DO:
+                unroll_nodes(state, &node->body);
+                break;
+            case IR_FOR:
+                unroll_nodes(state, &node->body);
+                link = unroll_loop(state, link);
+                continue;
+        }
+        link = &node->next;
+    }
+}
+
+/* Unroll the FOR at link if it can be, returning the link after whatever replaces it */
+static IR_NODE **unroll_loop(UNROLL_STATE *state, IR_NODE **link)
+{
+    IR_NODE *node = *link;
+    IR_NODE *body_end = last_node(node->body);
+    IR_NODE *copies = NULL;
+    IR_NODE **copies_end = &copies;
+    IR_NODE *unrolled;
+    UNROLL_LOOP loop;
+    long long budget = state->ctx->options.unroll_budget;
+    long long factor;
+    long long main_trips;
+    int i;
+    if(!is_unrollable(node, &loop)) return &node->next;
+
+    if(loop.trips * loop.size <= budget)
+    {
+        /* The loop goes, leaving init and then every iteration */
+        unrolled = unroll_iterations(state, &loop, 0);
+        if(unrolled == NULL) return &node->next;
+        INFO("Optimisation: Unrolled a FOR loop running %lld times\n", loop.trips)
+        state->unrolled++;
+        last_node(node->init)->next = unrolled;
+        *link = node->init;
+        link = &last_node(unrolled)->next;
+        *link = node->next;
+        return link;
+    }
+
+    for(factor = MAX_UNROLL_FACTOR; factor > 1; factor /= 2)
+    {
+        if(loop.trips >= 2*factor && (factor + loop.trips % factor) * loop.size <= budget) break;
+    }
+    if(factor == 1) return &node->next;
+    main_trips = loop.trips - loop.trips % factor;
+
+    /* Each iteration now runs factor of the old ones, stepping between them, and the loop goes
+    ** on while there are factor left to run. The iterations left over run after it. */
+    for(i = 1; i < factor && !state->failed; i++)
+    {
+        *copies_end = copy_nodes(state, node->step);
+        if(*copies_end == NULL) break;
+        (*copies_end)->next = copy_body(state, node->body);
+        while(*copies_end != NULL) copies_end = &(*copies_end)->next;
+    }
+    unrolled = state->failed ? NULL : unroll_iterations(state, &loop, main_trips);
+    if(unrolled == NULL) return &node->next;
+    if(body_end != NULL) body_end->next = copies;
+    else node->body = copies;
+    INFO("Optimisation: Unrolled a FOR loop running %lld times by %lld\n", loop.trips, factor)
+    state->unrolled++;
+    node->condition->setup = NULL;
+    node->condition->right = ir_int_constant((int)(loop.start + (main_trips - factor) * loop.step));
+    node->condition->type = INT_T;
+    link = &last_node(unrolled)->next;
+    *link = node->next;
+    node->next = unrolled;
+    return link;
+}
+
+/* A FOR is unrolled when it starts from a constant, steps by a constant towards a constant
+** bound it compares with directly, and its body leaves the variable to the step */
+static int is_unrollable(IR_NODE *node, UNROLL_LOOP *loop)
+{
+    IR_CONDITION *condition = node->condition;
+    IR_INSTRUCTION *step;
+    IR_NODE *init;
+    long long bound;
+    long long last;
+    int symbol = node->variable.index;
+    int found = FALSE;
+    int i;
+    memset(loop, 0, sizeof(UNROLL_LOOP));
+    loop->loop = node;
+    if(node->counter != 0 || node->variable.type != INT_T || node->init == NULL) return FALSE;
+    if(condition->kind != IR_COMPARE || condition->left.kind != IR_VARIABLE || condition->left.index != symbol
+        || !integer_constant(condition->right, &bound)) return FALSE;
+
+    for(init = node->init; init != NULL; init = init->next)
+    {
+        if(init->kind != IR_BLOCK) return FALSE;
+        for(i = 0; i < init->count; i++)
+        {
+            if(init->code[i].dest.kind != IR_VARIABLE || init->code[i].dest.index != symbol) continue;
+            found = init->code[i].op == IR_COPY && integer_constant(init->code[i].a, &loop->start);
+        }
+    }
+    if(!found) return FALSE;
+
+    if(node->step == NULL || node->step->next != NULL || node->step->kind != IR_BLOCK || node->step->count != 1) return FALSE;
+    step = &node->step->code[0];
+    if(step->op != IR_ADD || step->type != INT_T || step->dest.kind != IR_VARIABLE || step->dest.index != symbol) return FALSE;
+    if(step->a.kind == IR_VARIABLE && step->a.index == symbol) found = integer_constant(step->b, &loop->step);
+    else found = step->b.kind == IR_VARIABLE && step->b.index == symbol && integer_constant(step->a, &loop->step);
+    if(!found || loop->step == 0) return FALSE;
+
+    if(condition->compare != (loop->step > 0 ? SYM_LESS_THAN_EQ : SYM_GREATER_THAN_EQ)) return FALSE;
+    if(loop->step > 0 ? loop->start > bound : loop->start < bound) return FALSE;
+    loop->trips = (bound - loop->start) / loop->step + 1;
+    /* The variable passes the bound on the last step, which must not overflow */
+    last = loop->start + loop->trips * loop->step;
+    if(last < INT_MIN || last > INT_MAX) return FALSE;
+
+    if(assigns_variable(node->body, symbol)) return FALSE;
+    loop->size = count_ir_instructions(node->body) + 1;
+    return TRUE;
+}
+
+static int integer_constant(IR_OPERAND operand, long long *value)
+{
+    if(operand.kind != IR_INT_CONST && operand.kind != IR_CHAR_CONST) return FALSE;
+    *value = operand.value;
+    return TRUE;
+}
+
+static int assigns_variable(IR_NODE *node, int symbol)
+{
+    int i;
+    for(; node != NULL; node = node->next)
+    {
+        for(i = 0; i < node->count; i++)
+        {
+            if(node->code[i].dest.kind == IR_VARIABLE && node->code[i].dest.index == symbol) return TRUE;
+        }
+        if(assigns_variable(node->body, symbol) || assigns_variable(node->orelse, symbol)
+            || assigns_variable(node->init, symbol) || assigns_variable(node->step, symbol)) return TRUE;
+    }
+    return FALSE;
+}
+
+/* The iterations from first on, each a copy of the body after the variable's value, and then
+** the value the loop leaves it with. Returns NULL when out of memory. */
+static IR_NODE *unroll_iterations(UNROLL_STATE *state, UNROLL_LOOP *loop, long long first)
+{
+    IR_NODE *head = NULL;
+    IR_NODE **tail = &head;
+    long long trip;
+    for(trip = first; ; trip++)
+    {
+        *tail = assign_variable(state, loop->loop->variable, loop->start + trip * loop->step);
+        if(*tail == NULL) return NULL;
+        if(trip == loop->trips) return head;
+        (*tail)->next = copy_body(state, loop->loop->body);
+        if(state->failed) return NULL;
+        while(*tail != NULL) tail = &(*tail)->next;
+    }
+}
+
+static IR_NODE *assign_variable(UNROLL_STATE *state, IR_OPERAND variable, long long value)
+{
+    IR_NODE *block = new_ir_node(state->program, IR_BLOCK);
+    IR_INSTRUCTION *instruction = block != NULL ? append_ir_instruction(state->program, block, IR_COPY, INT_T) : NULL;
+    if(instruction == NULL)
+    {
+        state->failed = TRUE;
+        return NULL;
+    }
+    instruction->dest = variable;
+    instruction->a = ir_int_constant((int)value);
+    return block;
+}
+
+/* A copy of a loop body with temporaries of its own */
+static IR_NODE *copy_body(UNROLL_STATE *state, IR_NODE *body)
+{
+    int needed = state->program->temp_count + 1;
+    if(needed > state->temp_capacity)
+    {
+        int *stamp = (int *)realloc(state->temp_stamp, sizeof(int) * needed);
+        if(stamp != NULL) state->temp_stamp = stamp;
+        int *copy = (int *)realloc(state->temp_copy, sizeof(int) * needed);
+        if(copy != NULL) state->temp_copy = copy;
+        if(stamp == NULL || copy == NULL)
+        {
+            state->failed = TRUE;
+            return NULL;
+        }
+        memset(state->temp_stamp + state->temp_capacity, 0, sizeof(int) * (needed - state->temp_capacity));
+        state->temp_capacity = needed;
+    }
+    state->copies++;
+    return copy_nodes(state, body);
+}
+
+/* Nodes are copied in the order they run, so each temporary is assigned before it is read.
+** The loops copied are summarised afresh by the passes which need it. */
+static IR_NODE *copy_nodes(UNROLL_STATE *state, IR_NODE *node)
+{
+    IR_NODE *head = NULL;
+    IR_NODE **tail = &head;
+    int i;
+    for(; node != NULL && !state->failed; node = node->next)
+    {
+        IR_NODE *copy = new_ir_node(state->program, node->kind);
+        if(copy == NULL)
+        {
+            state->failed = TRUE;
+            return NULL;
+        }
+        for(i = 0; i < node->count; i++)
+        {
+            IR_INSTRUCTION *instruction = append_ir_instruction(state->program, copy, node->code[i].op, node->code[i].type);
+            if(instruction == NULL)
+            {
+                state->failed = TRUE;
+                return NULL;
+            }
+            instruction->a = copy_operand(state, node->code[i].a);
+            instruction->b = copy_operand(state, node->code[i].b);
+            instruction->dest = copy_assigned_operand(state, node->code[i].dest);
+        }
+        copy->variable = node->variable;
+        copy->init = copy_nodes(state, node->init);
+        if(node->kind == IR_DO) copy->body = copy_nodes(state, node->body);
+        copy->condition = copy_condition(state, node->condition);
+        if(node->kind != IR_DO) copy->body = copy_nodes(state, node->body);
+        copy->orelse = copy_nodes(state, node->orelse);
+        copy->step = copy_nodes(state, node->step);
+        copy->counter = node->counter;
+        copy->bound = copy_operand(state, node->bound);
+        copy->stride = copy_operand(state, node->stride);
+        *tail = copy;
+        tail = &copy->next;
+    }
+    return head;
+}
+
+static IR_CONDITION *copy_condition(UNROLL_STATE *state, IR_CONDITION *condition)
+{
+    IR_CONDITION *copy;
+    if(condition == NULL) return NULL;
+    copy = new_ir_condition(state->program, condition->kind);
+    if(copy == NULL)
+    {
+        state->failed = TRUE;
+        return NULL;
+    }
+    copy->setup = copy_nodes(state, condition->setup);
+    copy->compare = condition->compare;
+    copy->type = condition->type;
+    copy->left = copy_operand(state, condition->left);
+    copy->right = copy_operand(state, condition->right);
+    copy->first = copy_condition(state, condition->first);
+    copy->second = copy_condition(state, condition->second);
+    return copy;
+}
+
+/* A temporary assigned earlier in the copy is read as its replacement; anything else is the same */
+static IR_OPERAND copy_operand(UNROLL_STATE *state, IR_OPERAND operand)
+{
+    if(operand.kind == IR_TEMP && operand.index < state->temp_capacity && state->temp_stamp[operand.index] == state->copies)
+        operand.index = state->temp_copy[operand.index];
+    return operand;
+}
+
+static IR_OPERAND copy_assigned_operand(UNROLL_STATE *state, IR_OPERAND operand)
+{
+    IR_OPERAND temp;
+    if(operand.kind != IR_TEMP) return operand;
+    temp = new_ir_temp(state->program, operand.type);
+    if(temp.kind != IR_TEMP)
+    {
+        state->failed = TRUE;
+        return operand;
+    }
+    state->temp_stamp[operand.index] = state->copies;
+    state->temp_copy[operand.index] = temp.index;
+    return temp;
+}
+
+static IR_NODE *last_node(IR_NODE *node)
+{
+    while(node != NULL && node->next != NULL) node = node->next;
+    return node;
+}
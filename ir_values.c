@@ -0,0 +1,302 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "include/compile.h"
+#include "include/ir.h"
+#include "include/optimise_ir.h"
+#include "include/splio.h"
+
+/* ------------- common subexpression elimination --------------------------- */
+
+/* Local value numbering, extended along the structure of the IR. Each arithmetic instruction is
+** looked up by its operation, type and operands; if the same value has already been computed
+** where it is still available, the instruction is replaced by a use of it. A repeated temporary
+** is deleted and its uses renamed to the earlier one, since temporaries are assigned once and so
+** the earlier one cannot change; any other repeat becomes a copy. A temporary which copies a
+** variable is read from the variable instead while the variable keeps its value, so that the
+** copy is left for dead store elimination and the value can be found again.
+**
+** A variable is identified by a version, which every assignment and READ moves on, so a value
+** computed from a variable, or stored in one, is no longer found once the variable changes.
+** What is computed inside a branch, a loop, or a comparison which may not be evaluated is
+** forgotten once that is left, but what is computed before a branch is available in it, and
+** the setup of a loop's first comparison in its body. Every variable a loop assigns is moved on
+** before the loop, as a value from before it may have changed by any later iteration. */
+
+/* The value dest = a op b, in the arithmetic of type. The operands are as renamed, with the
+** versions of any variables among them. */
+typedef struct {
+    enum IrOp op;
+    enum SymbolTypes type;
+    IR_OPERAND a;
+    IR_OPERAND b;
+    int a_version;
+    int b_version;
+    IR_OPERAND result;          /* Where the value is */
+    int result_version;         /* The version of result holding it, when it is a variable */
+    unsigned int hash;
+    int next;                   /* The next value in its bucket, or -1 */
+} VALUE_ENTRY;
+
+typedef struct {
+    COMPILE_CONTEXT *ctx;
+    VALUE_ENTRY *values;        /* Those available, in the order they were computed */
+    int value_count;
+    int value_capacity;
+    int *buckets;
+    unsigned int bucket_mask;
+    int *versions;              /* Indexed by symbol */
+    int next_version;
+    IR_OPERAND *temp_values;    /* What each temporary is read from instead, or IR_NONE */
+    int *temp_value_versions;   /* The version of the variable it is read from */
+    int reused;
+} VALUE_STATE;
+
+static const IR_OPERAND EMPTY_OPERAND = {IR_NONE, UNKNOWN_T, 0, 0};
+
+static void number_nodes(VALUE_STATE *, IR_NODE *);
+static void number_block(VALUE_STATE *, IR_NODE *);
+static void number_condition(VALUE_STATE *, IR_CONDITION *);
+static void number_instruction(VALUE_STATE *, IR_INSTRUCTION *);
+static void forget_values(VALUE_STATE *, int);
+static void move_on(VALUE_STATE *, IR_OPERAND);
+static void substitute_temp(VALUE_STATE *, IR_OPERAND *);
+static void set_temp_value(VALUE_STATE *, IR_OPERAND, IR_OPERAND);
+static int version_of(VALUE_STATE *, IR_OPERAND);
+static unsigned int hash_operand(IR_OPERAND, int);
+static int operand_order(IR_OPERAND, int, IR_OPERAND, int);
+
+void eliminate_common_subexpressions(COMPILE_CONTEXT *ctx, IR_PROGRAM *program)
+{
+    VALUE_STATE state;
+    unsigned int buckets = 16;
+    unsigned int i;
+    memset(&state, 0, sizeof(VALUE_STATE));
+    state.ctx = ctx;
+    /* Each instruction adds at most one value, so neither table need grow */
+    state.value_capacity = count_ir_instructions(program->body);
+    while(buckets < 2*(unsigned int)state.value_capacity) buckets *= 2;
+    state.bucket_mask = buckets - 1;
+    state.values = (VALUE_ENTRY *)malloc(sizeof(VALUE_ENTRY) * (state.value_capacity + 1));
+    state.buckets = (int *)malloc(sizeof(int) * buckets);
+    state.versions = (int *)calloc(ctx->symTabRec->in_use + 1, sizeof(int));
+    state.temp_values = (IR_OPERAND *)malloc(sizeof(IR_OPERAND) * (program->temp_count + 1));
+    state.temp_value_versions = (int *)calloc(program->temp_count + 1, sizeof(int));
+    if(state.values != NULL && state.buckets != NULL && state.versions != NULL && state.temp_values != NULL
+        && state.temp_value_versions != NULL && summarise_ir_loops(program, ctx->symTabRec->in_use) == 0)
+    {
+        for(i = 0; i < buckets; i++) state.buckets[i] = -1;
+        for(i = 0; i <= (unsigned int)program->temp_count; i++) state.temp_values[i] = EMPTY_OPERAND;
+        number_nodes(&state, program->body);
+        if(state.reused > 0)
+        {
+            INFO("Optimisation: Reused %d value%s already computed\n", state.reused, state.reused == 1 ? "" : "s")
+        }
+    }
+    free(state.values);
+    free(state.buckets);
+    free(state.versions);
+    free(state.temp_values);
+    free(state.temp_value_versions);
+}
+
+static void number_nodes(VALUE_STATE *state, IR_NODE *node)
+{
+    int mark;
+    int i;
+    for(; node != NULL; node = node->next)
+    {
+        switch(node->kind)
+        {
+            case IR_BLOCK:
+                number_block(state, node);
+                break;
+            case IR_IF:
+                number_condition(state, node->condition);
+                mark = state->value_count;
+                number_nodes(state, node->body);
+                forget_values(state, mark);
+                number_nodes(state, node->orelse);
+                forget_values(state, mark);
+                break;
+            case IR_WHILE:
+            case IR_DO:
+            case IR_FOR:
+                number_nodes(state, node->init);
+                mark = state->value_count;
+                for(i = 0; i < node->assigned_count; i++) state->versions[node->assigned[i]] = ++state->next_version;
+                if(node->kind == IR_DO)
+                {
+                    number_nodes(state, node->body);
+                    number_condition(state, node->condition);
+                }
+                else
+                {
+                    number_condition(state, node->condition);
+                    number_nodes(state, node->body);
+                    number_nodes(state, node->step);
+                }
+                substitute_temp(state, &node->bound);
+                substitute_temp(state, &node->stride);
+                forget_values(state, mark);
+                break;
+        }
+    }
+}
+
+static void number_block(VALUE_STATE *state, IR_NODE *block)
+{
+    int reused = state->reused;
+    int i;
+    for(i = 0; i < block->count; i++) number_instruction(state, &block->code[i]);
+    if(state->reused != reused) compact_ir_block(block);
+}
+
+/* The setup of the first comparison always runs; any other may not */
+static void number_condition(VALUE_STATE *state, IR_CONDITION *condition)
+{
+    int mark;
+    switch(condition->kind)
+    {
+        case IR_COMPARE:
+            number_nodes(state, condition->setup);
+            substitute_temp(state, &condition->left);
+            substitute_temp(state, &condition->right);
+            break;
+        case IR_NOT:
+            number_condition(state, condition->first);
+            break;
+        case IR_AND:
+        case IR_OR:
+            number_condition(state, condition->first);
+            mark = state->value_count;
+            number_condition(state, condition->second);
+            forget_values(state, mark);
+            break;
+    }
+}
+
+static void number_instruction(VALUE_STATE *state, IR_INSTRUCTION *instruction)
+{
+    VALUE_ENTRY key;
+    VALUE_ENTRY *entry;
+    int index;
+    switch(instruction->op)
+    {
+        case IR_WRITE:
+            substitute_temp(state, &instruction->a);
+            return;
+        case IR_READ:
+            move_on(state, instruction->dest);
+            return;
+        case IR_NEWLINE:
+        case IR_NOP:
+            return;
+        case IR_COPY:
+            substitute_temp(state, &instruction->a);
+            move_on(state, instruction->dest);
+            set_temp_value(state, instruction->dest, instruction->a);
+            return;
+        default:
+            break;
+    }
+    substitute_temp(state, &instruction->a);
+    substitute_temp(state, &instruction->b);
+    key.op = instruction->op;
+    key.type = instruction->type;
+    key.a = instruction->a;
+    key.b = instruction->b;
+    key.a_version = version_of(state, key.a);
+    key.b_version = version_of(state, key.b);
+    /* Both orders of the operands of an addition or multiplication give the same value */
+    if((key.op == IR_ADD || key.op == IR_MUL) && operand_order(key.a, key.a_version, key.b, key.b_version) > 0)
+    {
+        key.a = instruction->b;
+        key.b = instruction->a;
+        key.a_version = version_of(state, key.a);
+        key.b_version = version_of(state, key.b);
+    }
+    key.hash = (unsigned int)key.op * 31u + (unsigned int)key.type;
+    key.hash = key.hash * 1000003u ^ hash_operand(key.a, key.a_version);
+    key.hash = key.hash * 1000003u ^ hash_operand(key.b, key.b_version);
+
+    for(index = state->buckets[key.hash & state->bucket_mask]; index >= 0; index = entry->next)
+    {
+        entry = &state->values[index];
+        if(entry->hash != key.hash || entry->op != key.op || entry->type != key.type
+            || operand_order(entry->a, entry->a_version, key.a, key.a_version) != 0
+            || operand_order(entry->b, entry->b_version, key.b, key.b_version) != 0
+            || version_of(state, entry->result) != entry->result_version) continue;
+        state->reused++;
+        instruction->op = IR_COPY;
+        instruction->type = instruction->dest.type;
+        instruction->a = entry->result;
+        instruction->b = EMPTY_OPERAND;
+        move_on(state, instruction->dest);
+        set_temp_value(state, instruction->dest, instruction->a);
+        /* Nothing reads a repeated temporary now */
+        if(instruction->dest.kind == IR_TEMP && entry->result.kind == IR_TEMP) instruction->op = IR_NOP;
+        return;
+    }
+
+    move_on(state, instruction->dest);
+    /* A value stored as another type is no longer the same value */
+    if(instruction->dest.type != instruction->type || state->value_count == state->value_capacity) return;
+    key.result = instruction->dest;
+    key.result_version = version_of(state, instruction->dest);
+    key.next = state->buckets[key.hash & state->bucket_mask];
+    state->buckets[key.hash & state->bucket_mask] = state->value_count;
+    state->values[state->value_count++] = key;
+}
+
+/* Values are added at the head of their buckets, so they are taken off in the reverse order */
+static void forget_values(VALUE_STATE *state, int mark)
+{
+    while(state->value_count > mark)
+    {
+        VALUE_ENTRY *entry = &state->values[--state->value_count];
+        state->buckets[entry->hash & state->bucket_mask] = entry->next;
+    }
+}
+
+static void move_on(VALUE_STATE *state, IR_OPERAND operand)
+{
+    if(operand.kind == IR_VARIABLE) state->versions[operand.index] = ++state->next_version;
+}
+
+static void substitute_temp(VALUE_STATE *state, IR_OPERAND *operand)
+{
+    IR_OPERAND value;
+    if(operand->kind != IR_TEMP) return;
+    value = state->temp_values[operand->index];
+    if(value.kind != IR_NONE && version_of(state, value) == state->temp_value_versions[operand->index]) *operand = value;
+}
+
+/* A copy is only read from its source when that holds the same value, of the same type */
+static void set_temp_value(VALUE_STATE *state, IR_OPERAND temp, IR_OPERAND value)
+{
+    if(temp.kind != IR_TEMP || value.type != temp.type || (value.kind != IR_VARIABLE && value.kind != IR_TEMP)) return;
+    state->temp_values[temp.index] = value;
+    state->temp_value_versions[temp.index] = version_of(state, value);
+}
+
+static int version_of(VALUE_STATE *state, IR_OPERAND operand)
+{
+    return operand.kind == IR_VARIABLE ? state->versions[operand.index] : 0;
+}
+
+static unsigned int hash_operand(IR_OPERAND operand, int version)
+{
+    return (((unsigned int)operand.kind * 31u + (unsigned int)operand.index) * 31u + (unsigned int)operand.value) * 31u
+        + (unsigned int)version;
+}
+
+/* An order on operands, 0 when they are the same value */
+static int operand_order(IR_OPERAND left, int left_version, IR_OPERAND right, int right_version)
+{
+    if(left.kind != right.kind) return left.kind < right.kind ? -1 : 1;
+    if(left.index != right.index) return left.index < right.index ? -1 : 1;
+    if(left.value != right.value) return left.value < right.value ? -1 : 1;
+    if(left_version != right_version) return left_version < right_version ? -1 : 1;
+    return 0;
+}
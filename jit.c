@@ -0,0 +1,474 @@
+#include <limits.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "include/bytecode.h"
+#include "include/splio.h"
+
+/* ------------- template JIT --------------------------- */
+
+/* --jit runs the bytecode as x86-64 machine code, written into pages mapped for it in the
+** compiler's own process, so a program runs at once without a C compiler. Each instruction is
+** turned into a fixed template of machine code with its slots as displacements from %rbx, which
+** holds the slots throughout; branches are patched once every instruction has its address.
+** WRITE and READ call the functions below, so a program prints and reads just as it does on the
+** virtual machine. Where pages cannot be mapped executable, or the machine is not x86-64, the
+** program runs on the virtual machine instead. */
+
+#if defined(__x86_64__) && (defined(__unix__) || defined(__APPLE__))
+#define BC_JIT
+#endif
+
+#ifdef BC_JIT
+
+#include <sys/mman.h>
+
+#ifndef MAP_ANONYMOUS
+#define MAP_ANONYMOUS MAP_ANON
+#endif
+
+#define EAX 0
+#define ECX 1
+#define EDX 2
+#define ESI 6
+#define EDI 7
+
+/* Branches to the code which stops the program with a division error */
+#define DIVIDED_BY_ZERO -1
+#define DIVISION_OVERFLOWED -2
+
+typedef struct {
+    size_t at;                  /* Of the branch's 32 bit displacement */
+    int target;                 /* The instruction branched to, or a division error */
+} JIT_FIXUP;
+
+typedef struct {
+    unsigned char *code;
+    size_t length;
+    size_t capacity;
+    size_t *starts;             /* Where each instruction's machine code starts */
+    JIT_FIXUP *fixups;
+    int fixup_count;
+    int fixup_capacity;
+    int failed;                 /* Out of memory */
+} JIT_BUFFER;
+
+typedef int (*JIT_ENTRY)(BC_SLOT *);
+typedef void (*JIT_FUNCTION)(void);
+
+/* The second byte of the jcc taken when a comparison holds, in the order of enum CompareSymType */
+static const unsigned char INT_CONDITIONS[] = {0x84, 0x85, 0x8C, 0x8F, 0x8E, 0x8D};
+
+static void jit_write_char(int);
+static void jit_write_int(int);
+static void jit_write_real(double);
+static void jit_newline(void);
+static void jit_read_char(int *);
+static void jit_read_int(int *);
+static void jit_read_real(double *);
+static unsigned long long jit_trips(int, int, int);
+static void translate_to_machine_code(JIT_BUFFER *, BC_PROGRAM *);
+static void emit_machine_bytes(JIT_BUFFER *, const unsigned char *, size_t);
+static void emit_int32(JIT_BUFFER *, int);
+static void emit_slot_operand(JIT_BUFFER *, const unsigned char *, size_t, int, int);
+static void emit_jump(JIT_BUFFER *, const unsigned char *, size_t, int);
+static void emit_real_jump(JIT_BUFFER *, BC_INSTRUCTION *, enum CompareSymType, int);
+static void emit_call(JIT_BUFFER *, JIT_FUNCTION);
+
+static const unsigned char MOV_LOAD[] = {0x8B};
+static const unsigned char MOV_STORE[] = {0x89};
+static const unsigned char MOV_LOAD_64[] = {0x48, 0x8B};
+static const unsigned char MOV_STORE_64[] = {0x48, 0x89};
+static const unsigned char LEA_64[] = {0x48, 0x8D};
+static const unsigned char ADD_LOAD[] = {0x03};
+static const unsigned char CMP_LOAD[] = {0x3B};
+static const unsigned char MOVSD_LOAD[] = {0xF2, 0x0F, 0x10};
+static const unsigned char MOVSD_STORE[] = {0xF2, 0x0F, 0x11};
+static const unsigned char UCOMISD_LOAD[] = {0x66, 0x0F, 0x2E};
+static const unsigned char CVTSI2SD_LOAD[] = {0xF2, 0x0F, 0x2A};
+static const unsigned char CVTTSD2SI_LOAD[] = {0xF2, 0x0F, 0x2C};
+static const unsigned char JMP[] = {0xE9};
+
+/* Returns what run_bytecode would: 0 once the program halts, 1 when it divides by zero, or -1
+** when out of memory */
+int run_jit(BC_PROGRAM *program)
+{
+    JIT_BUFFER buffer;
+    JIT_ENTRY entry;
+    BC_SLOT *slots;
+    void *pages;
+    int status;
+    memset(&buffer, 0, sizeof(JIT_BUFFER));
+    buffer.starts = (size_t *)malloc(sizeof(size_t) * (program->count + 1));
+    if(buffer.starts == NULL) return -1;
+    translate_to_machine_code(&buffer, program);
+    free(buffer.starts);
+    free(buffer.fixups);
+    if(buffer.failed)
+    {
+        free(buffer.code);
+        return -1;
+    }
+
+    /* The pages are never writable and executable at once */
+    pages = mmap(NULL, buffer.length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if(pages == MAP_FAILED || (memcpy(pages, buffer.code, buffer.length), mprotect(pages, buffer.length, PROT_READ | PROT_EXEC)) != 0)
+    {
+        INFO("JIT: No executable pages, so running the bytecode\n")
+        if(pages != MAP_FAILED) munmap(pages, buffer.length);
+        free(buffer.code);
+        return run_bytecode(program);
+    }
+    INFO("JIT: %lu bytes of machine code for %d instructions\n", (unsigned long)buffer.length, program->count)
+    free(buffer.code);
+
+    slots = (BC_SLOT *)malloc(sizeof(BC_SLOT) * program->slot_count);
+    if(slots == NULL)
+    {
+        munmap(pages, buffer.length);
+        return -1;
+    }
+    memcpy(slots, program->slots, sizeof(BC_SLOT) * program->slot_count);
+    memcpy(&entry, &pages, sizeof(entry));
+    status = entry(slots);
+    munmap(pages, buffer.length);
+    free(slots);
+    if(status == 0) return 0;
+    fflush(stdout);
+    fprintf(stderr, "Error : %s\n", status == 1 ? "Division by zero" : "Division overflow");
+    return 1;
+}
+
+static void jit_write_char(int value)
+{
+    putchar(value);
+}
+
+static void jit_write_int(int value)
+{
+    printf("%d", value);
+}
+
+static void jit_write_real(double value)
+{
+    printf("%lg", value);
+}
+
+static void jit_newline(void)
+{
+    putchar('\n');
+}
+
+/* A READ which finds nothing leaves its variable as it was */
+static void jit_read_char(int *slot)
+{
+    char character;
+    if(scanf(" %c", &character) == 1) *slot = character;
+}
+
+static void jit_read_int(int *slot)
+{
+    (void)scanf("%d", slot);
+}
+
+static void jit_read_real(double *slot)
+{
+    (void)scanf("%lg", slot);
+}
+
+/* As TRIPS does on the virtual machine */
+static unsigned long long jit_trips(int from, int to, int by)
+{
+    if(by > 0) return from <= to ? (unsigned long long)((long long)to - from) / by + 1 : 0;
+    if(by < 0) return from >= to ? (unsigned long long)((long long)from - to) / -(long long)by + 1 : 0;
+    return from >= to ? ~0ull : 0;
+}
+
+/* The function takes the slots in %rdi and returns 0, or 1 or 2 for a division by zero or an
+** overflowing division. %rbx is saved first, which also aligns the stack for calls. */
+static void translate_to_machine_code(JIT_BUFFER *buffer, BC_PROGRAM *program)
+{
+    static const unsigned char PROLOGUE[] = {0x53, 0x48, 0x89, 0xFB};                 /* push %rbx; mov %rdi, %rbx */
+    static const unsigned char RETURN[] = {0x31, 0xC0, 0x5B, 0xC3};                   /* xor %eax, %eax; pop %rbx; ret */
+    static const unsigned char MOVSX_AL[] = {0x0F, 0xBE, 0xC0};                       /* movsbl %al, %eax */
+    static const unsigned char CDQ_IDIV_ECX[] = {0x99, 0xF7, 0xF9};                   /* cltd; idiv %ecx */
+    static const unsigned char SHL_CL[] = {0xD3, 0xE0};                               /* shl %cl, %eax */
+    static const unsigned char TEST_ECX[] = {0x85, 0xC9};                             /* test %ecx, %ecx */
+    static const unsigned char CMP_ECX_MINUS_1_JNE[] = {0x83, 0xF9, 0xFF, 0x75, 0x0B}; /* cmp $-1, %ecx; jne past the next two */
+    static const unsigned char CMP_EAX_INT_MIN[] = {0x3D, 0x00, 0x00, 0x00, 0x80};    /* cmp $INT_MIN, %eax */
+    static const unsigned char JE[] = {0x0F, 0x84};
+    static const unsigned char JNC[] = {0x0F, 0x83};
+    static const unsigned char SUB_1_64[] = {0x48, 0x83};                             /* subq $1, slot */
+    static const unsigned char INT_OPERATIONS[][2] = {{0x03}, {0x2B}, {0x0F, 0xAF}};  /* add, sub, imul */
+    static const unsigned char REAL_OPERATIONS[][3] = {{0xF2, 0x0F, 0x58}, {0xF2, 0x0F, 0x5C}, {0xF2, 0x0F, 0x59}, {0xF2, 0x0F, 0x5E}};
+    static const unsigned char STOP_WITH[] = {0x5B, 0xC3};                            /* pop %rbx; ret */
+    unsigned char jump[2] = {0x0F, 0};
+    int i;
+    emit_machine_bytes(buffer, PROLOGUE, sizeof(PROLOGUE));
+    for(i = 0; i < program->count && !buffer->failed; i++)
+    {
+        BC_INSTRUCTION *instruction = &program->code[i];
+        enum BcOp op = instruction->op;
+        buffer->starts[i] = buffer->length;
+        switch(op)
+        {
+            case BC_HALT:
+                emit_machine_bytes(buffer, RETURN, sizeof(RETURN));
+                break;
+            case BC_MOVE:
+                emit_slot_operand(buffer, MOV_LOAD_64, sizeof(MOV_LOAD_64), EAX, instruction->a);
+                emit_slot_operand(buffer, MOV_STORE_64, sizeof(MOV_STORE_64), EAX, instruction->dest);
+                break;
+            case BC_TO_CHAR:
+                emit_slot_operand(buffer, MOV_LOAD, sizeof(MOV_LOAD), EAX, instruction->a);
+                emit_machine_bytes(buffer, MOVSX_AL, sizeof(MOVSX_AL));
+                emit_slot_operand(buffer, MOV_STORE, sizeof(MOV_STORE), EAX, instruction->dest);
+                break;
+            case BC_TO_INT:
+                emit_slot_operand(buffer, CVTTSD2SI_LOAD, sizeof(CVTTSD2SI_LOAD), EAX, instruction->a);
+                emit_slot_operand(buffer, MOV_STORE, sizeof(MOV_STORE), EAX, instruction->dest);
+                break;
+            case BC_TO_REAL:
+                emit_slot_operand(buffer, CVTSI2SD_LOAD, sizeof(CVTSI2SD_LOAD), EAX, instruction->a);
+                emit_slot_operand(buffer, MOVSD_STORE, sizeof(MOVSD_STORE), EAX, instruction->dest);
+                break;
+            case BC_ADD_I:
+            case BC_SUB_I:
+            case BC_MUL_I:
+                emit_slot_operand(buffer, MOV_LOAD, sizeof(MOV_LOAD), EAX, instruction->a);
+                emit_slot_operand(buffer, INT_OPERATIONS[op - BC_ADD_I], op == BC_MUL_I ? 2 : 1, EAX, instruction->b);
+                emit_slot_operand(buffer, MOV_STORE, sizeof(MOV_STORE), EAX, instruction->dest);
+                break;
+            case BC_DIV_I:
+                emit_slot_operand(buffer, MOV_LOAD, sizeof(MOV_LOAD), ECX, instruction->b);
+                emit_slot_operand(buffer, MOV_LOAD, sizeof(MOV_LOAD), EAX, instruction->a);
+                emit_machine_bytes(buffer, TEST_ECX, sizeof(TEST_ECX));
+                emit_jump(buffer, JE, sizeof(JE), DIVIDED_BY_ZERO);
+                emit_machine_bytes(buffer, CMP_ECX_MINUS_1_JNE, sizeof(CMP_ECX_MINUS_1_JNE));
+                emit_machine_bytes(buffer, CMP_EAX_INT_MIN, sizeof(CMP_EAX_INT_MIN));
+                emit_jump(buffer, JE, sizeof(JE), DIVISION_OVERFLOWED);
+                emit_machine_bytes(buffer, CDQ_IDIV_ECX, sizeof(CDQ_IDIV_ECX));
+                emit_slot_operand(buffer, MOV_STORE, sizeof(MOV_STORE), EAX, instruction->dest);
+                break;
+            case BC_SHL_I:
+                /* shl counts modulo 32, as the virtual machine does */
+                emit_slot_operand(buffer, MOV_LOAD, sizeof(MOV_LOAD), EAX, instruction->a);
+                emit_slot_operand(buffer, MOV_LOAD, sizeof(MOV_LOAD), ECX, instruction->b);
+                emit_machine_bytes(buffer, SHL_CL, sizeof(SHL_CL));
+                emit_slot_operand(buffer, MOV_STORE, sizeof(MOV_STORE), EAX, instruction->dest);
+                break;
+            case BC_ADD_R:
+            case BC_SUB_R:
+            case BC_MUL_R:
+            case BC_DIV_R:
+                emit_slot_operand(buffer, MOVSD_LOAD, sizeof(MOVSD_LOAD), EAX, instruction->a);
+                emit_slot_operand(buffer, REAL_OPERATIONS[op - BC_ADD_R], 3, EAX, instruction->b);
+                emit_slot_operand(buffer, MOVSD_STORE, sizeof(MOVSD_STORE), EAX, instruction->dest);
+                break;
+            case BC_WRITE_C:
+            case BC_WRITE_I:
+                emit_slot_operand(buffer, MOV_LOAD, sizeof(MOV_LOAD), EDI, instruction->a);
+                emit_call(buffer, op == BC_WRITE_C ? (JIT_FUNCTION)jit_write_char : (JIT_FUNCTION)jit_write_int);
+                break;
+            case BC_WRITE_R:
+                emit_slot_operand(buffer, MOVSD_LOAD, sizeof(MOVSD_LOAD), EAX, instruction->a);
+                emit_call(buffer, (JIT_FUNCTION)jit_write_real);
+                break;
+            case BC_NEWLINE:
+                emit_call(buffer, (JIT_FUNCTION)jit_newline);
+                break;
+            case BC_READ_C:
+            case BC_READ_I:
+            case BC_READ_R:
+                emit_slot_operand(buffer, LEA_64, sizeof(LEA_64), EDI, instruction->dest);
+                emit_call(buffer, op == BC_READ_C ? (JIT_FUNCTION)jit_read_char :
+                    op == BC_READ_I ? (JIT_FUNCTION)jit_read_int : (JIT_FUNCTION)jit_read_real);
+                break;
+            case BC_JUMP:
+                emit_jump(buffer, JMP, sizeof(JMP), instruction->dest);
+                break;
+            case BC_TRIPS:
+                emit_slot_operand(buffer, MOV_LOAD, sizeof(MOV_LOAD), EDI, instruction->a);
+                emit_slot_operand(buffer, MOV_LOAD, sizeof(MOV_LOAD), ESI, instruction->b);
+                emit_slot_operand(buffer, MOV_LOAD, sizeof(MOV_LOAD), EDX, instruction->c);
+                emit_call(buffer, (JIT_FUNCTION)jit_trips);
+                emit_slot_operand(buffer, MOV_STORE_64, sizeof(MOV_STORE_64), EAX, instruction->dest);
+                break;
+            case BC_COUNT:
+                /* Subtracting one borrows only once the counter has run out */
+                emit_slot_operand(buffer, SUB_1_64, sizeof(SUB_1_64), 5, instruction->a);
+                emit_machine_bytes(buffer, (const unsigned char *)"\x01", 1);
+                emit_jump(buffer, JNC, sizeof(JNC), instruction->dest);
+                break;
+            default:
+                if(op >= BC_JEQ_I && op <= BC_JGE_I)
+                {
+                    emit_slot_operand(buffer, MOV_LOAD, sizeof(MOV_LOAD), EAX, instruction->a);
+                    emit_slot_operand(buffer, CMP_LOAD, sizeof(CMP_LOAD), EAX, instruction->b);
+                    jump[1] = INT_CONDITIONS[op - BC_JEQ_I];
+                    emit_jump(buffer, jump, sizeof(jump), instruction->dest);
+                }
+                else if(op >= BC_ADD_JEQ_I && op <= BC_ADD_JGE_I)
+                {
+                    emit_slot_operand(buffer, MOV_LOAD, sizeof(MOV_LOAD), EAX, instruction->a);
+                    emit_slot_operand(buffer, ADD_LOAD, sizeof(ADD_LOAD), EAX, instruction->c);
+                    emit_slot_operand(buffer, MOV_STORE, sizeof(MOV_STORE), EAX, instruction->a);
+                    emit_slot_operand(buffer, CMP_LOAD, sizeof(CMP_LOAD), EAX, instruction->b);
+                    jump[1] = INT_CONDITIONS[op - BC_ADD_JEQ_I];
+                    emit_jump(buffer, jump, sizeof(jump), instruction->dest);
+                }
+                else if(op >= BC_JEQ_R && op <= BC_JGE_R) emit_real_jump(buffer, instruction, (enum CompareSymType)(op - BC_JEQ_R), TRUE);
+                else emit_real_jump(buffer, instruction, (enum CompareSymType)(op - BC_JNOT_EQ_R), FALSE);
+                break;
+        }
+    }
+    buffer->starts[program->count] = buffer->length;
+
+    /* The division errors return 1 or 2 in %eax */
+    {
+        size_t divided_by_zero = buffer->length;
+        size_t overflowed;
+        emit_machine_bytes(buffer, (const unsigned char *)"\xB8\x01\x00\x00\x00", 5);
+        emit_machine_bytes(buffer, STOP_WITH, sizeof(STOP_WITH));
+        overflowed = buffer->length;
+        emit_machine_bytes(buffer, (const unsigned char *)"\xB8\x02\x00\x00\x00", 5);
+        emit_machine_bytes(buffer, STOP_WITH, sizeof(STOP_WITH));
+        if(buffer->failed) return;
+        for(i = 0; i < buffer->fixup_count; i++)
+        {
+            JIT_FIXUP *fixup = &buffer->fixups[i];
+            size_t target = fixup->target == DIVIDED_BY_ZERO ? divided_by_zero
+                : fixup->target == DIVISION_OVERFLOWED ? overflowed : buffer->starts[fixup->target];
+            int displacement = (int)((long long)target - (long long)(fixup->at + 4));
+            memcpy(&buffer->code[fixup->at], &displacement, 4);
+        }
+    }
+}
+
+static void emit_machine_bytes(JIT_BUFFER *buffer, const unsigned char *bytes, size_t length)
+{
+    if(buffer->failed) return;
+    if(buffer->length + length > buffer->capacity)
+    {
+        size_t capacity = buffer->capacity ? buffer->capacity : 4096;
+        unsigned char *grown;
+        while(capacity < buffer->length + length) capacity *= 2;
+        grown = (unsigned char *)realloc(buffer->code, capacity);
+        if(grown == NULL)
+        {
+            buffer->failed = TRUE;
+            return;
+        }
+        buffer->code = grown;
+        buffer->capacity = capacity;
+    }
+    memcpy(buffer->code + buffer->length, bytes, length);
+    buffer->length += length;
+}
+
+static void emit_int32(JIT_BUFFER *buffer, int value)
+{
+    unsigned char bytes[4];
+    memcpy(bytes, &value, 4);
+    emit_machine_bytes(buffer, bytes, 4);
+}
+
+/* An instruction with register reg and slot as [%rbx + 8*slot] */
+static void emit_slot_operand(JIT_BUFFER *buffer, const unsigned char *opcode, size_t length, int reg, int slot)
+{
+    unsigned char modrm = (unsigned char)(0x83 | reg << 3);
+    emit_machine_bytes(buffer, opcode, length);
+    emit_machine_bytes(buffer, &modrm, 1);
+    emit_int32(buffer, slot * (int)sizeof(BC_SLOT));
+}
+
+/* A branch to instruction target, or to a division error, patched once all are placed */
+static void emit_jump(JIT_BUFFER *buffer, const unsigned char *opcode, size_t length, int target)
+{
+    emit_machine_bytes(buffer, opcode, length);
+    if(buffer->failed) return;
+    if(buffer->fixup_count == buffer->fixup_capacity)
+    {
+        int capacity = buffer->fixup_capacity ? buffer->fixup_capacity*2 : 64;
+        JIT_FIXUP *grown = (JIT_FIXUP *)realloc(buffer->fixups, sizeof(JIT_FIXUP) * capacity);
+        if(grown == NULL)
+        {
+            buffer->failed = TRUE;
+            return;
+        }
+        buffer->fixups = grown;
+        buffer->fixup_capacity = capacity;
+    }
+    buffer->fixups[buffer->fixup_count].at = buffer->length;
+    buffer->fixups[buffer->fixup_count++].target = target;
+    emit_int32(buffer, 0);
+}
+
+/* ucomisd sets the flags as an unsigned comparison would, and all of them for a NaN. < and <=
+** compare the other way round, so that every ordering tests the carry flag; == and != test
+** parity for a NaN as well. The branch is taken when the comparison comes out as when. */
+static void emit_real_jump(JIT_BUFFER *buffer, BC_INSTRUCTION *instruction, enum CompareSymType compare, int when)
+{
+    static const unsigned char JP[] = {0x0F, 0x8A};
+    static const unsigned char JNE[] = {0x0F, 0x85};
+    static const unsigned char JE[] = {0x0F, 0x84};
+    static const unsigned char JP_OVER_JE[] = {0x7A, 0x06};
+    static const unsigned char ABOVE[][2] = {{0x0F, 0x86}, {0x0F, 0x87}};       /* jbe, ja */
+    static const unsigned char ABOVE_EQUAL[][2] = {{0x0F, 0x82}, {0x0F, 0x83}}; /* jb, jae */
+    int first = instruction->a;
+    int second = instruction->b;
+    if(compare == SYM_LESS_THAN || compare == SYM_LESS_THAN_EQ)
+    {
+        first = instruction->b;
+        second = instruction->a;
+        compare = compare == SYM_LESS_THAN ? SYM_GREATER_THAN : SYM_GREATER_THAN_EQ;
+    }
+    emit_slot_operand(buffer, MOVSD_LOAD, sizeof(MOVSD_LOAD), EAX, first);
+    emit_slot_operand(buffer, UCOMISD_LOAD, sizeof(UCOMISD_LOAD), EAX, second);
+    switch(compare)
+    {
+        case SYM_GREATER_THAN:
+            emit_jump(buffer, ABOVE[when != 0], 2, instruction->dest);
+            break;
+        case SYM_GREATER_THAN_EQ:
+            emit_jump(buffer, ABOVE_EQUAL[when != 0], 2, instruction->dest);
+            break;
+        default:
+            /* Equal is zero set and parity clear */
+            if(when == (compare == SYM_EQ_TO))
+            {
+                emit_machine_bytes(buffer, JP_OVER_JE, sizeof(JP_OVER_JE));
+                emit_jump(buffer, JE, sizeof(JE), instruction->dest);
+            }
+            else
+            {
+                emit_jump(buffer, JP, sizeof(JP), instruction->dest);
+                emit_jump(buffer, JNE, sizeof(JNE), instruction->dest);
+            }
+            break;
+    }
+}
+
+/* mov $function, %rax; call *%rax */
+static void emit_call(JIT_BUFFER *buffer, JIT_FUNCTION function)
+{
+    static const unsigned char MOV_RAX[] = {0x48, 0xB8};
+    static const unsigned char CALL_RAX[] = {0xFF, 0xD0};
+    unsigned char address[8];
+    memcpy(address, &function, 8);
+    emit_machine_bytes(buffer, MOV_RAX, sizeof(MOV_RAX));
+    emit_machine_bytes(buffer, address, 8);
+    emit_machine_bytes(buffer, CALL_RAX, sizeof(CALL_RAX));
+}
+
+#else
+
+/* Without executable pages to write machine code into, the virtual machine runs the program */
+int run_jit(BC_PROGRAM *program)
+{
+    return run_bytecode(program);
+}
+
+#endif
@@ -0,0 +1,561 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "include/arena.h"
+#include "include/compile.h"
+#include "include/ir.h"
+#include "include/lower_tree.h"
+#include "include/splio.h"
+#include "include/symbol_table.h"
+#include "include/tree_procedures.h"
+#include "include/types.h"
+
+/* Statements are appended to the sequence ending at tail. Instructions go into the block at
+** the end of that sequence, which is opened on demand and closed by any other statement. */
+typedef struct {
+    COMPILE_CONTEXT *ctx;
+    IR_PROGRAM *program;
+    IR_NODE **tail;
+    IR_NODE *block;
+    int failed;
+} IR_BUILDER;
+
+static void sanitise_identifier(COMPILE_CONTEXT *, int);
+static int lower_declarations(IR_BUILDER *, TERNARY_TREE);
+static IR_NODE *lower_sequence(IR_BUILDER *, TERNARY_TREE);
+static void lower_statement(IR_BUILDER *, TERNARY_TREE);
+static void lower_assignment(IR_BUILDER *, TERNARY_TREE);
+static void lower_for(IR_BUILDER *, TERNARY_TREE);
+static void lower_write(IR_BUILDER *, TERNARY_TREE);
+static IR_CONDITION *lower_condition(IR_BUILDER *, TERNARY_TREE);
+static IR_CONDITION *lower_compare(IR_BUILDER *, TERNARY_TREE, enum CompareSymType, TERNARY_TREE, IR_OPERAND);
+static IR_CONDITION *new_compare(IR_BUILDER *, IR_OPERAND, enum CompareSymType, IR_OPERAND);
+static IR_OPERAND lower_expression(IR_BUILDER *, TERNARY_TREE, IR_OPERAND *, enum SymbolTypes *);
+static IR_OPERAND lower_term(IR_BUILDER *, TERNARY_TREE, IR_OPERAND *, enum SymbolTypes *);
+static IR_OPERAND lower_value(IR_BUILDER *, TERNARY_TREE, IR_OPERAND *, enum SymbolTypes *);
+static void lower_into(IR_BUILDER *, TERNARY_TREE, IR_OPERAND, enum SymbolTypes *);
+static IR_OPERAND emit_binary(IR_BUILDER *, enum IrOp, IR_OPERAND, IR_OPERAND, IR_OPERAND *);
+static IR_INSTRUCTION *emit(IR_BUILDER *, enum IrOp, enum SymbolTypes);
+static void append_node(IR_BUILDER *, IR_NODE *);
+static int use_identifier(IR_BUILDER *, TERNARY_TREE);
+static int constant_step_sign(TERNARY_TREE);
+
+char *RESERVED_WORDS[] = {"auto", "double", "int", "struct", "break", "else", "long", "switch", "case", "enum", "register", "typedef", "char", "extern", "return", "union", "const", "float", "short", "unsigned", "continue", "for", "signed", "void", "default", "goto", "sizeof", "volatile", "do", "if", "static", "while",
+    /* and the names the generated program itself uses */
+    "main", "printf", "scanf", "putchar"};
+
+static void sanitise_identifier(COMPILE_CONTEXT *ctx, int sym_index)
+{
+    SYMTABNODEPTR sym_ptr = ctx->symTabRec->array[sym_index];
+    char *id = sym_ptr->identifier;
+    INFO("Sanitising identifier: %s\n", id)
+    const char gen_var_prefix = 'v';
+    int i;
+    int len = (int)(sizeof(RESERVED_WORDS) / sizeof(RESERVED_WORDS[0]));
+    /* Each symbol only needs checking once */
+    if(sym_ptr->sanitised) return;
+    sym_ptr->sanitised = TRUE;
+    for(i=0; i < len; i++) {
+        if(!strcmp(id, RESERVED_WORDS[i])) {
+            char var_name[2 + 3*sizeof(unsigned int)];
+            do {
+                snprintf(var_name, sizeof(var_name), "%c%u", gen_var_prefix, ctx->gen_var_count++);
+            } while (lookup_symbol(var_name, ctx->symTabRec) >= 0);
+            INFO("Sanitised variable name: %s\n", var_name)
+            rename_symbol(ctx->symTabRec, sym_index, var_name);
+            return;
+        }
+    }
+}
+
+/* Lower a parsed (and tree-optimised) program. The checks GenerateC used to make as it went
+** are made here: every variable is declared once, used only once declared, assigned values of
+** no wider a type, and written only once it has been given a value. Returns NULL once these
+** have been reported. */
+IR_PROGRAM *lower_tree(COMPILE_CONTEXT *ctx, TERNARY_TREE t)
+{
+    IR_BUILDER builder;
+    TERNARY_TREE block;
+    if(t == NULL || t->nodeIdentifier != PROGRAM) return NULL;
+
+    SYMTABNODEPTR prog_id_node = ctx->symTabRec->array[t->first->item];
+    sanitise_identifier(ctx, t->first->item);
+    prog_id_node->declared = TRUE;
+    prog_id_node->type = PROG_T;
+
+    memset(&builder, 0, sizeof(IR_BUILDER));
+    builder.ctx = ctx;
+    builder.program = create_ir_program(ctx->irArena, prog_id_node->identifier);
+    if(builder.program == NULL) return NULL;
+
+    /* Optimise moves the statements of a program without declarations into first */
+    block = t->second;
+    if(block->first != NULL && block->first->nodeIdentifier == DECLARATION_BLOCK)
+    {
+        if(lower_declarations(&builder, block->first) < 0) return NULL;
+        builder.program->body = lower_sequence(&builder, block->second);
+    }
+    else builder.program->body = lower_sequence(&builder, block->first != NULL ? block->first : block->second);
+    return builder.failed ? NULL : builder.program;
+}
+
+static int lower_declarations(IR_BUILDER *builder, TERNARY_TREE t)
+{
+    COMPILE_CONTEXT *ctx = builder->ctx;
+    TERNARY_TREE link;
+    TERNARY_TREE id;
+    for(link = t; link != NULL; link = link->second)
+    {
+        TERNARY_TREE declaration = link->first;
+        if(declaration == NULL) continue;
+        for(id = declaration->first; id != NULL; id = id->second)
+        {
+            int sym_index = id->first->item;
+            SYMTABNODEPTR current_sym = ctx->symTabRec->array[sym_index];
+            sanitise_identifier(ctx, sym_index);
+            if(current_sym->declared) {
+                ERROR(ctx->lineno, ctx->colno, "Variable with identifier \"%s\" has already been declared.", current_sym->identifier)
+                return -1;
+            }
+            current_sym->type = declaration->second->item;
+            current_sym->declared = TRUE;
+            if(add_ir_variable(builder->program, sym_index) < 0) return -1;
+        }
+    }
+    return 0;
+}
+
+/* Lower a STATEMENT_LIST into a sequence of its own, leaving the enclosing one as it was */
+static IR_NODE *lower_sequence(IR_BUILDER *builder, TERNARY_TREE t)
+{
+    IR_NODE *head = NULL;
+    IR_NODE **tail = builder->tail;
+    IR_NODE *block = builder->block;
+    TERNARY_TREE link;
+    builder->tail = &head;
+    builder->block = NULL;
+    for(link = t; link != NULL; link = link->second)
+    {
+        if(link->first != NULL) lower_statement(builder, link->first);
+    }
+    builder->tail = tail;
+    builder->block = block;
+    return head;
+}
+
+static void lower_statement(IR_BUILDER *builder, TERNARY_TREE t)
+{
+    IR_NODE *node;
+    int sym_index;
+    /* Stop at the first error, as GenerateC did */
+    if(builder->failed) return;
+    if(t->nodeIdentifier == STATEMENT) t = t->first;
+    switch(t->nodeIdentifier)
+    {
+        case ASSIGNMENT:
+            lower_assignment(builder, t);
+            return;
+        case IF_S:
+            node = new_ir_node(builder->program, IR_IF);
+            node->condition = lower_condition(builder, t->first);
+            node->body = lower_sequence(builder, t->second);
+            if(t->third != NULL) node->orelse = lower_sequence(builder, t->third);
+            append_node(builder, node);
+            return;
+        case WHILE_S:
+            node = new_ir_node(builder->program, IR_WHILE);
+            node->condition = lower_condition(builder, t->first);
+            node->body = lower_sequence(builder, t->second->first);
+            append_node(builder, node);
+            return;
+        case DO_S:
+            node = new_ir_node(builder->program, IR_DO);
+            node->body = lower_sequence(builder, t->first->first);
+            node->condition = lower_condition(builder, t->second);
+            append_node(builder, node);
+            return;
+        case FOR_S:
+            lower_for(builder, t);
+            return;
+        case WRITE_S:
+            lower_write(builder, t);
+            return;
+        case WRITE_NEWLINE:
+            emit(builder, IR_NEWLINE, UNKNOWN_T);
+            return;
+        case READ_S:
+        {
+            IR_INSTRUCTION *instruction;
+            sym_index = use_identifier(builder, t->first);
+            if(sym_index < 0) return;
+            instruction = emit(builder, IR_READ, builder->ctx->symTabRec->array[sym_index]->type);
+            if(instruction != NULL) instruction->dest = ir_variable(builder->ctx, sym_index);
+            builder->ctx->symTabRec->array[sym_index]->initialised = TRUE;
+            return;
+        }
+    }
+}
+
+static void lower_assignment(IR_BUILDER *builder, TERNARY_TREE t)
+{
+    COMPILE_CONTEXT *ctx = builder->ctx;
+    enum SymbolTypes value_type;
+    int sym_index = use_identifier(builder, t->second);
+    if(sym_index < 0) return;
+    SYMTABNODEPTR currSym = ctx->symTabRec->array[sym_index];
+    lower_into(builder, t->first, ir_variable(ctx, sym_index), &value_type);
+    if(currSym->type < value_type) {
+        ERROR(ctx->lineno, ctx->colno, "Invalid assignment: \"%s\" does not have the correct type.\n", currSym->identifier)
+        builder->failed = TRUE;
+        return;
+    }
+    currSym->initialised = TRUE;
+}
+
+/* The loop variable is set once by init. Each time round, the condition compares it with the
+** TO value and step adds the BY value, both of which are evaluated afresh every iteration, as
+** the body may change them; when it cannot, hoisting evaluates them once before the loop.
+** A constant BY decides the direction of the comparison; otherwise it is decided at run time,
+** continuing while (by > 0 && var <= to) || (!(by > 0) && var >= to), with BY and TO each
+** evaluated once by the first comparison and the rest reusing them. */
+static void lower_for(IR_BUILDER *builder, TERNARY_TREE t)
+{
+    COMPILE_CONTEXT *ctx = builder->ctx;
+    IR_PROGRAM *program = builder->program;
+    TERNARY_TREE for_assign = t->first;
+    TERNARY_TREE by = t->second->first;
+    TERNARY_TREE to = t->second->second;
+    IR_NODE **tail = builder->tail;
+    IR_NODE *block = builder->block;
+    enum SymbolTypes value_type;
+    int sym_index = use_identifier(builder, for_assign->first);
+    if(sym_index < 0) return;
+    SYMTABNODEPTR for_iter = ctx->symTabRec->array[sym_index];
+    if(for_iter->type == REAL_T) {
+        WARNING(ctx->lineno, 0, "Iterator \"%s\" defined as type REAL may cause the FOR loop to run perpetually.\n", for_iter->identifier)
+    }
+
+    IR_NODE *node = new_ir_node(program, IR_FOR);
+    if(node == NULL)
+    {
+        builder->failed = TRUE;
+        return;
+    }
+    node->variable = ir_variable(ctx, sym_index);
+
+    builder->tail = &node->init;
+    builder->block = NULL;
+    lower_into(builder, for_assign->second, node->variable, &value_type);
+    for_iter->initialised = TRUE;
+
+    int sign = constant_step_sign(by);
+    if(sign != 0)
+        node->condition = lower_compare(builder, NULL, sign > 0 ? SYM_LESS_THAN_EQ : SYM_GREATER_THAN_EQ, to, node->variable);
+    else
+    {
+        IR_CONDITION *upward = new_ir_condition(program, IR_AND);
+        IR_CONDITION *downward = new_ir_condition(program, IR_AND);
+        IR_CONDITION *not_upward = new_ir_condition(program, IR_NOT);
+        node->condition = new_ir_condition(program, IR_OR);
+        if(upward == NULL || downward == NULL || not_upward == NULL || node->condition == NULL)
+        {
+            builder->failed = TRUE;
+            return;
+        }
+        upward->first = lower_compare(builder, by, SYM_GREATER_THAN, NULL, ir_int_constant(0));
+        if(upward->first == NULL) return;
+        /* TO is needed whichever way the loop goes */
+        builder->tail = &upward->first->setup;
+        builder->block = NULL;
+        while(*builder->tail != NULL)
+        {
+            builder->block = *builder->tail;
+            builder->tail = &(*builder->tail)->next;
+        }
+        IR_OPERAND bound = lower_expression(builder, to, NULL, &value_type);
+        upward->second = new_compare(builder, node->variable, SYM_LESS_THAN_EQ, bound);
+        not_upward->first = new_compare(builder, upward->first->left, SYM_GREATER_THAN, ir_int_constant(0));
+        downward->first = not_upward;
+        downward->second = new_compare(builder, node->variable, SYM_GREATER_THAN_EQ, bound);
+        node->condition->first = upward;
+        node->condition->second = downward;
+    }
+
+    builder->tail = &node->step;
+    builder->block = NULL;
+    IR_OPERAND step = lower_expression(builder, by, NULL, &value_type);
+    emit_binary(builder, IR_ADD, node->variable, step, &node->variable);
+
+    builder->tail = tail;
+    builder->block = block;
+    node->body = lower_sequence(builder, t->third->first);
+    append_node(builder, node);
+}
+
+/* 1 or -1 when BY is a single constant, whose sign is that of the literal as written (so a
+** BY of 0 counts up, as it always has); 0 when it is only known at run time */
+static int constant_step_sign(TERNARY_TREE by)
+{
+    if(by->nodeIdentifier != EXPRESSION || by->first->nodeIdentifier != TERM
+        || by->first->first->nodeIdentifier != VAL_CONSTANT) return 0;
+    TERNARY_TREE constant = by->first->first->first;
+    if(constant->nodeIdentifier == CHAR_CONST) return 1;
+    switch(constant->first->nodeIdentifier)
+    {
+        case INT_CONST:
+        case FLOAT_CONST:
+            return 1;
+        case NEG_INT_CONST:
+        case NEG_FLOAT_CONST:
+            return -1;
+    }
+    return 0;
+}
+
+/* Every value is computed before any is printed, as printf's arguments were */
+static void lower_write(IR_BUILDER *builder, TERNARY_TREE t)
+{
+    COMPILE_CONTEXT *ctx = builder->ctx;
+    TERNARY_TREE link;
+    int count = 0;
+    int i;
+    for(link = t->first; link != NULL; link = link->second) count++;
+    IR_OPERAND *values = (IR_OPERAND *)arena_alloc(builder->program->arena, sizeof(IR_OPERAND) * count);
+    enum SymbolTypes *types = (enum SymbolTypes *)arena_alloc(builder->program->arena, sizeof(enum SymbolTypes) * count);
+    if(values == NULL || types == NULL)
+    {
+        builder->failed = TRUE;
+        return;
+    }
+    for(link = t->first, i = 0; link != NULL; link = link->second, i++)
+    {
+        values[i] = lower_value(builder, link->first, NULL, &types[i]);
+        if(link->first->nodeIdentifier == VAL_IDENTIFIER && values[i].kind == IR_VARIABLE)
+        {
+            SYMTABNODEPTR curr_sym = ctx->symTabRec->array[values[i].index];
+            if(!curr_sym->initialised) {
+                ERROR(ctx->lineno, ctx->colno, "Attempt to WRITE uninitialised variable \"%s\"\n", curr_sym->identifier)
+                builder->failed = TRUE;
+                return;
+            }
+        }
+    }
+    for(i = 0; i < count; i++)
+    {
+        IR_INSTRUCTION *instruction = emit(builder, IR_WRITE, types[i]);
+        if(instruction != NULL) instruction->a = values[i];
+    }
+}
+
+static IR_CONDITION *lower_condition(IR_BUILDER *builder, TERNARY_TREE t)
+{
+    IR_CONDITION *condition;
+    IR_OPERAND none = {IR_NONE, UNKNOWN_T, 0, 0};
+    switch(t->nodeIdentifier)
+    {
+        case CONDITIONAL:
+            return lower_condition(builder, t->first);
+        case COMPARISON:
+            return lower_compare(builder, t->first, t->second->item, t->third, none);
+        case NEGATION:
+            condition = new_ir_condition(builder->program, IR_NOT);
+            condition->first = lower_condition(builder, t->first);
+            return condition;
+        case LOG_AND:
+        case LOG_OR:
+            condition = new_ir_condition(builder->program, t->nodeIdentifier == LOG_AND ? IR_AND : IR_OR);
+            condition->first = lower_condition(builder, t->first);
+            condition->second = lower_condition(builder, t->second);
+            return condition;
+    }
+    return NULL;
+}
+
+/* A comparison gets its own setup sequence, so its operands are computed only when it is
+** tested. A side without an expression compares the operand given instead. */
+static IR_CONDITION *lower_compare(IR_BUILDER *builder, TERNARY_TREE left, enum CompareSymType compare, TERNARY_TREE right, IR_OPERAND operand)
+{
+    IR_CONDITION *condition = new_ir_condition(builder->program, IR_COMPARE);
+    IR_NODE **tail = builder->tail;
+    IR_NODE *block = builder->block;
+    enum SymbolTypes value_type;
+    if(condition == NULL)
+    {
+        builder->failed = TRUE;
+        return NULL;
+    }
+    condition->compare = compare;
+    builder->tail = &condition->setup;
+    builder->block = NULL;
+    condition->left = left != NULL ? lower_expression(builder, left, NULL, &value_type) : operand;
+    condition->right = right != NULL ? lower_expression(builder, right, NULL, &value_type) : operand;
+    condition->type = ir_arithmetic_type(condition->left.type, condition->right.type);
+    builder->tail = tail;
+    builder->block = block;
+    return condition;
+}
+
+/* A comparison of operands which are already evaluated, so with no setup */
+static IR_CONDITION *new_compare(IR_BUILDER *builder, IR_OPERAND left, enum CompareSymType compare, IR_OPERAND right)
+{
+    IR_CONDITION *condition = new_ir_condition(builder->program, IR_COMPARE);
+    if(condition == NULL)
+    {
+        builder->failed = TRUE;
+        return NULL;
+    }
+    condition->compare = compare;
+    condition->left = left;
+    condition->right = right;
+    condition->type = ir_arithmetic_type(left.type, right.type);
+    return condition;
+}
+
+/* Evaluate an expression into dest, which the last operation writes directly */
+static void lower_into(IR_BUILDER *builder, TERNARY_TREE t, IR_OPERAND dest, enum SymbolTypes *value_type)
+{
+    IR_OPERAND result = lower_expression(builder, t, &dest, value_type);
+    if(result.kind != dest.kind || result.index != dest.index)
+    {
+        IR_INSTRUCTION *instruction = emit(builder, IR_COPY, dest.type);
+        if(instruction == NULL) return;
+        instruction->dest = dest;
+        instruction->a = result;
+    }
+}
+
+/* Expressions and terms are chains evaluated left to right. Only the operation which completes
+** the chain may write dest; the rest produce temporaries. value_type is the widest type of the
+** operands, which is what WRITE prints and ASSIGNMENT checks. */
+static IR_OPERAND lower_expression(IR_BUILDER *builder, TERNARY_TREE t, IR_OPERAND *dest, enum SymbolTypes *value_type)
+{
+    enum SymbolTypes operand_type;
+    IR_OPERAND result = lower_term(builder, t->first, t->nodeIdentifier == EXPRESSION ? dest : NULL, value_type);
+    while(t->nodeIdentifier == EXPR_ADD || t->nodeIdentifier == EXPR_MINUS)
+    {
+        enum IrOp op = t->nodeIdentifier == EXPR_ADD ? IR_ADD : IR_SUB;
+        t = t->second;
+        IR_OPERAND operand = lower_term(builder, t->first, NULL, &operand_type);
+        if(operand_type > *value_type) *value_type = operand_type;
+        result = emit_binary(builder, op, result, operand, t->nodeIdentifier == EXPRESSION ? dest : NULL);
+    }
+    return result;
+}
+
+static IR_OPERAND lower_term(IR_BUILDER *builder, TERNARY_TREE t, IR_OPERAND *dest, enum SymbolTypes *value_type)
+{
+    enum SymbolTypes operand_type;
+    IR_OPERAND result = lower_value(builder, t->first, t->nodeIdentifier == TERM ? dest : NULL, value_type);
+    while(t->nodeIdentifier == TERM_MUL || t->nodeIdentifier == TERM_DIV)
+    {
+        enum IrOp op = t->nodeIdentifier == TERM_MUL ? IR_MUL : IR_DIV;
+        t = t->second;
+        IR_OPERAND operand = lower_value(builder, t->first, NULL, &operand_type);
+        if(operand_type > *value_type) *value_type = operand_type;
+        result = emit_binary(builder, op, result, operand, t->nodeIdentifier == TERM ? dest : NULL);
+    }
+    return result;
+}
+
+static IR_OPERAND lower_value(IR_BUILDER *builder, TERNARY_TREE t, IR_OPERAND *dest, enum SymbolTypes *value_type)
+{
+    TERNARY_TREE constant;
+    int sym_index;
+    switch(t->nodeIdentifier)
+    {
+        case VAL_IDENTIFIER:
+            sym_index = use_identifier(builder, t->first);
+            if(sym_index < 0) break;
+            *value_type = builder->ctx->symTabRec->array[sym_index]->type;
+            return ir_variable(builder->ctx, sym_index);
+        case VAL_EXPR:
+            return lower_expression(builder, t->first, dest, value_type);
+        case VAL_CONSTANT:
+            constant = t->first;
+            if(constant->nodeIdentifier == CHAR_CONST)
+            {
+                *value_type = CHAR_T;
+                return ir_char_constant(constant->item);
+            }
+            constant = constant->first;
+            *value_type = (constant->nodeIdentifier == FLOAT_CONST || constant->nodeIdentifier == NEG_FLOAT_CONST) ? REAL_T : INT_T;
+            switch(constant->nodeIdentifier)
+            {
+                case INT_CONST:
+                    return ir_int_constant(constant->item);
+                case NEG_INT_CONST:
+                    return ir_int_constant(-constant->item);
+                case FLOAT_CONST:
+                    return ir_real_constant(constant->item, FALSE);
+                case NEG_FLOAT_CONST:
+                    return ir_real_constant(constant->item, TRUE);
+            }
+            break;
+    }
+    *value_type = INT_T;
+    return ir_int_constant(0);
+}
+
+/* dest = a op b, or a fresh temporary when dest is NULL. The operation is carried out in the
+** type C would use and the result converted to the type of dest, as an assignment would. */
+static IR_OPERAND emit_binary(IR_BUILDER *builder, enum IrOp op, IR_OPERAND a, IR_OPERAND b, IR_OPERAND *dest)
+{
+    enum SymbolTypes type = ir_arithmetic_type(a.type, b.type);
+    IR_OPERAND result = dest != NULL ? *dest : new_ir_temp(builder->program, type);
+    IR_INSTRUCTION *instruction = emit(builder, op, type);
+    if(instruction == NULL) return result;
+    instruction->dest = result;
+    instruction->a = a;
+    instruction->b = b;
+    return result;
+}
+
+static IR_INSTRUCTION *emit(IR_BUILDER *builder, enum IrOp op, enum SymbolTypes type)
+{
+    IR_INSTRUCTION *instruction;
+    if(builder->block == NULL)
+    {
+        IR_NODE *block = new_ir_node(builder->program, IR_BLOCK);
+        if(block == NULL)
+        {
+            builder->failed = TRUE;
+            return NULL;
+        }
+        *builder->tail = block;
+        builder->tail = &block->next;
+        builder->block = block;
+    }
+    instruction = append_ir_instruction(builder->program, builder->block, op, type);
+    if(instruction == NULL) builder->failed = TRUE;
+    return instruction;
+}
+
+static void append_node(IR_BUILDER *builder, IR_NODE *node)
+{
+    if(node == NULL)
+    {
+        builder->failed = TRUE;
+        return;
+    }
+    *builder->tail = node;
+    builder->tail = &node->next;
+    builder->block = NULL;
+}
+
+static int use_identifier(IR_BUILDER *builder, TERNARY_TREE t)
+{
+    COMPILE_CONTEXT *ctx = builder->ctx;
+    SYMTABNODEPTR sym_ptr = ctx->symTabRec->array[t->item];
+    if(!sym_ptr->declared) {
+        ERROR(ctx->lineno, ctx->colno, "Unknown identifier \"%s\"\n", sym_ptr->identifier)
+        builder->failed = TRUE;
+        return -1;
+    }
+    if(sym_ptr->type == PROG_T) {
+        ERROR(ctx->lineno, ctx->colno, "\"%s\" names the program, not a variable\n", sym_ptr->identifier)
+        builder->failed = TRUE;
+        return -1;
+    }
+    return t->item;
+}
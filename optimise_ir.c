@@ -0,0 +1,38 @@
+#include "include/compile.h"
+#include "include/ir.h"
+#include "include/optimise_ir.h"
+#include "include/splio.h"
+
+/* Optimise the lowered program. Optimise has already folded what it can in the tree; the
+** passes here follow values through assignments and control flow. Each pass leaves the
+** program valid, so any of them can be left out. Conditions are folded as soon as constants
+** are known, so nothing after has to visit the branches which never run. Loops with constant
+** bounds are then unrolled, and both run again over the copies. Common
+** subexpressions go before hoisting, so each is hoisted once. Dead stores are
+** removed before hoisting as well as after it, so hoisting does not carry dead code out
+** through every loop around it. Declarations go last, once nothing more can be deleted. */
+void optimise_ir(COMPILE_CONTEXT *ctx, IR_PROGRAM *program)
+{
+    INFO("Optimisation: Propagating constants..\n")
+    propagate_constants(ctx, program);
+    INFO("Optimisation: Folding conditions..\n")
+    fold_conditions(ctx, program);
+    INFO("Optimisation: Unrolling loops..\n")
+    if(unroll_loops(ctx, program) > 0)
+    {
+        INFO("Optimisation: Propagating constants..\n")
+        propagate_constants(ctx, program);
+        INFO("Optimisation: Folding conditions..\n")
+        fold_conditions(ctx, program);
+    }
+    INFO("Optimisation: Eliminating common subexpressions..\n")
+    eliminate_common_subexpressions(ctx, program);
+    INFO("Optimisation: Eliminating dead stores..\n")
+    eliminate_dead_stores(ctx, program);
+    INFO("Optimisation: Hoisting loop invariants..\n")
+    hoist_loop_invariants(ctx, program);
+    INFO("Optimisation: Eliminating dead stores..\n")
+    eliminate_dead_stores(ctx, program);
+    INFO("Optimisation: Removing unused variables..\n")
+    remove_unused_variables(ctx, program);
+}
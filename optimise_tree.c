@@ -1,76 +1,45 @@
+#include <limits.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "include/arena.h"
+#include "include/compile.h"
+#include "include/ir.h"
+#include "include/optimise_ir.h"
 #include "include/optimise_tree.h"
 #include "include/splio.h"
+#include "include/symbol_table.h"
 #include "include/tree_procedures.h"
 #include "include/types.h"
 
 enum OperatorType {ADD, SUBTRACT, MUL, DIV};
 
-/* Define a structure to hold the current symbol data */
-typedef struct {
-    SYMTABNODEPTR node;
-    TERNARY_TREE *assignment_node;
-    int irremovable;
-    int used;
-} SYMTABNODEDATA;
-
-static SYMTABNODEDATA **symtabnode_data = NULL;
-
-static int expr_is_constant_val(TERNARY_TREE);
-static void replace_val_id(TERNARY_TREE *);
-static void elim_variables(TERNARY_TREE *);
-static TERNARY_TREE fold_constants(TERNARY_TREE, TERNARY_TREE, enum OperatorType);
-static void fold_expression(TERNARY_TREE *);
-static void fold_term(TERNARY_TREE *);
-
-static int expr_is_constant_val(TERNARY_TREE t) {
-    int retVal = TRUE;
-
-    switch(t->nodeIdentifier) {
-        case EXPR_ADD:
-        case EXPR_MINUS:
-            retVal = expr_is_constant_val(t->second);
-        case EXPRESSION:
-            retVal = retVal == FALSE ? FALSE : expr_is_constant_val(t->first);
-            return retVal;
-        case TERM_MUL:
-        case TERM_DIV:
-            retVal = expr_is_constant_val(t->second);
-        case TERM:
-            retVal = retVal == FALSE ? FALSE : expr_is_constant_val(t->first);
-            return retVal;
-        case VAL_IDENTIFIER:
-            return FALSE;
-        case VAL_EXPR:
-            return expr_is_constant_val(t->first);
-        case VAL_CONSTANT:
-            return TRUE;        
-    }
-
-    return FALSE;
-}
-
-static void replace_val_id(TERNARY_TREE *t) {
-    TERNARY_TREE this_node = *t;
-    if(this_node->first->nodeIdentifier != VAL_IDENTIFIER) return;
-    
-    int idNum = this_node->first->first->item; /* TERM -> VAL_IDENTIFIER -> ID_VAL */
-    SYMTABNODEDATA *sym_data = symtabnode_data[idNum];
-    if(sym_data->irremovable) return;
-    if(sym_data->assignment_node == NULL) {
-        sym_data->used;
-        return;
-    };
-
-    /* Now replace the VAL_IDENTIFIER WITH A VAL_EXPR */
-
-    TERNARY_TREE val_expr = create_inode(NOTHING, VAL_EXPR, (*(sym_data->assignment_node))->first, NULL, NULL);
-    TERNARY_TREE old_val = this_node->first;
-    this_node->first = val_expr;
-    free(old_val);
-    *t = this_node;
-}
-
-static TERNARY_TREE fold_constants(TERNARY_TREE left, TERNARY_TREE right, enum OperatorType op) {
+/* The IR operation each is carried out as */
+static const enum IrOp IR_OPERATORS[] = {IR_ADD, IR_SUB, IR_MUL, IR_DIV};
+
+/* Only constants written out in an expression are folded here. Following values through
+** assignments needs to know about control flow, so it is left to the passes over the lowered
+** program (see optimise_ir.c), as are identities such as x * 1, which become visible once
+** values are followed (see ir_simplify.c)
+**
+** Operator chains are evaluated left to right, so constants are only combined from the front
+** of a chain: in x - 1 + 2, 1 + 2 is not a subexpression. REAL constants are folded as the
+** generated program would compute them (see fold_reals), and the result written out as a new
+** literal which reads back as exactly the same double. */
+
+static TERNARY_TREE fold_constants(COMPILE_CONTEXT *, TERNARY_TREE, TERNARY_TREE, enum OperatorType);
+static TERNARY_TREE fold_real_constants(COMPILE_CONTEXT *, TERNARY_TREE, TERNARY_TREE, enum OperatorType);
+static double real_constant_value(COMPILE_CONTEXT *, TERNARY_TREE);
+static void fold_expression(COMPILE_CONTEXT *, TERNARY_TREE *);
+static void fold_term(COMPILE_CONTEXT *, TERNARY_TREE *);
+static void unwrap_constant(TERNARY_TREE *);
+static int is_operator_link(TERNARY_TREE);
+static void reassociate_chain(COMPILE_CONTEXT *, TERNARY_TREE *, int);
+static enum SymbolTypes operand_type(COMPILE_CONTEXT *, TERNARY_TREE);
+static void optimise_chain(COMPILE_CONTEXT *, TERNARY_TREE *);
+static void optimise_node(COMPILE_CONTEXT *, TERNARY_TREE *);
+
+static TERNARY_TREE fold_constants(COMPILE_CONTEXT *ctx, TERNARY_TREE left, TERNARY_TREE right, enum OperatorType op) {
 
     int left_is_number = left->nodeIdentifier == NUMBER_CONST;
     int right_is_number = right->nodeIdentifier == NUMBER_CONST;
@@ -82,14 +51,14 @@ static TERNARY_TREE fold_constants(TERNARY_TREE left, TERNARY_TREE right, enum O
 
     INFO("Optimisation: Folding expression: Types are correct\n")
 
-    /*We can fold chars and integers. However, we will leave the C compiler to interpret the given floating-point values */
+    /* Arithmetic with a REAL operand is carried out in double, just as C would */
     if( left_is_number
         && ( (left->first->nodeIdentifier == FLOAT_CONST) || (left->first->nodeIdentifier == NEG_FLOAT_CONST) ) ) {
-        return NULL;
+        return fold_real_constants(ctx, left, right, op);
     }
     if( right_is_number
         && ( (right->first->nodeIdentifier == FLOAT_CONST) || (right->first->nodeIdentifier == NEG_FLOAT_CONST) ) ) {
-        return NULL;
+        return fold_real_constants(ctx, left, right, op);
     }
     /* We have integers so we are good to continue */
     TERNARY_TREE number_left = left_is_number ? left->first : NULL;
@@ -114,203 +83,400 @@ static TERNARY_TREE fold_constants(TERNARY_TREE left, TERNARY_TREE right, enum O
     else val_2 = right->item;
 
     int val;
-    
-    switch(op){
-        case ADD:
-            val = val_1 + val_2;
-            INFO("Optimisation: Folded expression: %d + %d = %d\n", val_1, val_2, val)
-            break;
-        case SUBTRACT:
-            val = val_1 - val_2;
-            INFO("Optimisation: Folded expression: %d - %d = %d\n", val_1, val_2, val)
-            break;
-        case MUL:
-            val = val_1 * val_2;
-            INFO("Optimisation: Folded expression: %d * %d = %d\n", val_1, val_2, val)
-            break;
-        case DIV:
-            if(val_2 == 0) {
-                return NULL;
-            }
-            else {
-                val = val_1 / val_2;
-                INFO("Optimisation: Folded expression: %d / %d = %d\n", val_1, val_2, val)
-            }
-    }
+
+    /* Division by zero is left for run time, as is INT_MIN, which has no magnitude to write */
+    if(!fold_integers(IR_OPERATORS[op], val_1, val_2, &val) || val == INT_MIN) return NULL;
+    INFO("Optimisation: Folded expression: %d %s %d = %d\n", val_1, IR_OP_NAMES[IR_OPERATORS[op]], val_2, val)
+
+    /* Arithmetic on two characters gives a character, as WRITE would print it unfolded, but one
+    ** is written as a char, which would wrap a larger value */
+    if(!left_is_number && !right_is_number && (val < 0 || val > 127)) return NULL;
 
     int val_is_negative = val < 0;
 
-    TERNARY_TREE constant_bit = !(left_is_number && right_is_number)
-                              ? create_inode(val, CHAR_CONST, NULL, NULL, NULL)
-                              : create_inode(NOTHING, NUMBER_CONST,
-                                    create_inode(val_is_negative ? 0-val : val, val_is_negative ? NEG_INT_CONST : INT_CONST, NULL, NULL, NULL),
+    TERNARY_TREE constant_bit = !left_is_number && !right_is_number
+                              ? create_inode(ctx, val, CHAR_CONST, NULL, NULL, NULL)
+                              : create_inode(ctx, NOTHING, NUMBER_CONST,
+                                    create_inode(ctx, val_is_negative ? 0-val : val, val_is_negative ? NEG_INT_CONST : INT_CONST, NULL, NULL, NULL),
                                     NULL, NULL);
 
 
     INFO("Optimisation: Folding expression: Restructuring tree\n")
     
-    return create_inode(NOTHING, TERM,
-            create_inode(NOTHING, VAL_CONSTANT, constant_bit, NULL, NULL),
+    return create_inode(ctx, NOTHING, TERM,
+            create_inode(ctx, NOTHING, VAL_CONSTANT, constant_bit, NULL, NULL),
             NULL, NULL);
 
 }
 
-static void fold_expression(TERNARY_TREE *t)
+static TERNARY_TREE fold_real_constants(COMPILE_CONTEXT *ctx, TERNARY_TREE left, TERNARY_TREE right, enum OperatorType op) {
+
+    double val_1 = real_constant_value(ctx, left);
+    double val_2 = real_constant_value(ctx, right);
+    double val;
+
+    if(!fold_reals(IR_OPERATORS[op], val_1, val_2, &val)) return NULL;
+    int literal = install_real_literal(ctx->symTabRec, fabs(val));
+    if(literal < 0) return NULL;
+    INFO("Optimisation: Folded expression: %.17g %s %.17g = %.17g\n", val_1, IR_OP_NAMES[IR_OPERATORS[op]], val_2, val)
+
+    /* -0.0 is kept as the negation of 0.0 */
+    return create_inode(ctx, NOTHING, TERM,
+            create_inode(ctx, NOTHING, VAL_CONSTANT,
+                create_inode(ctx, NOTHING, NUMBER_CONST,
+                    create_inode(ctx, literal, signbit(val) ? NEG_FLOAT_CONST : FLOAT_CONST, NULL, NULL, NULL),
+                    NULL, NULL),
+                NULL, NULL),
+            NULL, NULL);
+}
+
+/* A CHAR_CONST or NUMBER_CONST as C would convert it to double */
+static double real_constant_value(COMPILE_CONTEXT *ctx, TERNARY_TREE constant) {
+    if(constant->nodeIdentifier == CHAR_CONST) return constant->item;
+    constant = constant->first;
+    switch(constant->nodeIdentifier) {
+        case NEG_INT_CONST:
+            return -(double)constant->item;
+        case FLOAT_CONST:
+            return ctx->symTabRec->array[constant->item]->value;
+        case NEG_FLOAT_CONST:
+            return -ctx->symTabRec->array[constant->item]->value;
+    }
+    return constant->item;
+}
+
+/* t is the head of an expression chain. While its first two terms are constants, they are
+** replaced by their folded value, which the rest of the chain follows. The constants further
+** along are then gathered up where that is allowed (see reassociate_chain). */
+static void fold_expression(COMPILE_CONTEXT *ctx, TERNARY_TREE *t)
 {
     if( (t == NULL) || (*t == NULL) ) {
-        /* This term does not exist */
+        /* This expression does not exist */
         return;
     }
-    TERNARY_TREE this_node = *t;
-    /* Always try to fold the first term */
-    fold_term(&(this_node->first));
-    if(this_node->first->nodeIdentifier != TERM || this_node->first->first->nodeIdentifier != VAL_CONSTANT) {
-        /* If the first branch could not be folded, then we cannot fold the expression */
-        return;
+    while( ((*t)->nodeIdentifier == EXPR_ADD) || ((*t)->nodeIdentifier == EXPR_MINUS) ) {
+        TERNARY_TREE this_node = *t;
+        TERNARY_TREE next = this_node->second; /* EXPRESSION->(THE REST OF THE CHAIN) */
+        TERNARY_TREE term_1 = this_node->first; /* EXPRESSION->TERM */
+        TERNARY_TREE term_2 = next->first; /* EXPRESSION->(THE REST OF THE CHAIN)->TERM */
+
+        /* Bracketed terms are folded by then, as Optimise visits the operands first */
+        if(term_1->nodeIdentifier != TERM || term_1->first->nodeIdentifier != VAL_CONSTANT
+            || term_2->nodeIdentifier != TERM || term_2->first->nodeIdentifier != VAL_CONSTANT) break;
+
+        INFO("Optimisation: About to fold constants within expression\n")
+        TERNARY_TREE folded_term = fold_constants(ctx, term_1->first->first, term_2->first->first,
+            this_node->nodeIdentifier == EXPR_ADD ? ADD : SUBTRACT);
+        if(!folded_term) break;
+
+        /* The replaced nodes are owned by the tree arena, so there is nothing to free */
+        *t = create_inode(ctx, next->item, next->nodeIdentifier, folded_term, next->second, next->third);
     }
-    if( this_node->nodeIdentifier == EXPRESSION ) {
-        /* Can't do anythong more here */
+    if( ((*t)->nodeIdentifier == EXPR_ADD) || ((*t)->nodeIdentifier == EXPR_MINUS) ) reassociate_chain(ctx, t, TRUE);
+}
+
+/* t is the head of a term chain, folded as fold_expression folds an expression */
+static void fold_term(COMPILE_CONTEXT *ctx, TERNARY_TREE *t)
+{
+    if( (t == NULL) || (*t == NULL) ) {
+        /* This term does not exist */
         return;
     }
+    unwrap_constant(&((*t)->first));
+    while( ((*t)->nodeIdentifier == TERM_MUL) || ((*t)->nodeIdentifier == TERM_DIV) ) {
+        TERNARY_TREE this_node = *t;
+        TERNARY_TREE next = this_node->second; /* TERM->(THE REST OF THE CHAIN) */
+        unwrap_constant(&(next->first));
+        if( (this_node->first->nodeIdentifier != VAL_CONSTANT)
+            || (next->first->nodeIdentifier != VAL_CONSTANT) ) {
+                /* ¯\_(ツ)_/¯ We tried */
+                break;
+            }
 
-    if(this_node->second->nodeIdentifier != EXPRESSION) {
-        /* Try to fold the constants within this expression */
-        fold_expression(&(this_node->second));
-        if(this_node->second->nodeIdentifier != EXPRESSION 
-            || this_node->second->first->nodeIdentifier != TERM 
-            || this_node->second->first->first->nodeIdentifier != VAL_CONSTANT) return;
+        TERNARY_TREE folded_term = fold_constants(ctx, this_node->first->first, next->first->first,
+            this_node->nodeIdentifier == TERM_MUL ? MUL : DIV);
+        if(!folded_term) {
+            break;
+        }
+        /* The folded TERM's constant takes the place of the first two values */
+        *t = create_inode(ctx, next->item, next->nodeIdentifier, folded_term->first, next->second, next->third);
     }
-    
-    /* Start trying to fold the constants within the expression */
-    TERNARY_TREE sub_expr_2  = this_node->second; /*  EXPRESSION->EXPRESSION */
-    TERNARY_TREE term_1      = this_node->first; /*               EXPRESSION->TERM */
-    TERNARY_TREE term_2      = sub_expr_2->first; /*  EXPRESSION->EXPRESSION->TERM */
-    TERNARY_TREE val_const_1 = term_1->first; /*                  EXPRESSION->TERM->VAL_CONSTANT */
-    TERNARY_TREE val_const_2 = term_2->first; /*      EXPRESSION->EXPRESSION->TERM->VAL_CONSTANT */
-    TERNARY_TREE const_1     = val_const_1->first; /*             EXPRESSION->TERM->VAL_CONSTANT->(SOME CONSTANT) */
-    TERNARY_TREE const_2     = val_const_2->first; /* EXPRESSION->EXPRESSION->TERM->VAL_CONSTANT->(SOME CONSTANT) */
-
-    int const_1_is_number = const_1->nodeIdentifier == NUMBER_CONST;
-    int const_2_is_number = const_2->nodeIdentifier == NUMBER_CONST;
-    TERNARY_TREE number_const_1 = const_1_is_number ? const_1->first : NULL;
-    TERNARY_TREE number_const_2 = const_2_is_number ? const_2->first : NULL;
-
-    enum OperatorType op;
-
-    if(this_node->nodeIdentifier == EXPR_ADD) {
-        op = ADD;
+    if( ((*t)->nodeIdentifier == TERM_MUL) || ((*t)->nodeIdentifier == TERM_DIV) ) reassociate_chain(ctx, t, FALSE);
+}
+
+/* ------------- reassociation --------------------------- */
+
+/* A chain is evaluated left to right, but in a run of operands which are only added to (or
+** subtracted from), or only multiplied into, what comes before them, the order does not matter
+** to the result, so the run's constants can be combined wherever they are: x + 1 + 2 is x + 3
+** and 2 * x * 3 is x * 6. A divisor ends a run, as does the first REAL operand, since the
+** arithmetic before it is in integers. Integer arithmetic wraps, so it is exact in any order,
+** and characters are integers. REAL arithmetic rounds after every operation, so its runs are
+** only reassociated when the program is compiled with --fast-math.
+**
+** A run which is combined is written back with its other operands in their order, followed by
+** its constant, unless the run begins the chain with an operand which is subtracted. */
+
+typedef struct {
+    TERNARY_TREE operand;       /* The TERM of a sum, or the value of a product */
+    int inverse;                /* Subtracted, or a divisor */
+    int item;                   /* The item of the link before the operand */
+    int run;                    /* -1 for an operand which cannot be moved */
+    int constant;
+} CHAIN_OPERAND;
+
+/* A run's constants combined. Characters only stay characters when every constant was one. */
+typedef struct {
+    enum SymbolTypes type;
+    int integer;
+    double real;
+} CHAIN_CONSTANT;
+
+static int combine_run(COMPILE_CONTEXT *, CHAIN_OPERAND *, int, int, int, CHAIN_CONSTANT *);
+static TERNARY_TREE chain_constant(COMPILE_CONTEXT *, CHAIN_CONSTANT *, int);
+
+static void reassociate_chain(COMPILE_CONTEXT *ctx, TERNARY_TREE *t, int is_sum)
+{
+    CHAIN_OPERAND local_operands[16];
+    CHAIN_OPERAND *operands = local_operands;
+    int capacity = 16;
+    int count = 0;
+    int constant_count = 0;
+    int minus_item = NOTHING;
+    int has_minus = FALSE;
+    int multiply_item = NOTHING;
+    int first_real;
+    int changed = FALSE;
+    int out = 0;
+    int run = 0;
+    int i;
+    TERNARY_TREE link = *t;
+    int inverse = FALSE;
+    int item = NOTHING;
+
+    for(;;) {
+        if(count == capacity) {
+            CHAIN_OPERAND *grown = (CHAIN_OPERAND *)malloc(sizeof(CHAIN_OPERAND) * capacity * 2);
+            if(grown == NULL) goto done;
+            memcpy(grown, operands, sizeof(CHAIN_OPERAND) * count);
+            if(operands != local_operands) free(operands);
+            operands = grown;
+            capacity *= 2;
+        }
+        if(!is_sum) unwrap_constant(&(link->first));
+        operands[count].operand = link->first;
+        operands[count].inverse = inverse;
+        operands[count].item = item;
+        operands[count].constant = is_sum
+            ? link->first->nodeIdentifier == TERM && link->first->first->nodeIdentifier == VAL_CONSTANT
+            : link->first->nodeIdentifier == VAL_CONSTANT;
+        if(operands[count].constant) constant_count++;
+        count++;
+        if(!is_operator_link(link)) break;
+        inverse = link->nodeIdentifier == EXPR_MINUS || link->nodeIdentifier == TERM_DIV;
+        item = link->item;
+        if(link->nodeIdentifier == EXPR_MINUS) {
+            minus_item = link->item;
+            has_minus = TRUE;
+        }
+        if(link->nodeIdentifier == TERM_MUL) multiply_item = link->item;
+        link = link->second;
     }
-    else if(this_node->nodeIdentifier == EXPR_MINUS) {
-        op = SUBTRACT;
+    if(constant_count < 2) goto done;
+
+    first_real = count;
+    for(i = 0; i < count; i++) {
+        enum SymbolTypes type = operand_type(ctx, operands[i].operand);
+        if(type == UNKNOWN_T) goto done;
+        if(type == REAL_T && first_real == count) {
+            first_real = i;
+            run++;
+        }
+        if( (i >= first_real && !ctx->options.fast_math) || (!is_sum && operands[i].inverse) ) {
+            operands[i].run = -1;
+            run++;
+        }
+        else operands[i].run = run;
     }
-    else return;
-
-    INFO("Optimisation: About to fold constants within expression\n")
-    TERNARY_TREE folded_term = fold_constants(const_1, const_2, op);
 
-    if(!folded_term) return;
+    /* The chain is written back over operands, which only ever shrinks */
+    i = 0;
+    while(i < count) {
+        CHAIN_CONSTANT combined = {UNKNOWN_T, 0, 0};
+        CHAIN_OPERAND folded;
+        TERNARY_TREE value = NULL;
+        int run_constants = 0;
+        int nonconstant = -1;
+        int leading = FALSE;
+        int end;
+        for(end = i; end < count && operands[end].run == operands[i].run; end++) {
+            if(operands[end].constant) run_constants++;
+            else if(nonconstant < 0) nonconstant = end;
+        }
 
-    *t = create_inode(NOTHING, EXPRESSION, folded_term, NULL, NULL);
+        if(operands[i].run >= 0 && run_constants >= 2
+            && combine_run(ctx, operands + i, end - i, is_sum, i >= first_real, &combined)) {
+            /* The constant can only lead when the run begins the chain */
+            leading = i == 0 && (nonconstant < 0 || operands[nonconstant].inverse);
+            folded.inverse = !leading && is_sum && has_minus
+                && (combined.type == REAL_T ? signbit(combined.real) : combined.integer < 0);
+            folded.item = folded.inverse ? minus_item : (is_sum || leading ? NOTHING : multiply_item);
+            folded.run = operands[i].run;
+            folded.constant = TRUE;
+            value = chain_constant(ctx, &combined, folded.inverse);
+        }
+        if(value == NULL) {
+            memmove(&operands[out], &operands[i], sizeof(CHAIN_OPERAND) * (end - i));
+            out += end - i;
+            i = end;
+            continue;
+        }
 
+        INFO("Optimisation: Reassociated %d constants of a %s\n", run_constants, is_sum ? "sum" : "product")
+        folded.operand = is_sum ? create_inode(ctx, NOTHING, TERM, value, NULL, NULL) : value;
+        if(leading) operands[out++] = folded;
+        for(; i < end; i++) {
+            if(!operands[i].constant) operands[out++] = operands[i];
+        }
+        if(!leading) operands[out++] = folded;
+        changed = TRUE;
+    }
 
-    /* Clean up */
-    free(sub_expr_2);
-    free(term_1);
-    free(term_2);
-    free(val_const_1);
-    free(val_const_2);
-    free(const_1);
-    free(const_2);
-    if(const_1_is_number) free(number_const_1);
-    if(const_2_is_number) free(number_const_2);
+    if(changed) {
+        link = create_inode(ctx, NOTHING, is_sum ? EXPRESSION : TERM, operands[out - 1].operand, NULL, NULL);
+        for(i = out - 2; i >= 0; i--) {
+            CHAIN_OPERAND *after = &operands[i + 1];
+            int identifier = is_sum ? (after->inverse ? EXPR_MINUS : EXPR_ADD) : (after->inverse ? TERM_DIV : TERM_MUL);
+            link = create_inode(ctx, after->item, identifier, operands[i].operand, link, NULL);
+        }
+        *t = link;
+    }
+done:
+    if(operands != local_operands) free(operands);
 }
 
-static void fold_term(TERNARY_TREE *t)
+/* Combine the constants of a run, in the order they appear. Returns FALSE when the result has
+** no constant to write it as. */
+static int combine_run(COMPILE_CONTEXT *ctx, CHAIN_OPERAND *run, int length, int is_sum, int is_real, CHAIN_CONSTANT *result)
 {
-    if( (t == NULL) || (*t == NULL) ) {
-        /* This term does not exist */
-        return;
-    }
-    TERNARY_TREE this_node = *t;
-    if( (this_node->first != NULL)
-        && (this_node->first->nodeIdentifier == VAL_EXPR) ) {
-            /* This term contains an expression within a value node, which could be folded.. 
-            /* this_node->VAL_EXPR->(SOME EXPRESSION TYPE) */
-            fold_expression(&(this_node->first->first));
+    unsigned int integer = is_sum ? 0 : 1;
+    double real = 0;
+    int first = TRUE;
+    int all_char = TRUE;
+    int i;
+
+    for(i = 0; i < length; i++) {
+        if(!run[i].constant) continue;
+        TERNARY_TREE constant = (is_sum ? run[i].operand->first : run[i].operand)->first;
+        if(is_real) {
+            double value = real_constant_value(ctx, constant);
+            if(first) real = is_sum && run[i].inverse ? -value : value;
+            else if(!fold_reals(is_sum ? (run[i].inverse ? IR_SUB : IR_ADD) : IR_MUL, real, value, &real)) return FALSE;
+            first = FALSE;
+            continue;
+        }
+        unsigned int value = (unsigned int)(int)real_constant_value(ctx, constant);
+        if(constant->nodeIdentifier != CHAR_CONST) all_char = FALSE;
+        if(!is_sum) integer *= value;
+        else if(run[i].inverse) integer -= value;
+        else integer += value;
     }
-    if(this_node->nodeIdentifier == TERM || this_node->first->nodeIdentifier != VAL_CONSTANT) {
-        /* This term is already as good as it's going to get */
-        return;
+
+    if(is_real) {
+        result->type = REAL_T;
+        result->real = real;
+        return TRUE;
     }
-    if(this_node->second->nodeIdentifier != TERM) {
-        /* If the second term is a multiplication or division, try to fold that first */
-        fold_term(&(this_node->second));
+    result->integer = (int)integer;
+    result->type = all_char ? CHAR_T : INT_T;
+    /* A character constant is written as a char, and INT_MIN has no magnitude to write */
+    if(all_char) return result->integer >= 0 && result->integer <= 127;
+    return result->integer != INT_MIN;
+}
 
+/* The VAL_CONSTANT for a combined constant, or its negation, or NULL if it has none */
+static TERNARY_TREE chain_constant(COMPILE_CONTEXT *ctx, CHAIN_CONSTANT *constant, int negate)
+{
+    TERNARY_TREE number;
+    if(constant->type == CHAR_T) {
+        return create_inode(ctx, NOTHING, VAL_CONSTANT,
+            create_inode(ctx, constant->integer, CHAR_CONST, NULL, NULL, NULL), NULL, NULL);
     }
-    if(this_node->second->first->nodeIdentifier == VAL_EXPR) {
-        fold_expression(&(this_node->second));
+    if(constant->type == REAL_T) {
+        double value = negate ? -constant->real : constant->real;
+        int literal = install_real_literal(ctx->symTabRec, fabs(value));
+        if(literal < 0) return NULL;
+        number = create_inode(ctx, literal, signbit(value) ? NEG_FLOAT_CONST : FLOAT_CONST, NULL, NULL, NULL);
     }
-    if( (this_node->second->nodeIdentifier != TERM)
-        && (this_node->second->first->nodeIdentifier != VAL_CONSTANT) ) {
-            /* ¯\_(ツ)_/¯ We tried */
-            return;
-        }   
-
-    /* We can now try to fold the constants */
-    TERNARY_TREE sub_term_2  = this_node->second; /*  TERM->TERM */
-    TERNARY_TREE val_const_1 = this_node->first; /*         TERM->VAL_CONSTANT */
-    TERNARY_TREE val_const_2 = sub_term_2->first; /*  TERM->TERM->VAL_CONSTANT */
-    TERNARY_TREE const_1     = val_const_1->first; /*       TERM->VAL_CONSTANT->(SOME CONSTANT) */
-    TERNARY_TREE const_2     = val_const_2->first; /* TERM->TERM->VAL_CONSTANT->(SOME CONSTANT) */
-
-    int const_1_is_number = const_1->nodeIdentifier == NUMBER_CONST;
-    int const_2_is_number = const_2->nodeIdentifier == NUMBER_CONST;
-
-    /*We can fold chars and integers. However, we will leave the C compiler to interpret the given floating-point values */
-    if( const_1_is_number
-        && (const_1->first->nodeIdentifier == FLOAT_CONST) || (const_1->first->nodeIdentifier == NEG_FLOAT_CONST) ) {
-        return;
-        if( const_2_is_number 
-            && (const_2->first->nodeIdentifier == FLOAT_CONST) || (const_2->first->nodeIdentifier == NEG_FLOAT_CONST) ) {
-                return;
-        }
+    else {
+        int value = negate ? -constant->integer : constant->integer;
+        number = create_inode(ctx, value < 0 ? -value : value, value < 0 ? NEG_INT_CONST : INT_CONST, NULL, NULL, NULL);
     }
-    /* We have integers so we are good to continue */
-    TERNARY_TREE number_const_1 = const_1_is_number ? const_1->first : NULL;
-    TERNARY_TREE number_const_2 = const_2_is_number ? const_2->first : NULL;
-
-    int is_negative_1 = const_1_is_number ? ((const_1->nodeIdentifier == NEG_INT_CONST) ? 1 : 0) : 0;
-    int is_negative_2 = const_1_is_number ? ((const_2->nodeIdentifier == NEG_INT_CONST) ? 1 : 0) : 0;    
+    return create_inode(ctx, NOTHING, VAL_CONSTANT,
+        create_inode(ctx, NOTHING, NUMBER_CONST, number, NULL, NULL), NULL, NULL);
+}
 
-    enum OperatorType op;
-    
-        if(this_node->nodeIdentifier == TERM_MUL) {
-            op = MUL;
-        }
-        else if(this_node->nodeIdentifier == TERM_DIV) {
-            op = DIV;
+/* The widest type of the values in an expression, term or value, as lowering gives it, or
+** UNKNOWN_T if it uses anything which is not a variable */
+static enum SymbolTypes operand_type(COMPILE_CONTEXT *ctx, TERNARY_TREE t)
+{
+    enum SymbolTypes widest = UNKNOWN_T;
+    enum SymbolTypes type;
+    for(; t != NULL; t = is_operator_link(t) ? t->second : NULL) {
+        switch(t->nodeIdentifier) {
+            case EXPRESSION:
+            case EXPR_ADD:
+            case EXPR_MINUS:
+            case TERM:
+            case TERM_MUL:
+            case TERM_DIV:
+                type = operand_type(ctx, t->first);
+                break;
+            case VAL_EXPR:
+                /* A bracket is typed once, and its item, which is otherwise unused, keeps the type
+                ** for the chains around it. Folding inside it never changes the type. */
+                if(t->item == NOTHING) t->item = operand_type(ctx, t->first);
+                type = t->item;
+                break;
+            case VAL_IDENTIFIER:
+                /* Undeclared identifiers are installed with UNKNOWN_T */
+                type = ctx->symTabRec->array[t->first->item]->type;
+                break;
+            case VAL_CONSTANT:
+                if(t->first->nodeIdentifier == CHAR_CONST) type = CHAR_T;
+                else if(t->first->first->nodeIdentifier == FLOAT_CONST || t->first->first->nodeIdentifier == NEG_FLOAT_CONST) type = REAL_T;
+                else type = INT_T;
+                break;
+            default:
+                type = UNKNOWN_T;
+                break;
         }
-        else return;
-
-    TERNARY_TREE folded_term = fold_constants(const_1, const_2, op);
+        if(type != CHAR_T && type != INT_T && type != REAL_T) return UNKNOWN_T;
+        if(type > widest) widest = type;
+    }
+    return widest;
+}
 
-    if(!folded_term) {
-        return;
+/* A bracketed expression which has been folded down to a constant is replaced by the constant */
+static void unwrap_constant(TERNARY_TREE *value)
+{
+    TERNARY_TREE expression;
+    if(*value == NULL || (*value)->nodeIdentifier != VAL_EXPR) return;
+    expression = (*value)->first;
+    if(expression->nodeIdentifier == EXPRESSION && expression->first->nodeIdentifier == TERM
+        && expression->first->first->nodeIdentifier == VAL_CONSTANT) {
+        *value = expression->first->first;
     }
-    *t = folded_term;
-
-    /* Clean up */
-    free(sub_term_2);
-    free(val_const_1);
-    free(val_const_2);
-    free(const_1);
-    free(const_2);
-    if(const_1_is_number) free(number_const_1);
-    if(const_2_is_number) free(number_const_2);
+}
+
+static int is_operator_link(TERNARY_TREE t)
+{
+    return t->nodeIdentifier == EXPR_ADD || t->nodeIdentifier == EXPR_MINUS
+        || t->nodeIdentifier == TERM_MUL || t->nodeIdentifier == TERM_DIV;
 }
 
 
-void Optimise(TERNARY_TREE *t)
+void Optimise(COMPILE_CONTEXT *ctx, TERNARY_TREE *t)
 {
     /* 
     /* What can we optimise?
@@ -321,28 +487,55 @@ void Optimise(TERNARY_TREE *t)
         return;
     }
     TERNARY_TREE this_node = *t;
-     /* If we are inside a loop then we may not want to optimise assignments as they could happen more than once
-     ** If an assignment is made on each loop where the value assigned is the same every time, then we may want to optimise this out the loop 
-     ** We check to see if the node is a LOOP_BODY (DO_S), FOR_S OR WHILE_S
-     */
-    static int inside_loop = FALSE;
-    if((this_node->nodeIdentifier == LOOP_BODY) || (this_node->nodeIdentifier == WHILE_S) || (this_node->nodeIdentifier == FOR_S)) inside_loop = TRUE;
-
-    if(symtabnode_data == NULL){
-        symtabnode_data = malloc(sizeof(SYMTABNODEDATA *)*symTabRec->in_use);
-        int node_data_num;
-        for(node_data_num = 0; node_data_num < symTabRec->in_use; node_data_num++) {
-            SYMTABNODEDATA *new = malloc(sizeof(SYMTABNODEDATA));
-            new->node = symTabRec->array[node_data_num];
-            new->used = FALSE;
-            new->irremovable = FALSE;
-            symtabnode_data[node_data_num] = new;
+
+    if(is_chain_link(this_node)) {
+        optimise_chain(ctx, t);
+        return;
+    }
+
+    Optimise(ctx, &(this_node->first));
+    Optimise(ctx, &(this_node->second));
+    Optimise(ctx, &(this_node->third));
+    optimise_node(ctx, t);
+}
+
+/* Optimise a list or operator chain without recursing once per link. The operands are visited
+** front to back and the links are then rewritten back to front, which is the same order as
+** recursing down second would give. An operator chain is only folded from its head. */
+static void optimise_chain(COMPILE_CONTEXT *ctx, TERNARY_TREE *t)
+{
+    TERNARY_TREE *local_slots[16];
+    TERNARY_TREE **slots = local_slots;
+    int capacity = 16;
+    int count = 0;
+    TERNARY_TREE *slot = t;
+
+    while(is_chain_link(*slot)) {
+        if(count == capacity) {
+            TERNARY_TREE **grown = (TERNARY_TREE **)malloc(sizeof(TERNARY_TREE *) * capacity * 2);
+            memcpy(grown, slots, sizeof(TERNARY_TREE *) * count);
+            if(slots != local_slots) free(slots);
+            slots = grown;
+            capacity *= 2;
         }
+        slots[count++] = slot;
+        Optimise(ctx, &((*slot)->first));
+        Optimise(ctx, &((*slot)->third));
+        slot = &((*slot)->second);
+    }
+    /* The terminating EXPRESSION or TERM, if any */
+    Optimise(ctx, slot);
+
+    while(count > 0) {
+        count--;
+        if(count == 0 || !is_operator_link(*slots[count])) optimise_node(ctx, slots[count]);
     }
+    if(slots != local_slots) free(slots);
+}
 
-    Optimise(&(this_node->first));
-    Optimise(&(this_node->second));
-    Optimise(&(this_node->third));
+static void optimise_node(COMPILE_CONTEXT *ctx, TERNARY_TREE *t)
+{
+    TERNARY_TREE this_node = *t;
     /*INFO("Optimisation: Current node pointer is %p, identifier is %d", this_node, this_node->nodeIdentifier)
     INFO("Optimisation: Current node is %s\n", NODE_TYPE_NAMES[this_node->nodeIdentifier]);*/
     switch(this_node->nodeIdentifier)
@@ -360,8 +553,15 @@ void Optimise(TERNARY_TREE *t)
                 *t = NULL;
             }
             break;
-        case DECLARATION:
+        case DECLARATION: {
+            /* Expressions are typed by reassociate_chain before lowering declares the variables,
+            ** so their types are filled in now. Lowering sets the same types again. */
+            TERNARY_TREE id;
+            for(id = this_node->first; id != NULL; id = id->second) {
+                ctx->symTabRec->array[id->first->item]->type = this_node->second->item;
+            }
             break;
+        }
         case ID_LIST:
             break;
         case TYPE_P:
@@ -369,7 +569,7 @@ void Optimise(TERNARY_TREE *t)
         case STATEMENT_LIST:
             if(this_node->first == NULL) {
                 if(this_node->second == NULL) {
-                    free(*t);
+                    *t = NULL;
                 }
                 else {
                     *t = this_node->second;
@@ -379,38 +579,16 @@ void Optimise(TERNARY_TREE *t)
         case STATEMENT:
             break;
         case ASSIGNMENT:
-        {
-            int idNum = this_node->second->item;
-
-            SYMTABNODEDATA *curr = symtabnode_data[idNum];
-            if(curr->assignment_node && !curr->irremovable && !curr->used) {
-                /*free*/
-            }
-
-            /* Determine whether the value being assigned in constant or not. */
-            if(!expr_is_constant_val(this_node->first)){
-                curr->assignment_node = t;
-                break;
-            }
-
-            /* Get the identifier being assigned to */
-            symtabnode_data[idNum]->assignment_node = t;
-            INFO("Found assignment")
             break;
-        }
         case IF_S:
             break;
         case DO_S:
-            inside_loop = FALSE;
             break;
         case WHILE_S:
-            inside_loop = FALSE;
             break;
         case FOR_S:
-            inside_loop = FALSE;
             break;
         case FOR_ASSIGN:
-            symtabnode_data[this_node->first->item]->irremovable = TRUE;
             break;
         case FOR_PROPERTIES:
             break;
@@ -421,17 +599,9 @@ void Optimise(TERNARY_TREE *t)
         case WRITE_NEWLINE:
             break;
         case READ_S:
-            symtabnode_data[this_node->first->item]->used = TRUE;
-            symtabnode_data[this_node->first->item]->irremovable = TRUE;
             break;
         case OUTPUT_LIST:
-        {
-            if(this_node->first->nodeIdentifier != VAL_IDENTIFIER) {
-                break;
-            }
-            if(!inside_loop)
-                replace_val_id(t);
-        }
+            break;
         case CONDITIONAL:
             break;
         case NEGATION:
@@ -448,25 +618,20 @@ void Optimise(TERNARY_TREE *t)
             break;
         case EXPR_ADD:
             INFO("Attempting to fold expression..\n")
-            fold_expression(t);
+            fold_expression(ctx, t);
             break;
         case EXPR_MINUS:
             INFO("Attempting to fold expression..\n")
-            fold_expression(t);
+            fold_expression(ctx, t);
             break;
         case TERM:
-        {
-            if(this_node->first->nodeIdentifier != VAL_IDENTIFIER) break;
-            if(!inside_loop) 
-                replace_val_id(t);
-        }
         case TERM_MUL:
             INFO("Attempting to fold term..\n")
-            fold_term(t);
+            fold_term(ctx, t);
             break;
         case TERM_DIV:
             INFO("Attempting to fold term..\n")
-            fold_term(t);
+            fold_term(ctx, t);
             break;
         case VAL_IDENTIFIER:
             break;
@@ -1,17 +1,243 @@
+#include <errno.h>
 #include <stdio.h>
-int yyparse(void);
+#include <stdlib.h>
+#include <string.h>
+#include "include/batch.h"
+#include "include/bytecode.h"
+#include "include/compile.h"
+#include "include/compile_stats.h"
 
-int main(void)
+static int compile_stdin(const char *, const COMPILE_OPTIONS *, COMPILE_STATS *);
+static int run_program(const char *, const COMPILE_OPTIONS *, COMPILE_STATS *);
+static void usage(const char *);
+
+/* With no files the program is read from stdin and the C written to stdout, or to the file
+** named by -o. Given files, they are compiled as one batch on a pool of threads and -o names
+** the directory for the output. --stats reports where the time and memory went, as text or
+** JSON on stderr, and --trace writes the phases as Chrome trace events. --fast-math lets REAL
+** arithmetic be reassociated, which may change its rounding. --asm writes x86-64 assembly for
+** the GNU assembler in place of C. --unroll=N sets how many instructions a FOR loop with
+** constant bounds may be unrolled into, 0 for none. --run compiles the one program named to
+** bytecode and runs it straight away, leaving stdin for it to READ; --jit does the same but
+** compiles the bytecode on to machine code first. */
+int main(int argc, char **argv)
 {
+    int retVal;
+    int arg;
+    int jobs = 0;
+    int file_count = 0;
+    const char *output_path = NULL;
+    const char *trace_path = NULL;
+    int stats_format = -1;      /* -1 for no report, otherwise the json flag */
+    COMPILE_OPTIONS options;
+    COMPILE_STATS stats;
+    char **files;
     #if YYDEBUG == 1
     extern int yydebug;
     yydebug = 1;
     #endif
-    
-    return (yyparse());
+
+    default_compile_options(&options);
+    files = (char **)malloc(sizeof(char *) * argc);
+    if(files == NULL) return 2;
+    for(arg = 1; arg < argc; arg++)
+    {
+        if((!strcmp(argv[arg], "--jobs") || !strcmp(argv[arg], "-j")) && arg + 1 < argc)
+        {
+            jobs = atoi(argv[++arg]);
+        }
+        else if(!strncmp(argv[arg], "--jobs=", 7))
+        {
+            jobs = atoi(argv[arg] + 7);
+        }
+        else if(!strcmp(argv[arg], "--stats") || !strcmp(argv[arg], "--stats=text"))
+        {
+            stats_format = 0;
+        }
+        else if(!strcmp(argv[arg], "--stats=json"))
+        {
+            stats_format = 1;
+        }
+        else if(!strcmp(argv[arg], "--trace") && arg + 1 < argc)
+        {
+            trace_path = argv[++arg];
+        }
+        else if(!strncmp(argv[arg], "--trace=", 8))
+        {
+            trace_path = argv[arg] + 8;
+        }
+        else if(!strcmp(argv[arg], "--fast-math"))
+        {
+            options.fast_math = 1;
+        }
+        else if(!strcmp(argv[arg], "--asm"))
+        {
+            options.assembly = 1;
+        }
+        else if(!strcmp(argv[arg], "--run"))
+        {
+            options.run = 1;
+        }
+        else if(!strcmp(argv[arg], "--jit"))
+        {
+            options.run = 1;
+            options.jit = 1;
+        }
+        else if(!strncmp(argv[arg], "--unroll=", 9))
+        {
+            options.unroll_budget = atoi(argv[arg] + 9);
+        }
+        else if(!strcmp(argv[arg], "-o") && arg + 1 < argc)
+        {
+            output_path = argv[++arg];
+        }
+        else if(argv[arg][0] == '-')
+        {
+            usage(argv[0]);
+            free(files);
+            return 2;
+        }
+        else files[file_count++] = argv[arg];
+    }
+
+    if(options.run && file_count != 1)
+    {
+        usage(argv[0]);
+        free(files);
+        return 2;
+    }
+
+    int collecting = stats_format >= 0 || trace_path != NULL;
+    init_compile_stats(&stats, trace_path != NULL, monotonic_seconds());
+    if(options.run)
+    {
+        retVal = run_program(files[0], &options, collecting ? &stats : NULL);
+    }
+    else if(file_count == 0)
+    {
+        retVal = compile_stdin(output_path, &options, collecting ? &stats : NULL);
+    }
+    else
+    {
+        retVal = compile_batch(files, file_count, output_path, jobs, &options, collecting ? &stats : NULL);
+        retVal = retVal > 0 ? 1 : 0;
+    }
+    free(files);
+
+    if(stats_format >= 0) report_compile_stats(stderr, &stats, stats_format);
+    if(trace_path != NULL && write_trace(trace_path, &stats) != 0)
+    {
+        fprintf(stderr, "Error : Could not write %s\n", trace_path);
+        if(retVal == 0) retVal = 1;
+    }
+    free_compile_stats(&stats);
+    return retVal;
+}
+
+static int compile_stdin(const char *output_path, const COMPILE_OPTIONS *options, COMPILE_STATS *stats)
+{
+    int retVal;
+    size_t length;
+    char *source;
+    COMPILE_CONTEXT *ctx;
+
+    ctx = create_compile_context();
+    if(ctx == NULL) return 2;
+    ctx->stats = stats;
+    ctx->options = *options;
+    if(stats != NULL) stats->label = "stdin";
+
+    begin_phase(ctx, PHASE_READ);
+    source = read_source(stdin, &length);
+    end_phase(ctx, PHASE_READ);
+    if(source == NULL)
+    {
+        fprintf(stderr, "Error : Could not read the program\n");
+        destroy_compile_context(ctx);
+        return 1;
+    }
+
+    retVal = compile_source(ctx, source, length);
+    if(retVal == 0)
+    {
+        /* Nothing is written unless the whole program compiled */
+        begin_phase(ctx, PHASE_WRITE);
+        FILE *output = output_path != NULL ? fopen(output_path, "wb") : stdout;
+        if(output == NULL || write_compiled_output(output, ctx) != 0)
+        {
+            fprintf(stderr, "Error : Could not write %s\n", output_path != NULL ? output_path : "the output");
+            retVal = 1;
+        }
+        if(output != NULL && output != stdout) fclose(output);
+        end_phase(ctx, PHASE_WRITE);
+    }
+
+    /* Every tree node, symbol and identifier is owned by the context's arenas */
+    #ifdef ARENA_STATS
+    report_compile_arenas(stderr, ctx);
+    #endif
+    destroy_compile_context(ctx);
+    free(source);
+    return retVal < 0 ? 1 : retVal;
+}
+
+/* Compile the program at path to bytecode and run it on the compiler's own stdin and stdout.
+** Returns what the program exits with: 1 if it divides by zero, as for any failure here. */
+static int run_program(const char *path, const COMPILE_OPTIONS *options, COMPILE_STATS *stats)
+{
+    int retVal;
+    size_t length;
+    char *source;
+    COMPILE_CONTEXT *ctx;
+    FILE *input = fopen(path, "rb");
+    if(input == NULL)
+    {
+        fprintf(stderr, "%s: %s\n", path, strerror(errno));
+        return 1;
+    }
+
+    ctx = create_compile_context();
+    if(ctx == NULL)
+    {
+        fclose(input);
+        return 2;
+    }
+    ctx->stats = stats;
+    ctx->options = *options;
+    if(stats != NULL) stats->label = path;
+
+    begin_phase(ctx, PHASE_READ);
+    source = read_source(input, &length);
+    end_phase(ctx, PHASE_READ);
+    fclose(input);
+    if(source == NULL)
+    {
+        fprintf(stderr, "Error : Could not read %s\n", path);
+        destroy_compile_context(ctx);
+        return 1;
+    }
+
+    retVal = compile_source(ctx, source, length);
+    if(retVal == 0 && ctx->bytecode != NULL)
+    {
+        begin_phase(ctx, PHASE_RUN);
+        retVal = ctx->options.jit ? run_jit(ctx->bytecode) : run_bytecode(ctx->bytecode);
+        end_phase(ctx, PHASE_RUN);
+        if(retVal < 0) fprintf(stderr, "Error : Could not run %s\n", path);
+    }
+
+    #ifdef ARENA_STATS
+    report_compile_arenas(stderr, ctx);
+    #endif
+    destroy_compile_context(ctx);
+    free(source);
+    return retVal < 0 ? 1 : retVal;
 }
 
-void yyerror(char *s)
+static void usage(const char *program)
 {
-    fprintf(stderr, "Error : Exiting %s\n", s);
+    fprintf(stderr, "Usage: %s [-o program.c] < program.spl\n", program);
+    fprintf(stderr, "       %s [--jobs N] program.spl... [-o output_dir/]\n", program);
+    fprintf(stderr, "       %s --run|--jit program.spl < input\n", program);
+    fprintf(stderr, "Each form also takes --stats[=text|json], --trace trace.json, --fast-math, --asm and --unroll=N\n");
 }
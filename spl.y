@@ -8,7 +8,6 @@
 
 #define DO_TREE_OPS
 
-#include <time.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -17,44 +16,68 @@
 
 
 #if defined DO_TREE_OPS && defined ME
+#include "include/arena.h"
 #include "include/colours.h"
 #include "include/codegen.h"
+#include "include/compile.h"
+#include "include/compile_stats.h"
+#include "include/ir.h"
+#include "include/lower_tree.h"
+#include "include/optimise_ir.h"
 #include "include/optimise_tree.h"
 #include "include/splio.h"
+#include "include/string_builder.h"
 #include "include/symbol_table.h"
 #include "include/tree_procedures.h"
 #elif defined DO_TREE_OPS
 #include "include/colours.h"
 #include "include/splio.h"
+#include "arena.c"
+#include "string_builder.c"
 #include "symbol_table.c"
 #include "utils.c"
+#include "ir.c"
+#include "lower_tree.c"
+#include "ir_simplify.c"
+#include "ir_dataflow.c"
+#include "ir_loops.c"
+#include "ir_branches.c"
+#include "ir_values.c"
+#include "ir_unroll.c"
+#include "optimise_ir.c"
 #include "codegen.c"
+#include "codegen_asm.c"
+#include "bytecode.c"
+#include "vm.c"
+#include "jit.c"
 #include "optimise_tree.c"
 #include "tree_procedures.c"
 #include "types.c"
+#include "compile_stats.c"
 #endif
-
-int yycolumn = 1;
-
-/* ------------- forward declarations --------------------------- */
-
-
-void yyerror(char *);
-extern int yylex(void);
-
-extern int yylineno;
-extern int *lineno;
-extern int *colno;
 %}
 
+/* The parser and scanner keep no state of their own between calls; everything belongs to the
+** scanner handle and the compile context which are passed in */
+%define api.pure full
+%lex-param   { void *scanner }
+%parse-param { void *scanner } { COMPILE_CONTEXT *ctx }
+
 %locations
 
 %defines
 
 /* Include types.h again so that it is included in the bison header file */
 %code requires { 
+    #include "include/compile.h"
     #include "include/types.h"
-    extern int yycolumn;
+}
+
+/* ------------- forward declarations --------------------------- */
+
+%code {
+    int yylex(YYSTYPE *, YYLTYPE *, void *);
+    void yyerror(YYLTYPE *, void *, COMPILE_CONTEXT *, const char *);
 }
 
 /****************/
@@ -70,6 +93,11 @@ extern int *colno;
 %union {
     int iVal;
     TERNARY_TREE  tVal;
+    /* Lists are built left-recursively, so the last link is carried along to append in O(1) */
+    struct {
+        TERNARY_TREE head;
+        TERNARY_TREE tail;
+    } lVal;
 }
 
 %token COLON FULLSTOP SEMICOLON COMMA ASSIGN BRA KET PLUS MINUS MULTIPLY DIVIDE 
@@ -82,63 +110,21 @@ extern int *colno;
 %token<iVal> IDENTIFIER INT CHAR FLOAT
 
 /* Whereas Rules return a tVal type (Tree) */
-%type<tVal> program block declaration_block declaration identifier_list identifier
-%type<tVal> type statement_list statement assignment_statement if_statement do_statement
+%type<tVal> program block declaration identifier
+%type<tVal> type statement assignment_statement if_statement do_statement
 %type<tVal> while_statement for_statement for_assign for_props loop_body
-%type<tVal> write_statement read_statement output_list conditional comparison comparator
-%type<tVal> expression term value constant number_constant
+%type<tVal> write_statement read_statement conditional comparison comparator
+%type<tVal> value constant number_constant
+
+/* and list rules return an lVal (the head and tail of a chain of nodes) */
+%type<lVal> declaration_block identifier_list statement_list output_list expression term
 
 %%
 program                 :  identifier  COLON  block  ENDP  identifier  FULLSTOP
                         {
                         #ifdef DO_TREE_OPS
-                            TERNARY_TREE ParseTree;
-                            ParseTree = create_inode(NOTHING, PROGRAM, $1, $3, $5);
-                        #ifdef DEBUG
-                            PrintTree(ParseTree, 0);
-                        #endif
-                            Optimise(&ParseTree);
-                        #ifdef DEBUG
-                            PrintTree(ParseTree, 0);
-                        #else
-                            int retVal = 0;
-                            const char *temp_dir = "spl_compiler";
-                            const char *extension = ".c";
-                            time_t seconds_since_epoch = time(NULL);
-                            long ticks = seconds_since_epoch*CLOCKS_PER_SEC;
-                            INFO("Ticks since epoch, %ld\n", ticks)
-                            size_t name_length = 
-                                strlen(temp_dir) + snprintf(NULL, 0, "%ld", ticks) + strlen(extension) + 1;
-                            char *file_name = (char *)malloc(name_length);
-                            INFO("Name length %zd, ptr is %p\n", name_length, file_name)
-                            snprintf(file_name, name_length, "%s%ld%s", temp_dir, ticks, extension);
-                            INFO("Creating file \"%s\"\n", file_name)
-                            FILE *output = fopen(file_name, "a");
-                            INFO("File name is %s, pointer is %p\n", file_name, output)
-                            INFO("Generating code..\n")
-                            lineno = &yylineno;
-                            colno  = &yycolumn;
-                            retVal = GenerateC(ParseTree, 0, output);
-                            fclose(output);
-                            if(retVal >  -1) {
-                                output = fopen(file_name, "r");
-                                char* read_buf = (char *)malloc(100);
-                                INFO("Attempting to print code..\n")
-                                while(fgets(read_buf, 100, output)!=NULL)
-                                {
-                                    printf("%s", read_buf);
-                                }
-                                fclose(output);
-                                free(read_buf);
-                            }
-                            else printf("Compilation failed.\n");
-                            int ret = remove(file_name);
-                            if(!ret)
-                            {
-                                INFO("Temp file removed successfully.\n")
-                            }
-                            free(file_name);
-                        #endif /*    DEBUG    */
+                            /* The passes over the tree are run by compile_source once parsing succeeds */
+                            ctx->parseTree = create_inode(ctx, NOTHING, PROGRAM, $1, $3, $5);
                         #endif /* DO_TREE_OPS */
                         }
                         ;
@@ -146,13 +132,13 @@ program                 :  identifier  COLON  block  ENDP  identifier  FULLSTOP
 block                   : DECLARATIONS  declaration_block  CODE  statement_list
                         {
 #ifdef DO_TREE_OPS
-                            $$ = create_inode(NOTHING, BLOCK, $2, $4, NULL);
+                            $$ = create_inode(ctx, NOTHING, BLOCK, $2.head, $4.head, NULL);
 #endif
                         }  
                         | CODE  statement_list
                         {
 #ifdef DO_TREE_OPS
-                            $$ = create_inode(NOTHING, BLOCK, $2, NULL, NULL);
+                            $$ = create_inode(ctx, NOTHING, BLOCK, $2.head, NULL, NULL);
 #endif
                         }
                         ;
@@ -160,13 +146,15 @@ block                   : DECLARATIONS  declaration_block  CODE  statement_list
 declaration_block       :  declaration
                         {
 #ifdef DO_TREE_OPS
-                            $$ = create_inode(NOTHING, DECLARATION_BLOCK, $1, NULL, NULL);
+                            $$.head = $$.tail = create_inode(ctx, NOTHING, DECLARATION_BLOCK, $1, NULL, NULL);
 #endif
                         }
-                        |  declaration  declaration_block
+                        |  declaration_block  declaration
                         {
 #ifdef DO_TREE_OPS
-                            $$ = create_inode(NOTHING, DECLARATION_BLOCK, $1, $2, NULL);
+                            $$.head = $1.head;
+                            $$.tail = link_inode($1.tail, DECLARATION_BLOCK, NOTHING,
+                                create_inode(ctx, NOTHING, DECLARATION_BLOCK, $2, NULL, NULL));
 #endif
                         }
                         ;
@@ -174,7 +162,7 @@ declaration_block       :  declaration
 declaration             :  identifier_list  OF TYPE  type  SEMICOLON
                         {
 #ifdef DO_TREE_OPS
-                            $$ = create_inode(NOTHING, DECLARATION, $1, $4, NULL);
+                            $$ = create_inode(ctx, NOTHING, DECLARATION, $1.head, $4, NULL);
 #endif
                         }
                         ;
@@ -182,13 +170,15 @@ declaration             :  identifier_list  OF TYPE  type  SEMICOLON
 identifier_list         :  identifier
                         {
 #ifdef DO_TREE_OPS
-                            $$ = create_inode(NOTHING, ID_LIST, $1, NULL, NULL);
+                            $$.head = $$.tail = create_inode(ctx, NOTHING, ID_LIST, $1, NULL, NULL);
 #endif
                         }
-                        |  identifier  COMMA  identifier_list
+                        |  identifier_list  COMMA  identifier
                         {
 #ifdef DO_TREE_OPS
-                            $$ = create_inode(NOTHING, ID_LIST, $1, $3, NULL);
+                            $$.head = $1.head;
+                            $$.tail = link_inode($1.tail, ID_LIST, NOTHING,
+                                create_inode(ctx, NOTHING, ID_LIST, $3, NULL, NULL));
 #endif
                         }
                         ;
@@ -196,19 +186,19 @@ identifier_list         :  identifier
 type                    : CHARACTER
                         {
 #ifdef DO_TREE_OPS
-                            $$ = create_inode(CHAR_T, TYPE_P, NULL, NULL, NULL);
+                            $$ = create_inode(ctx, CHAR_T, TYPE_P, NULL, NULL, NULL);
 #endif
                         }
                         | INTEGER
                         {
 #ifdef DO_TREE_OPS
-                            $$ = create_inode(INT_T, TYPE_P, NULL, NULL, NULL);
+                            $$ = create_inode(ctx, INT_T, TYPE_P, NULL, NULL, NULL);
 #endif
                         }
                         | REAL
                         {
 #ifdef DO_TREE_OPS
-                            $$ = create_inode(REAL_T, TYPE_P, NULL, NULL, NULL);
+                            $$ = create_inode(ctx, REAL_T, TYPE_P, NULL, NULL, NULL);
 #endif
                         }
                         ;
@@ -216,13 +206,15 @@ type                    : CHARACTER
 statement_list          :  statement
                         {
 #ifdef DO_TREE_OPS
-                            $$ = create_inode(NOTHING, STATEMENT_LIST, $1, NULL, NULL);
+                            $$.head = $$.tail = create_inode(ctx, NOTHING, STATEMENT_LIST, $1, NULL, NULL);
 #endif
                         }
-                        |  statement  SEMICOLON  statement_list
+                        |  statement_list  SEMICOLON  statement
                         {
 #ifdef DO_TREE_OPS
-                            $$ = create_inode(NOTHING, STATEMENT_LIST, $1, $3, NULL);
+                            $$.head = $1.head;
+                            $$.tail = link_inode($1.tail, STATEMENT_LIST, NOTHING,
+                                create_inode(ctx, NOTHING, STATEMENT_LIST, $3, NULL, NULL));
 #endif
                         }
                         ;
@@ -230,43 +222,43 @@ statement_list          :  statement
 statement               :  assignment_statement
                         {
 #ifdef DO_TREE_OPS
-                            $$ = create_inode(NOTHING, STATEMENT, $1, NULL, NULL);
+                            $$ = create_inode(ctx, NOTHING, STATEMENT, $1, NULL, NULL);
 #endif
                         }
                         |  if_statement
                         {
 #ifdef DO_TREE_OPS
-                            $$ = create_inode(NOTHING, STATEMENT, $1, NULL, NULL);
+                            $$ = create_inode(ctx, NOTHING, STATEMENT, $1, NULL, NULL);
 #endif
                         }
                         |  do_statement
                         {
 #ifdef DO_TREE_OPS
-                            $$ = create_inode(NOTHING, STATEMENT, $1, NULL, NULL);
+                            $$ = create_inode(ctx, NOTHING, STATEMENT, $1, NULL, NULL);
 #endif
                         }
                         |  while_statement
                         {
 #ifdef DO_TREE_OPS
-                            $$ = create_inode(NOTHING, STATEMENT, $1, NULL, NULL);
+                            $$ = create_inode(ctx, NOTHING, STATEMENT, $1, NULL, NULL);
 #endif
                         }
                         |  for_statement
                         {
 #ifdef DO_TREE_OPS
-                            $$ = create_inode(NOTHING, STATEMENT, $1, NULL, NULL);
+                            $$ = create_inode(ctx, NOTHING, STATEMENT, $1, NULL, NULL);
 #endif
                         }
                         |  write_statement
                         {
 #ifdef DO_TREE_OPS
-                            $$ = create_inode(NOTHING, STATEMENT, $1, NULL, NULL);
+                            $$ = create_inode(ctx, NOTHING, STATEMENT, $1, NULL, NULL);
 #endif
                         }
                         |  read_statement
                         {
 #ifdef DO_TREE_OPS
-                            $$ = create_inode(NOTHING, STATEMENT, $1, NULL, NULL);
+                            $$ = create_inode(ctx, NOTHING, STATEMENT, $1, NULL, NULL);
 #endif
                         }
                         ;
@@ -274,7 +266,7 @@ statement               :  assignment_statement
 assignment_statement    :  expression  ASSIGN  identifier
                         {
 #ifdef DO_TREE_OPS
-                            $$ = create_inode(NOTHING, ASSIGNMENT, $1, $3, NULL);
+                            $$ = create_inode(ctx, NOTHING, ASSIGNMENT, $1.head, $3, NULL);
 #endif
                         }
                         ;
@@ -282,13 +274,13 @@ assignment_statement    :  expression  ASSIGN  identifier
 if_statement            : IF  conditional  THEN  statement_list  ENDIF
                         {
 #ifdef DO_TREE_OPS
-                            $$ = create_inode(NOTHING, IF_S, $2, $4, NULL);
+                            $$ = create_inode(ctx, NOTHING, IF_S, $2, $4.head, NULL);
 #endif
                         }
                         | IF  conditional  THEN  statement_list  ELSE  statement_list  ENDIF
                         {
 #ifdef DO_TREE_OPS
-                            $$ = create_inode(NOTHING, IF_S, $2, $4, $6);
+                            $$ = create_inode(ctx, NOTHING, IF_S, $2, $4.head, $6.head);
 #endif
                         }
                         ;
@@ -296,7 +288,7 @@ if_statement            : IF  conditional  THEN  statement_list  ENDIF
 do_statement            : loop_body  WHILE  conditional  ENDDO
                         {
 #ifdef DO_TREE_OPS
-                            $$ = create_inode(NOTHING, DO_S, $1, $3, NULL);
+                            $$ = create_inode(ctx, NOTHING, DO_S, $1, $3, NULL);
 #endif
                         }
                         ;
@@ -304,7 +296,7 @@ do_statement            : loop_body  WHILE  conditional  ENDDO
 while_statement         : WHILE  conditional loop_body  ENDWHILE
                         {
 #ifdef DO_TREE_OPS
-                            $$ = create_inode(NOTHING, WHILE_S, $2, $3, NULL);
+                            $$ = create_inode(ctx, NOTHING, WHILE_S, $2, $3, NULL);
 #endif
                         }
                         ;
@@ -312,7 +304,7 @@ while_statement         : WHILE  conditional loop_body  ENDWHILE
 for_statement           : FOR  for_assign  for_props  loop_body  ENDFOR
                         {
 #ifdef DO_TREE_OPS
-                            $$ = create_inode(NOTHING, FOR_S, $2, $3, $4);
+                            $$ = create_inode(ctx, NOTHING, FOR_S, $2, $3, $4);
 #endif
                         }
                         ;
@@ -320,14 +312,14 @@ for_statement           : FOR  for_assign  for_props  loop_body  ENDFOR
 for_assign              : identifier IS expression
                         {
 #ifdef DO_TREE_OPS
-                            $$ = create_inode(NOTHING, FOR_ASSIGN, $1, $3, NULL);
+                            $$ = create_inode(ctx, NOTHING, FOR_ASSIGN, $1, $3.head, NULL);
 #endif
                         }
 
 for_props               : BY expression TO expression
                         {
 #ifdef DO_TREE_OPS
-                            $$ = create_inode(NOTHING, FOR_PROPERTIES, $2, $4, NULL);
+                            $$ = create_inode(ctx, NOTHING, FOR_PROPERTIES, $2.head, $4.head, NULL);
 #endif
                         }
 
@@ -335,20 +327,20 @@ for_props               : BY expression TO expression
 loop_body               : DO statement_list
                         {
 #ifdef DO_TREE_OPS
-                            $$ = create_inode(NOTHING, LOOP_BODY, $2, NULL, NULL);
+                            $$ = create_inode(ctx, NOTHING, LOOP_BODY, $2.head, NULL, NULL);
 #endif
                         }
  
 write_statement         : WRITE BRA  output_list  KET
                         {
 #ifdef DO_TREE_OPS
-                            $$ = create_inode(NOTHING, WRITE_S, $3, NULL, NULL);
+                            $$ = create_inode(ctx, NOTHING, WRITE_S, $3.head, NULL, NULL);
 #endif
                         }
                         | NEWLINE
                         {
 #ifdef DO_TREE_OPS
-                            $$ = create_inode(NOTHING, WRITE_NEWLINE, NULL, NULL, NULL);
+                            $$ = create_inode(ctx, NOTHING, WRITE_NEWLINE, NULL, NULL, NULL);
 #endif
                         }
                         ;
@@ -356,7 +348,7 @@ write_statement         : WRITE BRA  output_list  KET
 read_statement          : READ BRA  identifier  KET
                         {
 #ifdef DO_TREE_OPS
-                            $$ = create_inode(NOTHING, READ_S, $3, NULL, NULL);
+                            $$ = create_inode(ctx, NOTHING, READ_S, $3, NULL, NULL);
 #endif
                         }
                         ;
@@ -364,13 +356,15 @@ read_statement          : READ BRA  identifier  KET
 output_list             :  value
                         {
 #ifdef DO_TREE_OPS
-                            $$ = create_inode(NOTHING, OUTPUT_LIST, $1, NULL, NULL);
+                            $$.head = $$.tail = create_inode(ctx, NOTHING, OUTPUT_LIST, $1, NULL, NULL);
 #endif
                         } 
-                        |  value  COMMA  output_list
+                        |  output_list  COMMA  value
                         {
 #ifdef DO_TREE_OPS
-                            $$ = create_inode(NOTHING, OUTPUT_LIST, $1, $3, NULL);
+                            $$.head = $1.head;
+                            $$.tail = link_inode($1.tail, OUTPUT_LIST, NOTHING,
+                                create_inode(ctx, NOTHING, OUTPUT_LIST, $3, NULL, NULL));
 #endif
                         }
                         ;
@@ -378,25 +372,25 @@ output_list             :  value
 conditional             :  comparison
                         {
 #ifdef DO_TREE_OPS
-                            $$ = create_inode(NOTHING, CONDITIONAL, $1, NULL, NULL);
+                            $$ = create_inode(ctx, NOTHING, CONDITIONAL, $1, NULL, NULL);
 #endif
                         }  
                         |  NOT conditional
                         {
 #ifdef DO_TREE_OPS
-                            $$ = create_inode(NOTHING, NEGATION, $2, NULL, NULL);
+                            $$ = create_inode(ctx, NOTHING, NEGATION, $2, NULL, NULL);
 #endif
                         }
                         |  comparison   AND  conditional
                         {
 #ifdef DO_TREE_OPS
-                            $$ = create_inode(NOTHING, LOG_AND, $1, $3, NULL);
+                            $$ = create_inode(ctx, NOTHING, LOG_AND, $1, $3, NULL);
 #endif
                         }
                         |  comparison  OR  conditional
                         {
 #ifdef DO_TREE_OPS
-                            $$ = create_inode(OR, LOG_OR, $1, $3, NULL);
+                            $$ = create_inode(ctx, OR, LOG_OR, $1, $3, NULL);
 #endif
                         }
                         ;
@@ -404,7 +398,7 @@ conditional             :  comparison
 comparison              :  expression comparator expression
                         {
 #ifdef DO_TREE_OPS
-                            $$ = create_inode(NOTHING, COMPARISON, $1, $2, $3);
+                            $$ = create_inode(ctx, NOTHING, COMPARISON, $1.head, $2, $3.head);
 #endif
                         }
                         ;
@@ -412,76 +406,86 @@ comparison              :  expression comparator expression
 comparator              : EQUAL_TO
                         {
 #ifdef DO_TREE_OPS
-                            $$ = create_inode(SYM_EQ_TO, COMPARATOR, NULL, NULL, NULL);
+                            $$ = create_inode(ctx, SYM_EQ_TO, COMPARATOR, NULL, NULL, NULL);
 #endif
                         }
                         | NEQUAL_TO
                         {
 #ifdef DO_TREE_OPS
-                            $$ = create_inode(SYM_NEQ_TO, COMPARATOR, NULL, NULL, NULL);
+                            $$ = create_inode(ctx, SYM_NEQ_TO, COMPARATOR, NULL, NULL, NULL);
 #endif
                         }
                         | LESS_THAN
                         {
 #ifdef DO_TREE_OPS
-                            $$ = create_inode(SYM_LESS_THAN, COMPARATOR, NULL, NULL, NULL);
+                            $$ = create_inode(ctx, SYM_LESS_THAN, COMPARATOR, NULL, NULL, NULL);
 #endif
                         }
                         | GREATER_THAN
                         {
 #ifdef DO_TREE_OPS
-                            $$ = create_inode(SYM_GREATER_THAN, COMPARATOR, NULL, NULL, NULL);
+                            $$ = create_inode(ctx, SYM_GREATER_THAN, COMPARATOR, NULL, NULL, NULL);
 #endif
                         }
                         | LESS_THAN_EQUAL
                         {
 #ifdef DO_TREE_OPS
-                            $$ = create_inode(SYM_LESS_THAN_EQ, COMPARATOR, NULL, NULL, NULL);
+                            $$ = create_inode(ctx, SYM_LESS_THAN_EQ, COMPARATOR, NULL, NULL, NULL);
 #endif
                         }
                         | GREATER_THAN_EQUAL
                         {
 #ifdef DO_TREE_OPS
-                            $$ = create_inode(SYM_GREATER_THAN_EQ, COMPARATOR, NULL, NULL, NULL);
+                            $$ = create_inode(ctx, SYM_GREATER_THAN_EQ, COMPARATOR, NULL, NULL, NULL);
 #endif
                         }
                         ;
  
+/* Expressions and terms are chains of operands, each link holding the operator which follows
+** its operand, with the last link an EXPRESSION or TERM. They are evaluated left to right. */
 expression              : term
                         {
 #ifdef DO_TREE_OPS
-                            $$ = create_inode(NOTHING, EXPRESSION, $1, NULL, NULL);
+                            $$.head = $$.tail = create_inode(ctx, NOTHING, EXPRESSION, $1.head, NULL, NULL);
 #endif
                         }
-                        | term  PLUS  expression
+                        | expression  PLUS  term
                         {
 #ifdef DO_TREE_OPS
-                            $$ = create_inode(NOTHING, EXPR_ADD, $1, $3, NULL);
+                            $$.head = $1.head;
+                            $$.tail = link_inode($1.tail, EXPR_ADD, NOTHING,
+                                create_inode(ctx, NOTHING, EXPRESSION, $3.head, NULL, NULL));
 #endif
                         }
-                        |  term  MINUS  expression
+                        |  expression  MINUS  term
                         {
 #ifdef DO_TREE_OPS
-                            $$ = create_inode(MINUS, EXPR_MINUS, $1, $3, NULL);
+                            $$.head = $1.head;
+                            $$.tail = link_inode($1.tail, EXPR_MINUS, MINUS,
+                                create_inode(ctx, NOTHING, EXPRESSION, $3.head, NULL, NULL));
 #endif
                         };
  
 term                    :  value
                         {
 #ifdef DO_TREE_OPS
-                            $$ = create_inode(NOTHING, TERM, $1, NULL, NULL);
+                            $$.head = $$.tail = create_inode(ctx, NOTHING, TERM, $1, NULL, NULL);
 #endif
                         }
-                        |  value  MULTIPLY  term
+                        |  term  MULTIPLY  value
                         {
 #ifdef DO_TREE_OPS
-                            $$ = create_inode(MULTIPLY, TERM_MUL, $1, $3, NULL);
+                            $$.head = $1.head;
+                            $$.tail = link_inode($1.tail, TERM_MUL, MULTIPLY,
+                                create_inode(ctx, NOTHING, TERM, $3, NULL, NULL));
 #endif
                         }
-                        |  value  DIVIDE  term
+                        |  term  DIVIDE  value
                         {
 #ifdef DO_TREE_OPS
-                            $$ = create_inode(DIVIDE, TERM_DIV, $1, $3, NULL);
+                            $$.head = $1.head;
+                            $$.tail = link_inode($1.tail, TERM_DIV, DIVIDE,
+                                create_inode(ctx, NOTHING, TERM, $3, NULL, NULL));
 #endif
                         }
                         ;
@@ -489,32 +493,32 @@ term                    :  value
 value                   : identifier
                         {
 #ifdef DO_TREE_OPS
-                            $$ = create_inode(NOTHING, VAL_IDENTIFIER, $1, NULL, NULL);
+                            $$ = create_inode(ctx, NOTHING, VAL_IDENTIFIER, $1, NULL, NULL);
 #endif
                         }
                         | constant
                         {
 #ifdef DO_TREE_OPS
-                            $$ = create_inode(NOTHING, VAL_CONSTANT, $1, NULL, NULL);
+                            $$ = create_inode(ctx, NOTHING, VAL_CONSTANT, $1, NULL, NULL);
 #endif
                         }
                         | BRA  expression  KET
                         {
 #ifdef DO_TREE_OPS
-                            $$ = create_inode(NOTHING, VAL_EXPR, $2, NULL, NULL);
+                            $$ = create_inode(ctx, NOTHING, VAL_EXPR, $2.head, NULL, NULL);
 #endif
                         };
  
 constant                :  number_constant
                         {
 #ifdef DO_TREE_OPS
-                            $$ = create_inode(NOTHING, NUMBER_CONST, $1, NULL, NULL);
+                            $$ = create_inode(ctx, NOTHING, NUMBER_CONST, $1, NULL, NULL);
 #endif
                         }
                         |  CHAR
                         {
 #ifdef DO_TREE_OPS
-                            $$ = create_inode($1, CHAR_CONST, NULL, NULL, NULL);
+                            $$ = create_inode(ctx, $1, CHAR_CONST, NULL, NULL, NULL);
 #endif
                         }
                         ;
@@ -522,25 +526,25 @@ constant                :  number_constant
 number_constant         : INT
                         {
 #ifdef DO_TREE_OPS
-                            $$ = create_inode($1, INT_CONST, NULL, NULL, NULL);
+                            $$ = create_inode(ctx, $1, INT_CONST, NULL, NULL, NULL);
 #endif
                         }
                         | MINUS INT
                         {
 #ifdef DO_TREE_OPS
-                            $$ = create_inode($2, NEG_INT_CONST, NULL, NULL, NULL);
+                            $$ = create_inode(ctx, $2, NEG_INT_CONST, NULL, NULL, NULL);
 #endif
                         }
                         | FLOAT
                         {
 #ifdef DO_TREE_OPS
-                            $$ = create_inode($1, FLOAT_CONST, NULL, NULL, NULL);
+                            $$ = create_inode(ctx, $1, FLOAT_CONST, NULL, NULL, NULL);
 #endif
                         }
                         | MINUS FLOAT
                         {
 #ifdef DO_TREE_OPS
-                            $$ = create_inode($2, NEG_FLOAT_CONST, NULL, NULL, NULL);
+                            $$ = create_inode(ctx, $2, NEG_FLOAT_CONST, NULL, NULL, NULL);
 #endif
                         }
                         ;
@@ -548,7 +552,7 @@ number_constant         : INT
 identifier              : IDENTIFIER
                         {
 #ifdef DO_TREE_OPS
-                            $$ = create_inode($1, ID_VAL, NULL, NULL, NULL);
+                            $$ = create_inode(ctx, $1, ID_VAL, NULL, NULL, NULL);
 #endif
                         }
 
@@ -556,4 +560,6 @@ identifier              : IDENTIFIER
 
 #ifndef ME
 #include "lex.yy.c"
+#include "compile.c"
+#include "batch.c"
 #endif
\ No newline at end of file
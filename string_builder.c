@@ -0,0 +1,134 @@
+#include <errno.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "include/string_builder.h"
+
+static int reserve_bytes(STRING_BUILDER *, size_t);
+
+void init_string_builder(STRING_BUILDER *sb)
+{
+    sb->data = NULL;
+    sb->length = 0;
+    sb->capacity = 0;
+    sb->failed = 0;
+    sb->heap_allocations = 0;
+    sb->heap_bytes = 0;
+}
+
+/* Make room for extra more bytes and the terminating NUL */
+static int reserve_bytes(STRING_BUILDER *sb, size_t extra)
+{
+    size_t needed = sb->length + extra + 1;
+    if(sb->failed) return -1;
+    if(needed <= sb->capacity) return 0;
+    size_t new_capacity = sb->capacity ? sb->capacity : INITIAL_BUILDER_CAPACITY;
+    while(new_capacity < needed) new_capacity *= 2;
+    char *grown = (char *)realloc(sb->data, new_capacity);
+    if(grown == NULL)
+    {
+        sb->failed = 1;
+        return -1;
+    }
+    sb->data = grown;
+    sb->capacity = new_capacity;
+    sb->heap_allocations++;
+    sb->heap_bytes += new_capacity;
+    return 0;
+}
+
+int append_bytes(STRING_BUILDER *sb, const char *bytes, size_t count)
+{
+    if(count == 0) return sb->failed ? -1 : 0;
+    if(reserve_bytes(sb, count) < 0) return -1;
+    memcpy(sb->data + sb->length, bytes, count);
+    sb->length += count;
+    sb->data[sb->length] = '\0';
+    return 0;
+}
+
+int append_string(STRING_BUILDER *sb, const char *s)
+{
+    return append_bytes(sb, s, strlen(s));
+}
+
+/* Format straight into the spare capacity, growing and formatting again only if it did not fit */
+int append_format(STRING_BUILDER *sb, const char *format, ...)
+{
+    va_list args;
+    int count;
+    if(reserve_bytes(sb, 64) < 0) return -1;
+    va_start(args, format);
+    count = vsnprintf(sb->data + sb->length, sb->capacity - sb->length, format, args);
+    va_end(args);
+    if(count < 0) return -1;
+    if((size_t)count >= sb->capacity - sb->length)
+    {
+        if(reserve_bytes(sb, (size_t)count) < 0) return -1;
+        va_start(args, format);
+        vsnprintf(sb->data + sb->length, sb->capacity - sb->length, format, args);
+        va_end(args);
+    }
+    sb->length += (size_t)count;
+    return 0;
+}
+
+/* Integers are the commonest thing generated code prints, so they skip vsnprintf */
+int append_int(STRING_BUILDER *sb, int value)
+{
+    char digits[3*sizeof(int) + 2];
+    char *start = digits + sizeof(digits);
+    unsigned int magnitude = value < 0 ? 0u - (unsigned int)value : (unsigned int)value;
+    do {
+        *--start = (char)('0' + magnitude % 10);
+        magnitude /= 10;
+    } while(magnitude != 0);
+    if(value < 0) *--start = '-';
+    return append_bytes(sb, start, (size_t)(digits + sizeof(digits) - start));
+}
+
+int append_repeated(STRING_BUILDER *sb, char c, size_t count)
+{
+    if(count == 0) return sb->failed ? -1 : 0;
+    if(reserve_bytes(sb, count) < 0) return -1;
+    memset(sb->data + sb->length, c, count);
+    sb->length += count;
+    sb->data[sb->length] = '\0';
+    return 0;
+}
+
+/* Empty the builder but keep its storage for the next use */
+void reset_string_builder(STRING_BUILDER *sb)
+{
+    sb->length = 0;
+    sb->failed = 0;
+    if(sb->data != NULL) sb->data[0] = '\0';
+}
+
+/* Hand the contents to the file's descriptor directly, which is a single write unless the
+** kernel accepts only part of it */
+int write_string_builder(FILE *output, STRING_BUILDER *sb)
+{
+    size_t written = 0;
+    if(fflush(output) != 0) return -1;
+    int fd = fileno(output);
+    while(written < sb->length)
+    {
+        ssize_t count = write(fd, sb->data + written, sb->length - written);
+        if(count < 0)
+        {
+            if(errno == EINTR) continue;
+            return -1;
+        }
+        written += (size_t)count;
+    }
+    return 0;
+}
+
+void free_string_builder(STRING_BUILDER *sb)
+{
+    free(sb->data);
+    init_string_builder(sb);
+}
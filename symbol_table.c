@@ -1,7 +1,16 @@
+#include <math.h>
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "include/splio.h"
 #include "include/symbol_table.h"
+#include "include/types.h"
+
+static unsigned int hash_identifier(const char *);
+static int find_slot(DYNAMIC_SYMTAB *, const char *, unsigned int);
+static int grow_hash_index(DYNAMIC_SYMTAB *);
+static void index_symbol(DYNAMIC_SYMTAB *, int);
 
 DYNAMIC_SYMTAB *create_dynamic_symtab()
 {
@@ -9,9 +18,103 @@ DYNAMIC_SYMTAB *create_dynamic_symtab()
     new_array->array = (SYMTABNODEPTR *)malloc(sizeof(SYMTABNODEPTR) * INITIAL_CAPACITY);
     new_array->capacity = INITIAL_CAPACITY;
     new_array->in_use = 0;
+    new_array->entries = NULL;
+    new_array->hash_slots = NULL;
+    new_array->hash_capacity = 0;
+    new_array->hash_in_use = 0;
+    new_array->symbol_arena = NULL;
+    new_array->identifier_arena = NULL;
     return new_array;
 }
 
+/* A table which owns its symbols, for use with install_symbol. The table, its entries and
+** their identifiers all live in the given arenas, so only the hash index is freed by destroy_symtab */
+DYNAMIC_SYMTAB *create_arena_symtab(ARENA *symbols, ARENA *identifiers)
+{
+    DYNAMIC_SYMTAB *new_array = (DYNAMIC_SYMTAB *)arena_alloc(symbols, sizeof(DYNAMIC_SYMTAB));
+    if(new_array == NULL) return NULL;
+    new_array->array = (SYMTABNODEPTR *)arena_alloc(symbols, sizeof(SYMTABNODEPTR) * INITIAL_CAPACITY);
+    new_array->capacity = INITIAL_CAPACITY;
+    new_array->in_use = 0;
+    new_array->entries = (SYMTABNODE *)arena_alloc(symbols, sizeof(SYMTABNODE) * INITIAL_CAPACITY);
+    new_array->hash_slots = NULL;
+    new_array->hash_capacity = 0;
+    new_array->hash_in_use = 0;
+    new_array->symbol_arena = symbols;
+    new_array->identifier_arena = identifiers;
+    return new_array;
+}
+
+/* FNV-1a, good enough for short identifiers and cheap to compute in the lexer */
+static unsigned int hash_identifier(const char *s)
+{
+    unsigned int hash = 2166136261u;
+    while(*s)
+    {
+        hash ^= (unsigned char)*s++;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+/* Returns the slot holding s, or the slot it should be inserted into if it is not present */
+static int find_slot(DYNAMIC_SYMTAB *symTab, const char *s, unsigned int hash)
+{
+    unsigned int mask = (unsigned int)symTab->hash_capacity - 1;
+    unsigned int slot = hash & mask;
+    int first_deleted = -1;
+    for(;;)
+    {
+        int index = symTab->hash_slots[slot];
+        if(index == HASH_SLOT_EMPTY)
+        {
+            return first_deleted >= 0 ? first_deleted : (int)slot;
+        }
+        if(index == HASH_SLOT_DELETED)
+        {
+            if(first_deleted < 0) first_deleted = (int)slot;
+        }
+        else
+        {
+            SYMTABNODEPTR sym = symTab->array[index];
+            if(sym->hash == hash && strcmp(s, sym->identifier) == 0)
+            {
+                return (int)slot;
+            }
+        }
+        slot = (slot + 1) & mask;
+    }
+}
+
+static int grow_hash_index(DYNAMIC_SYMTAB *symTab)
+{
+    int new_capacity = symTab->hash_capacity ? symTab->hash_capacity*2 : INITIAL_HASH_CAPACITY;
+    int *new_slots = (int *)malloc(sizeof(int) * new_capacity);
+    if(new_slots == NULL) return -1;
+    INFO("Growing symbol hash index from %d to %d slots\n", symTab->hash_capacity, new_capacity)
+    int i;
+    for(i = 0; i < new_capacity; i++) new_slots[i] = HASH_SLOT_EMPTY;
+    free(symTab->hash_slots);
+    symTab->hash_slots = new_slots;
+    symTab->hash_capacity = new_capacity;
+    symTab->hash_in_use = 0;
+    /* Re-insert every named symbol, which also drops any deleted markers */
+    for(i = 0; i < symTab->in_use; i++)
+    {
+        if(symTab->array[i]->identifier != NULL) index_symbol(symTab, i);
+    }
+    return 0;
+}
+
+static void index_symbol(DYNAMIC_SYMTAB *symTab, int index)
+{
+    SYMTABNODEPTR sym = symTab->array[index];
+    int slot = find_slot(symTab, sym->identifier, sym->hash);
+    if(symTab->hash_slots[slot] >= 0) return; /* Already indexed under an earlier symbol */
+    symTab->hash_slots[slot] = index;
+    symTab->hash_in_use++;
+}
+
 int add_symbol(DYNAMIC_SYMTAB *array, SYMTABNODEPTR element)
 {
     INFO("Enter add symbol procedure..\n");
@@ -21,8 +124,8 @@ int add_symbol(DYNAMIC_SYMTAB *array, SYMTABNODEPTR element)
         SYMTABNODEPTR *orig = array->array;
         int new_capacity = array->capacity*2;
         array->array = realloc(array->array, sizeof(SYMTABNODEPTR) * new_capacity);
-        if(array->array == NULL) 
-        { 
+        if(array->array == NULL)
+        {
             array->array = orig;
             return -1;
         }
@@ -36,6 +139,78 @@ int add_symbol(DYNAMIC_SYMTAB *array, SYMTABNODEPTR element)
     return array->in_use-1;
 }
 
+/* Look up an identifier, installing it with the given type if it is not already present.
+** Symbols installed this way are owned by the table, which keeps them in one contiguous block
+** and keeps array[] pointing into that block, so it must be created by create_arena_symtab
+** and not be mixed with add_symbol. */
+int install_symbol(DYNAMIC_SYMTAB *symTab, char *id, enum SymbolTypes type)
+{
+    unsigned int hash = hash_identifier(id);
+    if(symTab->hash_slots == NULL && grow_hash_index(symTab) < 0) return -1;
+
+    int slot = find_slot(symTab, id, hash);
+    if(symTab->hash_slots[slot] >= 0) return symTab->hash_slots[slot];
+
+    if(symTab->in_use == symTab->capacity)
+    {
+        /* The old blocks stay in the arena until it is released, which at most doubles the footprint */
+        int new_capacity = symTab->capacity*2;
+        SYMTABNODE *entries = (SYMTABNODE *)arena_alloc(symTab->symbol_arena, sizeof(SYMTABNODE) * new_capacity);
+        SYMTABNODEPTR *array = (SYMTABNODEPTR *)arena_alloc(symTab->symbol_arena, sizeof(SYMTABNODEPTR) * new_capacity);
+        if(entries == NULL || array == NULL) return -1;
+        INFO("Symbol storage grown to %d entries, now at %p\n", new_capacity, entries)
+        memcpy(entries, symTab->entries, sizeof(SYMTABNODE) * symTab->in_use);
+        int i;
+        for(i = 0; i < symTab->in_use; i++) array[i] = &entries[i];
+        symTab->entries = entries;
+        symTab->array = array;
+        symTab->capacity = new_capacity;
+    }
+
+    int index = symTab->in_use++;
+    SYMTABNODEPTR new = &symTab->entries[index];
+    memset(new, 0, sizeof(SYMTABNODE));
+    new->identifier = arena_strdup(symTab->identifier_arena, id);
+    new->type = type;
+    new->hash = hash;
+    symTab->array[index] = new;
+    INFO("Installed identifier \"%s\" at index %d\n", new->identifier, index)
+
+    if(symTab->hash_slots[slot] == HASH_SLOT_EMPTY) symTab->hash_in_use++;
+    symTab->hash_slots[slot] = index;
+    /* Keep the load factor at or below one half so probe sequences stay short */
+    if(symTab->hash_in_use*2 > symTab->hash_capacity) grow_hash_index(symTab);
+    return index;
+}
+
+/* Install the literal a folded REAL value is written as, which needs no declaration. Its text is
+** the shortest that reads back as the same double, so the C compiler sees exactly the value
+** folded. Only a finite value of at least zero can be written this way; a negative one is the
+** negation of its magnitude's literal. Returns -1 for any other value, or when out of memory. */
+int install_real_literal(DYNAMIC_SYMTAB *symTab, double value)
+{
+    char text[40];
+    int precision;
+    if(!isfinite(value) || signbit(value)) return -1;
+    for(precision = 1; precision < 17; precision++)
+    {
+        snprintf(text, sizeof(text), "%.*g", precision, value);
+        if(strtod(text, NULL) == value) break;
+    }
+    if(precision == 17) snprintf(text, sizeof(text), "%.17g", value);
+    /* Without a point or an exponent, C would read an integer */
+    if(strpbrk(text, ".e") == NULL) strcat(text, ".0");
+
+    int index = install_symbol(symTab, text, REAL_T);
+    if(index < 0) return -1;
+    SYMTABNODEPTR literal = symTab->array[index];
+    literal->declared = TRUE;
+    literal->initialised = TRUE;
+    literal->sanitised = TRUE;
+    literal->value = value;
+    return index;
+}
+
 int lookup_symbol(char *s, DYNAMIC_SYMTAB *symTab)
 {
     int i;
@@ -43,26 +218,61 @@ int lookup_symbol(char *s, DYNAMIC_SYMTAB *symTab)
     SYMTABNODEPTR *array = symTab->array;
 
     INFO("Sym Table array at %p, Current size: %d\n", array, in_use);
-    if(in_use > 0) 
+    if(symTab->hash_slots != NULL)
     {
-        INFO("Identifier of last item: %s\n", array[in_use-1]->identifier);
+        int index = symTab->hash_slots[find_slot(symTab, s, hash_identifier(s))];
+        return index >= 0 ? index : -1;
     }
+    /* Tables built with add_symbol only hold a handful of entries, so they are not indexed */
     for(i=0; i<in_use; i++)
     {
-        if(strcmp(s, array[i]->identifier) == 0)
+        if(array[i]->identifier != NULL && strcmp(s, array[i]->identifier) == 0)
         {
             return (i);
         }
     }
-    return (-1);    
+    return (-1);
+}
+
+/* Give an installed symbol a new identifier, keeping its index */
+int rename_symbol(DYNAMIC_SYMTAB *symTab, int index, char *new_id)
+{
+    SYMTABNODEPTR sym = symTab->array[index];
+    if(symTab->hash_slots != NULL)
+    {
+        int slot = find_slot(symTab, sym->identifier, sym->hash);
+        if(symTab->hash_slots[slot] == index)
+        {
+            symTab->hash_slots[slot] = HASH_SLOT_DELETED;
+        }
+    }
+    char *interned = arena_strdup(symTab->identifier_arena, new_id);
+    if(interned == NULL) return -1;
+    sym->identifier = interned;
+    sym->hash = hash_identifier(interned);
+    if(symTab->hash_slots != NULL)
+    {
+        int slot = find_slot(symTab, interned, sym->hash);
+        if(symTab->hash_slots[slot] < 0)
+        {
+            if(symTab->hash_slots[slot] == HASH_SLOT_EMPTY) symTab->hash_in_use++;
+            symTab->hash_slots[slot] = index;
+        }
+        if(symTab->hash_in_use*2 > symTab->hash_capacity) grow_hash_index(symTab);
+    }
+    return 0;
 }
 
 int reset_dynamic_symtab(DYNAMIC_SYMTAB *array)
 {
-    free(array->array);
-    array->array = (SYMTABNODEPTR *)malloc(sizeof(SYMTABNODEPTR)*INITIAL_CAPACITY);
-    array->capacity = INITIAL_CAPACITY;
+    /* The storage is kept so that tables which are reset for every statement do not churn the allocator */
     array->in_use = 0;
+    if(array->hash_slots != NULL)
+    {
+        int i;
+        for(i = 0; i < array->hash_capacity; i++) array->hash_slots[i] = HASH_SLOT_EMPTY;
+        array->hash_in_use = 0;
+    }
     if(array->array == NULL)
         return -1;
     return 0;
@@ -70,6 +280,8 @@ int reset_dynamic_symtab(DYNAMIC_SYMTAB *array)
 
 void destroy_symtab(DYNAMIC_SYMTAB *array)
 {
+    free(array->hash_slots);
+    if(array->symbol_arena != NULL) return;
     free(array->array);
     free(array);
-}
\ No newline at end of file
+}
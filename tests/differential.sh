@@ -0,0 +1,55 @@
+#!/bin/sh
+# Run every program in tests/corpus through each backend, and check that --run, --jit and --asm
+# print what the generated C does, and stop the same way. A program reads name.in when there is
+# one, and nothing otherwise. A trap only has to be a failure on every backend, as the generated
+# C and --asm die by SIGFPE where --run and --jit report it, so the trap programs write nothing
+# before they divide.
+#
+# usage: tests/differential.sh [path/to/spl]
+
+SPL=${1:-./spl}
+CC=${CC:-cc}
+CORPUS=$(dirname "$0")/corpus
+WORK=${TMPDIR:-/tmp}/spl_differential.$$
+trap 'rm -f "$WORK".*' EXIT
+failed=0
+
+# Run a command on the program's input; its output, then whether it succeeded, go to $WORK.$1
+run() {
+    out=$1
+    shift
+    if "$@" < "$input" > "$WORK.$out" 2> /dev/null; then
+        echo "(finished)" >> "$WORK.$out"
+    else
+        echo "(failed)" >> "$WORK.$out"
+    fi
+}
+
+check() {
+    if cmp -s "$WORK.c.out" "$WORK.out"; then
+        echo "ok   $1"
+    else
+        echo "FAIL $1:"; diff "$WORK.c.out" "$WORK.out"
+        failed=1
+    fi
+}
+
+for program in "$CORPUS"/*.spl; do
+    name=$(basename "$program" .spl)
+    input=$CORPUS/$name.in
+    [ -f "$input" ] || input=/dev/null
+
+    "$SPL" -o "$WORK.c" < "$program" && $CC -o "$WORK.exe" "$WORK.c" -lm || exit 1
+    run c.out "$WORK.exe"
+
+    for backend in --run --jit; do
+        run out "$SPL" $backend "$program"; check "$name $backend"
+    done
+
+    if [ "$(uname -m)" = x86_64 ]; then
+        "$SPL" --asm -o "$WORK.s" < "$program" && $CC -o "$WORK.exe" "$WORK.s" -lm || exit 1
+        run out "$WORK.exe"; check "$name --asm"
+    fi
+done
+
+exit $failed
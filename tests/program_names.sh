@@ -0,0 +1,46 @@
+#!/bin/sh
+# Check that a program may be named after a function the READ runtime's headers declare, such as
+# read or write, and still compile and run as C and as assembly.
+#
+# usage: tests/program_names.sh [path/to/spl]
+
+SPL=${1:-./spl}
+CC=${CC:-cc}
+WORK=${TMPDIR:-/tmp}/spl_program_names.$$
+trap 'rm -f "$WORK".*' EXIT
+failed=0
+
+printf '42 x\n' > "$WORK.in"
+printf '42x\n' > "$WORK.expected"
+
+check() {
+    if cmp -s "$WORK.expected" "$WORK.out"; then
+        echo "ok   $1"
+    else
+        echo "FAIL $1: got"; cat "$WORK.out"
+        failed=1
+    fi
+}
+
+for name in read write close stat fstat lseek mmap sleep; do
+    cat > "$WORK.spl" <<EOF2
+$name : DECLARATIONS
+  a OF TYPE INTEGER;
+  c OF TYPE CHARACTER;
+CODE
+  READ(a); READ(c); WRITE(a, c); NEWLINE
+ENDP $name.
+EOF2
+    rm -f "$WORK.out"
+    "$SPL" -o "$WORK.c" < "$WORK.spl" && $CC -o "$WORK.exe" "$WORK.c" -lm &&
+        "$WORK.exe" < "$WORK.in" > "$WORK.out"
+    check "C, program $name"
+    if [ "$(uname -m)" = x86_64 ]; then
+        rm -f "$WORK.out"
+        "$SPL" --asm -o "$WORK.s" < "$WORK.spl" && $CC -o "$WORK.exe" "$WORK.s" -lm &&
+            "$WORK.exe" < "$WORK.in" > "$WORK.out"
+        check "--asm, program $name"
+    fi
+done
+
+exit $failed
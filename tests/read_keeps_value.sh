@@ -0,0 +1,53 @@
+#!/bin/sh
+# Check that a READ at end of input, or one whose input does not match, leaves its variable as it
+# was, on every backend. What was stored before the READ must not be deleted as a dead store, nor
+# its value folded into the WRITE after it.
+#
+# usage: tests/read_keeps_value.sh [path/to/spl]
+
+SPL=${1:-./spl}
+CC=${CC:-cc}
+WORK=${TMPDIR:-/tmp}/spl_read_keeps_value.$$
+trap 'rm -f "$WORK".*' EXIT
+failed=0
+
+cat > "$WORK.spl" <<'EOF'
+keeps : DECLARATIONS
+  a, i OF TYPE INTEGER;
+  x OF TYPE REAL;
+  c OF TYPE CHARACTER;
+CODE
+  7 -> a; 2.5 -> x; 'q' -> c;
+  READ(a); READ(x); READ(c);
+  WRITE(a, x, c); NEWLINE;
+  FOR i IS 1 BY 1 TO 2 DO
+    i * 10 -> a; READ(a); WRITE(a); NEWLINE
+  ENDFOR
+ENDP keeps.
+EOF
+printf '72.5q\n10\n20\n' > "$WORK.expected"
+
+check() {
+    if cmp -s "$WORK.expected" "$WORK.out"; then
+        echo "ok   $1"
+    else
+        echo "FAIL $1: got"; cat "$WORK.out"
+        failed=1
+    fi
+}
+
+"$SPL" -o "$WORK.c" < "$WORK.spl" && $CC -o "$WORK.exe" "$WORK.c" -lm || exit 1
+"$WORK.exe" < /dev/null > "$WORK.out"; check "C, empty input"
+# The first READ fails to match, and the rest find the end of input
+echo '+' | "$WORK.exe" > "$WORK.out"; check "C, mismatched input"
+
+for backend in --run --jit; do
+    "$SPL" $backend "$WORK.spl" < /dev/null > "$WORK.out"; check "$backend, empty input"
+done
+
+if [ "$(uname -m)" = x86_64 ]; then
+    "$SPL" --asm -o "$WORK.s" < "$WORK.spl" && $CC -o "$WORK.exe" "$WORK.s" -lm || exit 1
+    "$WORK.exe" < /dev/null > "$WORK.out"; check "--asm, empty input"
+fi
+
+exit $failed
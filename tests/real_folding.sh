@@ -0,0 +1,97 @@
+#!/bin/sh
+# Check that folding REAL constants gives the same double as the generated program would at run
+# time. Each expression is compiled once with its REAL literals, which are folded, and once with
+# them READ from input, which cannot be; the results of both are printed with %a and compared.
+# Tokens are separated by spaces, so that each REAL literal, with its sign, is one token.
+#
+# usage: tests/real_folding.sh [path/to/spl]
+
+SPL=${1:-./spl}
+CC=${CC:-cc}
+WORK=${TMPDIR:-/tmp}/spl_real_folding.$$
+trap 'rm -f "$WORK".*' EXIT
+failed=0
+
+cat > "$WORK.expressions" <<'EOF2'
+0.1 + 0.2
+1.0 / 3.0
+0.1 * 3 - 0.3
+2 / 3.0
+1 - 0.9 - 0.1
+0.7 + 0.1 + 0.2
+100.0 * 1.1
+-0.0 * 1.0
+0.0 - 0.0
+-0.5 * 0.0
+1.0 / 49.0 * 49.0
+123456789.123 * 987654321.987
+0.000001 * 0.000001 * 0.000001
+3.0 * ( 1.0 / 3.0 )
+( 0.1 + 0.2 ) * ( 0.3 - 0.1 )
+'a' * 0.5
+7 / 2 * 1.5
+1.5 + 7 / 2
+99999999999999999.0 * 10.0
+0.3 - 0.1 - 0.1 - 0.1
+EOF2
+
+# Write the folded and the unfolded program, and the literals the unfolded one reads
+awk -v work="$WORK" '
+{
+    folded = folded sep "  " $0 " -> x; WRITE(x); NEWLINE"
+    line = ""
+    for(i = 1; i <= NF; i++)
+    {
+        if($i ~ /^-?[0-9]+\.[0-9]+$/)
+        {
+            print $i > (work ".in")
+            $i = "r" ++count
+        }
+        line = line (i > 1 ? " " : "") $i
+    }
+    unfolded = unfolded sep "  " line " -> x; WRITE(x); NEWLINE"
+    sep = ";\n"
+}
+END {
+    printf "folded : DECLARATIONS\n  x OF TYPE REAL;\nCODE\n%s\nENDP folded.\n", folded > (work ".folded.spl")
+    printf "unfolded : DECLARATIONS\n  x, r1" > (work ".unfolded.spl")
+    for(i = 2; i <= count; i++) printf ", r%d", i > (work ".unfolded.spl")
+    printf " OF TYPE REAL;\nCODE\n" > (work ".unfolded.spl")
+    for(i = 1; i <= count; i++) printf "  READ(r%d);\n", i > (work ".unfolded.spl")
+    printf "%s\nENDP unfolded.\n", unfolded > (work ".unfolded.spl")
+}' "$WORK.expressions"
+
+# Print REALs with %a, in place of the decimal form WRITE gives them
+hex_writes() {
+    awk '
+    /^static void spl_write_real\(double value\)$/ {
+        print "static void spl_write_hex(double value)\n{"
+        print "    if(spl_out_length > (int)sizeof(spl_out) - 32) spl_flush();"
+        print "    spl_out_length += sprintf(spl_out + spl_out_length, \"%a\", value);\n}\n"
+    }
+    /^void spl_program_/ && !renamed { print "#define spl_write_real spl_write_hex\n"; renamed = 1 }
+    { print }'
+}
+
+for program in folded unfolded; do
+    "$SPL" -o "$WORK.c" < "$WORK.$program.spl" || exit 1
+    hex_writes < "$WORK.c" > "$WORK.hex.c"
+    $CC -o "$WORK.exe" "$WORK.hex.c" -lm || exit 1
+    "$WORK.exe" < "$WORK.in" > "$WORK.$program.out"
+done
+
+if [ "$(wc -l < "$WORK.expressions")" -ne "$(wc -l < "$WORK.folded.out")" ]; then
+    echo "FAIL the folded program printed"; cat "$WORK.folded.out"
+    exit 1
+fi
+paste -d '|' "$WORK.expressions" "$WORK.folded.out" "$WORK.unfolded.out" > "$WORK.results"
+while IFS='|' read -r expression folded unfolded; do
+    if [ "$folded" = "$unfolded" ]; then
+        echo "ok   $expression"
+    else
+        echo "FAIL $expression: folded to $folded, but $unfolded at run time"
+        failed=1
+    fi
+done < "$WORK.results"
+
+exit $failed
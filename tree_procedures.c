@@ -1,18 +1,17 @@
 #include <stdlib.h>
 #include <string.h>
+#include "include/arena.h"
+#include "include/compile.h"
 #include "include/splio.h"
 #include "include/symbol_table.h"
 #include "include/tree_procedures.h"
 #include "include/utils.h"
 
-int *lineno;
-int *colno;
-
-TERNARY_TREE create_inode(int ival, int case_identifier, TERNARY_TREE p1,
+TERNARY_TREE create_inode(COMPILE_CONTEXT *ctx, int ival, int case_identifier, TERNARY_TREE p1,
 			 TERNARY_TREE  p2, TERNARY_TREE  p3)
 {
     TERNARY_TREE t;
-    t = (TERNARY_TREE)malloc(sizeof(TREE_NODE));
+    t = (TERNARY_TREE)arena_alloc(ctx->treeArena, sizeof(TREE_NODE));
     t->item = ival;
     t->nodeIdentifier = case_identifier;
     t->first = p1;
@@ -21,59 +20,90 @@ TERNARY_TREE create_inode(int ival, int case_identifier, TERNARY_TREE p1,
     return (t);
 }
 
+/* Append next to a chain, making tail the link (and operator) which precedes it */
+TERNARY_TREE link_inode(TERNARY_TREE tail, int case_identifier, int ival, TERNARY_TREE next)
+{
+    tail->nodeIdentifier = case_identifier;
+    tail->item = ival;
+    tail->second = next;
+    return next;
+}
+
+/* Lists and operator chains continue through their second branch. These can be as long as
+** the program, so they are walked with a loop rather than by recursing down second. */
+int is_chain_link(TERNARY_TREE t)
+{
+    if(t == NULL) return FALSE;
+    switch(t->nodeIdentifier)
+    {
+        case DECLARATION_BLOCK:
+        case ID_LIST:
+        case STATEMENT_LIST:
+        case OUTPUT_LIST:
+        case EXPR_ADD:
+        case EXPR_MINUS:
+        case TERM_MUL:
+        case TERM_DIV:
+            return TRUE;
+    }
+    return FALSE;
+}
+
 #ifdef DEBUG
-void PrintTree(TERNARY_TREE t, int level)
+void PrintTree(COMPILE_CONTEXT *ctx, TERNARY_TREE t, int level)
 {
-    if(t == NULL) return;
-	int indent_count = 0;
-    for(indent_count = 0; indent_count < level; indent_count++) printf("---");
-    printf("Node Id: %s", NODE_TYPE_NAMES[t->nodeIdentifier]);
-    if(t->item != NOTHING)
+    /* Each link of a chain is printed at the same level */
+    while(t != NULL)
     {
-        printf(",  ");
-        switch(t->nodeIdentifier)
+        int indent_count = 0;
+        for(indent_count = 0; indent_count < level; indent_count++) printf("---");
+        printf("Node Id: %s", NODE_TYPE_NAMES[t->nodeIdentifier]);
+        if(t->item != NOTHING)
         {
-            case INT_CONST:
-                printf("Integer value: %d", t->item);
-                break;
-            case NEG_INT_CONST:
-                printf("Integer value: %d", -t->item);
-                break;
-            case FLOAT_CONST:
-                printf("Float value: %s", symTabRec->array[t->item]->identifier);
-                break;
-            case NEG_FLOAT_CONST:
-                printf("Float value: %s", make_float_negative(symTabRec->array[t->item]->identifier));
-                break;
-            case CHAR_CONST:
-                printf("Character value: %c", (char)t->item);
-                break;
-            case ID_VAL:
-                printf("Identifier value: %s", symTabRec->array[t->item]->identifier);
-                break;
-            case TYPE_P:
-                switch(t->item)
-                {
-                    case CHAR_T:
-                        printf("Type: Integer");
-                        break;
-                    case INT_T:
-                        printf("Type: Real");
-                        break;
-                    case REAL_T:
-                        printf("Type: Character");
-                        break;
-                }
-                break;
-            default:
-                printf("Item value: %d", t->item);
+            printf(",  ");
+            switch(t->nodeIdentifier)
+            {
+                case INT_CONST:
+                    printf("Integer value: %d", t->item);
+                    break;
+                case NEG_INT_CONST:
+                    printf("Integer value: %d", -t->item);
+                    break;
+                case FLOAT_CONST:
+                    printf("Float value: %s", ctx->symTabRec->array[t->item]->identifier);
+                    break;
+                case NEG_FLOAT_CONST:
+                    printf("Float value: %s", make_float_negative(ctx->symTabRec->array[t->item]->identifier));
+                    break;
+                case CHAR_CONST:
+                    printf("Character value: %c", (char)t->item);
+                    break;
+                case ID_VAL:
+                    printf("Identifier value: %s", ctx->symTabRec->array[t->item]->identifier);
+                    break;
+                case TYPE_P:
+                    switch(t->item)
+                    {
+                        case CHAR_T:
+                            printf("Type: Integer");
+                            break;
+                        case INT_T:
+                            printf("Type: Real");
+                            break;
+                        case REAL_T:
+                            printf("Type: Character");
+                            break;
+                    }
+                    break;
+                default:
+                    printf("Item value: %d", t->item);
+            }
         }
+        putchar('\n');
+        PrintTree(ctx, t->first, level + 1);
+        if(!is_chain_link(t)) PrintTree(ctx, t->second, level + 1);
+        PrintTree(ctx, t->third, level + 1);
+        t = is_chain_link(t) ? t->second : NULL;
     }
-    putchar('\n');
-    level++;
-    PrintTree(t->first, level);
-    PrintTree(t->second, level);
-    PrintTree(t->third, level);
-    level--;
 }
 #endif
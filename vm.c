@@ -0,0 +1,197 @@
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "include/bytecode.h"
+
+/* ------------- bytecode interpreter --------------------------- */
+
+/* Each handler ends by jumping straight to the next instruction's handler, whose address was
+** stored in the instruction, so every instruction has a dispatch branch of its own for the
+** processor to predict. That needs labels as values, a GNU extension; other compilers build the
+** same handlers as the cases of a switch. WRITE and READ go through stdio with the formats the
+** generated C uses, so a program prints and reads just as it would once compiled. */
+
+#if defined(__GNUC__) && !defined(BC_SWITCH_DISPATCH)
+#define BC_THREADED
+#endif
+
+#ifdef BC_THREADED
+#define BC_CASE(OP) run_##OP:
+#define BC_NEXT goto *pc->handler
+#define CREATE_BC_HANDLER(OP) &&run_##OP,
+#else
+#define BC_CASE(OP) case OP:
+#define BC_NEXT continue
+#endif
+
+#define SLOT(FIELD) slots[pc->FIELD]
+#define BC_BRANCH(CONDITION) pc = (CONDITION) ? code + pc->dest : pc + 1; BC_NEXT;
+#define WRAPPING_ADD(X, Y) (int)((unsigned int)(X) + (unsigned int)(Y))
+
+/* The comparisons, in the order of enum CompareSymType, and the branches made of each */
+#define FOREACH_BC_COMPARISON(CREATE) \
+CREATE(EQ, ==) CREATE(NE, !=) CREATE(LT, <) CREATE(GT, >) CREATE(LE, <=) CREATE(GE, >=)
+
+#define RUN_BC_COMPARISON(NAME, OPERATOR) \
+    BC_CASE(BC_J##NAME##_I) BC_BRANCH(SLOT(a).i OPERATOR SLOT(b).i) \
+    BC_CASE(BC_J##NAME##_R) BC_BRANCH(SLOT(a).r OPERATOR SLOT(b).r) \
+    BC_CASE(BC_JNOT_##NAME##_R) BC_BRANCH(!(SLOT(a).r OPERATOR SLOT(b).r)) \
+    BC_CASE(BC_ADD_J##NAME##_I) \
+        SLOT(a).i = WRAPPING_ADD(SLOT(a).i, SLOT(c).i); \
+        BC_BRANCH(SLOT(a).i OPERATOR SLOT(b).i)
+
+/* Run a program with the compiler's stdin and stdout as its own. Returns 0 once it halts, 1
+** when it divides by zero, or -1 when out of memory. */
+int run_bytecode(BC_PROGRAM *program)
+{
+    BC_INSTRUCTION *code = program->code;
+    BC_INSTRUCTION *pc = code;
+    BC_SLOT *slots = (BC_SLOT *)malloc(sizeof(BC_SLOT) * program->slot_count);
+    long long from;
+    long long to;
+    long long by;
+    char character;
+    int status = 0;
+    if(slots == NULL) return -1;
+    memcpy(slots, program->slots, sizeof(BC_SLOT) * program->slot_count);
+
+#ifdef BC_THREADED
+    static const void *const handlers[] = {FOREACH_BC_OP(CREATE_BC_HANDLER)};
+    if(!program->threaded)
+    {
+        int i;
+        for(i = 0; i < program->count; i++) code[i].handler = handlers[code[i].op];
+        program->threaded = TRUE;
+    }
+    BC_NEXT;
+#else
+    for(;;) switch(pc->op)
+    {
+#endif
+    BC_CASE(BC_HALT)
+        goto halted;
+    BC_CASE(BC_MOVE)
+        SLOT(dest) = SLOT(a);
+        pc++;
+        BC_NEXT;
+    BC_CASE(BC_TO_CHAR)
+        SLOT(dest).i = (char)SLOT(a).i;
+        pc++;
+        BC_NEXT;
+    BC_CASE(BC_TO_INT)
+        SLOT(dest).i = (int)SLOT(a).r;
+        pc++;
+        BC_NEXT;
+    BC_CASE(BC_TO_REAL)
+        SLOT(dest).r = SLOT(a).i;
+        pc++;
+        BC_NEXT;
+
+    /* Integer arithmetic wraps, as it does in the generated C on the machines it runs on */
+    BC_CASE(BC_ADD_I)
+        SLOT(dest).i = WRAPPING_ADD(SLOT(a).i, SLOT(b).i);
+        pc++;
+        BC_NEXT;
+    BC_CASE(BC_SUB_I)
+        SLOT(dest).i = (int)((unsigned int)SLOT(a).i - (unsigned int)SLOT(b).i);
+        pc++;
+        BC_NEXT;
+    BC_CASE(BC_MUL_I)
+        SLOT(dest).i = (int)((unsigned int)SLOT(a).i * (unsigned int)SLOT(b).i);
+        pc++;
+        BC_NEXT;
+    BC_CASE(BC_DIV_I)
+        if(SLOT(b).i == 0 || (SLOT(b).i == -1 && SLOT(a).i == INT_MIN)) goto divide_error;
+        SLOT(dest).i = SLOT(a).i / SLOT(b).i;
+        pc++;
+        BC_NEXT;
+    BC_CASE(BC_SHL_I)
+        SLOT(dest).i = (int)((unsigned int)SLOT(a).i << (SLOT(b).i & 31));
+        pc++;
+        BC_NEXT;
+    BC_CASE(BC_ADD_R)
+        SLOT(dest).r = SLOT(a).r + SLOT(b).r;
+        pc++;
+        BC_NEXT;
+    BC_CASE(BC_SUB_R)
+        SLOT(dest).r = SLOT(a).r - SLOT(b).r;
+        pc++;
+        BC_NEXT;
+    BC_CASE(BC_MUL_R)
+        SLOT(dest).r = SLOT(a).r * SLOT(b).r;
+        pc++;
+        BC_NEXT;
+    BC_CASE(BC_DIV_R)
+        SLOT(dest).r = SLOT(a).r / SLOT(b).r;
+        pc++;
+        BC_NEXT;
+
+    BC_CASE(BC_WRITE_C)
+        putchar(SLOT(a).i);
+        pc++;
+        BC_NEXT;
+    BC_CASE(BC_WRITE_I)
+        printf("%d", SLOT(a).i);
+        pc++;
+        BC_NEXT;
+    BC_CASE(BC_WRITE_R)
+        printf("%lg", SLOT(a).r);
+        pc++;
+        BC_NEXT;
+    BC_CASE(BC_NEWLINE)
+        putchar('\n');
+        pc++;
+        BC_NEXT;
+    /* A READ which finds nothing leaves its variable as it was */
+    BC_CASE(BC_READ_C)
+        if(scanf(" %c", &character) == 1) SLOT(dest).i = character;
+        pc++;
+        BC_NEXT;
+    BC_CASE(BC_READ_I)
+        (void)scanf("%d", &SLOT(dest).i);
+        pc++;
+        BC_NEXT;
+    BC_CASE(BC_READ_R)
+        (void)scanf("%lg", &SLOT(dest).r);
+        pc++;
+        BC_NEXT;
+
+    BC_CASE(BC_JUMP)
+        pc = code + pc->dest;
+        BC_NEXT;
+    FOREACH_BC_COMPARISON(RUN_BC_COMPARISON)
+
+    /* As spl_trips in the generated C: a step of zero counts down for ever */
+    BC_CASE(BC_TRIPS)
+        from = SLOT(a).i;
+        to = SLOT(b).i;
+        by = SLOT(c).i;
+        if(by > 0) SLOT(dest).n = from <= to ? (unsigned long long)(to - from) / by + 1 : 0;
+        else if(by < 0) SLOT(dest).n = from >= to ? (unsigned long long)(from - to) / -by + 1 : 0;
+        else SLOT(dest).n = from >= to ? ~0ull : 0;
+        pc++;
+        BC_NEXT;
+    BC_CASE(BC_COUNT)
+        BC_BRANCH(SLOT(a).n-- != 0)
+#ifndef BC_THREADED
+    default:
+        goto halted;
+    }
+#endif
+
+divide_error:
+    fflush(stdout);
+    fprintf(stderr, "Error : %s\n", SLOT(b).i == 0 ? "Division by zero" : "Division overflow");
+    status = 1;
+halted:
+    free(slots);
+    return status;
+}
+
+#undef BC_CASE
+#undef BC_NEXT
+#undef SLOT
+#undef BC_BRANCH
+#undef WRAPPING_ADD